@@ -0,0 +1,259 @@
+import javax.tools.JavaCompiler;
+import javax.tools.ToolProvider;
+import java.io.IOException;
+import java.net.URL;
+import java.net.URLClassLoader;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.HashMap;
+import java.util.LinkedHashMap;
+import java.util.List;
+import java.util.Locale;
+import java.util.Map;
+import java.util.regex.Matcher;
+import java.util.regex.Pattern;
+
+/**
+ * Benchmark harness that measures what a single {@code memdbgvis.visualize()} hit costs the application.
+ * <br><br>
+ * The harness generates a workload class with a tunable shape, compiles it with debug information so that the agent
+ * can read its local variable table, and calls {@code memdbgvis.visualize()} from inside it repeatedly. The agent must
+ * be loaded in its non-interactive benchmark mode, which appends one JSON line per hit with the time spent in each
+ * agent phase and the payload size:
+ * <br><br>
+ * {@code java -agentpath:C:\path\to\memdbgvis.dll=bench=C:\path\to\agent.jsonl -cp memdbgvis.jar;. CaptureBenchmark
+ * --agent-log C:\path\to\agent.jsonl --locals 16 --array 10000 --string 4096 --statics 16 --graph 8 --depth 32 --iterations 200}
+ * <br><br>
+ * The summary (p50/p99 of the end-to-end time and of every agent phase, the payload size, and the throughput of the
+ * agent's string capture and of its heap dumps in GB/s) is printed as JSON and optionally written to the file given by
+ * {@code --out}. Heap dumps are only written with the agent's {@code hprof} option, and {@code --heap-mb} fills the heap
+ * with that much live data first.
+ * <br><br>
+ * Nothing in the harness depends on the platform, use {@code :} instead of {@code ;} in the class path on Linux and
+ * macOS. The agent is only built for Windows so far, so that is where results are recorded; every summary names the
+ * operating system and Java version it was taken on.
+ *
+ * @author VJZ
+ * @version 1.0.0
+ */
+public final class CaptureBenchmark {
+    private static final Pattern JSON_NUMBER = Pattern.compile("\"(\\w+)\":(\\d+)");
+    private static long[] endToEndNanos;
+    private static int hitIndex;
+
+    private CaptureBenchmark() {
+    }
+
+    /**
+     * Entry point of the harness. See the class documentation for the accepted arguments.
+     * @param args command line arguments in the form {@code --name value}
+     * @throws Exception if the workload cannot be generated, compiled or run
+     */
+    public static void main(String[] args) throws Exception {
+        final Map<String, String> options = parseArguments(args);
+        final int locals = Integer.parseInt(options.getOrDefault("locals", "8"));
+        final int arraySize = Integer.parseInt(options.getOrDefault("array", "1000"));
+        final int stringLength = Integer.parseInt(options.getOrDefault("string", "16"));
+        final int statics = Integer.parseInt(options.getOrDefault("statics", "8"));
+        final int graphDepth = Integer.parseInt(options.getOrDefault("graph", "4"));
+        final int stackDepth = Integer.parseInt(options.getOrDefault("depth", "8"));
+        final int warmup = Integer.parseInt(options.getOrDefault("warmup", "10"));
+        final int iterations = Integer.parseInt(options.getOrDefault("iterations", "100"));
+        final int heapMegabytes = Integer.parseInt(options.getOrDefault("heap-mb", "0"));
+        final Path agentLog = Path.of(options.getOrDefault("agent-log", "memdbgvis.bench.jsonl"));
+
+        // start from an empty agent log so that line N belongs to hit N
+        Files.deleteIfExists(agentLog);
+
+        final Class<?> workload = compileWorkload(generateWorkload(locals, arraySize, stringLength, statics, graphDepth, heapMegabytes));
+        final Runnable run = (Runnable) workload.getMethod("create", int.class).invoke(null, stackDepth);
+
+        endToEndNanos = new long[warmup + iterations];
+        for (int i = 0; i < warmup + iterations; i++)
+            run.run();
+
+        final String summary = summarize(options, Arrays.copyOfRange(endToEndNanos, warmup, endToEndNanos.length), agentLog, warmup);
+        System.out.println(summary);
+
+        if (options.containsKey("out"))
+            Files.writeString(Path.of(options.get("out")), summary + System.lineSeparator());
+    }
+
+    /**
+     * Called by the generated workload right after {@code memdbgvis.visualize()} returns.
+     * @param nanos time between the call to {@code visualize()} and the thread resuming
+     */
+    public static void record(long nanos) {
+        endToEndNanos[hitIndex++] = nanos;
+    }
+
+    private static Map<String, String> parseArguments(String[] args) {
+        final Map<String, String> options = new HashMap<>();
+        for (int i = 0; i + 1 < args.length; i += 2) {
+            if (!args[i].startsWith("--"))
+                throw new IllegalArgumentException("Unexpected argument: " + args[i]);
+            options.put(args[i].substring(2), args[i + 1]);
+        }
+        return options;
+    }
+
+    /**
+     * Generates the source of a workload class. Local variables and static fields rotate through primitive values,
+     * strings, primitive arrays and object arrays so that every formatting path of the agent is exercised. The heap can
+     * be filled with live ballast, half arrays and half small objects, to measure heap dumps of a realistic size.
+     */
+    private static String generateWorkload(int locals, int arraySize, int stringLength, int statics, int graphDepth, int heapMegabytes) {
+        final StringBuilder source = new StringBuilder();
+        source.append("import com.vjzcorp.jvmtools.memdbgvis;\n");
+        source.append("public final class CaptureWorkload implements Runnable {\n");
+        source.append("    static final class Node {\n");
+        source.append("        final int value; final Node next;\n");
+        source.append("        Node(int value, Node next) { this.value = value; this.next = next; }\n");
+        source.append("        @Override public String toString() { return \"Node(\" + value + (next == null ? \"\" : \", \" + next) + \")\"; }\n");
+        source.append("    }\n");
+
+        for (int i = 0; i < statics; i++)
+            source.append("    static ").append(declaration(i, "s" + i, arraySize, stringLength, graphDepth)).append('\n');
+
+        source.append("    static final Object[] BALLAST = ballast(").append(heapMegabytes).append(");\n");
+        source.append("    private final int depth;\n");
+        source.append("    private CaptureWorkload(int depth) { this.depth = depth; }\n");
+        source.append("    public static Runnable create(int depth) { return new CaptureWorkload(depth); }\n");
+        source.append("    static Object[] objects(int length) { Object[] array = new Object[length]; for (int i = 0; i < length; i++) array[i] = i; return array; }\n");
+        // mostly ASCII text with line breaks, delimiters and non-ASCII characters mixed in, like real log messages
+        source.append("    static String text(int length, int seed) { StringBuilder text = new StringBuilder(length); for (int i = 0; i < length; i++) text.append(i % 64 == 63 ? '\\n' : i % 97 == 96 ? '\\u00e9' : (char) ('a' + (i + seed) % 26)); return text.toString(); }\n");
+        source.append("    static Node graph(int depth) { Node node = null; for (int i = depth; i > 0; i--) node = new Node(i, node); return node; }\n");
+        source.append("    static Object[] ballast(int megabytes) { Object[] ballast = new Object[2 * megabytes]; for (int i = 0; i < megabytes; i++) { ballast[2 * i] = new long[65536]; ballast[2 * i + 1] = graph(21845); } return ballast; }\n");
+        source.append("    @Override public void run() { descend(depth); }\n");
+        source.append("    private void descend(int remaining) { if (remaining > 1) descend(remaining - 1); else hit(); }\n");
+        source.append("    private void hit() {\n");
+
+        for (int i = 0; i < locals; i++)
+            source.append("        ").append(declaration(i, "l" + i, arraySize, stringLength, graphDepth)).append('\n');
+
+        source.append("        final long start = System.nanoTime();\n");
+        source.append("        memdbgvis.visualize();\n");
+        source.append("        CaptureBenchmark.record(System.nanoTime() - start);\n");
+
+        // keep every local alive across the breakpoint
+        source.append("        if (System.nanoTime() == 0) System.out.println(");
+        for (int i = 0; i < locals; i++)
+            source.append("String.valueOf(l").append(i).append(") + ");
+        source.append("\"\");\n");
+        source.append("    }\n");
+        source.append("}\n");
+        return source.toString();
+    }
+
+    private static String declaration(int index, String name, int arraySize, int stringLength, int graphDepth) {
+        switch (index % 8) {
+            case 0: return "int " + name + " = " + index + ";";
+            case 1: return "double " + name + " = " + index + ".5;";
+            case 2: return "long " + name + " = " + index + "L;";
+            case 3: return "String " + name + " = text(" + stringLength + ", " + index + ");";
+            case 4: return "int[] " + name + " = new int[" + arraySize + "];";
+            case 5: return "double[] " + name + " = new double[" + arraySize + "];";
+            case 6: return "Object[] " + name + " = objects(" + arraySize + ");";
+            default: return "Node " + name + " = graph(" + graphDepth + ");";
+        }
+    }
+
+    private static Class<?> compileWorkload(String source) throws IOException, ClassNotFoundException {
+        final Path directory = Files.createTempDirectory("memdbgvis-bench");
+        final Path file = directory.resolve("CaptureWorkload.java");
+        Files.writeString(file, source);
+
+        // the agent reads local variables through the local variable table, so debug information is required
+        final JavaCompiler compiler = ToolProvider.getSystemJavaCompiler();
+        if (compiler == null)
+            throw new IllegalStateException("A JDK is required to compile the generated workload.");
+
+        final int status = compiler.run(null, null, null, "-g", "-cp", System.getProperty("java.class.path"), "-d", directory.toString(), file.toString());
+        if (status != 0)
+            throw new IllegalStateException("The generated workload failed to compile.");
+
+        final URLClassLoader loader = new URLClassLoader(new URL[] { directory.toUri().toURL() }, CaptureBenchmark.class.getClassLoader());
+        return loader.loadClass("CaptureWorkload");
+    }
+
+    private static String summarize(Map<String, String> options, long[] endToEnd, Path agentLog, int warmup) throws IOException {
+        final Map<String, List<Long>> series = new LinkedHashMap<>();
+        for (long nanos : endToEnd)
+            series.computeIfAbsent("end_to_end_ns", key -> new ArrayList<>()).add(nanos);
+
+        // agent records are numbered by hit, skip the ones that belong to the warmup
+        if (Files.exists(agentLog)) {
+            final List<String> lines = awaitAgentRecords(agentLog, warmup + endToEnd.length);
+            for (String line : lines.subList(Math.min(warmup, lines.size()), lines.size())) {
+                final Matcher matcher = JSON_NUMBER.matcher(line);
+                while (matcher.find()) {
+                    if (!matcher.group(1).equals("hit"))
+                        series.computeIfAbsent(matcher.group(1), key -> new ArrayList<>()).add(Long.parseLong(matcher.group(2)));
+                }
+            }
+        }
+
+        final StringBuilder json = new StringBuilder("{\"config\":{");
+        boolean first = true;
+        for (Map.Entry<String, String> option : options.entrySet()) {
+            json.append(first ? "" : ",").append('"').append(option.getKey()).append("\":\"").append(option.getValue().replace("\\", "\\\\")).append('"');
+            first = false;
+        }
+
+        // results are compared across runs, so the machine they were taken on is part of them
+        json.append("},\"os\":\"").append(System.getProperty("os.name")).append(' ').append(System.getProperty("os.arch"))
+            .append("\",\"java\":\"").append(System.getProperty("java.version")).append('"');
+        json.append(",\"samples\":").append(endToEnd.length).append(",\"metrics\":{");
+        first = true;
+        for (Map.Entry<String, List<Long>> entry : series.entrySet()) {
+            final long[] values = entry.getValue().stream().mapToLong(Long::longValue).sorted().toArray();
+            if (values.length == 0)
+                continue;
+
+            json.append(first ? "" : ",").append('"').append(entry.getKey()).append("\":{\"p50\":").append(percentile(values, 0.50))
+                .append(",\"p99\":").append(percentile(values, 0.99)).append(",\"max\":").append(values[values.length - 1]).append('}');
+            first = false;
+        }
+
+        // bytes per nanosecond is the same as gigabytes per second
+        json.append('}');
+        final long stringBytes = series.getOrDefault("string_bytes", List.of()).stream().mapToLong(Long::longValue).sum();
+        final long stringNanos = series.getOrDefault("string_ns", List.of()).stream().mapToLong(Long::longValue).sum();
+        if (stringNanos > 0)
+            json.append(",\"string_gbps\":").append(String.format(Locale.ROOT, "%.3f", (double) stringBytes / stringNanos));
+        final long dumpBytes = series.getOrDefault("hprof_bytes", List.of()).stream().mapToLong(Long::longValue).sum();
+        final long dumpNanos = series.getOrDefault("heap_dump", List.of()).stream().mapToLong(Long::longValue).sum();
+        if (dumpBytes > 0 && dumpNanos > 0)
+            json.append(",\"hprof_gbps\":").append(String.format(Locale.ROOT, "%.3f", (double) dumpBytes / dumpNanos));
+
+        return json.append('}').toString();
+    }
+
+    /**
+     * The agent writes the record of a hit after the thread has resumed, so the last records may still be on their way.
+     * @param agentLog agent log written in benchmark mode
+     * @param expected number of records the run produces
+     * @return the records written within a few seconds
+     * @throws IOException if the log cannot be read
+     */
+    private static List<String> awaitAgentRecords(Path agentLog, int expected) throws IOException {
+        final long deadline = System.nanoTime() + 10_000_000_000L;
+        List<String> lines = Files.readAllLines(agentLog);
+        while (lines.size() < expected && System.nanoTime() < deadline) {
+            try {
+                Thread.sleep(10);
+            } catch (InterruptedException e) {
+                Thread.currentThread().interrupt();
+                break;
+            }
+            lines = Files.readAllLines(agentLog);
+        }
+        return lines;
+    }
+
+    private static long percentile(long[] sorted, double fraction) {
+        return sorted[(int) Math.min(sorted.length - 1, Math.ceil(fraction * sorted.length) - 1)];
+    }
+}
\ No newline at end of file
@@ -10,28 +10,40 @@ JNIEXPORT jint JNICALL Agent_OnLoad(JavaVM* vm, char* options, void* reserved)
 	if (result != JNI_OK)
 		return result;
 
-	// set capabilities for the agent
-	jvmtiCapabilities capabilities = {};
-	capabilities.can_generate_exception_events = JNI_TRUE;
-	capabilities.can_access_local_variables = JNI_TRUE;
-	jvmtiError error = jvmti->AddCapabilities(&capabilities);
-	if (Agent::catchJVMTIError(jvmti, error, "Unable to set agent capabilities."))
-		return JNI_ERR;
+	Agent::environment = jvmti;
+	return Agent::attach(jvmti, nullptr, options);
+}
 
-	// set the event notification mode
-	error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_EXCEPTION_CATCH, nullptr);
-	if (Agent::catchJVMTIError(jvmti, error, "Cannot set event notification mode."))
-		return JNI_ERR;
+// entrypoint when the agent is loaded into a running JVM, for example jcmd <pid> JVMTI.agent_load C:\path\to\memdbgvis.dll headless
+// loading it again replaces the options, and loading it with the detach option turns the agent off
+JNIEXPORT jint JNICALL Agent_OnAttach(JavaVM* vm, char* options, void* reserved)
+{
+	JNIEnv* env;
+	jint result = vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_8);
+	if (result != JNI_OK)
+		return result;
 
-	// assign a callback as a event handler
-	jvmtiEventCallbacks callbacks = {};
-	callbacks.ExceptionCatch = &Agent::callbackEventHandler;
-	error = jvmti->SetEventCallbacks(&callbacks, sizeof callbacks);
-	if (Agent::catchJVMTIError(jvmti, error, "Cannot set event callbacks."))
-		return JNI_ERR;
+	// the library stays loaded between attaches, so every attach reuses the same JVMTI environment
+	if (Agent::environment == nullptr)
+	{
+		result = vm->GetEnv(reinterpret_cast<void**>(&Agent::environment), JVMTI_VERSION);
+		if (result != JNI_OK)
+			return result;
+	}
 
-	// return OK status if everything works
-	return JNI_OK;
+	Agent::detach(Agent::environment, env);
+	if (AgentOptions(options).has("detach"))
+		return JNI_OK;
+	return Agent::attach(Agent::environment, env, options);
+}
+
+// native method of the Java wrapper class that exports the capture histograms on demand
+extern "C" JNIEXPORT jboolean JNICALL Java_com_vjzcorp_jvmtools_memdbgvis_exportCaptureMetrics0(JNIEnv* env, jclass klass, jstring path)
+{
+	const char* cpath = env->GetStringUTFChars(path, nullptr);
+	const bool success = Agent::captureHistograms.exportTo(cpath);
+	env->ReleaseStringUTFChars(path, cpath);
+	return success ? JNI_TRUE : JNI_FALSE;
 }
 
 // function that handles JVMTI errors
@@ -51,6 +63,275 @@ static bool Agent::catchJVMTIError(jvmtiEnv* jvmti, jvmtiError error, const std:
 	return true;
 }
 
+// adds the capabilities and enables the events the options ask for, env is null while the VM is still starting
+static jint Agent::attach(jvmtiEnv* jvmti, JNIEnv* env, const char* options)
+{
+	std::lock_guard lock(Agent::attachMutex);
+
+	// the configuration is parsed and trimmed to the capabilities the VM grants, and only published once it is complete
+	const auto config = std::make_shared<AgentConfig>(options);
+	Agent::capturesUntilDetach.store(std::max(config->options.getNumber("count", 0), 0LL), std::memory_order_relaxed);
+
+	// a condition that does not parse is reported once and then ignored, so its captures still happen
+	std::vector<std::string> condition_errors = config->lineBreakpoints.conditionErrors();
+	if (!config->visualizeCondition.error().empty())
+		condition_errors.push_back("when: " + config->visualizeCondition.error());
+	std::string message;
+	if (!condition_errors.empty())
+	{
+		message = "Invalid capture conditions are ignored.";
+		for (const std::string& condition_error : condition_errors)
+			message += "\n" + condition_error;
+	}
+
+	// a watch that does not parse is left out entirely, ignoring only its condition would stop at every write
+	if (!config->fieldWatches.errors().empty())
+	{
+		message += message.empty() ? "Invalid watches are not armed." : "\nInvalid watches are not armed.";
+		for (const std::string& watch_error : config->fieldWatches.errors())
+			message += "\n" + watch_error;
+	}
+	if (!message.empty())
+		VisualizerProcComm::displayErrorDialog(std::wstring(message.begin(), message.end()).c_str());
+
+	// the archive stays open across attaches, by default it is the memdbgvis.archive folder next to the agent
+	if (config->options.has("archive"))
+	{
+		const std::string directory = config->options.get("archive");
+		const std::wstring path = directory.empty() ? VisualizerProcComm().dataFilePath(L"archive") : std::wstring(directory.begin(), directory.end());
+		const long long segment_bytes = config->options.getNumber("archivemb", SnapshotArchive::DEFAULT_SEGMENT_MB) << 20;
+		if (!Agent::snapshotArchive.open(path, segment_bytes, config->options.getNumber("archivesegments", SnapshotArchive::DEFAULT_SEGMENTS)))
+			VisualizerProcComm::displayErrorDialog((L"Cannot open the snapshot archive: " + path + (Agent::snapshotArchive.error().empty() ? L"" : L"\n" + Agent::snapshotArchive.error())).c_str());
+	}
+
+	// heap data is formatted on one worker per spare core unless set otherwise, with no workers it is formatted by the capturing thread
+	const long long workers = config->options.getNumber("workers", static_cast<long long>(std::thread::hardware_concurrency()) - 1);
+	Agent::capturePipeline.start(static_cast<size_t>(std::clamp<long long>(workers, 0, 64)));
+
+	// HotSpot only hands out some capabilities while the VM starts, so a live attach asks for the ones still available
+	// capabilities an earlier attach kept are available as well, the features that need any other are turned off and listed
+	jvmtiCapabilities potential = {};
+	jvmtiError error = jvmti->GetPotentialCapabilities(&potential);
+	if (Agent::catchJVMTIError(jvmti, error, "Cannot get potential capabilities."))
+		return JNI_ERR;
+
+	std::vector<std::string> unavailable;
+	const auto grant = [&unavailable](const bool wanted, const bool available, const char* feature)
+	{
+		if (wanted && !available)
+			unavailable.push_back(feature);
+		return wanted && available ? 1u : 0u;
+	};
+	jvmtiCapabilities& capabilities = config->capabilities;
+	capabilities.can_generate_exception_events = grant(true, potential.can_generate_exception_events, "memdbgvis.visualize() captures");
+	capabilities.can_access_local_variables = grant(true, potential.can_access_local_variables, "local variables");
+	capabilities.can_get_line_numbers = grant(true, potential.can_get_line_numbers, "line numbers");
+	capabilities.can_tag_objects = grant(true, potential.can_tag_objects, "object tags");
+	capabilities.can_generate_garbage_collection_events = grant(true, potential.can_generate_garbage_collection_events, "garbage collection pauses");
+	capabilities.can_generate_sampled_object_alloc_events = grant(config->options.has("allocsample"), potential.can_generate_sampled_object_alloc_events, "allocsample");
+	capabilities.can_generate_field_modification_events = grant(!config->fieldWatches.empty(), potential.can_generate_field_modification_events, "watch");
+	capabilities.can_generate_breakpoint_events = grant(!config->lineBreakpoints.empty(), potential.can_generate_breakpoint_events && potential.can_get_line_numbers, "break");
+	capabilities.can_generate_object_free_events = grant(config->options.has("incremental"), potential.can_generate_object_free_events, "incremental");
+	const unsigned int monitors = grant(config->options.has("monitors"), potential.can_get_owned_monitor_stack_depth_info && potential.can_get_current_contended_monitor, "monitors");
+	capabilities.can_get_owned_monitor_stack_depth_info = monitors;
+	capabilities.can_get_current_contended_monitor = monitors;
+	capabilities.can_generate_monitor_events = grant(config->options.has("contention"), potential.can_generate_monitor_events, "contention");
+	error = jvmti->AddCapabilities(&capabilities);
+	if (Agent::catchJVMTIError(jvmti, error, "Unable to set agent capabilities."))
+		return JNI_ERR;
+
+	// the configuration is still private, so the features without their capability are dropped from it before anything reads it
+	if (!capabilities.can_generate_field_modification_events)
+		config->fieldWatches.parse("");
+	if (!capabilities.can_generate_breakpoint_events)
+		config->lineBreakpoints.parse("");
+	if (!capabilities.can_generate_sampled_object_alloc_events)
+		config->options.erase("allocsample");
+	if (!capabilities.can_generate_object_free_events)
+		config->options.erase("incremental");
+	if (!monitors)
+		config->options.erase("monitors");
+	if (!capabilities.can_generate_monitor_events)
+		config->options.erase("contention");
+	if (!unavailable.empty())
+	{
+		std::string message = "Not available to an agent attached to a running VM, turned off:";
+		for (const std::string& feature : unavailable)
+			message += "\n" + feature;
+		VisualizerProcComm::displayErrorDialog(std::wstring(message.begin(), message.end()).c_str());
+	}
+
+	// capabilities added while the VM starts may not be available again, so detaching keeps them
+	if (env == nullptr)
+		Agent::onLoadCapabilities = capabilities;
+
+	// from here on a detach undoes whatever was enabled, even if a later step fails
+	Agent::config.store(config);
+	Agent::attached = true;
+
+	// allocation sampling is off unless requested, the value is the mean number of bytes between samples
+	if (config->options.has("allocsample"))
+	{
+		const auto interval = static_cast<jint>(std::clamp<long long>(config->options.getNumber("allocsample", AllocationSampler::DEFAULT_INTERVAL), 0, std::numeric_limits<jint>::max()));
+		Agent::allocationSampler.setInterval(interval);
+		error = jvmti->SetHeapSamplingInterval(interval);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot set heap sampling interval."))
+			return JNI_ERR;
+
+		error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_SAMPLED_OBJECT_ALLOC, nullptr);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot enable allocation sampling."))
+			return JNI_ERR;
+	}
+
+	// set the event notification mode
+	if (capabilities.can_generate_exception_events)
+	{
+		error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_EXCEPTION_CATCH, nullptr);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot set event notification mode."))
+			return JNI_ERR;
+	}
+
+	// the archived contents of objects are forgotten once the objects are collected
+	if (config->options.has("incremental"))
+	{
+		error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_OBJECT_FREE, nullptr);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot enable object free events."))
+			return JNI_ERR;
+	}
+
+	// contended monitor entries are timed from the moment a thread blocks until it owns the monitor
+	if (config->options.has("contention"))
+	{
+		error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_MONITOR_CONTENDED_ENTER, nullptr);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot enable monitor contention events."))
+			return JNI_ERR;
+		error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_MONITOR_CONTENDED_ENTERED, nullptr);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot enable monitor contention events."))
+			return JNI_ERR;
+	}
+
+	// snapshots still being formatted when the program ends are written before the VM goes away
+	error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_VM_DEATH, nullptr);
+	if (Agent::catchJVMTIError(jvmti, error, "Cannot enable VM death events."))
+		return JNI_ERR;
+
+	// the sampler threads can only be started once the VM is initialized, and triggers in classes loaded before then are armed there
+	const bool triggers = !config->fieldWatches.empty() || !config->lineBreakpoints.empty();
+	if (env == nullptr && (config->options.getNumber("sampler", MetricsSampler::DEFAULT_INTERVAL_MS) > 0 || config->options.has("profile") || triggers))
+	{
+		error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_VM_INIT, nullptr);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot enable VM initialization events."))
+			return JNI_ERR;
+	}
+
+	// watches and breakpoints are armed when the class declaring them is prepared
+	if (triggers)
+	{
+		error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_CLASS_PREPARE, nullptr);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot enable class prepare events."))
+			return JNI_ERR;
+	}
+	if (!config->fieldWatches.empty())
+	{
+		error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_FIELD_MODIFICATION, nullptr);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot enable field modification events."))
+			return JNI_ERR;
+	}
+	if (!config->lineBreakpoints.empty())
+	{
+		error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_BREAKPOINT, nullptr);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot enable breakpoint events."))
+			return JNI_ERR;
+	}
+
+	// garbage collection pauses are timed natively for the runtime metrics
+	if (capabilities.can_generate_garbage_collection_events)
+	{
+		error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_GARBAGE_COLLECTION_START, nullptr);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot enable garbage collection events."))
+			return JNI_ERR;
+		error = jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_GARBAGE_COLLECTION_FINISH, nullptr);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot enable garbage collection events."))
+			return JNI_ERR;
+	}
+
+	// assign a callback as a event handler
+	jvmtiEventCallbacks callbacks = {};
+	callbacks.ExceptionCatch = &Agent::callbackEventHandler;
+	callbacks.VMInit = &Agent::callbackVMInit;
+	callbacks.VMDeath = &Agent::callbackVMDeath;
+	callbacks.ClassPrepare = &Agent::callbackClassPrepare;
+	callbacks.FieldModification = &Agent::callbackFieldModification;
+	callbacks.Breakpoint = &Agent::callbackBreakpoint;
+	callbacks.GarbageCollectionStart = &Agent::callbackGarbageCollectionStart;
+	callbacks.GarbageCollectionFinish = &Agent::callbackGarbageCollectionFinish;
+	callbacks.SampledObjectAlloc = &Agent::callbackSampledObjectAlloc;
+	callbacks.ObjectFree = &Agent::callbackObjectFree;
+	callbacks.MonitorContendedEnter = &Agent::callbackMonitorContendedEnter;
+	callbacks.MonitorContendedEntered = &Agent::callbackMonitorContendedEntered;
+	error = jvmti->SetEventCallbacks(&callbacks, sizeof callbacks);
+	if (Agent::catchJVMTIError(jvmti, error, "Cannot set event callbacks."))
+		return JNI_ERR;
+
+	// a running VM sends no VMInit event, so the sampler is started and loaded classes are armed right away
+	if (env != nullptr)
+		Agent::callbackVMInit(jvmti, env, nullptr);
+
+	// return OK status if everything works
+	return JNI_OK;
+}
+
+// turns every event off, clears watches and breakpoints and gives the capabilities back, so the VM runs at full speed again
+static void Agent::detach(jvmtiEnv* jvmti, JNIEnv* env)
+{
+	std::lock_guard lock(Agent::attachMutex);
+	if (!Agent::attached)
+		return;
+	Agent::attached = false;
+	const std::shared_ptr<AgentConfig> config = Agent::config.load();
+
+	// VM death stays enabled, it costs nothing and still writes the snapshots taken before the detach
+	for (const jvmtiEvent event : { JVMTI_EVENT_EXCEPTION_CATCH, JVMTI_EVENT_VM_INIT, JVMTI_EVENT_CLASS_PREPARE, JVMTI_EVENT_FIELD_MODIFICATION, JVMTI_EVENT_BREAKPOINT,
+		JVMTI_EVENT_GARBAGE_COLLECTION_START, JVMTI_EVENT_GARBAGE_COLLECTION_FINISH, JVMTI_EVENT_SAMPLED_OBJECT_ALLOC, JVMTI_EVENT_OBJECT_FREE,
+		JVMTI_EVENT_MONITOR_CONTENDED_ENTER, JVMTI_EVENT_MONITOR_CONTENDED_ENTERED })
+		static_cast<void>(jvmti->SetEventNotificationMode(JVMTI_DISABLE, event, nullptr));
+
+	config->fieldWatches.disarm(jvmti, env);
+	config->lineBreakpoints.disarm(jvmti);
+	Agent::metricsSampler.stop();
+	Agent::stackProfiler.stop();
+
+	// without object free events the archived contents could outlive their objects, so the next attach starts over
+	Agent::objectTags.clear();
+
+	// capabilities such as local variable access and breakpoints keep the JIT from optimizing fully while they are held
+	// those added while the VM started are kept, since a later attach could not get them back, and their events stay off
+	jvmtiCapabilities capabilities = {};
+	if (jvmti->GetCapabilities(&capabilities) != JVMTI_ERROR_NONE)
+		return;
+	std::array<unsigned char, sizeof capabilities> held, kept;
+	std::memcpy(held.data(), &capabilities, sizeof capabilities);
+	std::memcpy(kept.data(), &Agent::onLoadCapabilities, sizeof capabilities);
+	for (size_t i = 0; i < held.size(); i++)
+		held[i] &= static_cast<unsigned char>(~kept[i]);
+	std::memcpy(&capabilities, held.data(), sizeof capabilities);
+	static_cast<void>(jvmti->RelinquishCapabilities(&capabilities));
+}
+
+// the count option detaches the agent by itself once enough snapshots have been taken
+static void Agent::countCapture(jvmtiEnv* jvmti, JNIEnv* env)
+{
+	long long remaining = Agent::capturesUntilDetach.load(std::memory_order_relaxed);
+	do
+	{
+		if (remaining <= 0)
+			return;
+	} while (!Agent::capturesUntilDetach.compare_exchange_weak(remaining, remaining - 1, std::memory_order_relaxed));
+
+	if (remaining == 1)
+		Agent::detach(jvmti, env);
+}
+
 // core backbone callback function that handles critical operations of the agent
 static void Agent::callbackEventHandler(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location, jobject exception)
 {
@@ -64,6 +345,50 @@ static void Agent::callbackEventHandler(jvmtiEnv* jvmti, JNIEnv* env, jthread th
 	// visualizer invoked only if called from memdbgvis exception class
 	if (std::string(exception_signature) != "Lcom/vjzcorp/jvmtools/memdbgvis;")
 		return;
+	const std::shared_ptr<AgentConfig> config = Agent::config.load();
+
+	// the condition is evaluated in the caller of visualize(), calls that fail it only pay for the evaluation
+	std::string trigger = "memdbgvis.visualize()";
+	if (!config->visualizeCondition.empty())
+	{
+		jmethodID caller;
+		jlocation caller_location;
+		error = jvmti->GetFrameLocation(thread, 1, &caller, &caller_location);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot get caller frame location."))
+			return;
+
+		if (!config->visualizeCondition.evaluate({ jvmti, env, thread, 1, nullptr }, caller, caller_location))
+			return;
+		trigger += " when " + config->visualizeCondition.source();
+	}
+
+	// the frame at depth 0 is visualize() itself, the snapshot is taken of its caller
+	Agent::capturing = true;
+	Agent::captureSnapshot(jvmti, env, thread, 1, exception_class, trigger);
+	Agent::capturing = false;
+	Agent::countCapture(jvmti, env);
+}
+
+// takes a snapshot of the frame at the given depth of the thread's stack and shows it, shared by every kind of trigger
+static void Agent::captureSnapshot(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, const jint depth, jclass agent_class, const std::string& trigger)
+{
+	jvmtiError error;
+
+	// time every phase of the capture and count the bytes that every phase adds to the payload
+	// the capture is shared with the pipeline, which may still be formatting it after the thread resumed
+	// entries are written into an arena taken from the pool, so a value costs no allocation of its own
+	const auto capture = std::make_shared<PendingCapture>();
+	capture->config = Agent::config.load();
+	const AgentConfig* config = capture->config.get();
+	capture->arena = Agent::payloadArenas.acquire();
+	CaptureMetrics& capture_metrics = capture->metrics;
+	PayloadArena& arena = *capture->arena;
+	VisualizerPayload& payload = capture->payload;
+	const auto emit = [&capture_metrics](std::vector<std::string_view>& section, const std::string_view entry)
+	{
+		capture_metrics.count(CaptureCounter::BytesProduced, static_cast<long long>(entry.size()) + 1);
+		section.push_back(entry);
+	};
 
 	// get stack depth
 	jint count;
@@ -73,33 +398,125 @@ static void Agent::callbackEventHandler(jvmtiEnv* jvmti, JNIEnv* env, jthread th
 
 	// initialize array of stack frames
 	const auto frames = std::make_unique<jvmtiFrameInfo[]>(count);
-	error = jvmti->GetStackTrace(thread, 1, count, frames.get(), &count);
+	error = jvmti->GetStackTrace(thread, depth, count, frames.get(), &count);
 	if (Agent::catchJVMTIError(jvmti, error, "Cannot get stack frames."))
 		return;
+	if (count == 0)
+		return;
+	const jint frame_count = count;
 
 	// create visualizer communication objects
 	VisualizerProcComm visualizer;
-	VisualizerPayload payload;
-	jmethodID toStringMethod = env->GetMethodID(exception_class, "toString", "()Ljava/lang/String;");
+	payload.lineNum = Agent::lineNumbers.lineOf(jvmti, frames[0].method, frames[0].location);
+	payload.trigger = trigger;
+	ObjectRenderer renderer(jvmti, env, config->options, capture_metrics);
+	const bool interactive = !config->options.has("headless") && !config->options.has("bench");
+	DrillDownSession session(env, interactive);
+
+	// arrays and object bytes are only copied here, their entries are filled in once the pipeline has formatted them
+	// heap data is keyed by the object's tag, objects that could not be tagged fall back to their rendered text
+	capture->incremental = config->options.has("incremental") && Agent::snapshotArchive.isOpen();
+	const auto copy_heap = [&](const std::string& signature, jobject obj, const std::string& str, const jlong tag)
+	{
+		HeapCopy copy{};
+		std::string formatted;
+		if (!Agent::copyHeapData(env, agent_class, renderer, signature, obj, str, formatted, copy, capture_metrics))
+			return;
+		const std::string_view key = tag != 0 ? arena.concat({ "#", tag }) : arena.store(str);
+		if (!formatted.empty())
+		{
+			emit(payload.heapByteData, arena.join({ key, formatted }));
+			return;
+		}
+
+		copy.key = key;
+		copy.tag = tag;
+		copy.heapEntry = payload.heapByteData.size();
+		payload.heapByteData.emplace_back();
+		copy.hashEntry = payload.arrayBlockHashes.size();
+		if (copy.type != 'O')
+			payload.arrayBlockHashes.emplace_back();
+		capture->copies.push_back(std::move(copy));
+	};
 
 	// get thread info and load it into payload
 	error = jvmti->GetThreadInfo(thread, &payload.threadInfo);
 	if (Agent::catchJVMTIError(jvmti, error, "Cannot get current thread name."))
 		return;
+	capture_metrics.count(CaptureCounter::JNICalls, 4);
+	capture_metrics.lap(CapturePhase::StackWalk);
+
+	// get miscellaneous JVM metrics, only available when the wrapper class is visible from the captured frame
+	if (agent_class != nullptr)
+	{
+		jmethodID getRuntimeMetricsMethod = env->GetStaticMethodID(agent_class, "getRuntimeMetrics", "()Ljava/lang/String;");
+		auto jmetrics = reinterpret_cast<jstring>(env->CallStaticObjectMethod(agent_class, getRuntimeMetricsMethod));
+		const char* cmetrics = env->GetStringUTFChars(jmetrics, nullptr);
+
+		// one "name\avalue\aunit" metric per line, followed by the pauses the agent timed itself
+		for (std::string_view metrics_text(cmetrics); !metrics_text.empty();)
+		{
+			const size_t line_end = std::min(metrics_text.find('\n'), metrics_text.size());
+			emit(payload.metrics, arena.store(metrics_text.substr(0, line_end)));
+			metrics_text.remove_prefix(std::min(line_end + 1, metrics_text.size()));
+		}
+		env->ReleaseStringUTFChars(jmetrics, cmetrics);
+	}
+	for (const std::string& metric : Agent::gcMonitor.report())
+		emit(payload.metrics, arena.store(metric));
+	for (const std::string& metric : Agent::objectTags.report())
+		emit(payload.metrics, arena.store(metric));
+	for (const std::string& metric : config->fieldWatches.report())
+		emit(payload.metrics, arena.store(metric));
+	for (const std::string& metric : config->lineBreakpoints.report())
+		emit(payload.metrics, arena.store(metric));
+	for (const std::string& metric : config->visualizeCondition.report("visualize()"))
+		emit(payload.metrics, arena.store(metric));
+	for (const std::string& sample : Agent::metricsSampler.window())
+		emit(payload.metricsWindow, arena.store(sample));
+	capture_metrics.count(CaptureCounter::JNICalls, 4);
+	capture_metrics.lap(CapturePhase::RuntimeMetrics);
+
+	// allocation sites sampled since the previous capture
+	if (config->options.has("allocsample"))
+	{
+		for (const std::string& site : Agent::allocationSampler.report(jvmti, Agent::lineNumbers, static_cast<size_t>(config->options.getNumber("allocsites", AllocationSampler::DEFAULT_SITES))))
+			emit(payload.allocationSites, arena.store(site));
+	}
+	capture_metrics.lap(CapturePhase::AllocationSites);
+
+	// owned and contended monitors of every thread, and the monitors threads waited for the longest since the previous capture
+	if (config->options.has("monitors"))
+	{
+		MonitorGraph graph(jvmti, env);
+		if (graph.capture(Agent::objectTags))
+		{
+			for (const std::string& line : graph.serialize())
+				emit(payload.monitors, arena.store(line));
+			for (const std::string& metric : graph.report())
+				emit(payload.metrics, arena.store(metric));
+		}
+	}
+	if (config->options.has("contention"))
+	{
+		for (const std::string& line : Agent::monitorContention.report(jvmti, env, static_cast<size_t>(config->options.getNumber("contention", MonitorContention::DEFAULT_MONITORS))))
+			emit(payload.monitors, arena.store(line));
+	}
+	capture_metrics.lap(CapturePhase::Monitors);
 
-	// get miscellaneous JVM metrics
-	jmethodID getRuntimeMetricsMethod = env->GetStaticMethodID(exception_class, "getRuntimeMetrics", "()Ljava/lang/String;");
-	auto jmetrics = reinterpret_cast<jstring>(env->CallObjectMethod(env->CallStaticObjectMethod(exception_class, getRuntimeMetricsMethod), toStringMethod));
-	const char* cmetrics = env->GetStringUTFChars(jmetrics, nullptr);
-	payload.metrics = cmetrics;
-	env->ReleaseStringUTFChars(jmetrics, cmetrics);
+	// stacks of all threads sampled since the previous capture
+	if (config->options.has("profile"))
+	{
+		for (const std::string& line : Agent::stackProfiler.report(jvmti))
+			emit(payload.profile, arena.store(line));
+	}
+	capture_metrics.lap(CapturePhase::Profile);
 
 	// populate call stack view with method names
 	for (jint i = 0; i < count; i++)
 	{
 		char* method_name;
 		char* method_signature;
-		std::string decoded_signature;
 		jint modifiers;
 
 		error = jvmti->GetMethodName(frames[i].method, &method_name, &method_signature, nullptr);
@@ -107,23 +524,25 @@ static void Agent::callbackEventHandler(jvmtiEnv* jvmti, JNIEnv* env, jthread th
 			continue;
 
 		error = jvmti->GetMethodModifiers(frames[i].method, &modifiers);
+		capture_metrics.count(CaptureCounter::JNICalls, 2);
 		if (Agent::catchJVMTIError(jvmti, error, "Cannot get current method modifiers."))
 			continue;
 
-		// if method is static
-		if (modifiers & JVMTI_HEAP_REFERENCE_STATIC_FIELD)
-			decoded_signature = "static ";
-
-		// load method names into payload struct
-		decoded_signature += Agent::decodeJVMTypeSignature(std::string(method_name), std::string(method_signature), true);
-		payload.methodNames.emplace_back(decoded_signature);
+		// load method names into payload struct, static methods are marked as such
+		emit(payload.methodNames, Agent::internDeclaration(method_name, method_signature, (modifiers & JVMTI_HEAP_REFERENCE_STATIC_FIELD) != 0, true));
 	}
+	capture_metrics.lap(CapturePhase::CallStack);
 
-	// get local variables in current stack frame
+	// get local variables in current stack frame, an agent attached without access to them still reads the static fields
 	jvmtiLocalVariableEntry* local_var_table;
-	error = jvmti->GetLocalVariableTable(frames[0].method, &count, &local_var_table);
-	if (Agent::catchJVMTIError(jvmti, error, "Cannot get local variable table for current stack frame."))
-		goto serialize_launch;
+	local_var_table = nullptr;
+	count = 0;
+	if (config->capabilities.can_access_local_variables)
+	{
+		error = jvmti->GetLocalVariableTable(frames[0].method, &count, &local_var_table);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot get local variable table for current stack frame."))
+			goto serialize_launch;
+	}
 
 	// enumerate through all local variables
 	for (jint i = 0; i < count; i++)
@@ -132,227 +551,69 @@ static void Agent::callbackEventHandler(jvmtiEnv* jvmti, JNIEnv* env, jthread th
 		if (*local_var_table[i].signature == 'B' || *local_var_table[i].signature == 'S' || *local_var_table[i].signature == 'I' || *local_var_table[i].signature == 'C' || *local_var_table[i].signature == 'Z')
 		{
 			jint value;
-			error = jvmti->GetLocalInt(thread, 1, local_var_table[i].slot, &value);
+			error = jvmti->GetLocalInt(thread, depth, local_var_table[i].slot, &value);
+			capture_metrics.count(CaptureCounter::JNICalls);
 			if (Agent::catchJVMTIError(jvmti, error, "Cannot get local variable of integer type.", true))
 				continue;
-			payload.localVars.push_back(Agent::decodeJVMTypeSignature(local_var_table[i].name, local_var_table[i].signature) + '\a' + std::to_string(value));
+			emit(payload.localVars, arena.join({ Agent::internDeclaration(local_var_table[i].name, local_var_table[i].signature, false), value }));
 		}
 		else if (*local_var_table[i].signature == 'D') /* local variables of double type */
 		{
 			jdouble double_value;
-			error = jvmti->GetLocalDouble(thread, 1, local_var_table[i].slot, &double_value);
+			error = jvmti->GetLocalDouble(thread, depth, local_var_table[i].slot, &double_value);
+			capture_metrics.count(CaptureCounter::JNICalls);
 			if (Agent::catchJVMTIError(jvmti, error, "Cannot get local variable of double type.", true))
 				continue;
-			payload.localVars.push_back(Agent::decodeJVMTypeSignature(local_var_table[i].name, local_var_table[i].signature) + '\a' + std::to_string(double_value));
+			emit(payload.localVars, arena.join({ Agent::internDeclaration(local_var_table[i].name, local_var_table[i].signature, false), double_value }));
 		}
 		else if (*local_var_table[i].signature == 'F')  /* local variables of float type */
 		{
 			jfloat float_value;
-			error = jvmti->GetLocalFloat(thread, 1, local_var_table[i].slot, &float_value);
+			error = jvmti->GetLocalFloat(thread, depth, local_var_table[i].slot, &float_value);
+			capture_metrics.count(CaptureCounter::JNICalls);
 			if (Agent::catchJVMTIError(jvmti, error, "Cannot get local variable of float type.", true))
 				continue;
-			payload.localVars.push_back(Agent::decodeJVMTypeSignature(local_var_table[i].name, local_var_table[i].signature) + '\a' + std::to_string(float_value));
+			emit(payload.localVars, arena.join({ Agent::internDeclaration(local_var_table[i].name, local_var_table[i].signature, false), float_value }));
 		}
 		else if (*local_var_table[i].signature == 'J') /* local variables of long type */
 		{
 			jlong long_value;
-			error = jvmti->GetLocalLong(thread, 1, local_var_table[i].slot, &long_value);
+			error = jvmti->GetLocalLong(thread, depth, local_var_table[i].slot, &long_value);
+			capture_metrics.count(CaptureCounter::JNICalls);
 			if (Agent::catchJVMTIError(jvmti, error, "Cannot get local variable of long type.", true))
 				continue;
-			payload.localVars.push_back(Agent::decodeJVMTypeSignature(local_var_table[i].name, local_var_table[i].signature) + '\a' + std::to_string(long_value));
+			emit(payload.localVars, arena.join({ Agent::internDeclaration(local_var_table[i].name, local_var_table[i].signature, false), long_value }));
 		}
 		else if (*local_var_table[i].signature == '[' || *local_var_table[i].signature == 'L') /* local object references */
 		{
 			// get local object reference
 			jobject obj;
-			error = jvmti->GetLocalObject(thread, 1, local_var_table[i].slot, &obj);
+			error = jvmti->GetLocalObject(thread, depth, local_var_table[i].slot, &obj);
+			capture_metrics.count(CaptureCounter::JNICalls);
 			if (Agent::catchJVMTIError(jvmti, error, "Cannot get object reference.", true))
 				continue;
 
 			// null reference
 			if (obj == nullptr)
 			{
-				payload.localVars.push_back(Agent::decodeJVMTypeSignature(local_var_table[i].name, local_var_table[i].signature) + '\a' + "null");
+				emit(payload.localVars, arena.join({ Agent::internDeclaration(local_var_table[i].name, local_var_table[i].signature, false), "null" }));
 				continue;
 			}
 
-			// make it string serializable
-			auto jstr = reinterpret_cast<jstring>(env->CallObjectMethod(obj, toStringMethod));
-			const char* cstr = env->GetStringUTFChars(jstr, nullptr);
-			std::string str(cstr);
-			str = std::regex_replace(str, std::regex("\n"), "\\n");
-			str = std::regex_replace(str, std::regex("\r"), "\\r");
-			env->ReleaseStringUTFChars(jstr, cstr);
-			payload.localVars.push_back(Agent::decodeJVMTypeSignature(local_var_table[i].name, local_var_table[i].signature) + '\a' + str);
-
-			// get contents of array 
-			if (*local_var_table[i].signature == '[')
-			{
-				std::stringstream stream;
-				stream << "{ ";
-
-				if (std::string(local_var_table[i].signature).back() == 'I') /* int[] */
-				{
-					auto array = reinterpret_cast<jintArray>(obj);
-					jint* elements = env->GetIntArrayElements(array, nullptr);
-
-					for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-						stream << elements[j] << ", ";
-
-					stream << elements[env->GetArrayLength(array) - 1] << " }";
-					env->ReleaseIntArrayElements(array, elements, JNI_ABORT);
-				}
-				else if (std::string(local_var_table[i].signature).back() == 'B') /* byte[] */
-				{
-					auto array = reinterpret_cast<jbyteArray>(obj);
-					jbyte* elements = env->GetByteArrayElements(array, nullptr);
-
-					for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-						stream << int{ elements[j] } << ", ";
-
-					stream << int{ elements[env->GetArrayLength(array) - 1] } << " }";
-					env->ReleaseByteArrayElements(array, elements, JNI_ABORT);
-				}
-				else if (std::string(local_var_table[i].signature).back() == 'S') /* short[] */
-				{
-					auto array = reinterpret_cast<jshortArray>(obj);
-					jshort* elements = env->GetShortArrayElements(array, nullptr);
-
-					for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-						stream << elements[j] << ", ";
-
-					stream << elements[env->GetArrayLength(array) - 1] << " }";
-					env->ReleaseShortArrayElements(array, elements, JNI_ABORT);
-				}
-				else if (std::string(local_var_table[i].signature).back() == 'J') /* long[] */
-				{
-					auto array = reinterpret_cast<jlongArray>(obj);
-					jlong* elements = env->GetLongArrayElements(array, nullptr);
-
-					for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-						stream << elements[j] << ", ";
-
-					stream << elements[env->GetArrayLength(array) - 1] << " }";
-					env->ReleaseLongArrayElements(array, elements, JNI_ABORT);
-				}
-				else if (std::string(local_var_table[i].signature).back() == 'F') /* float[] */
-				{
-					auto array = reinterpret_cast<jfloatArray>(obj);
-					jfloat* elements = env->GetFloatArrayElements(array, nullptr);
-
-					for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-						stream << elements[j] << ", ";
-
-					stream << elements[env->GetArrayLength(array) - 1] << " }";
-					env->ReleaseFloatArrayElements(array, elements, JNI_ABORT);
-				}
-				else if (std::string(local_var_table[i].signature).back() == 'D') /* double[] */
-				{
-					auto array = reinterpret_cast<jdoubleArray>(obj);
-					jdouble* elements = env->GetDoubleArrayElements(array, nullptr);
-
-					for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-						stream << elements[j] << ", ";
-
-					stream << elements[env->GetArrayLength(array) - 1] << " }";
-					env->ReleaseDoubleArrayElements(array, elements, JNI_ABORT);
-				}
-				else if (std::string(local_var_table[i].signature).back() == 'C') /* char[] */
-				{
-					auto array = reinterpret_cast<jcharArray>(obj);
-					jchar* elements = env->GetCharArrayElements(array, nullptr);
-
-					for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-					{
-						if (elements[j] == '\n')
-							stream << R"('\n', )";
-						else if (elements[j] == '\r')
-							stream << R"('\r', )";
-						else
-							stream << '\'' << static_cast<char>(elements[j]) << "', ";
-					}
-
-					if (elements[env->GetArrayLength(array) - 1] == '\n')
-						stream << R"('\n' })";
-					else if (elements[env->GetArrayLength(array) - 1] == '\r')
-						stream << R"('\r' })";
-					else
-						stream << '\'' << static_cast<char>(elements[env->GetArrayLength(array) - 1]) << "' }";
-
-					env->ReleaseCharArrayElements(array, elements, JNI_ABORT);
-				}
-				else if (std::string(local_var_table[i].signature).back() == 'Z') /* boolean[] */
-				{
-					auto array = reinterpret_cast<jbooleanArray>(obj);
-					jboolean* elements = env->GetBooleanArrayElements(array, nullptr);
-
-					for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-					{
-						if (elements[j])
-							stream << "true, ";
-						else
-							stream << "false, ";
-					}
-
-					if (elements[env->GetArrayLength(array) - 1])
-						stream << "true }";
-					else
-						stream << "false }";
-
-					env->ReleaseBooleanArrayElements(array, elements, JNI_ABORT);
-				}
-				else if (std::string(local_var_table[i].signature).find("[L") != std::string::npos) /* custom object array */
-				{
-					auto jarray = reinterpret_cast<jobjectArray>(obj);
-
-					for (jint j = 0; j < env->GetArrayLength(jarray); j++)
-					{
-						jobject element = env->GetObjectArrayElement(jarray, j);
-						auto element_str = reinterpret_cast<jstring>(env->CallObjectMethod(element, toStringMethod));
-						const char* element_cstr;
-
-						if (element == nullptr)
-							element_cstr = "null";
-						else
-							element_cstr = env->GetStringUTFChars(element_str, nullptr);
-
-						std::string estr(element_cstr);
-						estr = std::regex_replace(estr, std::regex("\n"), "\\n");
-						estr = std::regex_replace(estr, std::regex("\r"), "\\r");
-
-						if (j == env->GetArrayLength(jarray) - 1)
-							stream << estr << " }";
-						else
-							stream << estr << ", ";
-					}
-				}
-
-				if (stream.str().length() <= 2) // empty array
-					stream << '}';
-
-				payload.heapByteData.push_back(str + '\a' + stream.str());
-			}
-			else if (*local_var_table[i].signature == 'L')
-			{
-				// call java method because jvmti has no suitable function for turning objects into raw bytes
-				jmethodID objectToBytesMethod = env->GetStaticMethodID(exception_class, "objectToBytes", "(Ljava/lang/Object;)[B");
-				jobject rawByteArray = env->CallStaticObjectMethod(exception_class, objectToBytesMethod, obj);
-				std::stringstream stream;
-				auto array = reinterpret_cast<jbyteArray>(rawByteArray);
-				jbyte* bytes = env->GetByteArrayElements(array, nullptr);
-
-				// if object is already in a string format, no need to generate hex dump
-				if (rawByteArray == nullptr || str.find('@') == std::string::npos)
-					continue;
-
-				for (jint j = 0; j < env->GetArrayLength(array); j++)
-					stream << std::hex << int{ bytes[j] } << ' ';
-
-				payload.heapByteData.push_back(str + '\a' + stream.str());
-				env->ReleaseByteArrayElements(array, bytes, JNI_ABORT);
-			}
+			// make it string serializable, the tag identifies the object across hits
+			capture_metrics.lap(CapturePhase::LocalVariables);
+			std::string str = renderer.render(obj);
+			const jlong tag = Agent::objectTags.tag(jvmti, obj);
+			emit(payload.localVars, arena.join({ Agent::internDeclaration(local_var_table[i].name, local_var_table[i].signature, false), str, session.track(obj), tag }));
+			capture_metrics.count(CaptureCounter::JNICalls);
+			capture_metrics.lap(CapturePhase::ToString);
+
+			// copy contents of array or raw bytes of object
+			copy_heap(local_var_table[i].signature, obj, str, tag);
+			capture_metrics.lap(CapturePhase::HeapCopy);
 		}
 	}
+	capture_metrics.lap(CapturePhase::LocalVariables);
 	
 	jclass current_class;
 	error = jvmti->GetMethodDeclaringClass(frames[0].method, &current_class);
@@ -385,236 +646,780 @@ static void Agent::callbackEventHandler(jvmtiEnv* jvmti, JNIEnv* env, jthread th
 			if (*signature == 'I')
 			{
 				const jint value = env->GetStaticIntField(current_class, fields[i]);
-				payload.staticFields.push_back("static " + Agent::decodeJVMTypeSignature(name, signature) + '\a' + std::to_string(value));
+				capture_metrics.count(CaptureCounter::JNICalls);
+				emit(payload.staticFields, arena.join({ Agent::internDeclaration(name, signature, true), value }));
 			}
 			else if (*signature == 'B')
 			{
 				const jbyte value = env->GetStaticByteField(current_class, fields[i]);
-				payload.staticFields.push_back("static " + Agent::decodeJVMTypeSignature(name, signature) + '\a' + std::to_string(value));
+				capture_metrics.count(CaptureCounter::JNICalls);
+				emit(payload.staticFields, arena.join({ Agent::internDeclaration(name, signature, true), value }));
 			}
 			else if (*signature == 'C')
 			{
 				const jchar value = env->GetStaticCharField(current_class, fields[i]);
-				payload.staticFields.push_back("static " + Agent::decodeJVMTypeSignature(name, signature) + '\a' + std::to_string(value));
+				capture_metrics.count(CaptureCounter::JNICalls);
+				emit(payload.staticFields, arena.join({ Agent::internDeclaration(name, signature, true), value }));
 			}
 			else if (*signature == 'S')
 			{
 				const jshort value = env->GetStaticShortField(current_class, fields[i]);
-				payload.staticFields.push_back("static " + Agent::decodeJVMTypeSignature(name, signature) + '\a' + std::to_string(value));
+				capture_metrics.count(CaptureCounter::JNICalls);
+				emit(payload.staticFields, arena.join({ Agent::internDeclaration(name, signature, true), value }));
 			}
 			else if (*signature == 'Z')
 			{
 				const jboolean value = env->GetStaticBooleanField(current_class, fields[i]);
-				payload.staticFields.push_back("static " + Agent::decodeJVMTypeSignature(name, signature) + '\a' + std::to_string(value));
+				capture_metrics.count(CaptureCounter::JNICalls);
+				emit(payload.staticFields, arena.join({ Agent::internDeclaration(name, signature, true), value }));
 			}
 			else if (*signature == 'D')
 			{
 				const jdouble double_value = env->GetStaticDoubleField(current_class, fields[i]);
-				payload.staticFields.push_back("static " + Agent::decodeJVMTypeSignature(name, signature) + '\a' + std::to_string(double_value));
+				capture_metrics.count(CaptureCounter::JNICalls);
+				emit(payload.staticFields, arena.join({ Agent::internDeclaration(name, signature, true), double_value }));
 			}
 			else if (*signature == 'F')
 			{
 				const jfloat float_value = env->GetStaticFloatField(current_class, fields[i]);
-				payload.staticFields.push_back("static " + Agent::decodeJVMTypeSignature(name, signature) + '\a' + std::to_string(float_value));
+				capture_metrics.count(CaptureCounter::JNICalls);
+				emit(payload.staticFields, arena.join({ Agent::internDeclaration(name, signature, true), float_value }));
 			}
 			else if (*signature == 'J')
 			{
 				const jlong long_value = env->GetStaticLongField(current_class, fields[i]);
-				payload.staticFields.push_back("static " + Agent::decodeJVMTypeSignature(name, signature) + '\a' + std::to_string(long_value));
+				capture_metrics.count(CaptureCounter::JNICalls);
+				emit(payload.staticFields, arena.join({ Agent::internDeclaration(name, signature, true), long_value }));
 			}
 			else if (*signature == '[' || *signature == 'L')
 			{
 				jobject obj = env->GetStaticObjectField(current_class, fields[i]);
-				auto jstr = reinterpret_cast<jstring>(env->CallObjectMethod(obj, toStringMethod));
+				capture_metrics.count(CaptureCounter::JNICalls);
 
 				// null reference
-				if (jstr == nullptr)
+				if (obj == nullptr)
 				{
-					payload.staticFields.push_back("static " + Agent::decodeJVMTypeSignature(name, signature) + '\a' + "null");
+					emit(payload.staticFields, arena.join({ Agent::internDeclaration(name, signature, true), "null" }));
 					continue;
 				}
 
-				const char* cstr = env->GetStringUTFChars(jstr, nullptr);
-				std::string str(cstr);
-				str = std::regex_replace(str, std::regex("\n"), "\\n");
-				str = std::regex_replace(str, std::regex("\r"), "\\r");
-				env->ReleaseStringUTFChars(jstr, cstr);
-				payload.staticFields.push_back("static " + Agent::decodeJVMTypeSignature(name, signature) + '\a' + str);
-
-				// get contents of array 
-				if (*signature == '[')
-				{
-					std::stringstream stream;
-					stream << "{ ";
-
-					if (std::string(signature).back() == 'I') /* static int[] */
-					{
-						auto array = reinterpret_cast<jintArray>(obj);
-						jint* elements = env->GetIntArrayElements(array, nullptr);
-
-						for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-							stream << elements[j] << ", ";
-
-						stream << elements[env->GetArrayLength(array) - 1] << " }";
-						env->ReleaseIntArrayElements(array, elements, JNI_ABORT);
-					}
-					else if (std::string(signature).back() == 'B') /* static byte[] */
-					{
-						auto array = reinterpret_cast<jbyteArray>(obj);
-						jbyte* elements = env->GetByteArrayElements(array, nullptr);
-
-						for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-							stream << int{ elements[j] } << ", ";
-
-						stream << int{ elements[env->GetArrayLength(array) - 1] } << " }";
-						env->ReleaseByteArrayElements(array, elements, JNI_ABORT);
-					}
-					else if (std::string(signature).back() == 'S') /* static short[] */
-					{
-						auto array = reinterpret_cast<jshortArray>(obj);
-						jshort* elements = env->GetShortArrayElements(array, nullptr);
-
-						for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-							stream << elements[j] << ", ";
-
-						stream << elements[env->GetArrayLength(array) - 1] << " }";
-						env->ReleaseShortArrayElements(array, elements, JNI_ABORT);
-					}
-					else if (std::string(signature).back() == 'J') /* static long[] */
-					{
-						auto array = reinterpret_cast<jlongArray>(obj);
-						jlong* elements = env->GetLongArrayElements(array, nullptr);
-
-						for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-							stream << elements[j] << ", ";
-
-						stream << elements[env->GetArrayLength(array) - 1] << " }";
-						env->ReleaseLongArrayElements(array, elements, JNI_ABORT);
-					}
-					else if (std::string(signature).back() == 'F') /* static float[] */
-					{
-						auto array = reinterpret_cast<jfloatArray>(obj);
-						jfloat* elements = env->GetFloatArrayElements(array, nullptr);
-
-						for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-							stream << elements[j] << ", ";
-
-						stream << elements[env->GetArrayLength(array) - 1] << " }";
-						env->ReleaseFloatArrayElements(array, elements, JNI_ABORT);
-					}
-					else if (std::string(signature).back() == 'D') /* static double[] */
-					{
-						auto array = reinterpret_cast<jdoubleArray>(obj);
-						jdouble* elements = env->GetDoubleArrayElements(array, nullptr);
-
-						for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-							stream << elements[j] << ", ";
-
-						stream << elements[env->GetArrayLength(array) - 1] << " }";
-						env->ReleaseDoubleArrayElements(array, elements, JNI_ABORT);
-					}
-					else if (std::string(signature).back() == 'C') /* static char[] */
-					{
-						auto array = reinterpret_cast<jcharArray>(obj);
-						jchar* elements = env->GetCharArrayElements(array, nullptr);
-
-						for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-						{
-							if (elements[j] == '\n')
-								stream << R"('\n', )";
-							else if (elements[j] == '\r')
-								stream << R"('\r', )";
-							else
-								stream << '\'' << static_cast<char>(elements[j]) << "', ";
-						}
-
-						if (elements[env->GetArrayLength(array) - 1] == '\n')
-							stream << R"('\n' })";
-						else if (elements[env->GetArrayLength(array) - 1] == '\r')
-							stream << R"('\r' })";
-						else
-							stream << '\'' << static_cast<char>(elements[env->GetArrayLength(array) - 1]) << "' }";
-
-						env->ReleaseCharArrayElements(array, elements, JNI_ABORT);
-					}
-					else if (std::string(signature).back() == 'Z') /* static boolean[] */
-					{
-						auto array = reinterpret_cast<jbooleanArray>(obj);
-						jboolean* elements = env->GetBooleanArrayElements(array, nullptr);
-
-						for (jint j = 0; j < env->GetArrayLength(array) - 1; j++)
-						{
-							if (elements[j])
-								stream << "true, ";
-							else
-								stream << "false, ";
-						}
-
-						if (elements[env->GetArrayLength(array) - 1])
-							stream << "true }";
-						else
-							stream << "false }";
-
-						env->ReleaseBooleanArrayElements(array, elements, JNI_ABORT);
-					}
-					else if (std::string(signature).find("[L") != std::string::npos) /* static custom object array */
-					{
-						auto jarray = reinterpret_cast<jobjectArray>(obj);
-
-						for (jint j = 0; j < env->GetArrayLength(jarray); j++)
-						{
-							jobject element = env->GetObjectArrayElement(jarray, j);
-							auto element_str = reinterpret_cast<jstring>(env->CallObjectMethod(element, toStringMethod));
-							const char* element_cstr;
-
-							if (element == nullptr)
-								element_cstr = "null";
-							else
-								element_cstr = env->GetStringUTFChars(element_str, nullptr);
-
-							std::string estr(element_cstr);
-							estr = std::regex_replace(estr, std::regex("\n"), "\\n");
-							estr = std::regex_replace(estr, std::regex("\r"), "\\r");
-
-							if (j == env->GetArrayLength(jarray) - 1)
-								stream << estr << " }";
-							else
-								stream << estr << ", ";
-						}
-					}
-
-					if (stream.str().length() <= 2) // empty array
-						stream << '}';
-
-					payload.heapByteData.push_back(str + '\a' + stream.str());
-				}
-				else if (*local_var_table[i].signature == 'L')
-				{
-					// call java method because jvmti has no suitable function for turning objects into raw bytes
-					jmethodID objectToBytesMethod = env->GetStaticMethodID(exception_class, "objectToBytes", "(Ljava/lang/Object;)[B");
-					jobject rawByteArray = env->CallStaticObjectMethod(exception_class, objectToBytesMethod, obj);
-					std::stringstream stream;
-					auto array = reinterpret_cast<jbyteArray>(rawByteArray);
-					jbyte* bytes = env->GetByteArrayElements(array, nullptr);
-
-					// if object is already in a string format, no need to generate hex dump
-					if (rawByteArray == nullptr || str.find('@') == std::string::npos)
-						continue;
-
-					for (jint j = 0; j < env->GetArrayLength(array); j++)
-						stream << std::hex << int{ bytes[j] } << ' ';
-
-					payload.heapByteData.push_back(str + '\a' + stream.str());
-					env->ReleaseByteArrayElements(array, bytes, JNI_ABORT);
-				}
+				// make it string serializable, the tag identifies the object across hits
+				capture_metrics.lap(CapturePhase::StaticFields);
+				std::string str = renderer.render(obj);
+				const jlong tag = Agent::objectTags.tag(jvmti, obj);
+				emit(payload.staticFields, arena.join({ Agent::internDeclaration(name, signature, true), str, session.track(obj), tag }));
+				capture_metrics.count(CaptureCounter::JNICalls);
+				capture_metrics.lap(CapturePhase::ToString);
+
+				// copy contents of array or raw bytes of object
+				copy_heap(signature, obj, str, tag);
+				capture_metrics.lap(CapturePhase::HeapCopy);
 			}
 		}
 	}
 
-	// write all data gathered from the JVM to shared file
+	// everything the pipeline needs has been copied, the data is formatted and written to the shared file there
 serialize_launch:
-	visualizer.serializeDataStruct(payload);
-	visualizer.launch();
+	capture_metrics.lap(CapturePhase::StaticFields);
+
+	// the heap dump is written before the thread resumes, memdbgvis.hprof next to the agent unless a folder is given
+	if (config->options.has("hprof"))
+	{
+		const std::string directory = config->options.get("hprof");
+		std::wstring path = visualizer.dataFilePath(L"hprof");
+		if (!directory.empty())
+		{
+			const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			CreateDirectory(std::wstring(directory.begin(), directory.end()).c_str(), nullptr);
+			path = std::wstring(directory.begin(), directory.end()) + L"\\heap-" + std::to_wstring(now) + L".hprof";
+		}
+
+		HeapDumper dumper(jvmti, env);
+		const size_t buffer_bytes = static_cast<size_t>(std::clamp<long long>(config->options.getNumber("hprofmb", HeapDumper::DEFAULT_BUFFER_MB), 1, 1024)) << 20;
+		if (dumper.dump(path, buffer_bytes, thread, frames.get(), frame_count, Agent::lineNumbers))
+		{
+			for (const std::string& metric : dumper.report())
+				emit(payload.metrics, arena.store(metric));
+		}
+		else
+			VisualizerProcComm::displayErrorDialog((L"Cannot write the heap dump " + path + L". " + std::wstring(dumper.error().begin(), dumper.error().end())).c_str());
+		capture_metrics.setHeapDumpBytes(dumper.bytes());
+		capture_metrics.lap(CapturePhase::HeapDump);
+	}
+
+	// non-interactive runs resume the thread right away, unless there are no workers to leave the formatting to
+	const bool release = !interactive && Agent::capturePipeline.running();
+	if (release)
+		capture_metrics.release();
+	Agent::formatCapture(capture, Agent::capturePipeline.ticket(), interactive);
+	if (release)
+		return;
+	Agent::capturePipeline.helpUntil([&capture] { return capture->written.load(std::memory_order_acquire); });
+	if (!interactive)
+		return;
+
+	visualizer.launch(&session, [jvmti, env, &session, &renderer](const std::string& request) { return Agent::answerDrillDown(jvmti, env, session, renderer, request); },
+		capture->incremental ? Agent::snapshotArchive.directory() : std::wstring());
+	visualizer.retainSnapshot();
+	capture_metrics.lap(CapturePhase::Launch);
+	Agent::captureHistograms.record(capture_metrics);
+}
+
+// starts the sampler threads and arms watches and breakpoints in classes that were prepared before the VM was initialized
+static void Agent::callbackVMInit(jvmtiEnv* jvmti, JNIEnv* env, jthread thread)
+{
+	const std::shared_ptr<AgentConfig> config = Agent::config.load();
+	const long long interval = config->options.getNumber("sampler", MetricsSampler::DEFAULT_INTERVAL_MS);
+	if (interval > 0 && !Agent::metricsSampler.start(jvmti, env, interval))
+		VisualizerProcComm::displayErrorDialog(L"Cannot start the metrics sampler thread.");
+	if (config->options.has("profile") && !Agent::stackProfiler.start(jvmti, env, config->options.getNumber("profile", StackProfiler::DEFAULT_INTERVAL_MS), static_cast<jint>(config->options.getNumber("profiledepth", StackProfiler::DEFAULT_DEPTH))))
+		VisualizerProcComm::displayErrorDialog(L"Cannot start the stack profiler thread.");
+
+	jint count;
+	jclass* classes;
+	if ((config->fieldWatches.empty() && config->lineBreakpoints.empty()) || jvmti->GetLoadedClasses(&count, &classes) != JVMTI_ERROR_NONE)
+		return;
+
+	for (jint i = 0; i < count; i++)
+	{
+		jint status = 0;
+		if (jvmti->GetClassStatus(classes[i], &status) == JVMTI_ERROR_NONE && status & JVMTI_CLASS_STATUS_PREPARED)
+			Agent::callbackClassPrepare(jvmti, env, thread, classes[i]);
+	}
+	jvmti->Deallocate(reinterpret_cast<unsigned char*>(classes));
+}
+
+// writes the snapshots that are still being formatted and stops the capture pipeline
+static void Agent::callbackVMDeath(jvmtiEnv* jvmti, JNIEnv* env)
+{
+	Agent::capturePipeline.stop();
+}
+
+static void Agent::callbackClassPrepare(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jclass klass)
+{
+	const std::shared_ptr<AgentConfig> config = Agent::config.load();
+	config->fieldWatches.arm(jvmti, env, klass);
+	config->lineBreakpoints.arm(jvmti, klass, Agent::lineNumbers);
+}
+
+// breakpoints are only installed on their own lines, so every hit is a capture
+static void Agent::callbackBreakpoint(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location)
+{
+	const std::shared_ptr<AgentConfig> config = Agent::config.load();
+	LineBreakpoint* breakpoint = config->lineBreakpoints.find(method, location);
+	if (Agent::capturing || breakpoint == nullptr)
+		return;
+	breakpoint->hits.fetch_add(1, std::memory_order_relaxed);
+
+	// hits that fail the condition resume right away
+	std::string trigger = "Breakpoint " + breakpoint->description;
+	if (!breakpoint->condition.empty())
+	{
+		if (!breakpoint->condition.evaluate({ jvmti, env, thread, 0, nullptr }, method, location))
+			return;
+		trigger += " if " + breakpoint->condition.source();
+	}
+
+	jclass agent_class = env->FindClass("com/vjzcorp/jvmtools/memdbgvis");
+	if (agent_class == nullptr)
+		env->ExceptionClear();
+
+	Agent::capturing = true;
+	Agent::captureSnapshot(jvmti, env, thread, 0, agent_class, trigger);
+	Agent::capturing = false;
+	Agent::countCapture(jvmti, env);
+}
+
+// only writes to watched fields are reported, the snapshot is taken of the method that is writing
+static void Agent::callbackFieldModification(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location, jclass field_klass, jobject object, jfieldID field, char signature_type, jvalue new_value)
+{
+	const std::shared_ptr<AgentConfig> config = Agent::config.load();
+	FieldWatch* watch = config->fieldWatches.find(env, field_klass, field);
+	if (Agent::capturing || watch == nullptr || !config->fieldWatches.check({ jvmti, env, thread, 0, nullptr }, *watch, method, location, signature_type, new_value))
+		return;
+
+	// the wrapper class is only used for the optional Java side metrics, captures work without it
+	jclass agent_class = env->FindClass("com/vjzcorp/jvmtools/memdbgvis");
+	if (agent_class == nullptr)
+		env->ExceptionClear();
+
+	// the field still holds its old value, the new one is part of the trigger
+	Agent::capturing = true;
+	Agent::captureSnapshot(jvmti, env, thread, 0, agent_class, "Watchpoint " + watch->description + ", writing " + FieldWatches::describeValue(signature_type, new_value));
+	Agent::capturing = false;
+	Agent::countCapture(jvmti, env);
+}
+
+// garbage collection events are sent while the VM is stopped, so these must not call JNI or allocate
+static void Agent::callbackGarbageCollectionStart(jvmtiEnv* jvmti)
+{
+	Agent::gcMonitor.pauseStarted();
+}
+
+static void Agent::callbackGarbageCollectionFinish(jvmtiEnv* jvmti)
+{
+	Agent::gcMonitor.pauseFinished();
+}
+
+// drops the archived content of a tagged object once it is collected
+static void Agent::callbackObjectFree(jvmtiEnv* jvmti, const jlong tag)
+{
+	Agent::objectTags.forget(tag);
+}
+
+// records a sampled allocation on the allocating thread, this runs on every sample so it must stay cheap
+static void Agent::callbackSampledObjectAlloc(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object, jclass object_klass, jlong size)
+{
+	Agent::allocationSampler.record(jvmti, thread, object_klass, size);
+}
+
+// a thread is about to block on a monitor another thread owns
+static void Agent::callbackMonitorContendedEnter(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object)
+{
+	Agent::monitorContention.contendedEnter();
+}
+
+// the blocked thread owns the monitor now, the monitor is only tagged once the wait is over
+static void Agent::callbackMonitorContendedEntered(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object)
+{
+	Agent::monitorContention.contendedEntered(Agent::objectTags.tag(jvmti, object));
+}
+
+// answers a request of the visualizer's object explorer while the thread is suspended
+static std::string Agent::answerDrillDown(jvmtiEnv* jvmti, JNIEnv* env, DrillDownSession& session, ObjectRenderer& renderer, const std::string& request)
+{
+	// requests are "FIELDS\a<handle>" or "RANGE\a<handle>\a<offset>\a<count>"
+	std::vector<std::string> args;
+	std::stringstream stream(request);
+	for (std::string arg; std::getline(stream, arg, '\a');)
+		args.push_back(arg);
+
+	if (args.size() < 2)
+		return "ERROR\aMalformed request.\n";
+
+	const jobject obj = session.resolve(std::strtoull(args[1].c_str(), nullptr, 10));
+	if (obj == nullptr)
+		return "ERROR\aUnknown object handle.\n";
+
+	// local references created while answering are released in one go
+	if (env->PushLocalFrame(64) != JNI_OK)
+	{
+		env->ExceptionClear();
+		return "ERROR\aOut of memory.\n";
+	}
+
+	std::string response;
+	if (args[0] == "FIELDS")
+		response = Agent::describeFields(jvmti, env, session, renderer, obj);
+	else if (args[0] == "RANGE" && args.size() >= 4)
+		response = Agent::describeArrayRange(jvmti, env, session, renderer, obj, std::atoi(args[2].c_str()), std::atoi(args[3].c_str()));
+	else
+		response = "ERROR\aUnknown request.\n";
+
+	env->PopLocalFrame(nullptr);
+	return response;
+}
+
+// lists the instance fields of an object, including inherited ones, as "type\aname\avalue\ahandle" lines
+static std::string Agent::describeFields(jvmtiEnv* jvmti, JNIEnv* env, DrillDownSession& session, ObjectRenderer& renderer, jobject obj)
+{
+	std::string response;
+
+	for (jclass klass = env->GetObjectClass(obj); klass != nullptr;)
+	{
+		jint count;
+		jfieldID* fields;
+		jvmtiError error = jvmti->GetClassFields(klass, &count, &fields);
+		if (Agent::catchJVMTIError(jvmti, error, "Cannot get class fields.", true))
+			return "ERROR\aCannot get class fields.\n";
+
+		for (jint i = 0; i < count; i++)
+		{
+			char* name;
+			char* signature;
+			jint modifiers;
+
+			// static fields are already listed in the snapshot
+			error = jvmti->GetFieldModifiers(klass, fields[i], &modifiers);
+			if (Agent::catchJVMTIError(jvmti, error, "Cannot get field modifiers.", true) || modifiers & JVMTI_HEAP_REFERENCE_STATIC_FIELD)
+				continue;
+
+			error = jvmti->GetFieldName(klass, fields[i], &name, &signature, nullptr);
+			if (Agent::catchJVMTIError(jvmti, error, "Cannot get field name.", true))
+				continue;
+
+			std::string value;
+			size_t handle = 0;
+			jvalue primitive{};
+
+			switch (*signature)
+			{
+			case 'Z': primitive.z = env->GetBooleanField(obj, fields[i]); break;
+			case 'B': primitive.b = env->GetByteField(obj, fields[i]); break;
+			case 'C': primitive.c = env->GetCharField(obj, fields[i]); break;
+			case 'S': primitive.s = env->GetShortField(obj, fields[i]); break;
+			case 'I': primitive.i = env->GetIntField(obj, fields[i]); break;
+			case 'J': primitive.j = env->GetLongField(obj, fields[i]); break;
+			case 'F': primitive.f = env->GetFloatField(obj, fields[i]); break;
+			case 'D': primitive.d = env->GetDoubleField(obj, fields[i]); break;
+			default:
+			{
+				jobject field_value = env->GetObjectField(obj, fields[i]);
+				value = field_value == nullptr ? "null" : renderer.render(field_value);
+				handle = session.track(field_value);
+				env->DeleteLocalRef(field_value);
+			}
+			}
+
+			if (*signature != 'L' && *signature != '[')
+				value = ObjectRenderer::renderPrimitive(primitive, *signature);
+
+			response += Agent::decodeJVMTypeSignature(name, signature) + '\a' + value + '\a' + std::to_string(handle) + '\n';
+			jvmti->Deallocate(reinterpret_cast<unsigned char*>(name));
+			jvmti->Deallocate(reinterpret_cast<unsigned char*>(signature));
+		}
+
+		jvmti->Deallocate(reinterpret_cast<unsigned char*>(fields));
+		const jclass superclass = env->GetSuperclass(klass);
+		env->DeleteLocalRef(klass);
+		klass = superclass;
+	}
+
+	return response;
+}
+
+// lists a page of array elements, preceded by a "LENGTH\a<length>" line
+static std::string Agent::describeArrayRange(jvmtiEnv* jvmti, JNIEnv* env, DrillDownSession& session, ObjectRenderer& renderer, jobject obj, jint offset, jint count)
+{
+	char* array_signature;
+	const jclass klass = env->GetObjectClass(obj);
+	const jvmtiError error = jvmti->GetClassSignature(klass, &array_signature, nullptr);
+	if (Agent::catchJVMTIError(jvmti, error, "Cannot get JVM class signature.", true))
+		return "ERROR\aCannot get array type.\n";
+
+	const std::string signature(array_signature);
+	jvmti->Deallocate(reinterpret_cast<unsigned char*>(array_signature));
+	if (signature.front() != '[')
+		return "ERROR\aObject is not an array.\n";
+
+	// pages are clamped to the array and to a size the visualizer can display at once
+	const jsize length = env->GetArrayLength(reinterpret_cast<jarray>(obj));
+	offset = std::clamp(offset, 0, length);
+	count = std::clamp(count, 0, std::min(length - offset, 1000));
+
+	const std::string element_signature = signature.substr(1);
+	const std::string element_type = Agent::dataTypeFormatter(element_signature);
+	std::string response = "LENGTH\a" + std::to_string(length) + '\n';
+
+	const auto append = [&](const jint index, const std::string& value, const size_t handle)
+	{
+		response += element_type + "\a[" + std::to_string(offset + index) + "]\a" + value + '\a' + std::to_string(handle) + '\n';
+	};
+
+	// primitive elements are copied with one region read per page
+	std::vector<jvalue> primitives(element_signature.size() == 1 ? count : 0);
+	switch (element_signature.size() == 1 ? element_signature.front() : 'L')
+	{
+	case 'Z':
+	{
+		std::vector<jboolean> elements(count);
+		env->GetBooleanArrayRegion(reinterpret_cast<jbooleanArray>(obj), offset, count, elements.data());
+		for (jint i = 0; i < count; i++)
+			primitives[i].z = elements[i];
+		break;
+	}
+	case 'B':
+	{
+		std::vector<jbyte> elements(count);
+		env->GetByteArrayRegion(reinterpret_cast<jbyteArray>(obj), offset, count, elements.data());
+		for (jint i = 0; i < count; i++)
+			primitives[i].b = elements[i];
+		break;
+	}
+	case 'C':
+	{
+		std::vector<jchar> elements(count);
+		env->GetCharArrayRegion(reinterpret_cast<jcharArray>(obj), offset, count, elements.data());
+		for (jint i = 0; i < count; i++)
+			primitives[i].c = elements[i];
+		break;
+	}
+	case 'S':
+	{
+		std::vector<jshort> elements(count);
+		env->GetShortArrayRegion(reinterpret_cast<jshortArray>(obj), offset, count, elements.data());
+		for (jint i = 0; i < count; i++)
+			primitives[i].s = elements[i];
+		break;
+	}
+	case 'I':
+	{
+		std::vector<jint> elements(count);
+		env->GetIntArrayRegion(reinterpret_cast<jintArray>(obj), offset, count, elements.data());
+		for (jint i = 0; i < count; i++)
+			primitives[i].i = elements[i];
+		break;
+	}
+	case 'J':
+	{
+		std::vector<jlong> elements(count);
+		env->GetLongArrayRegion(reinterpret_cast<jlongArray>(obj), offset, count, elements.data());
+		for (jint i = 0; i < count; i++)
+			primitives[i].j = elements[i];
+		break;
+	}
+	case 'F':
+	{
+		std::vector<jfloat> elements(count);
+		env->GetFloatArrayRegion(reinterpret_cast<jfloatArray>(obj), offset, count, elements.data());
+		for (jint i = 0; i < count; i++)
+			primitives[i].f = elements[i];
+		break;
+	}
+	case 'D':
+	{
+		std::vector<jdouble> elements(count);
+		env->GetDoubleArrayRegion(reinterpret_cast<jdoubleArray>(obj), offset, count, elements.data());
+		for (jint i = 0; i < count; i++)
+			primitives[i].d = elements[i];
+		break;
+	}
+	default: /* object and nested arrays */
+		for (jint i = 0; i < count; i++)
+		{
+			jobject element = env->GetObjectArrayElement(reinterpret_cast<jobjectArray>(obj), offset + i);
+			append(i, element == nullptr ? "null" : renderer.render(element), session.track(element));
+			env->DeleteLocalRef(element);
+		}
+		return response;
+	}
+
+	for (jint i = 0; i < count; i++)
+		append(i, ObjectRenderer::renderPrimitive(primitives[i], element_signature.front()), 0);
+	return response;
+}
+
+static unsigned long long Agent::hashBytes(const unsigned char* data, const size_t size)
+{
+	// four independent FNV-style lanes over 64-bit words keep the multipliers busy and vectorize well
+	constexpr unsigned long long prime = 0x100000001B3ULL;
+	unsigned long long lanes[4] = { 0xCBF29CE484222325ULL ^ size, 0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL };
+	size_t i = 0;
+
+	for (; i + sizeof lanes <= size; i += sizeof lanes)
+	{
+		unsigned long long words[4];
+		std::memcpy(words, data + i, sizeof words);
+		for (size_t lane = 0; lane < 4; lane++)
+			lanes[lane] = (lanes[lane] ^ words[lane]) * prime;
+	}
+
+	unsigned long long hash = lanes[0] ^ std::rotl(lanes[1], 17) ^ std::rotl(lanes[2], 31) ^ std::rotl(lanes[3], 47);
+	for (; i < size; i++)
+		hash = (hash ^ data[i]) * prime;
+	return hash;
+}
+
+// copies the contents of an array or the raw bytes of an object out of the heap, the only part of the Heap Inspector data that needs the application thread
+// data that is ready as is, such as a summary of an object array, is returned in formatted and nothing is copied
+static bool Agent::copyHeapData(JNIEnv* env, jclass agent_class, ObjectRenderer& renderer, const std::string& signature, jobject obj, const std::string& str, std::string& formatted, HeapCopy& copy, CaptureMetrics& metrics)
+{
+	if (signature.front() == 'L')
+	{
+		// if object is already in a string format, no need to generate hex dump
+		if (str.find('@') == std::string::npos || agent_class == nullptr)
+			return false;
+
+		// call java method because jvmti has no suitable function for turning objects into raw bytes
+		jmethodID objectToBytesMethod = env->GetStaticMethodID(agent_class, "objectToBytes", "(Ljava/lang/Object;)[B");
+		jobject rawByteArray = env->CallStaticObjectMethod(agent_class, objectToBytesMethod, obj);
+		metrics.count(CaptureCounter::JNICalls, 2);
+		if (rawByteArray == nullptr)
+			return false;
+
+		auto array = reinterpret_cast<jbyteArray>(rawByteArray);
+		copy.type = 'O';
+		copy.elementSize = 1;
+		copy.bytes.resize(static_cast<size_t>(env->GetArrayLength(array)));
+		env->GetByteArrayRegion(array, 0, static_cast<jsize>(copy.bytes.size()), reinterpret_cast<jbyte*>(copy.bytes.data()));
+		metrics.count(CaptureCounter::JNICalls, 2);
+		return true;
+	}
+
+	const jsize length = env->GetArrayLength(reinterpret_cast<jarray>(obj));
+	metrics.count(CaptureCounter::JNICalls);
+
+	// object and multi-dimensional arrays are summarized instead of listing every element
+	if (signature[1] == 'L' || signature[1] == '[')
+	{
+		formatted = length == 0 ? "{ }" : renderer.summarizeArray(reinterpret_cast<jobjectArray>(obj));
+		return true;
+	}
+
+	switch (signature.size() == 2 ? signature.back() : '\0')
+	{
+	case 'Z': case 'B': copy.elementSize = 1; break;
+	case 'C': case 'S': copy.elementSize = 2; break;
+	case 'I': case 'F': copy.elementSize = 4; break;
+	case 'J': case 'D': copy.elementSize = 8; break;
+	default: return false; /* unknown array type */
+	}
+
+	// the array is pinned only for the copy, formatting it can take far longer and no longer holds up the garbage collector
+	copy.type = signature.back();
+	copy.bytes.resize(static_cast<size_t>(length) * copy.elementSize);
+	const auto array = reinterpret_cast<jarray>(obj);
+	const auto data = static_cast<const unsigned char*>(env->GetPrimitiveArrayCritical(array, nullptr));
+	if (data == nullptr)
+		return false;
+	std::memcpy(copy.bytes.data(), data, copy.bytes.size());
+	env->ReleasePrimitiveArrayCritical(array, const_cast<unsigned char*>(data), JNI_ABORT);
+	metrics.count(CaptureCounter::JNICalls, 2);
+	return true;
+}
+
+// splits the copies of a capture into chunks for the pipeline, the task that finishes last hands the capture over to be written
+static void Agent::formatCapture(const std::shared_ptr<PendingCapture>& capture, const unsigned long long ticket, const bool interactive)
+{
+	for (HeapCopy& copy : capture->copies)
+	{
+		const size_t length = copy.bytes.size() / copy.elementSize;
+		copy.pieces.resize((length + Agent::HEAP_CHUNK_ELEMENTS - 1) / Agent::HEAP_CHUNK_ELEMENTS);
+		copy.blockHashes.resize((length + Agent::ARRAY_HASH_BLOCK - 1) / Agent::ARRAY_HASH_BLOCK);
+	}
+
+	const auto finish = [capture, ticket, interactive]
+	{
+		Agent::capturePipeline.complete(ticket, [capture, interactive] { Agent::writeCapture(*capture, interactive); });
+	};
+	if (!capture->incremental)
+		return Agent::runHeapChunks(capture, true, true, finish);
+
+	// incremental captures hash everything first, so copies the archive already holds are never formatted
+	Agent::runHeapChunks(capture, true, false, [capture, finish]
+	{
+		Agent::referenceUnchanged(*capture);
+		Agent::runHeapChunks(capture, false, true, finish);
+	});
+}
+
+// runs one task per chunk of every copy that is written in full, then continues with the given task
+static void Agent::runHeapChunks(const std::shared_ptr<PendingCapture>& capture, const bool hash, const bool format, const CapturePipeline::Task& then)
+{
+	std::vector<std::pair<size_t, size_t>> chunks;
+	for (size_t i = 0; i < capture->copies.size(); i++)
+	{
+		const HeapCopy& copy = capture->copies[i];
+		if (copy.reference != 0)
+			continue;
+		for (size_t first = 0; first < copy.bytes.size() / copy.elementSize; first += Agent::HEAP_CHUNK_ELEMENTS)
+			chunks.emplace_back(i, first);
+	}
+	if (chunks.empty())
+		return then();
+
+	capture->remaining.store(chunks.size(), std::memory_order_relaxed);
+	for (const auto& [index, first] : chunks)
+	{
+		Agent::capturePipeline.submit([capture, index, first, hash, format, then]
+		{
+			// workers count their allocations on their own threads, the capture adds them up for its HeapFormat phase
+			const unsigned long long allocations = AllocationCounter::allocations(), allocated_bytes = AllocationCounter::bytes();
+			if (hash)
+				Agent::hashHeapChunk(capture->copies[index], first);
+			if (format)
+				Agent::formatHeapChunk(capture->copies[index], first);
+			capture->taskAllocations.fetch_add(AllocationCounter::allocations() - allocations, std::memory_order_relaxed);
+			capture->taskAllocatedBytes.fetch_add(AllocationCounter::bytes() - allocated_bytes, std::memory_order_relaxed);
+			if (capture->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				then();
+		});
+	}
+}
+
+// copies of tagged objects whose content was archived in full by an earlier snapshot are written as a reference to it
+static void Agent::referenceUnchanged(PendingCapture& capture)
+{
+	for (HeapCopy& copy : capture.copies)
+	{
+		if (copy.tag == 0)
+			continue;
+
+		// the block hashes already cover every byte, so the content hash is a hash of them
+		copy.contentHash = Agent::hashBytes(reinterpret_cast<const unsigned char*>(copy.blockHashes.data()), copy.blockHashes.size() * sizeof(unsigned long long)) ^ (copy.bytes.size() << 8 | static_cast<unsigned char>(copy.type));
+		TaggedContent content{};
+		if (Agent::objectTags.find(copy.tag, copy.contentHash, content) && Agent::snapshotArchive.retains(content.segment))
+		{
+			copy.reference = content.snapshot;
+			Agent::objectTags.referenced(copy.bytes.size());
+		}
+	}
+}
+
+// hashes the blocks of one chunk, the visualizer compares the hashes of arrays to skip unchanged regions when diffing two hits
+static void Agent::hashHeapChunk(HeapCopy& copy, const size_t first)
+{
+	const size_t last = std::min(copy.bytes.size() / copy.elementSize, first + Agent::HEAP_CHUNK_ELEMENTS);
+	for (size_t block = first; block < last; block += Agent::ARRAY_HASH_BLOCK)
+		copy.blockHashes[block / Agent::ARRAY_HASH_BLOCK] = Agent::hashBytes(copy.bytes.data() + block * copy.elementSize, (std::min(last, block + Agent::ARRAY_HASH_BLOCK) - block) * copy.elementSize);
+}
+
+// formats one chunk of elements for the Heap Inspector
+static void Agent::formatHeapChunk(HeapCopy& copy, const size_t first)
+{
+	const size_t length = copy.bytes.size() / copy.elementSize;
+	const size_t last = std::min(length, first + Agent::HEAP_CHUNK_ELEMENTS);
+	const unsigned char* data = copy.bytes.data();
+
+	std::string& piece = copy.pieces[first / Agent::HEAP_CHUNK_ELEMENTS];
+	piece.reserve((last - first) * (copy.type == 'O' ? 3 : 6));
+	char buffer[32];
+
+	const auto append_number = [&piece, &buffer](const auto value, const int base = 10)
+	{
+		piece.append(buffer, std::to_chars(buffer, buffer + sizeof buffer, value, base).ptr);
+	};
+
+	for (size_t i = first; i < last; i++)
+	{
+		const unsigned char* element = data + i * copy.elementSize;
+		switch (copy.type)
+		{
+		case 'O':
+		{
+			// hex dump of the object bytes, each followed by a space
+			append_number(static_cast<unsigned int>(int{ static_cast<jbyte>(*element) }), 16);
+			piece += ' ';
+			continue;
+		}
+		case 'I': { jint value; std::memcpy(&value, element, sizeof value); append_number(value); break; }
+		case 'B': { append_number(int{ static_cast<jbyte>(*element) }); break; }
+		case 'S': { jshort value; std::memcpy(&value, element, sizeof value); append_number(value); break; }
+		case 'J': { jlong value; std::memcpy(&value, element, sizeof value); append_number(value); break; }
+		// elements print the same as a local of their type would
+		case 'F': { jfloat value; std::memcpy(&value, element, sizeof value); ObjectRenderer::appendFloatingPoint(piece, value); break; }
+		case 'D': { jdouble value; std::memcpy(&value, element, sizeof value); ObjectRenderer::appendFloatingPoint(piece, value); break; }
+		case 'C':
+		{
+			// escaped like strings, so no element can break a line or the '\a' delimiter of the snapshot
+			jchar value;
+			std::memcpy(&value, element, sizeof value);
+			char encoded[6];
+			piece += '\'';
+			piece.append(encoded, ObjectRenderer::encodeEscaped(&value, 1, encoded, encoded + sizeof encoded));
+			piece += '\'';
+			break;
+		}
+		default: /* boolean */
+			piece += *element ? "true" : "false";
+			break;
+		}
+
+		if (i + 1 < length)
+			piece += ", ";
+	}
+}
+
+// fills in the formatted heap data and writes the snapshot, runs in the order the captures were copied
+static void Agent::writeCapture(PendingCapture& capture, const bool interactive)
+{
+	CaptureMetrics& metrics = capture.metrics;
+	PayloadArena& arena = *capture.arena;
+	VisualizerPayload& payload = capture.payload;
+	metrics.adoptThread();
+	metrics.count(CaptureCounter::Allocations, static_cast<long long>(capture.taskAllocations.load(std::memory_order_relaxed)));
+	metrics.count(CaptureCounter::AllocatedBytes, static_cast<long long>(capture.taskAllocatedBytes.load(std::memory_order_relaxed)));
+
+	for (HeapCopy& copy : capture.copies)
+	{
+		// unchanged content is a reference to the archived snapshot that holds it, the visualizer reads it from there
+		std::string_view& entry = payload.heapByteData[copy.heapEntry];
+		if (copy.reference != 0)
+		{
+			entry = arena.concat({ "=", copy.key, "\a", copy.reference });
+			metrics.count(CaptureCounter::BytesProduced, static_cast<long long>(entry.size()) + 1);
+			continue;
+		}
+
+		// the formatted chunks are joined in place, "key\a{ a, b, c }" for arrays and "key\abytes" for objects
+		const std::string_view open = copy.type == 'O' ? "\a" : "\a{ ", close = copy.type == 'O' ? "" : copy.pieces.empty() ? "}" : " }";
+		size_t size = copy.key.size() + open.size() + close.size();
+		for (const std::string& piece : copy.pieces)
+			size += piece.size();
+
+		char* out = std::copy(open.begin(), open.end(), std::copy(copy.key.begin(), copy.key.end(), arena.reserve(size)));
+		for (const std::string& piece : copy.pieces)
+			out = std::copy(piece.begin(), piece.end(), out);
+		entry = arena.commit(std::copy(close.begin(), close.end(), out));
+		metrics.count(CaptureCounter::BytesProduced, static_cast<long long>(entry.size()) + 1);
+
+		if (copy.type == 'O')
+			continue;
+
+		// every hash takes at most 16 hex digits and a comma
+		out = std::copy(copy.key.begin(), copy.key.end(), arena.reserve(copy.key.size() + 24 + copy.blockHashes.size() * 17));
+		*out++ = '\a';
+		out = std::to_chars(out, out + 20, Agent::ARRAY_HASH_BLOCK).ptr;
+		*out++ = '\a';
+		for (size_t i = 0; i < copy.blockHashes.size(); i++)
+		{
+			if (i > 0)
+				*out++ = ',';
+			out = std::to_chars(out, out + 16, copy.blockHashes[i], 16).ptr;
+		}
+		payload.arrayBlockHashes[copy.hashEntry] = arena.commit(out);
+		metrics.count(CaptureCounter::BytesProduced, static_cast<long long>(payload.arrayBlockHashes[copy.hashEntry].size()) + 1);
+	}
+
+	// referenced arrays keep their block hashes in the snapshot they refer to
+	std::erase(payload.arrayBlockHashes, std::string_view());
+	metrics.lap(CapturePhase::HeapFormat);
+
+	// memory the capture holds besides the snapshot text, at its peak right before the snapshot is written
+	size_t held_bytes = arena.capacity();
+	for (const HeapCopy& copy : capture.copies)
+	{
+		held_bytes += copy.bytes.capacity() + copy.blockHashes.capacity() * sizeof(unsigned long long);
+		for (const std::string& piece : copy.pieces)
+			held_bytes += piece.capacity();
+	}
+	payload.metrics.push_back(arena.join({ "Capture Memory", held_bytes, "bytes" }));
+	payload.metrics.push_back(arena.join({ "Payload Arena", arena.bytes(), "bytes" }));
+	payload.metrics.push_back(arena.join({ "Payload Arena Blocks Allocated", arena.allocations(), "count" }));
+
+	for (const std::string& phase : metrics.serialize())
+		payload.captureMetrics.push_back(arena.store(phase));
+	ArchiveRecord archived{};
+	const size_t payload_bytes = VisualizerProcComm().serializeDataStruct(payload, &Agent::snapshotArchive, &archived);
+	metrics.setPayloadBytes(payload_bytes);
+	metrics.setMemory(held_bytes + payload_bytes, arena.bytes());
+	metrics.lap(CapturePhase::Serialize);
+
+	// content written in full is what later snapshots refer to, as long as this one made it into the archive
+	if (capture.incremental && archived.id != 0)
+	{
+		for (const HeapCopy& copy : capture.copies)
+		{
+			if (copy.tag != 0 && copy.reference == 0)
+				Agent::objectTags.remember(copy.tag, { copy.contentHash, archived.id, archived.segment });
+		}
+	}
+
+	// the copies are released as soon as the snapshot is written, a large capture can hold a lot of them
+	// the payload only points into the arena, which is reset for the next capture
+	std::vector<HeapCopy>().swap(capture.copies);
+	capture.payload = VisualizerPayload{};
+	Agent::payloadArenas.release(std::move(capture.arena));
+
+	// interactive captures are finished by the application thread once the visualizer closes
+	if (!interactive)
+	{
+		metrics.lap(CapturePhase::Launch);
+		Agent::captureHistograms.record(metrics);
+		if (capture.config->options.has("bench"))
+			metrics.appendBenchmarkRecord(capture.config->options.get("bench"), ++Agent::captureCount);
+	}
+	capture.written.store(true, std::memory_order_release);
 }
 
 static std::string Agent::dataTypeFormatter(std::string unformatted)
@@ -700,4 +1505,16 @@ static std::string Agent::decodeJVMTypeSignature(const std::string& name, const
 	}
 	
 	return decoded + ')';
+}
+
+// declarations are decoded once and interned, a hit on a frame seen before only looks them up
+static std::string_view Agent::internDeclaration(const char* name, const char* signature, const bool isStatic, const bool isMethod)
+{
+	// the key is built in a buffer the thread keeps, so looking up a known declaration does not allocate
+	thread_local std::string key;
+	key.assign(isStatic ? "S" : "-").append(isMethod ? "M" : "-").append(name).append(1, '\a').append(signature);
+	return Agent::declarations.intern(key, [name, signature, isStatic, isMethod]
+	{
+		return (isStatic ? "static " : "") + Agent::decodeJVMTypeSignature(name, signature, isMethod);
+	});
 }
\ No newline at end of file
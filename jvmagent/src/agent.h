@@ -4,6 +4,20 @@
 #define AGENT_H
 
 #include "pch.h"
+#include "agentconfig.h"
+#include "allocationsampler.h"
+#include "capturemetrics.h"
+#include "capturepipeline.h"
+#include "gcmonitor.h"
+#include "heapdumper.h"
+#include "linebreakpoints.h"
+#include "metricssampler.h"
+#include "monitorcontention.h"
+#include "objecttags.h"
+#include "objectrenderer.h"
+#include "payloadarena.h"
+#include "snapshotarchive.h"
+#include "stackprofiler.h"
 #include "visualizerproccomm.h"
 
 namespace Agent
@@ -14,10 +28,67 @@ namespace Agent
 		{'F', "float"}, {'D', "double"}, {'V', "void"}
 	};
 
+	// callbacks load the configuration once and keep it for as long as they run, attaching again publishes a new one
+	inline std::atomic<std::shared_ptr<AgentConfig>> config = std::make_shared<AgentConfig>(nullptr);
+	inline jvmtiEnv* environment = nullptr;
+	inline jvmtiCapabilities onLoadCapabilities = {};
+	inline std::mutex attachMutex;
+	inline bool attached = false;
+	inline std::atomic<long long> capturesUntilDetach = 0;
+	inline std::atomic<unsigned long long> captureCount = 0;
+	inline CaptureHistograms captureHistograms;
+	inline AllocationSampler allocationSampler;
+	inline GcMonitor gcMonitor;
+	inline MonitorContention monitorContention;
+	inline MetricsSampler metricsSampler;
+	inline StackProfiler stackProfiler;
+	inline LineNumberCache lineNumbers;
+	inline SnapshotArchive snapshotArchive;
+	inline CapturePipeline capturePipeline;
+	inline ObjectTags objectTags;
+	inline ArenaPool payloadArenas;
+	inline InternedStrings declarations;
+
+	// set while a thread captures, so writes made by toString() or the metrics calls do not trigger nested captures
+	inline thread_local bool capturing = false;
+
+	// elements per block when hashing primitive arrays for snapshot diffs
+	constexpr size_t ARRAY_HASH_BLOCK = 4096;
+
+	// elements formatted by one pipeline task, a whole number of hash blocks so each block is hashed by a single task
+	constexpr size_t HEAP_CHUNK_ELEMENTS = 16 * ARRAY_HASH_BLOCK;
+
 	static bool catchJVMTIError(jvmtiEnv* jvmti, jvmtiError error, const std::string& errmsg, bool silent = false);
+	static jint attach(jvmtiEnv* jvmti, JNIEnv* env, const char* options);
+	static void detach(jvmtiEnv* jvmti, JNIEnv* env);
+	static void countCapture(jvmtiEnv* jvmti, JNIEnv* env);
     static void JNICALL callbackEventHandler(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location, jobject exception);
+	static void captureSnapshot(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jint depth, jclass agent_class, const std::string& trigger);
+	static void JNICALL callbackVMInit(jvmtiEnv* jvmti, JNIEnv* env, jthread thread);
+	static void JNICALL callbackVMDeath(jvmtiEnv* jvmti, JNIEnv* env);
+	static void JNICALL callbackClassPrepare(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jclass klass);
+	static void JNICALL callbackBreakpoint(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location);
+	static void JNICALL callbackFieldModification(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jmethodID method, jlocation location, jclass field_klass, jobject object, jfieldID field, char signature_type, jvalue new_value);
+	static void JNICALL callbackGarbageCollectionStart(jvmtiEnv* jvmti);
+	static void JNICALL callbackGarbageCollectionFinish(jvmtiEnv* jvmti);
+	static void JNICALL callbackSampledObjectAlloc(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object, jclass object_klass, jlong size);
+	static void JNICALL callbackObjectFree(jvmtiEnv* jvmti, jlong tag);
+	static void JNICALL callbackMonitorContendedEnter(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object);
+	static void JNICALL callbackMonitorContendedEntered(jvmtiEnv* jvmti, JNIEnv* env, jthread thread, jobject object);
+	static std::string answerDrillDown(jvmtiEnv* jvmti, JNIEnv* env, DrillDownSession& session, ObjectRenderer& renderer, const std::string& request);
+	static std::string describeFields(jvmtiEnv* jvmti, JNIEnv* env, DrillDownSession& session, ObjectRenderer& renderer, jobject obj);
+	static std::string describeArrayRange(jvmtiEnv* jvmti, JNIEnv* env, DrillDownSession& session, ObjectRenderer& renderer, jobject obj, jint offset, jint count);
+	static unsigned long long hashBytes(const unsigned char* data, size_t size);
+	static bool copyHeapData(JNIEnv* env, jclass agent_class, ObjectRenderer& renderer, const std::string& signature, jobject obj, const std::string& str, std::string& formatted, HeapCopy& copy, CaptureMetrics& metrics);
+	static void formatCapture(const std::shared_ptr<PendingCapture>& capture, unsigned long long ticket, bool interactive);
+	static void runHeapChunks(const std::shared_ptr<PendingCapture>& capture, bool hash, bool format, const CapturePipeline::Task& then);
+	static void referenceUnchanged(PendingCapture& capture);
+	static void hashHeapChunk(HeapCopy& copy, size_t first);
+	static void formatHeapChunk(HeapCopy& copy, size_t first);
+	static void writeCapture(PendingCapture& capture, bool interactive);
 	static std::string dataTypeFormatter(std::string unformatted);
 	static std::string decodeJVMTypeSignature(const std::string& name, const std::string& signature, bool isMethod = false);
+	static std::string_view internDeclaration(const char* name, const char* signature, bool isStatic, bool isMethod = false);
 }
 
 #endif // AGENT_H
\ No newline at end of file
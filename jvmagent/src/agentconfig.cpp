@@ -0,0 +1,10 @@
+#include "pch.h"
+#include "agentconfig.h"
+
+AgentConfig::AgentConfig(const char* options)
+	: options(options)
+{
+	this->fieldWatches.parse(this->options.get("watch"));
+	this->lineBreakpoints.parse(this->options.get("break"));
+	this->visualizeCondition.parse(this->options.get("when"));
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#ifndef AGENTCONFIG_H
+#define AGENTCONFIG_H
+
+#include "pch.h"
+#include "agentoptions.h"
+#include "conditionexpression.h"
+#include "fieldwatches.h"
+#include "linebreakpoints.h"
+
+/*
+ * Everything one attach decides: its options, the watches, breakpoints and condition they name, and the capabilities
+ * the VM granted for them. A configuration is built and trimmed to its capabilities before it is published, and never
+ * parsed again afterwards. A later attach publishes a new one, while callbacks and pipeline tasks that are still
+ * running keep the one they started with alive until they are done with it.
+ */
+class AgentConfig
+{
+public:
+	AgentOptions options;
+	FieldWatches fieldWatches;
+	LineBreakpoints lineBreakpoints;
+	ConditionExpression visualizeCondition;
+	jvmtiCapabilities capabilities{};
+
+	explicit AgentConfig(const char* options);
+	~AgentConfig() = default;
+};
+
+#endif // AGENTCONFIG_H
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "agentoptions.h"
+
+AgentOptions::AgentOptions(const char* options)
+{
+	// the JVM passes a null pointer when no options are given
+	if (options == nullptr)
+		return;
+
+	std::stringstream stream(options);
+	std::string option;
+
+	while (std::getline(stream, option, ','))
+	{
+		if (option.empty())
+			continue;
+
+		// flags without a value are stored with an empty string
+		const size_t separator = option.find('=');
+		if (separator == std::string::npos)
+			this->m_values[option] = "";
+		else
+			this->m_values[option.substr(0, separator)] = option.substr(separator + 1);
+	}
+}
+
+bool AgentOptions::has(const std::string& key) const
+{
+	return this->m_values.contains(key);
+}
+
+std::string AgentOptions::get(const std::string& key, const std::string& fallback) const
+{
+	const auto it = this->m_values.find(key);
+	if (it == this->m_values.end() || it->second.empty())
+		return fallback;
+
+	return it->second;
+}
+
+long long AgentOptions::getNumber(const std::string& key, const long long fallback) const
+{
+	const auto it = this->m_values.find(key);
+	if (it == this->m_values.end() || it->second.empty())
+		return fallback;
+
+	// malformed numbers fall back to the default instead of aborting the JVM
+	try
+	{
+		return std::stoll(it->second);
+	}
+	catch (const std::logic_error&)
+	{
+		return fallback;
+	}
+}
+
+void AgentOptions::erase(const std::string& key)
+{
+	this->m_values.erase(key);
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+#ifndef AGENTOPTIONS_H
+#define AGENTOPTIONS_H
+
+#include "pch.h"
+
+/*
+ * Options passed to the agent after the library path, for example:
+ * -agentpath:C:\path\to\memdbgvis.dll=headless,bench=C:\path\to\results.jsonl
+ * Options are separated by commas and may either be a plain flag or a key-value pair.
+ */
+class AgentOptions
+{
+	std::unordered_map<std::string, std::string> m_values;
+
+public:
+	AgentOptions() = default;
+	explicit AgentOptions(const char* options);
+	~AgentOptions() = default;
+	bool has(const std::string& key) const;
+	std::string get(const std::string& key, const std::string& fallback = "") const;
+	long long getNumber(const std::string& key, long long fallback) const;
+	void erase(const std::string& key);
+};
+
+#endif // AGENTOPTIONS_H
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "pch.h"
+#include "agentthread.h"
+
+bool AgentThread::start(jvmtiEnv* jvmti, JNIEnv* env, const char* name, const jint priority, const Body body, void* owner)
+{
+	// agent threads need a java.lang.Thread object to run on
+	const jclass thread_class = env->FindClass("java/lang/Thread");
+	const jmethodID constructor = thread_class != nullptr ? env->GetMethodID(thread_class, "<init>", "(Ljava/lang/String;)V") : nullptr;
+	const jobject thread = constructor != nullptr ? env->NewObject(thread_class, constructor, env->NewStringUTF(name)) : nullptr;
+	if (thread == nullptr)
+	{
+		env->ExceptionClear();
+		return false;
+	}
+
+	// the thread owns its launch record once it runs
+	auto* launch = new Launch{ body, owner, this->m_generation.fetch_add(1, std::memory_order_relaxed) + 1 };
+	if (jvmti->RunAgentThread(thread, &AgentThread::run, launch, priority) == JVMTI_ERROR_NONE)
+		return true;
+	delete launch;
+	return false;
+}
+
+void AgentThread::stop()
+{
+	this->m_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool AgentThread::running(const unsigned long long generation) const
+{
+	return this->m_generation.load(std::memory_order_relaxed) == generation;
+}
+
+void AgentThread::run(jvmtiEnv* jvmti, JNIEnv* env, void* arg)
+{
+	const std::unique_ptr<Launch> launch(static_cast<Launch*>(arg));
+	launch->body(jvmti, env, launch->owner, launch->generation);
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#ifndef AGENTTHREAD_H
+#define AGENTTHREAD_H
+
+#include "pch.h"
+
+/*
+ * Runs a loop on a JVMTI agent thread until it is stopped. Every start and stop bumps a generation, and the generation
+ * a thread belongs to is fixed by start and handed to the thread, so a thread that only begins running after a stop,
+ * or after a stop and the next start, still exits instead of adopting the newer generation and running alongside it.
+ */
+class AgentThread
+{
+public:
+	// the loop runs for as long as running(generation) holds
+	typedef void (*Body)(jvmtiEnv* jvmti, JNIEnv* env, void* owner, unsigned long long generation);
+
+private:
+	typedef struct
+	{
+		Body body;
+		void* owner;
+		unsigned long long generation;
+	} Launch;
+
+	std::atomic<unsigned long long> m_generation = 0;
+
+	static void JNICALL run(jvmtiEnv* jvmti, JNIEnv* env, void* arg);
+
+public:
+	AgentThread() = default;
+	~AgentThread() = default;
+	bool start(jvmtiEnv* jvmti, JNIEnv* env, const char* name, jint priority, Body body, void* owner);
+	void stop();
+	bool running(unsigned long long generation) const;
+};
+
+#endif // AGENTTHREAD_H
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "pch.h"
+#include "allocationcounter.h"
+
+void AllocationCounter::record(const size_t size)
+{
+	s_allocations++;
+	s_bytes += size;
+}
+
+unsigned long long AllocationCounter::allocations()
+{
+	return s_allocations;
+}
+
+unsigned long long AllocationCounter::bytes()
+{
+	return s_bytes;
+}
+
+// the array and nothrow forms call these by default, so every allocation of the agent passes through here
+void* operator new(const size_t size)
+{
+	AllocationCounter::record(size);
+	for (;;)
+	{
+		if (void* memory = std::malloc(size > 0 ? size : 1))
+			return memory;
+
+		// same as the default: the new handler may free memory, without one the allocation fails
+		const std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include "pch.h"
+
+/*
+ * Counts the heap allocations the agent makes on every thread. The agent replaces the global operator new to do so,
+ * which only affects allocations made by the agent's own code and never those of the JVM. Captures read the counters
+ * between their phases, so every allocation is attributed to the phase that made it.
+ */
+class AllocationCounter
+{
+	static inline thread_local unsigned long long s_allocations = 0;
+	static inline thread_local unsigned long long s_bytes = 0;
+
+public:
+	static void record(size_t size);
+	static unsigned long long allocations();
+	static unsigned long long bytes();
+};
+
+#endif // ALLOCATIONCOUNTER_H
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "pch.h"
+#include "allocationsampler.h"
+
+thread_local AllocationSampler::BufferLease AllocationSampler::s_lease;
+
+AllocationSampler::BufferLease::~BufferLease()
+{
+	if (this->buffer != nullptr)
+		this->buffer->owned.store(false, std::memory_order_release);
+}
+
+void AllocationSampler::setInterval(const jint interval)
+{
+	this->m_interval = interval;
+}
+
+AllocationSampler::ThreadBuffer* AllocationSampler::acquireBuffer()
+{
+	if (s_lease.buffer != nullptr)
+		return s_lease.buffer;
+
+	// reuse the buffer of a thread that has exited, its totals keep counting towards the same sites
+	for (ThreadBuffer* buffer = this->m_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+	{
+		bool owned = false;
+		if (buffer->owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+			return s_lease.buffer = buffer;
+	}
+
+	// buffers are never freed, so readers can walk the list without synchronizing with exiting threads
+	auto* buffer = new ThreadBuffer{};
+	buffer->owned.store(true, std::memory_order_relaxed);
+	buffer->next = this->m_buffers.load(std::memory_order_relaxed);
+	while (!this->m_buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed));
+	return s_lease.buffer = buffer;
+}
+
+void AllocationSampler::record(jvmtiEnv* jvmti, jthread thread, jclass klass, const jlong size)
+{
+	jvmtiFrameInfo frames[MAX_DEPTH];
+	jint depth = 0;
+	if (jvmti->GetStackTrace(thread, 0, MAX_DEPTH, frames, &depth) != JVMTI_ERROR_NONE)
+		return;
+
+	// the class is part of the site, only as much of its signature as a site keeps is compared
+	char* signature = nullptr;
+	if (jvmti->GetClassSignature(klass, &signature, nullptr) != JVMTI_ERROR_NONE)
+		return;
+	char class_name[CLASS_NAME_SIZE] = {};
+	std::strncpy(class_name, signature, CLASS_NAME_SIZE - 1);
+	jvmti->Deallocate(reinterpret_cast<unsigned char*>(signature));
+
+	// FNV over the class name and the frames with their locations, zero marks a free slot
+	unsigned long long hash = 0xCBF29CE484222325ULL;
+	for (const char* c = class_name; *c != '\0'; c++)
+		hash = (hash ^ static_cast<unsigned char>(*c)) * 0x100000001B3ULL;
+	for (jint i = 0; i < depth; i++)
+	{
+		hash = (hash ^ reinterpret_cast<uintptr_t>(frames[i].method)) * 0x100000001B3ULL;
+		hash = (hash ^ static_cast<unsigned long long>(frames[i].location)) * 0x100000001B3ULL;
+	}
+	hash |= 1;
+
+	ThreadBuffer* buffer = this->acquireBuffer();
+	for (size_t probe = 0; probe < MAX_PROBES; probe++)
+	{
+		AllocationSite& site = buffer->sites[(hash + probe) & (SITES_PER_THREAD - 1)];
+		const unsigned long long site_hash = site.hash.load(std::memory_order_relaxed);
+
+		// first sample of this stack on this thread
+		if (site_hash == 0)
+		{
+			site.depth = depth;
+			std::copy(frames, frames + depth, site.frames.begin());
+			std::memcpy(site.className, class_name, CLASS_NAME_SIZE);
+			site.hash.store(hash, std::memory_order_release);
+		}
+		else if (site_hash != hash || site.depth != depth || std::strcmp(site.className, class_name) != 0
+			|| !std::equal(frames, frames + depth, site.frames.begin(), [](const jvmtiFrameInfo& a, const jvmtiFrameInfo& b) { return a.method == b.method && a.location == b.location; }))
+			continue;
+
+		// only this thread writes its buffer, so plain stores are enough for readers to see consistent totals
+		site.bytes.store(site.bytes.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+		site.count.store(site.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+
+	// the table of this thread is full around this hash
+	buffer->droppedBytes.store(buffer->droppedBytes.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+	buffer->droppedCount.store(buffer->droppedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+std::vector<std::string> AllocationSampler::report(jvmtiEnv* jvmti, LineNumberCache& lineNumbers, const size_t limit)
+{
+	// captures on several threads take turns, since every report moves the baseline of the next one
+	std::lock_guard lock(this->m_reportMutex);
+
+	// the same stack may have been sampled on several threads
+	std::unordered_map<unsigned long long, SiteTotals> totals;
+	long long dropped_bytes = 0, dropped_count = 0;
+	for (ThreadBuffer* buffer = this->m_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+	{
+		for (const AllocationSite& site : buffer->sites)
+		{
+			const unsigned long long hash = site.hash.load(std::memory_order_acquire);
+			if (hash == 0)
+				continue;
+
+			SiteTotals& total = totals.try_emplace(hash, SiteTotals{ &site, 0, 0 }).first->second;
+			total.bytes += site.bytes.load(std::memory_order_relaxed);
+			total.count += site.count.load(std::memory_order_relaxed);
+		}
+		dropped_bytes += buffer->droppedBytes.load(std::memory_order_relaxed);
+		dropped_count += buffer->droppedCount.load(std::memory_order_relaxed);
+	}
+
+	// only what was allocated since the previous report is shown
+	std::vector<SiteTotals> deltas;
+	long long total_bytes = dropped_bytes - this->m_reportedDropped.first, total_count = dropped_count - this->m_reportedDropped.second;
+	this->m_reportedDropped = { dropped_bytes, dropped_count };
+	for (const auto& [hash, total] : totals)
+	{
+		std::pair<long long, long long>& reported = this->m_reported[hash];
+		const SiteTotals delta = { total.site, total.bytes - reported.first, total.count - reported.second };
+		reported = { total.bytes, total.count };
+
+		if (delta.count <= 0)
+			continue;
+		total_bytes += delta.bytes;
+		total_count += delta.count;
+		deltas.push_back(delta);
+	}
+
+	// the top sites by bytes and by count usually overlap, both sets are listed once
+	const size_t top = std::min(limit, deltas.size());
+	long long count_threshold = std::numeric_limits<long long>::max();
+	if (top > 0)
+	{
+		std::vector<long long> counts;
+		counts.reserve(deltas.size());
+		for (const SiteTotals& delta : deltas)
+			counts.push_back(delta.count);
+		std::nth_element(counts.begin(), counts.begin() + static_cast<std::ptrdiff_t>(top - 1), counts.end(), std::greater<>());
+		count_threshold = counts[top - 1];
+	}
+	std::partial_sort(deltas.begin(), deltas.begin() + static_cast<std::ptrdiff_t>(top), deltas.end(), [](const SiteTotals& a, const SiteTotals& b) { return a.bytes > b.bytes; });
+
+	// the first line holds the totals: "TOTAL\abytes\asamples\asampling interval"
+	std::vector<std::string> lines;
+	lines.push_back("TOTAL\a" + std::to_string(total_bytes) + '\a' + std::to_string(total_count) + '\a' + std::to_string(this->m_interval));
+
+	// every site is "bytes\asamples\aclass\aframe\aframe..." with the allocating frame first
+	// frames carry their line, or their bytecode index in methods without line numbers, since sites only differ there
+	for (size_t i = 0; i < deltas.size(); i++)
+	{
+		if (i >= top && deltas[i].count < count_threshold)
+			continue;
+
+		const AllocationSite& site = *deltas[i].site;
+		std::string line = std::to_string(deltas[i].bytes) + '\a' + std::to_string(deltas[i].count) + '\a' + AllocationSampler::readableClassName(site.className);
+		for (jint j = 0; j < site.depth; j++)
+		{
+			const jint line_number = lineNumbers.lineOf(jvmti, site.frames[j].method, site.frames[j].location);
+			line += '\a' + this->methodName(jvmti, site.frames[j].method);
+			line += line_number >= 0 ? ':' + std::to_string(line_number) : " (bci " + std::to_string(site.frames[j].location) + ')';
+		}
+		lines.push_back(std::move(line));
+	}
+
+	return lines;
+}
+
+const std::string& AllocationSampler::methodName(jvmtiEnv* jvmti, jmethodID method)
+{
+	// frames repeat across sites, so every method is only resolved once
+	const auto cached = this->m_methodNames.find(method);
+	if (cached != this->m_methodNames.end())
+		return cached->second;
+
+	std::string name = "<unknown>";
+	jclass klass;
+	char* class_signature = nullptr;
+	char* method_name = nullptr;
+	if (jvmti->GetMethodDeclaringClass(method, &klass) == JVMTI_ERROR_NONE && jvmti->GetClassSignature(klass, &class_signature, nullptr) == JVMTI_ERROR_NONE && jvmti->GetMethodName(method, &method_name, nullptr, nullptr) == JVMTI_ERROR_NONE)
+		name = AllocationSampler::readableClassName(class_signature) + '.' + method_name;
+
+	jvmti->Deallocate(reinterpret_cast<unsigned char*>(class_signature));
+	jvmti->Deallocate(reinterpret_cast<unsigned char*>(method_name));
+	return this->m_methodNames.emplace(method, std::move(name)).first->second;
+}
+
+std::string AllocationSampler::readableClassName(const char* signature)
+{
+	// "Ljava/util/ArrayList;" -> "java.util.ArrayList", "[[I" -> "int[][]"
+	std::string_view view = signature;
+	size_t dimensions = 0;
+	while (!view.empty() && view.front() == '[')
+	{
+		view.remove_prefix(1);
+		dimensions++;
+	}
+
+	std::string name;
+	if (view.size() > 2 && view.front() == 'L')
+	{
+		name = view.substr(1, view.size() - 2);
+		std::replace(name.begin(), name.end(), '/', '.');
+	}
+	else if (!view.empty())
+	{
+		switch (view.front())
+		{
+		case 'Z': name = "boolean"; break;
+		case 'B': name = "byte"; break;
+		case 'C': name = "char"; break;
+		case 'S': name = "short"; break;
+		case 'I': name = "int"; break;
+		case 'J': name = "long"; break;
+		case 'F': name = "float"; break;
+		case 'D': name = "double"; break;
+		default: name = view; break;
+		}
+	}
+
+	for (size_t i = 0; i < dimensions; i++)
+		name += "[]";
+	return name;
+}
\ No newline at end of file
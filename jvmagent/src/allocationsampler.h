@@ -0,0 +1,83 @@
+#pragma once
+
+#ifndef ALLOCATIONSAMPLER_H
+#define ALLOCATIONSAMPLER_H
+
+#include "pch.h"
+#include "linebreakpoints.h"
+
+/*
+ * Allocation profiler fed by the JVM's SampledObjectAlloc event, enabled with the "allocsample" option.
+ * Every allocating thread records into its own fixed-size table of allocation sites, keyed by the hash of the
+ * allocated class and the sampled frames, methods and locations both, so separate allocations in one method stay
+ * apart. Apart from reading the class signature, taking a sample never locks, allocates or formats.
+ * Captures sum the tables of all threads and report the sites that allocated the most since the previous capture.
+ */
+class AllocationSampler
+{
+public:
+	static constexpr jint DEFAULT_INTERVAL = 512 * 1024;
+	static constexpr size_t DEFAULT_SITES = 10;
+
+private:
+	static constexpr jint MAX_DEPTH = 16;
+	static constexpr size_t SITES_PER_THREAD = 256;
+	static constexpr size_t MAX_PROBES = 16;
+	static constexpr size_t CLASS_NAME_SIZE = 96;
+
+	// written by the owning thread only, the hash is published last so readers never see a partial site
+	typedef struct
+	{
+		std::atomic<unsigned long long> hash;
+		jint depth;
+		std::array<jvmtiFrameInfo, MAX_DEPTH> frames;
+		char className[CLASS_NAME_SIZE];
+		std::atomic<long long> bytes;
+		std::atomic<long long> count;
+	} AllocationSite;
+
+	typedef struct ThreadBuffer
+	{
+		std::array<AllocationSite, SITES_PER_THREAD> sites;
+		std::atomic<long long> droppedBytes;
+		std::atomic<long long> droppedCount;
+		std::atomic<bool> owned;
+		ThreadBuffer* next;
+	} ThreadBuffer;
+
+	// hands the buffer back to the pool when its thread exits, so short-lived threads do not grow the pool
+	struct BufferLease
+	{
+		ThreadBuffer* buffer = nullptr;
+		~BufferLease();
+	};
+
+	typedef struct
+	{
+		const AllocationSite* site;
+		long long bytes;
+		long long count;
+	} SiteTotals;
+
+	static thread_local BufferLease s_lease;
+
+	std::atomic<ThreadBuffer*> m_buffers = nullptr;
+	std::mutex m_reportMutex;
+	std::unordered_map<unsigned long long, std::pair<long long, long long>> m_reported;
+	std::pair<long long, long long> m_reportedDropped;
+	std::unordered_map<jmethodID, std::string> m_methodNames;
+	jint m_interval = DEFAULT_INTERVAL;
+
+	ThreadBuffer* acquireBuffer();
+	const std::string& methodName(jvmtiEnv* jvmti, jmethodID method);
+
+public:
+	AllocationSampler() = default;
+	~AllocationSampler() = default;
+	void setInterval(jint interval);
+	void record(jvmtiEnv* jvmti, jthread thread, jclass klass, jlong size);
+	std::vector<std::string> report(jvmtiEnv* jvmti, LineNumberCache& lineNumbers, size_t limit);
+	static std::string readableClassName(const char* signature);
+};
+
+#endif // ALLOCATIONSAMPLER_H
\ No newline at end of file
@@ -0,0 +1,246 @@
+#include "pch.h"
+#include "capturemetrics.h"
+
+CaptureMetrics::CaptureMetrics()
+	: m_start(std::chrono::steady_clock::now()), m_lap(m_start)
+{
+	this->adoptThread();
+}
+
+const char* CaptureMetrics::phaseName(const CapturePhase phase)
+{
+	switch (phase)
+	{
+	case CapturePhase::StackWalk:
+		return "stack_walk";
+	case CapturePhase::RuntimeMetrics:
+		return "runtime_metrics";
+	case CapturePhase::AllocationSites:
+		return "allocation_sites";
+	case CapturePhase::Monitors:
+		return "monitors";
+	case CapturePhase::Profile:
+		return "profile";
+	case CapturePhase::CallStack:
+		return "call_stack";
+	case CapturePhase::LocalVariables:
+		return "local_variables";
+	case CapturePhase::StaticFields:
+		return "static_fields";
+	case CapturePhase::ToString:
+		return "to_string";
+	case CapturePhase::HeapCopy:
+		return "heap_copy";
+	case CapturePhase::HeapDump:
+		return "heap_dump";
+	case CapturePhase::HeapFormat:
+		return "heap_format";
+	case CapturePhase::Serialize:
+		return "serialize";
+	case CapturePhase::Launch:
+		return "launch";
+	default:
+		return "unknown";
+	}
+}
+
+const char* CaptureMetrics::counterName(const CaptureCounter counter)
+{
+	switch (counter)
+	{
+	case CaptureCounter::BytesProduced:
+		return "bytes";
+	case CaptureCounter::JNICalls:
+		return "jni_calls";
+	case CaptureCounter::ObjectsStringified:
+		return "stringified";
+	case CaptureCounter::StringBytes:
+		return "string_bytes";
+	case CaptureCounter::StringNanos:
+		return "string_ns";
+	case CaptureCounter::Allocations:
+		return "allocations";
+	case CaptureCounter::AllocatedBytes:
+		return "allocated_bytes";
+	default:
+		return "unknown";
+	}
+}
+
+void CaptureMetrics::lap(const CapturePhase phase)
+{
+	// attribute everything since the previous lap to the given phase
+	const auto now = std::chrono::steady_clock::now();
+	const auto idx = static_cast<size_t>(phase);
+	this->m_phaseNanos[idx] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - this->m_lap).count();
+	this->m_lap = now;
+
+	// a capture handed over to another thread is only counted from its first lap there
+	if (std::this_thread::get_id() == this->m_allocationThread)
+	{
+		this->count(CaptureCounter::Allocations, static_cast<long long>(AllocationCounter::allocations() - this->m_allocations));
+		this->count(CaptureCounter::AllocatedBytes, static_cast<long long>(AllocationCounter::bytes() - this->m_allocatedBytes));
+	}
+	this->adoptThread();
+
+	for (size_t i = 0; i < COUNTERS; i++)
+	{
+		this->m_phaseCounters[idx][i] += this->m_pendingCounters[i];
+		this->m_pendingCounters[i] = 0;
+	}
+}
+
+void CaptureMetrics::count(const CaptureCounter counter, const long long amount)
+{
+	// counters are held back until the next lap so they land in the same phase as the time
+	this->m_pendingCounters[static_cast<size_t>(counter)] += amount;
+}
+
+void CaptureMetrics::release()
+{
+	// the application thread resumes here while the rest of the capture goes on without it
+	this->m_release = std::chrono::steady_clock::now();
+	this->m_released = true;
+}
+
+void CaptureMetrics::adoptThread()
+{
+	// the capture goes on on the calling thread, its allocations are counted from here
+	this->m_allocationThread = std::this_thread::get_id();
+	this->m_allocations = AllocationCounter::allocations();
+	this->m_allocatedBytes = AllocationCounter::bytes();
+}
+
+void CaptureMetrics::setPayloadBytes(const size_t bytes)
+{
+	this->m_payloadBytes = bytes;
+}
+
+void CaptureMetrics::setMemory(const size_t peakBytes, const size_t arenaBytes)
+{
+	this->m_peakBytes = peakBytes;
+	this->m_arenaBytes = arenaBytes;
+}
+
+void CaptureMetrics::setHeapDumpBytes(const unsigned long long bytes)
+{
+	this->m_heapDumpBytes = bytes;
+}
+
+long long CaptureMetrics::phaseNanos(const CapturePhase phase) const
+{
+	return this->m_phaseNanos[static_cast<size_t>(phase)];
+}
+
+long long CaptureMetrics::phaseCounter(const CapturePhase phase, const CaptureCounter counter) const
+{
+	return this->m_phaseCounters[static_cast<size_t>(phase)][static_cast<size_t>(counter)];
+}
+
+long long CaptureMetrics::totalNanos() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(this->m_lap - this->m_start).count();
+}
+
+long long CaptureMetrics::heldNanos() const
+{
+	// a capture that was never released held the thread until it was done
+	return this->m_released ? std::chrono::duration_cast<std::chrono::nanoseconds>(this->m_release - this->m_start).count() : this->totalNanos();
+}
+
+std::vector<std::string> CaptureMetrics::serialize() const
+{
+	// one line per phase: name, nanoseconds and every counter separated by the payload delimiter
+	std::vector<std::string> lines;
+
+	for (size_t i = 0; i < PHASES; i++)
+	{
+		std::string line = CaptureMetrics::phaseName(static_cast<CapturePhase>(i)) + ('\a' + std::to_string(this->m_phaseNanos[i]));
+		for (size_t j = 0; j < COUNTERS; j++)
+			line += '\a' + std::to_string(this->m_phaseCounters[i][j]);
+		lines.push_back(line);
+	}
+
+	return lines;
+}
+
+void CaptureMetrics::appendBenchmarkRecord(const std::string& filepath, const unsigned long long hit) const
+{
+	// one JSON object per line so the benchmark harness can stream the results
+	std::ofstream output_filestream(filepath, std::ios::app);
+	output_filestream << "{\"hit\":" << hit << ",\"total_ns\":" << this->totalNanos() << ",\"held_ns\":" << this->heldNanos() << ",\"payload_bytes\":" << this->m_payloadBytes
+		<< ",\"peak_bytes\":" << this->m_peakBytes << ",\"arena_bytes\":" << this->m_arenaBytes << ",\"hprof_bytes\":" << this->m_heapDumpBytes << ",\"phases\":{";
+
+	for (size_t i = 0; i < PHASES; i++)
+	{
+		if (i > 0)
+			output_filestream << ',';
+		output_filestream << '"' << CaptureMetrics::phaseName(static_cast<CapturePhase>(i)) << "\":" << this->m_phaseNanos[i];
+	}
+
+	output_filestream << "},\"counters\":{";
+
+	for (size_t j = 0; j < COUNTERS; j++)
+	{
+		long long total = 0;
+		for (size_t i = 0; i < PHASES; i++)
+			total += this->m_phaseCounters[i][j];
+
+		if (j > 0)
+			output_filestream << ',';
+		output_filestream << '"' << CaptureMetrics::counterName(static_cast<CaptureCounter>(j)) << "\":" << total;
+	}
+
+	output_filestream << "}}\n";
+}
+
+void CaptureHistograms::add(const size_t series, const long long nanos)
+{
+	// index of the highest set bit picks the power-of-two bucket
+	size_t bucket = 0;
+	while (bucket < BUCKETS - 1 && (1LL << bucket) <= nanos)
+		bucket++;
+
+	this->m_buckets[series][bucket].fetch_add(1, std::memory_order_relaxed);
+	this->m_sumNanos[series].fetch_add(nanos, std::memory_order_relaxed);
+}
+
+void CaptureHistograms::record(const CaptureMetrics& metrics)
+{
+	for (size_t i = 0; i < static_cast<size_t>(CapturePhase::Count); i++)
+		this->add(i, metrics.phaseNanos(static_cast<CapturePhase>(i)));
+
+	this->add(SERIES - 1, metrics.totalNanos());
+	this->m_captures.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool CaptureHistograms::exportTo(const std::string& filepath) const
+{
+	std::ofstream output_filestream(filepath);
+	if (!output_filestream)
+		return false;
+
+	// upper bounds of the buckets are implied by their index: bucket i holds durations below 2^i ns
+	output_filestream << "{\"captures\":" << this->m_captures.load(std::memory_order_relaxed) << ",\"bucket_upper_bound_ns\":\"2^i\",\"phases\":{";
+
+	for (size_t i = 0; i < SERIES; i++)
+	{
+		if (i > 0)
+			output_filestream << ',';
+
+		output_filestream << '"' << (i == SERIES - 1 ? "total" : CaptureMetrics::phaseName(static_cast<CapturePhase>(i)))
+			<< "\":{\"sum_ns\":" << this->m_sumNanos[i].load(std::memory_order_relaxed) << ",\"buckets\":[";
+
+		for (size_t j = 0; j < BUCKETS; j++)
+		{
+			if (j > 0)
+				output_filestream << ',';
+			output_filestream << this->m_buckets[i][j].load(std::memory_order_relaxed);
+		}
+
+		output_filestream << "]}";
+	}
+
+	output_filestream << "}}\n";
+	return static_cast<bool>(output_filestream);
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+#ifndef CAPTUREMETRICS_H
+#define CAPTUREMETRICS_H
+
+#include "pch.h"
+#include "allocationcounter.h"
+
+/*
+ * Phases of a single capture. The event handler switches between phases as it runs,
+ * so each phase holds exclusive time: toString() calls made while reading local variables
+ * are attributed to ToString rather than LocalVariables, and copying arrays and object bytes to HeapCopy.
+ * HeapFormat is the time the capture pipeline took to format those copies once the application thread was done with them.
+ * Heap allocations are counted like the time, and the pipeline adds the allocations of its tasks to HeapFormat.
+ * HeapDump is the HPROF dump of the "hprof" option, written before the thread resumes.
+ * Monitors reads the locks of every thread for the "monitors" option and the contention histograms of "contention".
+ * Profile resolves and serializes the stacks the "profile" option sampled since the previous capture.
+ */
+enum class CapturePhase : size_t
+{
+	StackWalk,
+	RuntimeMetrics,
+	AllocationSites,
+	Monitors,
+	Profile,
+	CallStack,
+	LocalVariables,
+	StaticFields,
+	ToString,
+	HeapCopy,
+	HeapDump,
+	HeapFormat,
+	Serialize,
+	Launch,
+	Count
+};
+
+enum class CaptureCounter : size_t
+{
+	BytesProduced,
+	JNICalls,
+	ObjectsStringified,
+	StringBytes,
+	StringNanos,
+	Allocations,
+	AllocatedBytes,
+	Count
+};
+
+class CaptureMetrics
+{
+	static constexpr size_t PHASES = static_cast<size_t>(CapturePhase::Count);
+	static constexpr size_t COUNTERS = static_cast<size_t>(CaptureCounter::Count);
+
+	std::chrono::steady_clock::time_point m_start;
+	std::chrono::steady_clock::time_point m_lap;
+	std::array<long long, PHASES> m_phaseNanos{};
+	std::array<std::array<long long, COUNTERS>, PHASES> m_phaseCounters{};
+	std::array<long long, COUNTERS> m_pendingCounters{};
+	std::chrono::steady_clock::time_point m_release;
+	bool m_released = false;
+	size_t m_payloadBytes = 0;
+	size_t m_peakBytes = 0;
+	size_t m_arenaBytes = 0;
+	unsigned long long m_heapDumpBytes = 0;
+
+	// allocations are counted on the thread that laps, from where the previous lap on it left off
+	std::thread::id m_allocationThread;
+	unsigned long long m_allocations = 0;
+	unsigned long long m_allocatedBytes = 0;
+
+public:
+	CaptureMetrics();
+	~CaptureMetrics() = default;
+	static const char* phaseName(CapturePhase phase);
+	static const char* counterName(CaptureCounter counter);
+	void lap(CapturePhase phase);
+	void count(CaptureCounter counter, long long amount = 1);
+	void release();
+	void adoptThread();
+	void setPayloadBytes(size_t bytes);
+	void setMemory(size_t peakBytes, size_t arenaBytes);
+	void setHeapDumpBytes(unsigned long long bytes);
+	long long phaseNanos(CapturePhase phase) const;
+	long long phaseCounter(CapturePhase phase, CaptureCounter counter) const;
+	long long totalNanos() const;
+	long long heldNanos() const;
+	std::vector<std::string> serialize() const;
+	void appendBenchmarkRecord(const std::string& filepath, unsigned long long hit) const;
+};
+
+/*
+ * Aggregates the phase timings of every capture into power-of-two histograms.
+ * Bucket i counts captures that spent less than 2^i nanoseconds in a phase.
+ * All updates are lock-free so concurrent captures on different threads never block each other.
+ */
+class CaptureHistograms
+{
+	static constexpr size_t BUCKETS = 48;
+	static constexpr size_t SERIES = static_cast<size_t>(CapturePhase::Count) + 1;
+
+	std::array<std::array<std::atomic<unsigned long long>, BUCKETS>, SERIES> m_buckets{};
+	std::array<std::atomic<long long>, SERIES> m_sumNanos{};
+	std::atomic<unsigned long long> m_captures = 0;
+
+	void add(size_t series, long long nanos);
+
+public:
+	CaptureHistograms() = default;
+	~CaptureHistograms() = default;
+	void record(const CaptureMetrics& metrics);
+	bool exportTo(const std::string& filepath) const;
+};
+
+#endif // CAPTUREMETRICS_H
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "capturepipeline.h"
+
+CapturePipeline::~CapturePipeline()
+{
+	// pending captures are written when the VM dies, by the time the agent unloads the workers are already gone
+	for (std::thread& thread : this->m_threads)
+		thread.detach();
+}
+
+void CapturePipeline::start(const size_t workers)
+{
+	// the pool is sized once, attaching again keeps the workers that are already running
+	if (!this->m_queues.empty())
+		return;
+
+	for (size_t i = 0; i <= workers; i++)
+		this->m_queues.push_back(std::make_unique<Queue>());
+	for (size_t i = 0; i < workers; i++)
+		this->m_threads.emplace_back(&CapturePipeline::run, this, i);
+}
+
+void CapturePipeline::stop()
+{
+	// captures that are still formatting are written before the workers exit
+	if (!this->m_queues.empty())
+		this->helpUntil([this] { return this->idle(); });
+
+	{
+		std::lock_guard lock(this->m_sleepMutex);
+		this->m_stopping = true;
+	}
+	this->m_wake.notify_all();
+
+	for (std::thread& thread : this->m_threads)
+		thread.join();
+	this->m_threads.clear();
+}
+
+bool CapturePipeline::running() const
+{
+	return !this->m_threads.empty();
+}
+
+void CapturePipeline::submit(Task task)
+{
+	// workers keep their own tasks, everyone else spreads tasks over the workers
+	const size_t queue = s_home < this->m_queues.size() ? s_home : this->m_nextQueue.fetch_add(1, std::memory_order_relaxed) % this->m_queues.size();
+	this->m_queued.fetch_add(1, std::memory_order_release);
+	{
+		std::lock_guard lock(this->m_queues[queue]->mutex);
+		this->m_queues[queue]->tasks.push_back(std::move(task));
+	}
+	this->wake(false);
+}
+
+bool CapturePipeline::runOne(const size_t home)
+{
+	Task task;
+
+	// newest task of the own queue first, its data is most likely still in cache
+	{
+		std::lock_guard lock(this->m_queues[home]->mutex);
+		if (!this->m_queues[home]->tasks.empty())
+		{
+			task = std::move(this->m_queues[home]->tasks.back());
+			this->m_queues[home]->tasks.pop_back();
+		}
+	}
+
+	// otherwise steal the oldest task of another queue
+	for (size_t i = 1; !task && i < this->m_queues.size(); i++)
+	{
+		Queue& victim = *this->m_queues[(home + i) % this->m_queues.size()];
+		std::lock_guard lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+		}
+	}
+
+	if (!task)
+		return false;
+	this->m_queued.fetch_sub(1, std::memory_order_acq_rel);
+	task();
+	return true;
+}
+
+void CapturePipeline::run(const size_t index)
+{
+	s_home = index;
+	for (;;)
+	{
+		if (this->runOne(index))
+			continue;
+
+		std::unique_lock lock(this->m_sleepMutex);
+		this->m_wake.wait(lock, [this] { return this->m_stopping || this->m_queued.load(std::memory_order_acquire) > 0; });
+		if (this->m_stopping && this->m_queued.load(std::memory_order_acquire) == 0)
+			return;
+	}
+}
+
+void CapturePipeline::wake(const bool all)
+{
+	// taking the lock orders the wake-up after the waiter checked its condition, so it cannot be missed
+	{
+		std::lock_guard lock(this->m_sleepMutex);
+	}
+	if (all)
+		this->m_wake.notify_all();
+	else
+		this->m_wake.notify_one();
+}
+
+bool CapturePipeline::idle()
+{
+	std::lock_guard lock(this->m_orderMutex);
+	return this->m_queued.load(std::memory_order_acquire) == 0 && !this->m_writing && this->m_nextTicket == this->m_tickets.load(std::memory_order_acquire);
+}
+
+void CapturePipeline::helpUntil(const std::function<bool()>& done)
+{
+	const size_t home = s_home < this->m_queues.size() ? s_home : this->m_queues.size() - 1;
+	while (!done())
+	{
+		if (this->runOne(home))
+			continue;
+
+		// nothing left to run, the remaining tasks are running on other threads
+		std::unique_lock lock(this->m_sleepMutex);
+		this->m_wake.wait(lock, [this, &done] { return this->m_queued.load(std::memory_order_acquire) > 0 || done(); });
+	}
+}
+
+unsigned long long CapturePipeline::ticket()
+{
+	return this->m_tickets.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void CapturePipeline::complete(const unsigned long long ticket, Task write)
+{
+	std::unique_lock lock(this->m_orderMutex);
+	this->m_completed.emplace(ticket, std::move(write));
+
+	// a thread already writing picks this capture up once the ones before it are written
+	if (this->m_writing)
+		return;
+
+	this->m_writing = true;
+	while (!this->m_completed.empty() && this->m_completed.begin()->first == this->m_nextTicket)
+	{
+		Task next = std::move(this->m_completed.begin()->second);
+		this->m_completed.erase(this->m_completed.begin());
+		lock.unlock();
+		next();
+		lock.lock();
+		this->m_nextTicket++;
+	}
+	this->m_writing = false;
+	lock.unlock();
+
+	// threads waiting for a capture to be written check again
+	this->wake(true);
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#ifndef CAPTUREPIPELINE_H
+#define CAPTUREPIPELINE_H
+
+#include "pch.h"
+#include "capturemetrics.h"
+#include "payloadarena.h"
+#include "visualizerproccomm.h"
+
+class AgentConfig;
+
+// contents of an array or the raw bytes of an object, copied out of the heap so they can be formatted off the application thread
+typedef struct
+{
+	char type;
+	size_t elementSize;
+	std::vector<unsigned char> bytes;
+	std::string_view key;
+	jlong tag;
+	size_t heapEntry;
+	size_t hashEntry;
+	std::vector<std::string> pieces;
+	std::vector<unsigned long long> blockHashes;
+	unsigned long long contentHash;
+	unsigned long long reference;
+} HeapCopy;
+
+// a capture whose heap data is still being formatted, shared by the tasks that format it
+// the entries of its payload live in its arena, which goes back to the pool once the snapshot is written
+typedef struct
+{
+	std::shared_ptr<AgentConfig> config;
+	CaptureMetrics metrics;
+	std::unique_ptr<PayloadArena> arena;
+	VisualizerPayload payload;
+	std::vector<HeapCopy> copies;
+	bool incremental;
+	std::atomic<size_t> remaining;
+	std::atomic<unsigned long long> taskAllocations;
+	std::atomic<unsigned long long> taskAllocatedBytes;
+	std::atomic<bool> written;
+} PendingCapture;
+
+/*
+ * Work-stealing pool that formats and serializes captures once the application thread has copied their values.
+ * Every worker takes the newest task from its own queue and steals the oldest from the others when it runs dry, so the
+ * chunks of one large array spread over all cores. Threads waiting on a capture help run tasks instead of blocking, and
+ * with no workers that is all that runs them. Captures are written in the order their copies finished, whichever task
+ * completes first.
+ */
+class CapturePipeline
+{
+public:
+	typedef std::function<void()> Task;
+
+private:
+	typedef struct
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	} Queue;
+
+	// queue of each worker, the last one is shared by threads outside the pool
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_threads;
+	std::atomic<size_t> m_queued = 0;
+	std::atomic<size_t> m_nextQueue = 0;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	bool m_stopping = false;
+
+	std::mutex m_orderMutex;
+	std::map<unsigned long long, Task> m_completed;
+	std::atomic<unsigned long long> m_tickets = 0;
+	unsigned long long m_nextTicket = 0;
+	bool m_writing = false;
+
+	static inline thread_local size_t s_home = std::numeric_limits<size_t>::max();
+
+	bool runOne(size_t home);
+	void run(size_t index);
+	void wake(bool all);
+	bool idle();
+
+public:
+	CapturePipeline() = default;
+	~CapturePipeline();
+	void start(size_t workers);
+	void stop();
+	bool running() const;
+	void submit(Task task);
+	void helpUntil(const std::function<bool()>& done);
+	unsigned long long ticket();
+	void complete(unsigned long long ticket, Task write);
+};
+
+#endif // CAPTUREPIPELINE_H
\ No newline at end of file
@@ -1,8 +1,6 @@
 package com.vjzcorp.jvmtools;
 
 import java.io.IOException;
-import java.io.PrintWriter;
-import java.io.FileWriter;
 import java.io.ByteArrayOutputStream;
 import java.io.ObjectOutputStream;
 import java.io.NotSerializableException;
@@ -18,26 +16,17 @@ import java.util.List;
  */
 public final class memdbgvis extends Exception {
     /**
-     * Method used for invoking the agent and subsequently launching the visualizer. It accomplishes this in two steps:
-     * <br><br>
-     * 1. Fetch the line number of invocation and write it to a shared data file.
-     * <br>
-     * 2. Launch the visualizer by throwing a special exception which is handled by the native C++ JVMTI agent.
+     * Method used for invoking the agent and subsequently launching the visualizer.
+     * The visualizer is launched by throwing a special exception which is handled by the native C++ JVMTI agent,
+     * which captures the frame that called this method, including the line number of the call.
      */
     public static void visualize() {
         // getting JVM arguments
         final List<String> args = ManagementFactory.getRuntimeMXBean().getInputArguments();
 
-        // find the visualizer agent argument
+        // only throw when the visualizer agent is loaded
         for (String arg : args) {
             if (arg.startsWith("-agentpath")) {
-                String path = arg.substring(arg.indexOf(':') + 1).replaceAll(".dll", ".dat");
-                try (PrintWriter writer = new PrintWriter(new FileWriter(path, false))) {
-                    writer.println(new memdbgvis().getStackTrace()[1].getLineNumber()); // write line number to shared file
-                } catch (Exception e) {
-                    e.printStackTrace();
-                }
-
                 try {
                     try {
                         throw new memdbgvis();  // invoke the agent by throwing and then immediately catching an exception named 'memdbgvis'
@@ -51,8 +40,23 @@ public final class memdbgvis extends Exception {
         }
     }
 
+    /**
+     * Exports the timing histograms of every capture taken so far, one histogram per agent phase.
+     * The histograms are written as JSON and use power-of-two nanosecond buckets.
+     * @param path The file the histograms are written to.
+     * @return true if the histograms were exported, false if the agent is not loaded or the file cannot be written.
+     */
+    public static boolean exportCaptureMetrics(String path) {
+        try {
+            return exportCaptureMetrics0(path);
+        } catch (UnsatisfiedLinkError e) {
+            return false;
+        }
+    }
+
     /**
      * Utility method that retrieves runtime and memory metrics from different managed beans.
+     * Every metric is written as its name, its raw value and its unit separated by the bell character, so the visualizer can format it.
      * @see java.lang.management.MemoryMXBean
      * @see java.lang.management.MemoryUsage
      * @see java.lang.management.ThreadMXBean
@@ -60,16 +64,26 @@ public final class memdbgvis extends Exception {
      * @return a string with one metric per line
      */
     private static String getRuntimeMetrics() {
-        final long free = Runtime.getRuntime().freeMemory() >>> 10;
-        final long total = Runtime.getRuntime().totalMemory() >>> 10;
-        final String heapUsage = "Heap Usage: " + (ManagementFactory.getMemoryMXBean().getHeapMemoryUsage().getUsed() >>> 10) + " KiB\n";
-        final String nonHeapUsage = "Non-Heap Usage: " + (ManagementFactory.getMemoryMXBean().getNonHeapMemoryUsage().getUsed() >>> 10) + " KiB\n";
-        final String freeMem = "Free Memory: " + free + " KiB\n";
-        final String totalMem = "Total Memory: " + total + " KiB\n";
-        final String usedMem = "Memory Usage: " + String.format("%.2f", (float)(total - free) / total * 100) + "%\n";
-        final String uptime = "Execution Time: " + ManagementFactory.getThreadMXBean().getCurrentThreadUserTime() / 1e6 + " ms\n";
-        final String threadCount = "Live Thread Count: " +  ManagementFactory.getThreadMXBean().getThreadCount();
-        return heapUsage + nonHeapUsage + freeMem + totalMem + usedMem + uptime + threadCount;
+        final long free = Runtime.getRuntime().freeMemory();
+        final long total = Runtime.getRuntime().totalMemory();
+        return metric("Heap Usage", ManagementFactory.getMemoryMXBean().getHeapMemoryUsage().getUsed(), "bytes")
+            + metric("Non-Heap Usage", ManagementFactory.getMemoryMXBean().getNonHeapMemoryUsage().getUsed(), "bytes")
+            + metric("Free Memory", free, "bytes")
+            + metric("Total Memory", total, "bytes")
+            + metric("Memory Usage", (double)(total - free) / total * 100, "percent")
+            + metric("Execution Time", ManagementFactory.getThreadMXBean().getCurrentThreadUserTime(), "ns")
+            + metric("Live Thread Count", ManagementFactory.getThreadMXBean().getThreadCount(), "count");
+    }
+
+    /**
+     * Formats a single typed metric for the agent.
+     * @param name The name shown in the visualizer.
+     * @param value The raw value, numbers are never localized.
+     * @param unit One of "bytes", "ns", "percent" or "count".
+     * @return the metric terminated by a new line
+     */
+    private static String metric(String name, Object value, String unit) {
+        return name + '\u0007' + value + '\u0007' + unit + '\n';
     }
 
     /**
@@ -88,4 +102,11 @@ public final class memdbgvis extends Exception {
             return "Object serialization failed due to an I/O error.".getBytes();
         }
     }
+
+    /**
+     * Implemented by the native C++ agent.
+     * @param path The file the histograms are written to.
+     * @return true if the histograms were exported.
+     */
+    private static native boolean exportCaptureMetrics0(String path);
 }
\ No newline at end of file
@@ -0,0 +1,810 @@
+#include "pch.h"
+#include "conditionexpression.h"
+#include "allocationsampler.h"
+
+static bool isNameStart(const char c)
+{
+	return std::isalpha(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+bool ConditionExpression::parse(const std::string& source, const std::string& valueName)
+{
+	// a configuration parses its condition before it is published, attaching again builds a new one
+	std::lock_guard lock(this->m_mutex);
+	this->m_compiled.clear();
+	this->m_checks.store(0, std::memory_order_relaxed);
+	this->m_passed.store(0, std::memory_order_relaxed);
+	this->m_unbound.store(0, std::memory_order_relaxed);
+	this->m_nanos.store(0, std::memory_order_relaxed);
+	this->m_source = source;
+	this->m_valueName = valueName;
+	this->m_error.clear();
+	this->m_parsed = false;
+	if (source.empty())
+		return true;
+
+	std::vector<std::string> tokens;
+	size_t position = 0;
+	if (!ConditionExpression::tokenize(source, tokens, this->m_error) || !ConditionExpression::parseBinary(tokens, position, 0, this->m_syntax, this->m_error))
+		return false;
+	if (position != tokens.size())
+	{
+		this->m_error = "unexpected '" + tokens[position] + "'";
+		return false;
+	}
+
+	this->m_parsed = true;
+	return true;
+}
+
+void ConditionExpression::bindValue(const std::string& signature)
+{
+	// the watched field's declared type is known once its class is prepared, before any write is reported
+	std::lock_guard lock(this->m_mutex);
+	this->m_valueSignature = signature;
+}
+
+bool ConditionExpression::empty() const
+{
+	return !this->m_parsed;
+}
+
+const std::string& ConditionExpression::source() const
+{
+	return this->m_source;
+}
+
+const std::string& ConditionExpression::error() const
+{
+	return this->m_error;
+}
+
+bool ConditionExpression::tokenize(const std::string& source, std::vector<std::string>& tokens, std::string& error)
+{
+	static constexpr std::array<std::string_view, 6> pairs = { "||", "&&", "==", "!=", "<=", ">=" };
+	size_t i = 0;
+	while (i < source.size())
+	{
+		const char c = source[i];
+		if (std::isspace(static_cast<unsigned char>(c)))
+		{
+			i++;
+			continue;
+		}
+
+		size_t end = i + 1;
+		if (isNameStart(c))
+		{
+			while (end < source.size() && (isNameStart(source[end]) || std::isdigit(static_cast<unsigned char>(source[end]))))
+				end++;
+		}
+		else if (std::isdigit(static_cast<unsigned char>(c)))
+		{
+			// suffixes and malformed numbers are caught when the literal is parsed, a sign right after the exponent is part of it
+			while (end < source.size() && (std::isalnum(static_cast<unsigned char>(source[end])) || source[end] == '.'
+				|| ((source[end] == '+' || source[end] == '-') && (source[end - 1] == 'e' || source[end - 1] == 'E'))))
+				end++;
+		}
+		else if (c == '"')
+		{
+			// strings keep their opening quote so the parser can tell them from names
+			std::string literal = "\"";
+			for (; end < source.size() && source[end] != '"'; end++)
+			{
+				if (source[end] == '\\' && end + 1 < source.size())
+					end++;
+				literal += source[end];
+			}
+			if (end == source.size())
+			{
+				error = "unterminated string";
+				return false;
+			}
+
+			tokens.push_back(std::move(literal));
+			i = end + 1;
+			continue;
+		}
+		else if (std::ranges::find(pairs, std::string_view(source).substr(i, 2)) != pairs.end())
+			end = i + 2;
+		else if (std::string_view("<>+-*/%!().").find(c) == std::string_view::npos)
+		{
+			error = std::string("unexpected character '") + c + "'";
+			return false;
+		}
+
+		tokens.push_back(source.substr(i, end - i));
+		i = end;
+	}
+	return true;
+}
+
+bool ConditionExpression::parseBinary(const std::vector<std::string>& tokens, size_t& position, const size_t level, ConditionSyntax& node, std::string& error)
+{
+	// binary operators by precedence, lowest first, all of them left associative like in Java
+	static const std::vector<std::vector<std::string>> levels = {
+		{ "||" }, { "&&" }, { "==", "!=" }, { "<", "<=", ">", ">=" }, { "+", "-" }, { "*", "/", "%" }
+	};
+	if (level == levels.size())
+		return ConditionExpression::parseUnary(tokens, position, node, error);
+
+	if (!ConditionExpression::parseBinary(tokens, position, level + 1, node, error))
+		return false;
+
+	while (position < tokens.size() && std::ranges::find(levels[level], tokens[position]) != levels[level].end())
+	{
+		ConditionSyntax left = std::move(node);
+		node = { 'b', tokens[position++], {} };
+		node.operands.push_back(std::move(left));
+		node.operands.emplace_back();
+		if (!ConditionExpression::parseBinary(tokens, position, level + 1, node.operands.back(), error))
+			return false;
+	}
+	return true;
+}
+
+bool ConditionExpression::parseUnary(const std::vector<std::string>& tokens, size_t& position, ConditionSyntax& node, std::string& error)
+{
+	if (position < tokens.size() && (tokens[position] == "!" || tokens[position] == "-"))
+	{
+		node = { 'u', tokens[position++], {} };
+		node.operands.emplace_back();
+		return ConditionExpression::parseUnary(tokens, position, node.operands.back(), error);
+	}
+
+	if (!ConditionExpression::parsePrimary(tokens, position, node, error))
+		return false;
+
+	// member access binds tighter than any operator, arr.length or this.owner.name
+	while (position < tokens.size() && tokens[position] == ".")
+	{
+		if (++position == tokens.size() || !isNameStart(tokens[position][0]))
+		{
+			error = "expected a field name after '.'";
+			return false;
+		}
+
+		ConditionSyntax base = std::move(node);
+		node = { 'm', tokens[position++], {} };
+		node.operands.push_back(std::move(base));
+	}
+	return true;
+}
+
+bool ConditionExpression::parsePrimary(const std::vector<std::string>& tokens, size_t& position, ConditionSyntax& node, std::string& error)
+{
+	if (position == tokens.size())
+	{
+		error = "unexpected end of condition";
+		return false;
+	}
+
+	const std::string& token = tokens[position++];
+	if (token == "(")
+	{
+		if (!ConditionExpression::parseBinary(tokens, position, 0, node, error))
+			return false;
+		if (position == tokens.size() || tokens[position] != ")")
+		{
+			error = "missing ')'";
+			return false;
+		}
+		position++;
+		return true;
+	}
+
+	if (token[0] == '"')
+		node = { 's', token.substr(1), {} };
+	else if (std::isdigit(static_cast<unsigned char>(token[0])))
+	{
+		// Java suffixes are accepted, 10L, 1.5f and 2d
+		std::string digits = token;
+		bool real = digits.find_first_of(".eE") != std::string::npos;
+		if (std::string_view("lLfFdD").find(digits.back()) != std::string_view::npos)
+		{
+			real = real || std::tolower(static_cast<unsigned char>(digits.back())) != 'l';
+			digits.pop_back();
+		}
+
+		const char* last = digits.data() + digits.size();
+		std::from_chars_result parsed{};
+		if (real)
+		{
+			double value;
+			parsed = std::from_chars(digits.data(), last, value);
+		}
+		else
+		{
+			long long value;
+			parsed = std::from_chars(digits.data(), last, value);
+		}
+		if (parsed.ec != std::errc() || parsed.ptr != last)
+		{
+			error = "invalid number '" + token + "'";
+			return false;
+		}
+		node = { real ? 'f' : 'i', digits, {} };
+	}
+	else if (token == "true" || token == "false")
+		node = { 'z', token, {} };
+	else if (token == "null")
+		node = { '0', token, {} };
+	else if (isNameStart(token[0]))
+		node = { 'n', token, {} };
+	else
+	{
+		error = "unexpected '" + token + "'";
+		return false;
+	}
+	return true;
+}
+
+const CompiledCondition& ConditionExpression::compiled(const ConditionFrame& frame, jmethodID method, const jlocation location)
+{
+	std::lock_guard lock(this->m_mutex);
+	const auto key = std::make_pair(method, location);
+	const auto cached = this->m_compiled.find(key);
+	if (cached != this->m_compiled.end())
+		return cached->second;
+
+	CompiledCondition compiled{};
+	ConditionBinding binding{ frame.jvmti, frame.env, nullptr, false, location, {}, this->m_valueName, this->m_valueSignature };
+	jclass declaring_class;
+	jint modifiers;
+	jint count = 0;
+	jvmtiLocalVariableEntry* table = nullptr;
+	if (frame.jvmti->GetMethodDeclaringClass(method, &declaring_class) == JVMTI_ERROR_NONE && frame.jvmti->GetMethodModifiers(method, &modifiers) == JVMTI_ERROR_NONE)
+	{
+		// the closures outlive the event that compiled them, so classes are held by global references
+		binding.declaringClass = static_cast<jclass>(frame.env->NewGlobalRef(declaring_class));
+		binding.isStatic = (modifiers & 0x0008) != 0;
+
+		// the local variable table tells which slot holds every name in scope, it is missing for classes compiled without -g
+		if (frame.jvmti->GetLocalVariableTable(method, &count, &table) == JVMTI_ERROR_NONE)
+			binding.locals.assign(table, table + count);
+
+		std::string signature;
+		compiled.root = ConditionExpression::compileNode(this->m_syntax, binding, signature, compiled.error);
+	}
+	else
+		compiled.error = "the method of the frame is unknown";
+
+	// sites that cannot be bound are listed with the metrics, so they are named while the method is at hand
+	if (!compiled.error.empty())
+	{
+		char* class_signature = nullptr;
+		char* method_name = nullptr;
+		compiled.site = "bci " + std::to_string(location);
+		if (frame.jvmti->GetMethodDeclaringClass(method, &declaring_class) == JVMTI_ERROR_NONE && frame.jvmti->GetClassSignature(declaring_class, &class_signature, nullptr) == JVMTI_ERROR_NONE
+			&& frame.jvmti->GetMethodName(method, &method_name, nullptr, nullptr) == JVMTI_ERROR_NONE)
+			compiled.site = AllocationSampler::readableClassName(class_signature) + '.' + method_name + " (" + compiled.site + ')';
+		frame.jvmti->Deallocate(reinterpret_cast<unsigned char*>(class_signature));
+		frame.jvmti->Deallocate(reinterpret_cast<unsigned char*>(method_name));
+	}
+
+	for (const jvmtiLocalVariableEntry& local : binding.locals)
+	{
+		frame.jvmti->Deallocate(reinterpret_cast<unsigned char*>(local.name));
+		frame.jvmti->Deallocate(reinterpret_cast<unsigned char*>(local.signature));
+		frame.jvmti->Deallocate(reinterpret_cast<unsigned char*>(local.generic_signature));
+	}
+	frame.jvmti->Deallocate(reinterpret_cast<unsigned char*>(table));
+
+	// map nodes never move, so the reference stays valid after the lock is released
+	return this->m_compiled.emplace(key, std::move(compiled)).first->second;
+}
+
+ConditionNode ConditionExpression::compileNode(const ConditionSyntax& node, const ConditionBinding& binding, std::string& signature, std::string& error)
+{
+	signature.clear();
+	switch (node.kind)
+	{
+	case 'i':
+	{
+		ConditionValue value{ 'J', 0, 0, nullptr };
+		std::from_chars(node.text.data(), node.text.data() + node.text.size(), value.integer);
+		signature = "J";
+		return [value](const ConditionFrame&) { return value; };
+	}
+	case 'f':
+	{
+		ConditionValue value{ 'D', 0, 0, nullptr };
+		std::from_chars(node.text.data(), node.text.data() + node.text.size(), value.real);
+		signature = "D";
+		return [value](const ConditionFrame&) { return value; };
+	}
+	case 'z':
+	{
+		const ConditionValue value{ 'Z', node.text == "true", 0, nullptr };
+		signature = "Z";
+		return [value](const ConditionFrame&) { return value; };
+	}
+	case '0':
+		return [](const ConditionFrame&) { return ConditionValue{ 'L', 0, 0, nullptr }; };
+	case 's':
+		error = "strings can only be compared with == and !=";
+		return nullptr;
+	case 'n':
+		return ConditionExpression::compileName(node.text, binding, signature, error);
+	case 'm':
+	{
+		std::string base_signature;
+		ConditionNode base = ConditionExpression::compileNode(node.operands[0], binding, base_signature, error);
+		if (!base)
+			return nullptr;
+		if (base_signature.size() == 1)
+		{
+			error = "'" + node.text + "' is read from a primitive value";
+			return nullptr;
+		}
+		if (base_signature.starts_with('[') && node.text == "length")
+			signature = "I";
+		return ConditionExpression::compileMember(std::move(base), base_signature, node.text);
+	}
+	case 'u':
+	{
+		ConditionNode operand = ConditionExpression::compileNode(node.operands[0], binding, signature, error);
+		if (!operand)
+			return nullptr;
+		if (node.text == "!")
+		{
+			signature = "Z";
+			return [operand](const ConditionFrame& frame) -> ConditionValue
+			{
+				const ConditionValue value = operand(frame);
+				if (value.kind == 'E')
+					return value;
+				return { 'Z', !ConditionExpression::isTrue(value), 0, nullptr };
+			};
+		}
+		return [operand](const ConditionFrame& frame) -> ConditionValue
+		{
+			ConditionValue value = operand(frame);
+			if (value.kind == 'J')
+				value.integer = static_cast<jlong>(0ULL - static_cast<unsigned long long>(value.integer));
+			else if (value.kind == 'D')
+				value.real = -value.real;
+			else
+				value.kind = 'E';
+			return value;
+		};
+	}
+	default:
+		break;
+	}
+
+	// strings are compared by content, every other reference by identity
+	const bool equality = node.text == "==" || node.text == "!=";
+	for (size_t side = 0; side < 2 && equality; side++)
+	{
+		if (node.operands[side].kind != 's' || node.operands[1 - side].kind == 's')
+			continue;
+
+		std::string operand_signature;
+		ConditionNode operand = ConditionExpression::compileNode(node.operands[1 - side], binding, operand_signature, error);
+		if (!operand)
+			return nullptr;
+		signature = "Z";
+		return ConditionExpression::compileStringComparison(std::move(operand), binding, node.operands[side].text, node.text == "==");
+	}
+
+	std::string left_signature, right_signature;
+	ConditionNode left = ConditionExpression::compileNode(node.operands[0], binding, left_signature, error);
+	if (!left)
+		return nullptr;
+	ConditionNode right = ConditionExpression::compileNode(node.operands[1], binding, right_signature, error);
+	if (!right)
+		return nullptr;
+
+	static const std::unordered_map<std::string, char> codes = {
+		{ "||", '|' }, { "&&", '&' }, { "==", '=' }, { "!=", '!' }, { "<", '<' }, { "<=", 'l' }, { ">", '>' },
+		{ ">=", 'g' }, { "+", '+' }, { "-", '-' }, { "*", '*' }, { "/", '/' }, { "%", '%' }
+	};
+	const char op = codes.at(node.text);
+	if (op == '|' || op == '&')
+	{
+		// the right side only runs when it decides the result, so arr != null && arr.length > 0 never fails
+		signature = "Z";
+		return [left, right, op](const ConditionFrame& frame) -> ConditionValue
+		{
+			const ConditionValue first = left(frame);
+			if (first.kind == 'E')
+				return first;
+			if (ConditionExpression::isTrue(first) == (op == '|'))
+				return { 'Z', op == '|', 0, nullptr };
+
+			const ConditionValue second = right(frame);
+			if (second.kind == 'E')
+				return second;
+			return { 'Z', ConditionExpression::isTrue(second), 0, nullptr };
+		};
+	}
+
+	if (std::string_view("=!<l>g").find(op) != std::string_view::npos)
+		signature = "Z";
+	return [left, right, op](const ConditionFrame& frame)
+	{
+		return ConditionExpression::applyBinary(frame.env, op, left(frame), right(frame));
+	};
+}
+
+ConditionNode ConditionExpression::compileName(const std::string& name, const ConditionBinding& binding, std::string& signature, std::string& error)
+{
+	// in a watch condition the field's name is the value being written, it shadows the writer's locals and fields
+	if (!binding.valueName.empty() && name == binding.valueName)
+	{
+		signature = binding.valueSignature;
+		return &ConditionExpression::readWritten;
+	}
+
+	// locals shadow fields, and only locals in scope at the location count
+	for (const jvmtiLocalVariableEntry& local : binding.locals)
+	{
+		if (name != local.name || binding.location < local.start_location || binding.location >= local.start_location + local.length)
+			continue;
+
+		signature = local.signature;
+		const jint slot = local.slot;
+		const char type = local.signature[0];
+		return [slot, type](const ConditionFrame& frame) { return ConditionExpression::readLocal(frame, slot, type); };
+	}
+
+	// the receiver is known even without a local variable table
+	const auto receiver = [](const ConditionFrame& frame) -> ConditionValue
+	{
+		jobject instance = nullptr;
+		if (frame.jvmti->GetLocalInstance(frame.thread, frame.depth, &instance) != JVMTI_ERROR_NONE)
+			return { 'E', 0, 0, nullptr };
+		return { 'L', 0, 0, instance };
+	};
+	if (name == "this")
+	{
+		if (binding.isStatic)
+		{
+			error = "'this' is used in a static method";
+			return nullptr;
+		}
+		signature = "L;";
+		return receiver;
+	}
+
+	// everything else is a field of the method's class or one of its superclasses
+	jclass owner = nullptr;
+	jfieldID field = nullptr;
+	bool is_static = false;
+	if (binding.declaringClass == nullptr || !ConditionExpression::findField(binding.jvmti, binding.env, binding.declaringClass, name, owner, field, signature, is_static))
+	{
+		error = "unknown name '" + name + "'" + (binding.locals.empty() ? ", locals need classes compiled with -g" : "");
+		return nullptr;
+	}
+
+	const char type = signature[0];
+	if (is_static)
+		return [owner, field, type](const ConditionFrame& frame) { return ConditionExpression::readField(frame.env, nullptr, owner, field, type, true); };
+	if (binding.isStatic)
+	{
+		error = "instance field '" + name + "' is used in a static method";
+		return nullptr;
+	}
+
+	return [receiver, field, type](const ConditionFrame& frame)
+	{
+		const ConditionValue instance = receiver(frame);
+		if (instance.kind == 'E')
+			return instance;
+		return ConditionExpression::readField(frame.env, instance.object, nullptr, field, type, false);
+	};
+}
+
+ConditionNode ConditionExpression::compileMember(ConditionNode base, const std::string& baseSignature, const std::string& name)
+{
+	// the declared type already tells arrays apart
+	if (baseSignature.starts_with('[') && name == "length")
+	{
+		return [base](const ConditionFrame& frame) -> ConditionValue
+		{
+			const ConditionValue array = base(frame);
+			if (array.kind != 'L' || array.object == nullptr)
+				return { 'E', 0, 0, nullptr };
+			return { 'J', frame.env->GetArrayLength(static_cast<jarray>(array.object)), 0, nullptr };
+		};
+	}
+
+	// otherwise the field is resolved against the runtime class, and only resolved again when another class shows up
+	typedef struct
+	{
+		std::mutex mutex;
+		jclass klass;
+		jclass owner;
+		jfieldID field;
+		char type;
+		bool isStatic;
+		bool isArrayLength;
+	} MemberCache;
+	const auto cache = std::make_shared<MemberCache>();
+	return [base, cache, name](const ConditionFrame& frame) -> ConditionValue
+	{
+		const ConditionValue object = base(frame);
+		if (object.kind != 'L' || object.object == nullptr)
+			return { 'E', 0, 0, nullptr };
+
+		const jclass klass = frame.env->GetObjectClass(object.object);
+		std::unique_lock lock(cache->mutex);
+		if (cache->klass == nullptr || !frame.env->IsSameObject(klass, cache->klass))
+		{
+			// references to earlier classes are kept, another thread may still be reading through them
+			cache->klass = static_cast<jclass>(frame.env->NewGlobalRef(klass));
+			cache->owner = nullptr;
+			cache->field = nullptr;
+
+			char* signature = nullptr;
+			cache->isArrayLength = name == "length" && frame.jvmti->GetClassSignature(klass, &signature, nullptr) == JVMTI_ERROR_NONE && signature[0] == '[';
+			frame.jvmti->Deallocate(reinterpret_cast<unsigned char*>(signature));
+
+			std::string field_signature;
+			if (!cache->isArrayLength && ConditionExpression::findField(frame.jvmti, frame.env, klass, name, cache->owner, cache->field, field_signature, cache->isStatic))
+				cache->type = field_signature[0];
+		}
+
+		const jclass owner = cache->owner;
+		const jfieldID field = cache->field;
+		const char type = cache->type;
+		const bool is_static = cache->isStatic;
+		const bool is_array_length = cache->isArrayLength;
+		lock.unlock();
+
+		if (is_array_length)
+			return { 'J', frame.env->GetArrayLength(static_cast<jarray>(object.object)), 0, nullptr };
+		if (field == nullptr)
+			return { 'E', 0, 0, nullptr };
+		return ConditionExpression::readField(frame.env, object.object, owner, field, type, is_static);
+	};
+}
+
+ConditionNode ConditionExpression::compileStringComparison(ConditionNode operand, const ConditionBinding& binding, const std::string& literal, const bool equal)
+{
+	// only strings are compared by content, any other object is simply not equal to the literal
+	const auto string_class = static_cast<jclass>(binding.env->NewGlobalRef(binding.env->FindClass("java/lang/String")));
+	return [operand, string_class, literal, equal](const ConditionFrame& frame) -> ConditionValue
+	{
+		const ConditionValue value = operand(frame);
+		if (value.kind != 'L')
+			return { 'E', 0, 0, nullptr };
+
+		bool same = false;
+		if (value.object != nullptr && frame.env->IsInstanceOf(value.object, string_class))
+		{
+			const auto string = static_cast<jstring>(value.object);
+			const char* chars = frame.env->GetStringUTFChars(string, nullptr);
+			same = literal == chars;
+			frame.env->ReleaseStringUTFChars(string, chars);
+		}
+		return { 'Z', same == equal, 0, nullptr };
+	};
+}
+
+bool ConditionExpression::findField(jvmtiEnv* jvmti, JNIEnv* env, jclass klass, const std::string& name, jclass& owner, jfieldID& field, std::string& signature, bool& isStatic)
+{
+	// fields are looked up through the superclasses, the class declaring the field is kept for static reads
+	field = nullptr;
+	for (jclass current = klass; current != nullptr; current = env->GetSuperclass(current))
+	{
+		jint count;
+		jfieldID* fields;
+		if (jvmti->GetClassFields(current, &count, &fields) != JVMTI_ERROR_NONE)
+			return false;
+
+		for (jint i = 0; i < count && field == nullptr; i++)
+		{
+			char* field_name = nullptr;
+			char* field_signature = nullptr;
+			if (jvmti->GetFieldName(current, fields[i], &field_name, &field_signature, nullptr) != JVMTI_ERROR_NONE)
+				continue;
+
+			if (name == field_name)
+			{
+				jint modifiers = 0;
+				jvmti->GetFieldModifiers(current, fields[i], &modifiers);
+				field = fields[i];
+				signature = field_signature;
+				isStatic = (modifiers & 0x0008) != 0;
+				owner = static_cast<jclass>(env->NewGlobalRef(current));
+			}
+			jvmti->Deallocate(reinterpret_cast<unsigned char*>(field_name));
+			jvmti->Deallocate(reinterpret_cast<unsigned char*>(field_signature));
+		}
+		jvmti->Deallocate(reinterpret_cast<unsigned char*>(fields));
+
+		if (field != nullptr)
+			return true;
+	}
+	return false;
+}
+
+ConditionValue ConditionExpression::readWritten(const ConditionFrame& frame)
+{
+	if (frame.written == nullptr)
+		return { 'E', 0, 0, nullptr };
+	return *frame.written;
+}
+
+ConditionValue ConditionExpression::readLocal(const ConditionFrame& frame, const jint slot, const char type)
+{
+	ConditionValue value{ 'J', 0, 0, nullptr };
+	jvmtiError error;
+	switch (type)
+	{
+	case 'J':
+		error = frame.jvmti->GetLocalLong(frame.thread, frame.depth, slot, &value.integer);
+		break;
+	case 'F':
+	{
+		jfloat real = 0;
+		error = frame.jvmti->GetLocalFloat(frame.thread, frame.depth, slot, &real);
+		value = { 'D', 0, real, nullptr };
+		break;
+	}
+	case 'D':
+		value.kind = 'D';
+		error = frame.jvmti->GetLocalDouble(frame.thread, frame.depth, slot, &value.real);
+		break;
+	case 'L':
+	case '[':
+		value.kind = 'L';
+		error = frame.jvmti->GetLocalObject(frame.thread, frame.depth, slot, &value.object);
+		break;
+	default:
+	{
+		// booleans, bytes, chars and shorts all live in int slots
+		jint integer = 0;
+		error = frame.jvmti->GetLocalInt(frame.thread, frame.depth, slot, &integer);
+		value = { type == 'Z' ? 'Z' : 'J', integer, 0, nullptr };
+	}
+	}
+
+	if (error != JVMTI_ERROR_NONE)
+		value.kind = 'E';
+	return value;
+}
+
+ConditionValue ConditionExpression::readField(JNIEnv* env, jobject object, jclass klass, jfieldID field, const char type, const bool isStatic)
+{
+	switch (type)
+	{
+	case 'Z': return { 'Z', isStatic ? env->GetStaticBooleanField(klass, field) : env->GetBooleanField(object, field), 0, nullptr };
+	case 'B': return { 'J', isStatic ? env->GetStaticByteField(klass, field) : env->GetByteField(object, field), 0, nullptr };
+	case 'C': return { 'J', isStatic ? env->GetStaticCharField(klass, field) : env->GetCharField(object, field), 0, nullptr };
+	case 'S': return { 'J', isStatic ? env->GetStaticShortField(klass, field) : env->GetShortField(object, field), 0, nullptr };
+	case 'I': return { 'J', isStatic ? env->GetStaticIntField(klass, field) : env->GetIntField(object, field), 0, nullptr };
+	case 'J': return { 'J', isStatic ? env->GetStaticLongField(klass, field) : env->GetLongField(object, field), 0, nullptr };
+	case 'F': return { 'D', 0, isStatic ? env->GetStaticFloatField(klass, field) : env->GetFloatField(object, field), nullptr };
+	case 'D': return { 'D', 0, isStatic ? env->GetStaticDoubleField(klass, field) : env->GetDoubleField(object, field), nullptr };
+	default: return { 'L', 0, 0, isStatic ? env->GetStaticObjectField(klass, field) : env->GetObjectField(object, field) };
+	}
+}
+
+ConditionValue ConditionExpression::applyBinary(JNIEnv* env, const char op, const ConditionValue& left, const ConditionValue& right)
+{
+	constexpr ConditionValue failed{ 'E', 0, 0, nullptr };
+	if (left.kind == 'E' || right.kind == 'E')
+		return failed;
+
+	// references and booleans only support equality, references are compared by identity like in Java
+	if (left.kind == 'L' || right.kind == 'L' || left.kind == 'Z' || right.kind == 'Z')
+	{
+		if (left.kind != right.kind || (op != '=' && op != '!'))
+			return failed;
+		const bool equal = left.kind == 'L' ? env->IsSameObject(left.object, right.object) == JNI_TRUE : left.integer == right.integer;
+		return { 'Z', equal == (op == '='), 0, nullptr };
+	}
+
+	// binary numeric promotion, integral operands stay exact
+	if (left.kind == 'D' || right.kind == 'D')
+	{
+		const double a = left.kind == 'D' ? left.real : static_cast<double>(left.integer);
+		const double b = right.kind == 'D' ? right.real : static_cast<double>(right.integer);
+		switch (op)
+		{
+		case '=': return { 'Z', a == b, 0, nullptr };
+		case '!': return { 'Z', a != b, 0, nullptr };
+		case '<': return { 'Z', a < b, 0, nullptr };
+		case 'l': return { 'Z', a <= b, 0, nullptr };
+		case '>': return { 'Z', a > b, 0, nullptr };
+		case 'g': return { 'Z', a >= b, 0, nullptr };
+		case '+': return { 'D', 0, a + b, nullptr };
+		case '-': return { 'D', 0, a - b, nullptr };
+		case '*': return { 'D', 0, a * b, nullptr };
+		case '/': return { 'D', 0, a / b, nullptr };
+		case '%': return { 'D', 0, std::fmod(a, b), nullptr };
+		default: return failed;
+		}
+	}
+
+	// overflow wraps around as in Java, and dividing by zero fails the condition instead of throwing
+	const jlong a = left.integer;
+	const jlong b = right.integer;
+	const auto ua = static_cast<unsigned long long>(a);
+	const auto ub = static_cast<unsigned long long>(b);
+	switch (op)
+	{
+	case '=': return { 'Z', a == b, 0, nullptr };
+	case '!': return { 'Z', a != b, 0, nullptr };
+	case '<': return { 'Z', a < b, 0, nullptr };
+	case 'l': return { 'Z', a <= b, 0, nullptr };
+	case '>': return { 'Z', a > b, 0, nullptr };
+	case 'g': return { 'Z', a >= b, 0, nullptr };
+	case '+': return { 'J', static_cast<jlong>(ua + ub), 0, nullptr };
+	case '-': return { 'J', static_cast<jlong>(ua - ub), 0, nullptr };
+	case '*': return { 'J', static_cast<jlong>(ua * ub), 0, nullptr };
+	case '/':
+		if (b == 0)
+			return failed;
+		return { 'J', b == -1 ? static_cast<jlong>(0ULL - ua) : a / b, 0, nullptr };
+	case '%':
+		if (b == 0)
+			return failed;
+		return { 'J', b == -1 ? 0 : a % b, 0, nullptr };
+	default: return failed;
+	}
+}
+
+bool ConditionExpression::isTrue(const ConditionValue& value)
+{
+	switch (value.kind)
+	{
+	case 'D': return value.real != 0;
+	case 'L': return value.object != nullptr;
+	default: return value.integer != 0;
+	}
+}
+
+bool ConditionExpression::evaluate(const ConditionFrame& frame, jmethodID method, const jlocation location)
+{
+	const auto started = std::chrono::steady_clock::now();
+	const CompiledCondition& compiled = this->compiled(frame, method, location);
+
+	// a condition that cannot be bound at the location is false there, so a typo never makes every hit pay for a capture
+	// evaluation errors, such as reading the length of a null array, count as false as well
+	bool passed = false;
+	if (compiled.error.empty())
+	{
+		const ConditionValue value = compiled.root(frame);
+		passed = value.kind != 'E' && ConditionExpression::isTrue(value);
+	}
+	else
+		this->m_unbound.fetch_add(1, std::memory_order_relaxed);
+
+	this->m_nanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count(), std::memory_order_relaxed);
+	this->m_checks.fetch_add(1, std::memory_order_relaxed);
+	if (passed)
+		this->m_passed.fetch_add(1, std::memory_order_relaxed);
+	return passed;
+}
+
+std::vector<std::string> ConditionExpression::report(const std::string& name) const
+{
+	// typed metrics: how often the condition ran, how often it let a capture through and its mean cost, the first run includes compiling
+	if (this->empty())
+		return {};
+
+	const unsigned long long checks = this->m_checks.load(std::memory_order_relaxed);
+	const long long nanos = this->m_nanos.load(std::memory_order_relaxed);
+	std::vector<std::string> metrics = {
+		name + " Condition Checks\a" + std::to_string(checks) + "\acount",
+		name + " Condition Passed\a" + std::to_string(this->m_passed.load(std::memory_order_relaxed)) + "\acount",
+		name + " Condition Cost\a" + std::to_string(checks > 0 ? nanos / static_cast<long long>(checks) : 0) + "\ans"
+	};
+
+	// every call site the condition could not be bound at is listed once, with the hits it turned away
+	const unsigned long long unbound = this->m_unbound.load(std::memory_order_relaxed);
+	if (unbound == 0)
+		return metrics;
+	metrics.push_back(name + " Condition Unbound Hits\a" + std::to_string(unbound) + "\acount");
+	std::lock_guard lock(this->m_mutex);
+	for (const auto& [key, compiled] : this->m_compiled)
+	{
+		if (!compiled.error.empty())
+			metrics.push_back(name + " Condition Not Bound at " + compiled.site + '\a' + compiled.error + "\atext");
+	}
+	return metrics;
+}
\ No newline at end of file
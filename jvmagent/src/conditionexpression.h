@@ -0,0 +1,108 @@
+#pragma once
+
+#ifndef CONDITIONEXPRESSION_H
+#define CONDITIONEXPRESSION_H
+
+#include "pch.h"
+
+// kind is 'J' for integral values, 'D' for floating point, 'Z' for booleans, 'L' for references and 'E' when evaluation failed
+typedef struct
+{
+	char kind;
+	jlong integer;
+	jdouble real;
+	jobject object;
+} ConditionValue;
+
+// frame a condition is evaluated in, and for a watch the value about to be written
+typedef struct
+{
+	jvmtiEnv* jvmti;
+	JNIEnv* env;
+	jthread thread;
+	jint depth;
+	const ConditionValue* written;
+} ConditionFrame;
+
+typedef std::function<ConditionValue(const ConditionFrame&)> ConditionNode;
+
+// parsed expression before its names are bound to a frame
+// kind is 'n' for names, 'm' for member access, 'u' and 'b' for operators, 'i', 'f', 'z', 's' for literals and '0' for null
+typedef struct ConditionSyntax
+{
+	char kind;
+	std::string text;
+	std::vector<ConditionSyntax> operands;
+} ConditionSyntax;
+
+// what names resolve to in one method at one location
+typedef struct
+{
+	jvmtiEnv* jvmti;
+	JNIEnv* env;
+	jclass declaringClass;
+	bool isStatic;
+	jlocation location;
+	std::vector<jvmtiLocalVariableEntry> locals;
+	std::string valueName;
+	std::string valueSignature;
+} ConditionBinding;
+
+typedef struct
+{
+	ConditionNode root;
+	std::string error;
+	std::string site;
+} CompiledCondition;
+
+/*
+ * Condition over the locals and fields of a frame, for example i % 100 == 0 && arr.length > 1000.
+ * The expression is parsed once when the agent loads, and compiled into a tree of closures the first time it is
+ * evaluated at a location, with names bound to local variable slots and field IDs so later evaluations only read values.
+ * A location the names cannot be bound at, such as a method compiled without -g, fails the condition there.
+ * Watch conditions are evaluated in the writing method, with the name of the watched field standing for the new value.
+ */
+class ConditionExpression
+{
+	std::string m_source;
+	std::string m_error;
+	std::string m_valueName;
+	std::string m_valueSignature;
+	ConditionSyntax m_syntax{};
+	bool m_parsed = false;
+	mutable std::mutex m_mutex;
+	std::map<std::pair<jmethodID, jlocation>, CompiledCondition> m_compiled;
+	std::atomic<unsigned long long> m_checks = 0;
+	std::atomic<unsigned long long> m_passed = 0;
+	std::atomic<unsigned long long> m_unbound = 0;
+	std::atomic<long long> m_nanos = 0;
+
+	static bool tokenize(const std::string& source, std::vector<std::string>& tokens, std::string& error);
+	static bool parseBinary(const std::vector<std::string>& tokens, size_t& position, size_t level, ConditionSyntax& node, std::string& error);
+	static bool parseUnary(const std::vector<std::string>& tokens, size_t& position, ConditionSyntax& node, std::string& error);
+	static bool parsePrimary(const std::vector<std::string>& tokens, size_t& position, ConditionSyntax& node, std::string& error);
+	static ConditionNode compileNode(const ConditionSyntax& node, const ConditionBinding& binding, std::string& signature, std::string& error);
+	static ConditionNode compileName(const std::string& name, const ConditionBinding& binding, std::string& signature, std::string& error);
+	static ConditionNode compileMember(ConditionNode base, const std::string& baseSignature, const std::string& name);
+	static ConditionNode compileStringComparison(ConditionNode operand, const ConditionBinding& binding, const std::string& literal, bool equal);
+	static bool findField(jvmtiEnv* jvmti, JNIEnv* env, jclass klass, const std::string& name, jclass& owner, jfieldID& field, std::string& signature, bool& isStatic);
+	static ConditionValue readWritten(const ConditionFrame& frame);
+	static ConditionValue readLocal(const ConditionFrame& frame, jint slot, char type);
+	static ConditionValue readField(JNIEnv* env, jobject object, jclass klass, jfieldID field, char type, bool isStatic);
+	static ConditionValue applyBinary(JNIEnv* env, char op, const ConditionValue& left, const ConditionValue& right);
+	static bool isTrue(const ConditionValue& value);
+	const CompiledCondition& compiled(const ConditionFrame& frame, jmethodID method, jlocation location);
+
+public:
+	ConditionExpression() = default;
+	~ConditionExpression() = default;
+	bool parse(const std::string& source, const std::string& valueName = "");
+	void bindValue(const std::string& signature);
+	bool empty() const;
+	const std::string& source() const;
+	const std::string& error() const;
+	bool evaluate(const ConditionFrame& frame, jmethodID method, jlocation location);
+	std::vector<std::string> report(const std::string& name) const;
+};
+
+#endif // CONDITIONEXPRESSION_H
\ No newline at end of file
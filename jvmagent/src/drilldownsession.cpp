@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "drilldownsession.h"
+
+DrillDownSession::DrillDownSession(JNIEnv* env, const bool enabled)
+	: m_env(env), m_enabled(enabled)
+{
+	// one pipe per capturing thread, so concurrent captures never share a channel
+	this->m_pipeName = L"memdbgvis-" + std::to_wstring(GetCurrentProcessId()) + L'-' + std::to_wstring(GetCurrentThreadId());
+}
+
+DrillDownSession::~DrillDownSession()
+{
+	// objects are only pinned for as long as the visualizer window is open
+	for (const jobject obj : this->m_handles)
+		this->m_env->DeleteGlobalRef(obj);
+
+	if (this->m_pipe != INVALID_HANDLE_VALUE)
+		CloseHandle(this->m_pipe);
+}
+
+size_t DrillDownSession::track(jobject obj)
+{
+	// handle 0 means the object cannot be explored
+	if (!this->m_enabled || obj == nullptr)
+		return 0;
+
+	this->m_handles.push_back(this->m_env->NewGlobalRef(obj));
+	return this->m_handles.size();
+}
+
+jobject DrillDownSession::resolve(const size_t handle) const
+{
+	if (handle == 0 || handle > this->m_handles.size())
+		return nullptr;
+	return this->m_handles[handle - 1];
+}
+
+const std::wstring& DrillDownSession::pipeName() const
+{
+	return this->m_pipeName;
+}
+
+bool DrillDownSession::open()
+{
+	if (!this->m_enabled)
+		return false;
+
+	// a single instance that rejects remote clients, read and written with overlapped I/O so the visualizer exiting is noticed
+	this->m_pipe = CreateNamedPipe(
+		(L"\\\\.\\pipe\\" + this->m_pipeName).c_str(),
+		PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+		PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+		1,
+		64 * 1024,
+		4 * 1024,
+		0,
+		nullptr
+	);
+
+	return this->m_pipe != INVALID_HANDLE_VALUE;
+}
+
+bool DrillDownSession::write(const std::string& response, OVERLAPPED& overlapped) const
+{
+	DWORD written = 0;
+	ResetEvent(overlapped.hEvent);
+	if (!WriteFile(this->m_pipe, response.data(), static_cast<DWORD>(response.size()), &written, &overlapped) && GetLastError() != ERROR_IO_PENDING)
+		return false;
+
+	return GetOverlappedResult(this->m_pipe, &overlapped, &written, TRUE) && written == response.size();
+}
+
+void DrillDownSession::serve(HANDLE process, const DrillDownHandler& handler)
+{
+	OVERLAPPED overlapped{};
+	overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	const HANDLE waits[] = { overlapped.hEvent, process };
+	bool connected = false;
+
+	// wait for the visualizer to connect, or to exit without ever connecting
+	if (ConnectNamedPipe(this->m_pipe, &overlapped))
+		connected = true;
+	else if (GetLastError() == ERROR_PIPE_CONNECTED)
+		connected = true;
+	else if (GetLastError() == ERROR_IO_PENDING)
+	{
+		DWORD transferred = 0;
+		connected = WaitForMultipleObjects(2, waits, FALSE, INFINITE) == WAIT_OBJECT_0 && GetOverlappedResult(this->m_pipe, &overlapped, &transferred, FALSE);
+		if (!connected)
+		{
+			CancelIo(this->m_pipe);
+			GetOverlappedResult(this->m_pipe, &overlapped, &transferred, TRUE);
+		}
+	}
+
+	std::string buffer;
+	char chunk[4096];
+
+	while (connected)
+	{
+		DWORD read = 0;
+		ResetEvent(overlapped.hEvent);
+
+		// a broken pipe means the visualizer window was closed
+		if (!ReadFile(this->m_pipe, chunk, sizeof chunk, &read, &overlapped))
+		{
+			if (GetLastError() != ERROR_IO_PENDING)
+				break;
+
+			if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0)
+			{
+				CancelIo(this->m_pipe);
+				GetOverlappedResult(this->m_pipe, &overlapped, &read, TRUE);
+				break;
+			}
+
+			if (!GetOverlappedResult(this->m_pipe, &overlapped, &read, FALSE))
+				break;
+		}
+
+		// answer every complete request line, requests are handled on this thread so JNI stays usable
+		buffer.append(chunk, read);
+		for (size_t newline = buffer.find('\n'); newline != std::string::npos; newline = buffer.find('\n'))
+		{
+			const std::string response = handler(buffer.substr(0, newline)) + "END\n";
+			buffer.erase(0, newline + 1);
+			if (!this->write(response, overlapped))
+				connected = false;
+		}
+	}
+
+	// the thread stays suspended until the user closes the visualizer window
+	WaitForSingleObject(process, INFINITE);
+	DisconnectNamedPipe(this->m_pipe);
+	CloseHandle(overlapped.hEvent);
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#ifndef DRILLDOWNSESSION_H
+#define DRILLDOWNSESSION_H
+
+#include "pch.h"
+
+// answers one request line with the response lines, excluding the "END" terminator
+typedef std::function<std::string(const std::string&)> DrillDownHandler;
+
+/*
+ * Request/response channel between the visualizer and the thread suspended inside the agent.
+ * Objects shown in the snapshot are pinned with global references and identified by handles,
+ * so the visualizer can ask for their fields or a range of their elements on demand.
+ * Requests and responses are lines of '\a' separated fields sent over a named pipe; every response ends with "END".
+ */
+class DrillDownSession
+{
+	JNIEnv* m_env;
+	bool m_enabled;
+	std::vector<jobject> m_handles;
+	std::wstring m_pipeName;
+	HANDLE m_pipe = INVALID_HANDLE_VALUE;
+
+	bool write(const std::string& response, OVERLAPPED& overlapped) const;
+
+public:
+	DrillDownSession(JNIEnv* env, bool enabled);
+	~DrillDownSession();
+	size_t track(jobject obj);
+	jobject resolve(size_t handle) const;
+	const std::wstring& pipeName() const;
+	bool open();
+	void serve(HANDLE process, const DrillDownHandler& handler);
+};
+
+#endif // DRILLDOWNSESSION_H
\ No newline at end of file
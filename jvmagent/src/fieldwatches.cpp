@@ -0,0 +1,200 @@
+#include "pch.h"
+#include "fieldwatches.h"
+
+void FieldWatches::parse(const std::string& specs)
+{
+	// a configuration parses its watches before it is published, attaching again builds a new one
+	this->m_watches.clear();
+	this->m_errors.clear();
+
+	// watches are separated by semicolons since commas separate agent options
+	std::stringstream stream(specs);
+	for (std::string spec; std::getline(stream, spec, ';');)
+	{
+		const size_t first = spec.find_first_not_of(" \t");
+		if (first == std::string::npos)
+			continue;
+		spec = spec.substr(first, spec.find_last_not_of(" \t") + 1 - first);
+
+		// "com.foo.Account.balance < 0" -> class, field and the condition on the field's new value
+		const size_t target_end = std::min(spec.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_$."), spec.size());
+		const std::string target = spec.substr(0, target_end);
+		const size_t field_start = target.rfind('.');
+		if (field_start == std::string::npos || field_start == 0 || field_start + 1 == target.size())
+		{
+			this->m_errors.push_back("Watch " + spec + ": expected a class and field name, such as com.example.Account.balance");
+			continue;
+		}
+
+		auto watch = std::make_unique<FieldWatch>();
+		watch->classSignature = 'L' + target.substr(0, field_start) + ';';
+		std::replace(watch->classSignature.begin(), watch->classSignature.end(), '.', '/');
+		watch->fieldName = target.substr(field_start + 1);
+		watch->description = spec;
+		watch->armError = "its class is not loaded";
+
+		// the condition is the rest of the spec with the field's name in front, so it reads like the expression it is
+		if (target_end < spec.size() && !watch->condition.parse(watch->fieldName + ' ' + spec.substr(target_end), watch->fieldName))
+		{
+			this->m_errors.push_back("Watch " + spec + ": " + watch->condition.error());
+			continue;
+		}
+		this->m_watches.push_back(std::move(watch));
+	}
+}
+
+bool FieldWatches::empty() const
+{
+	return this->m_watches.empty();
+}
+
+void FieldWatches::arm(jvmtiEnv* jvmti, JNIEnv* env, jclass klass)
+{
+	char* signature = nullptr;
+	if (jvmti->GetClassSignature(klass, &signature, nullptr) != JVMTI_ERROR_NONE)
+		return;
+
+	// classes are prepared on many threads at once
+	std::lock_guard lock(this->m_armMutex);
+	for (const std::unique_ptr<FieldWatch>& watch : this->m_watches)
+	{
+		if (watch->classSignature != signature || watch->field.load(std::memory_order_relaxed) != nullptr)
+			continue;
+
+		jint count;
+		jfieldID* fields;
+		if (jvmti->GetClassFields(klass, &count, &fields) != JVMTI_ERROR_NONE)
+			continue;
+
+		// a field the class does not declare is listed with the metrics instead of leaving the watch silently idle
+		watch->armError = "its class has no field '" + watch->fieldName + "'";
+		for (jint i = 0; i < count; i++)
+		{
+			char* name = nullptr;
+			char* field_signature = nullptr;
+			if (jvmti->GetFieldName(klass, fields[i], &name, &field_signature, nullptr) != JVMTI_ERROR_NONE)
+				continue;
+
+			// only the named field is watched, every other field of the class keeps its compiled accessors
+			// the class and the value's type are set before the field is published, so a callback that finds the field sees both
+			if (watch->fieldName == name)
+			{
+				watch->condition.bindValue(field_signature);
+				if (jvmti->SetFieldModificationWatch(klass, fields[i]) == JVMTI_ERROR_NONE)
+				{
+					watch->armError.clear();
+					watch->klass = static_cast<jclass>(env->NewGlobalRef(klass));
+					watch->field.store(fields[i], std::memory_order_release);
+				}
+				else
+					watch->armError = "the field cannot be watched";
+			}
+			jvmti->Deallocate(reinterpret_cast<unsigned char*>(name));
+			jvmti->Deallocate(reinterpret_cast<unsigned char*>(field_signature));
+		}
+		jvmti->Deallocate(reinterpret_cast<unsigned char*>(fields));
+	}
+	jvmti->Deallocate(reinterpret_cast<unsigned char*>(signature));
+}
+
+void FieldWatches::disarm(jvmtiEnv* jvmti, JNIEnv* env)
+{
+	// the events are off by now, the global references keep the watched classes loaded until here
+	std::lock_guard lock(this->m_armMutex);
+	for (const std::unique_ptr<FieldWatch>& watch : this->m_watches)
+	{
+		const jfieldID field = watch->field.load(std::memory_order_relaxed);
+		if (field == nullptr)
+			continue;
+
+		static_cast<void>(jvmti->ClearFieldModificationWatch(watch->klass, field));
+		watch->field.store(nullptr, std::memory_order_release);
+		env->DeleteGlobalRef(watch->klass);
+		watch->klass = nullptr;
+		watch->armError = "the agent detached";
+	}
+}
+
+FieldWatch* FieldWatches::find(JNIEnv* env, jclass klass, jfieldID field) const
+{
+	// the ID alone can belong to a field of another class at the same offset
+	for (const std::unique_ptr<FieldWatch>& watch : this->m_watches)
+	{
+		if (watch->field.load(std::memory_order_acquire) == field && env->IsSameObject(watch->klass, klass))
+			return watch.get();
+	}
+	return nullptr;
+}
+
+bool FieldWatches::check(const ConditionFrame& frame, FieldWatch& watch, jmethodID method, const jlocation location, const char type, const jvalue value) const
+{
+	// every write to a watched field pays for this check, so its cost is measured and reported
+	const auto start = std::chrono::steady_clock::now();
+	bool matched = true;
+	if (!watch.condition.empty())
+	{
+		ConditionValue written{ 'L', 0, 0, nullptr };
+		switch (type)
+		{
+		case 'Z': written = { 'Z', value.z, 0, nullptr }; break;
+		case 'B': written.kind = 'J'; written.integer = value.b; break;
+		case 'C': written.kind = 'J'; written.integer = value.c; break;
+		case 'S': written.kind = 'J'; written.integer = value.s; break;
+		case 'I': written.kind = 'J'; written.integer = value.i; break;
+		case 'J': written.kind = 'J'; written.integer = value.j; break;
+		case 'F': written.kind = 'D'; written.real = value.f; break;
+		case 'D': written.kind = 'D'; written.real = value.d; break;
+		default: written.object = value.l; break;
+		}
+
+		ConditionFrame writer = frame;
+		writer.written = &written;
+		matched = watch.condition.evaluate(writer, method, location);
+	}
+	watch.checkNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+	watch.checks.fetch_add(1, std::memory_order_relaxed);
+	if (matched)
+		watch.hits.fetch_add(1, std::memory_order_relaxed);
+	return matched;
+}
+
+std::vector<std::string> FieldWatches::report() const
+{
+	// one set of typed metrics per watch: writes checked, captures triggered, the mean cost of a check and why it is not armed
+	std::lock_guard lock(this->m_armMutex);
+	std::vector<std::string> metrics;
+	for (const std::unique_ptr<FieldWatch>& watch : this->m_watches)
+	{
+		const unsigned long long checks = watch->checks.load(std::memory_order_relaxed);
+		const long long nanos = watch->checkNanos.load(std::memory_order_relaxed);
+		metrics.push_back("Watch " + watch->description + " Writes\a" + std::to_string(checks) + "\acount");
+		metrics.push_back("Watch " + watch->description + " Hits\a" + std::to_string(watch->hits.load(std::memory_order_relaxed)) + "\acount");
+		metrics.push_back("Watch " + watch->description + " Check Cost\a" + std::to_string(checks > 0 ? nanos / static_cast<long long>(checks) : 0) + "\ans");
+		if (!watch->armError.empty())
+			metrics.push_back("Watch " + watch->description + " Not Armed\a" + watch->armError + "\atext");
+		for (std::string& metric : watch->condition.report("Watch " + watch->description))
+			metrics.push_back(std::move(metric));
+	}
+	return metrics;
+}
+
+const std::vector<std::string>& FieldWatches::errors() const
+{
+	return this->m_errors;
+}
+
+std::string FieldWatches::describeValue(const char type, const jvalue value)
+{
+	switch (type)
+	{
+	case 'Z': return value.z ? "true" : "false";
+	case 'B': return std::to_string(value.b);
+	case 'C': return std::to_string(value.c);
+	case 'S': return std::to_string(value.s);
+	case 'I': return std::to_string(value.i);
+	case 'J': return std::to_string(value.j);
+	case 'F': return std::to_string(value.f);
+	case 'D': return std::to_string(value.d);
+	default: return value.l == nullptr ? "null" : "a new reference";
+	}
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef FIELDWATCHES_H
+#define FIELDWATCHES_H
+
+#include "pch.h"
+#include "conditionexpression.h"
+
+typedef struct
+{
+	std::string classSignature;
+	std::string fieldName;
+	std::string description;
+	ConditionExpression condition;
+	std::string armError;
+	jclass klass;
+	std::atomic<jfieldID> field;
+	std::atomic<unsigned long long> checks;
+	std::atomic<long long> checkNanos;
+	std::atomic<unsigned long long> hits;
+} FieldWatch;
+
+/*
+ * Fields named by the "watch" option, for example watch=com.foo.Account.balance < 0;com.foo.Account.owner == null.
+ * The condition after the field name is a ConditionExpression, evaluated in the writing method with the field's name
+ * standing for the value being written, so com.foo.Account.balance < 0 && amount > 100 also reads the writer's locals.
+ * Watches are armed with SetFieldModificationWatch as soon as their class is prepared, so only writes to the watched
+ * fields are reported by the VM and every other field keeps running at full speed. HotSpot derives the IDs of instance
+ * fields from their offsets, so a watch holds its class as well and a write only matches when both are the same.
+ */
+class FieldWatches
+{
+	std::vector<std::unique_ptr<FieldWatch>> m_watches;
+	std::vector<std::string> m_errors;
+	mutable std::mutex m_armMutex;
+
+public:
+	FieldWatches() = default;
+	~FieldWatches() = default;
+	void parse(const std::string& specs);
+	bool empty() const;
+	void arm(jvmtiEnv* jvmti, JNIEnv* env, jclass klass);
+	void disarm(jvmtiEnv* jvmti, JNIEnv* env);
+	FieldWatch* find(JNIEnv* env, jclass klass, jfieldID field) const;
+	bool check(const ConditionFrame& frame, FieldWatch& watch, jmethodID method, jlocation location, char type, jvalue value) const;
+	std::vector<std::string> report() const;
+	const std::vector<std::string>& errors() const;
+	static std::string describeValue(char type, jvalue value);
+};
+
+#endif // FIELDWATCHES_H
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "pch.h"
+#include "gcmonitor.h"
+
+long long GcMonitor::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t GcMonitor::bucketOf(const long long nanos)
+{
+	// values below SUB_BUCKETS get a bucket each, above that every power of two is split into SUB_BUCKETS linear buckets
+	const auto value = static_cast<unsigned long long>(std::max(nanos, 0LL));
+	if (value < SUB_BUCKETS)
+		return static_cast<size_t>(value);
+
+	const unsigned shift = static_cast<unsigned>(std::bit_width(value)) - 1 - SUB_BUCKET_BITS;
+	return (shift + 1) * SUB_BUCKETS + static_cast<size_t>((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+long long GcMonitor::bucketUpperBound(const size_t bucket)
+{
+	if (bucket < SUB_BUCKETS)
+		return static_cast<long long>(bucket) + 1;
+
+	const size_t shift = bucket / SUB_BUCKETS - 1;
+	return static_cast<long long>((SUB_BUCKETS + bucket % SUB_BUCKETS + 1) << shift);
+}
+
+void GcMonitor::pauseStarted()
+{
+	this->m_pauseStart.store(GcMonitor::now(), std::memory_order_relaxed);
+}
+
+void GcMonitor::pauseFinished()
+{
+	// a finish without a start happens when the agent is loaded during a collection
+	const long long start = this->m_pauseStart.exchange(0, std::memory_order_relaxed);
+	if (start == 0)
+		return;
+
+	const long long nanos = GcMonitor::now() - start;
+	this->m_buckets[GcMonitor::bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+	this->m_pauses.fetch_add(1, std::memory_order_relaxed);
+	this->m_sumNanos.fetch_add(nanos, std::memory_order_relaxed);
+
+	long long max = this->m_maxNanos.load(std::memory_order_relaxed);
+	while (nanos > max && !this->m_maxNanos.compare_exchange_weak(max, nanos, std::memory_order_relaxed));
+}
+
+std::vector<std::string> GcMonitor::report()
+{
+	std::lock_guard lock(this->m_reportMutex);
+
+	// pauses since the previous report are the difference of the histograms
+	std::array<unsigned long long, BUCKETS> buckets;
+	unsigned long long pauses = 0;
+	for (size_t i = 0; i < BUCKETS; i++)
+	{
+		const unsigned long long total = this->m_buckets[i].load(std::memory_order_relaxed);
+		buckets[i] = total - this->m_reportedBuckets[i];
+		this->m_reportedBuckets[i] = total;
+		pauses += buckets[i];
+	}
+
+	const unsigned long long total_pauses = this->m_pauses.load(std::memory_order_relaxed);
+	const long long sum_nanos = this->m_sumNanos.load(std::memory_order_relaxed);
+	const long long max_nanos = this->m_maxNanos.exchange(0, std::memory_order_relaxed);
+	const long long pause_nanos = sum_nanos - this->m_reportedSumNanos;
+	this->m_reportedSumNanos = sum_nanos;
+
+	// every metric is "name\avalue\aunit"
+	std::vector<std::string> metrics;
+	metrics.push_back("GC Pauses\a" + std::to_string(pauses) + "\acount");
+	metrics.push_back("GC Pause Time\a" + std::to_string(pause_nanos) + "\ans");
+	metrics.push_back("Total GC Pauses\a" + std::to_string(total_pauses) + "\acount");
+	if (pauses == 0)
+		return metrics;
+
+	// percentiles are reported as the upper bound of their bucket, at most an eighth above the true value
+	for (const auto& [name, percentile] : { std::pair{ "GC Pause p50", 0.50 }, std::pair{ "GC Pause p90", 0.90 }, std::pair{ "GC Pause p99", 0.99 } })
+	{
+		const auto target = static_cast<unsigned long long>(std::ceil(percentile * static_cast<double>(pauses)));
+		unsigned long long seen = 0;
+		size_t bucket = 0;
+		while (bucket < BUCKETS - 1 && (seen += buckets[bucket]) < target)
+			bucket++;
+		metrics.push_back(name + ('\a' + std::to_string(std::min(GcMonitor::bucketUpperBound(bucket), max_nanos))) + "\ans");
+	}
+	metrics.push_back("GC Pause Max\a" + std::to_string(max_nanos) + "\ans");
+	return metrics;
+}
\ No newline at end of file
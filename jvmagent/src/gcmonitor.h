@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef GCMONITOR_H
+#define GCMONITOR_H
+
+#include "pch.h"
+
+/*
+ * Records garbage collection pauses from the GarbageCollectionStart and GarbageCollectionFinish events.
+ * The events are sent while the VM is stopped and may not call JNI, so a pause only costs two clock reads
+ * and a few atomic increments on a log-linear histogram with eight buckets per power of two.
+ * Captures report the pauses since the previous capture as typed metrics.
+ */
+class GcMonitor
+{
+	static constexpr unsigned SUB_BUCKET_BITS = 3;
+	static constexpr size_t SUB_BUCKETS = size_t{ 1 } << SUB_BUCKET_BITS;
+	static constexpr size_t BUCKETS = (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+	std::atomic<long long> m_pauseStart = 0;
+	std::array<std::atomic<unsigned long long>, BUCKETS> m_buckets{};
+	std::atomic<unsigned long long> m_pauses = 0;
+	std::atomic<long long> m_sumNanos = 0;
+	std::atomic<long long> m_maxNanos = 0;
+
+	// baseline of the previous report, guarded since captures may run on several threads at once
+	std::mutex m_reportMutex;
+	std::array<unsigned long long, BUCKETS> m_reportedBuckets{};
+	long long m_reportedSumNanos = 0;
+
+	static long long now();
+	static size_t bucketOf(long long nanos);
+	static long long bucketUpperBound(size_t bucket);
+
+public:
+	GcMonitor() = default;
+	~GcMonitor() = default;
+	void pauseStarted();
+	void pauseFinished();
+	std::vector<std::string> report();
+};
+
+#endif // GCMONITOR_H
\ No newline at end of file
@@ -0,0 +1,840 @@
+#include "pch.h"
+#include "heapdumper.h"
+
+// the agent only runs on little-endian x86 and x64, so every number is swapped on its way into the file
+template <typename T>
+static T bigEndian(T value)
+{
+	T result = 0;
+	for (size_t i = 0; i < sizeof(T); i++)
+	{
+		result = static_cast<T>((result << 8) | (value & 0xFF));
+		value = static_cast<T>(value >> 8);
+	}
+	return result;
+}
+
+template <typename T>
+static void swapRun(unsigned char* out, const unsigned char* in, const size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		T value;
+		std::memcpy(&value, in + i * sizeof(T), sizeof(T));
+		value = bigEndian(value);
+		std::memcpy(out + i * sizeof(T), &value, sizeof(T));
+	}
+}
+
+HprofWriter::~HprofWriter()
+{
+	if (this->m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(this->m_file);
+}
+
+bool HprofWriter::open(const std::wstring& path, const size_t bufferBytes)
+{
+	this->m_file = CreateFile(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (this->m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	this->m_capacity = std::max<size_t>(bufferBytes, 64 << 10);
+	this->m_buffer = std::make_unique_for_overwrite<unsigned char[]>(this->m_capacity);
+
+	// format name, identifier size and the time of the dump in milliseconds
+	const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	this->bytes("JAVA PROFILE 1.0.2", sizeof "JAVA PROFILE 1.0.2");
+	this->u4(8);
+	this->u8(static_cast<unsigned long long>(now));
+	return true;
+}
+
+bool HprofWriter::close()
+{
+	this->record(HEAP_DUMP_END, 0);
+	this->flush();
+	CloseHandle(this->m_file);
+	this->m_file = INVALID_HANDLE_VALUE;
+	return !this->m_failed;
+}
+
+void HprofWriter::flush()
+{
+	// the open segment always fits into the buffer, its length is filled in before it is written
+	this->closeSegment();
+	for (size_t written = 0; written < this->m_used && !this->m_failed;)
+	{
+		DWORD chunk = 0;
+		if (!WriteFile(this->m_file, this->m_buffer.get() + written, static_cast<DWORD>(this->m_used - written), &chunk, nullptr) || chunk == 0)
+			this->m_failed = true;
+		written += chunk;
+	}
+	this->m_written += this->m_used;
+	this->m_used = 0;
+}
+
+void HprofWriter::closeSegment()
+{
+	if (this->m_segment == NO_SEGMENT)
+		return;
+
+	const unsigned int length = bigEndian(static_cast<unsigned int>(this->m_used - this->m_segment - 4));
+	std::memcpy(this->m_buffer.get() + this->m_segment, &length, sizeof length);
+	this->m_segment = NO_SEGMENT;
+}
+
+void HprofWriter::record(const unsigned char tag, const size_t length)
+{
+	// top-level records end the heap dump segment that is open
+	this->closeSegment();
+	this->u1(tag);
+	this->u4(0);
+	this->u4(static_cast<unsigned int>(length));
+}
+
+void HprofWriter::subRecord(const size_t length)
+{
+	if (this->m_segment != NO_SEGMENT && this->m_capacity - this->m_used >= length)
+		return;
+
+	this->closeSegment();
+	if (this->m_capacity - this->m_used < RECORD_HEADER + length)
+		this->flush();
+
+	// too large for any buffer, written through it in pieces behind a length that is known up front
+	if (this->m_capacity < RECORD_HEADER + length)
+	{
+		this->record(HEAP_DUMP_SEGMENT, length);
+		return;
+	}
+
+	this->u1(HEAP_DUMP_SEGMENT);
+	this->u4(0);
+	this->m_segment = this->m_used;
+	this->u4(0);
+}
+
+void HprofWriter::u1(const unsigned char value)
+{
+	this->bytes(&value, 1);
+}
+
+void HprofWriter::u4(const unsigned int value)
+{
+	const unsigned int swapped = bigEndian(value);
+	this->bytes(&swapped, sizeof swapped);
+}
+
+void HprofWriter::u8(const unsigned long long value)
+{
+	const unsigned long long swapped = bigEndian(value);
+	this->bytes(&swapped, sizeof swapped);
+}
+
+void HprofWriter::bytes(const void* data, size_t size)
+{
+	const auto* in = static_cast<const unsigned char*>(data);
+	while (size > 0)
+	{
+		if (this->m_used == this->m_capacity)
+			this->flush();
+		const size_t chunk = std::min(size, this->m_capacity - this->m_used);
+		std::memcpy(this->m_buffer.get() + this->m_used, in, chunk);
+		this->m_used += chunk;
+		in += chunk;
+		size -= chunk;
+	}
+}
+
+void HprofWriter::swapped(const void* elements, size_t count, const size_t elementSize)
+{
+	if (elementSize == 1)
+	{
+		this->bytes(elements, count);
+		return;
+	}
+
+	// swapped straight into the buffer, as many elements at a time as it has room for
+	const auto* in = static_cast<const unsigned char*>(elements);
+	while (count > 0)
+	{
+		if (this->m_capacity - this->m_used < elementSize)
+			this->flush();
+		const size_t run = std::min(count, (this->m_capacity - this->m_used) / elementSize);
+		unsigned char* out = this->m_buffer.get() + this->m_used;
+		if (elementSize == 2)
+			swapRun<unsigned short>(out, in, run);
+		else if (elementSize == 4)
+			swapRun<unsigned int>(out, in, run);
+		else
+			swapRun<unsigned long long>(out, in, run);
+		this->m_used += run * elementSize;
+		in += run * elementSize;
+		count -= run;
+	}
+}
+
+void HprofWriter::zeros(size_t size)
+{
+	while (size > 0)
+	{
+		if (this->m_used == this->m_capacity)
+			this->flush();
+		const size_t chunk = std::min(size, this->m_capacity - this->m_used);
+		std::memset(this->m_buffer.get() + this->m_used, 0, chunk);
+		this->m_used += chunk;
+		size -= chunk;
+	}
+}
+
+unsigned long long HprofWriter::written() const
+{
+	return this->m_written + this->m_used;
+}
+
+HeapDumper::HeapDumper(jvmtiEnv* jvmti, JNIEnv* env)
+	: m_jvmti(jvmti), m_env(env)
+{
+}
+
+HeapDumper::~HeapDumper()
+{
+	if (this->m_tags != nullptr)
+		this->m_tags->DisposeEnvironment();
+}
+
+bool HeapDumper::dump(const std::wstring& path, const size_t bufferBytes, jthread thread, const jvmtiFrameInfo* frames, const jint count, LineNumberCache& lines)
+{
+	const auto start = std::chrono::steady_clock::now();
+	this->m_path = path;
+
+	// the dump tags objects in an environment of its own, so the tags of snapshots are left alone
+	JavaVM* vm = nullptr;
+	jvmtiCapabilities capabilities = {};
+	capabilities.can_tag_objects = JNI_TRUE;
+	if (this->m_env->GetJavaVM(&vm) != JNI_OK || vm->GetEnv(reinterpret_cast<void**>(&this->m_tags), JVMTI_VERSION) != JNI_OK || this->m_tags->AddCapabilities(&capabilities) != JVMTI_ERROR_NONE)
+	{
+		this->m_error = "Cannot create a JVMTI environment for the heap dump.";
+		return false;
+	}
+
+	if (!this->m_writer.open(path, bufferBytes))
+	{
+		this->m_error = "Cannot create the heap dump file.";
+		return false;
+	}
+
+	if (!this->readClasses())
+	{
+		this->m_error = "Cannot read the loaded classes.";
+		this->m_writer.close();
+		return false;
+	}
+	this->writeStackTraces(thread, frames, count, lines);
+
+	for (ClassLayout& layout : this->m_classes)
+	{
+		this->m_writer.subRecord(layout.classDump.size());
+		this->m_writer.bytes(layout.classDump.data(), layout.classDump.size());
+		layout.classDump = std::string();
+	}
+
+	// string values are ordinary objects with a value array, the string callback is not needed
+	jvmtiHeapCallbacks callbacks = {};
+	callbacks.heap_reference_callback = &HeapDumper::followReference;
+	callbacks.primitive_field_callback = &HeapDumper::primitiveField;
+	callbacks.array_primitive_value_callback = &HeapDumper::arrayPrimitiveValues;
+	const jvmtiError error = this->m_tags->FollowReferences(0, nullptr, nullptr, &callbacks, this);
+	this->finish();
+
+	const bool written = this->m_writer.close();
+	this->m_nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	if (error != JVMTI_ERROR_NONE)
+		this->m_error = "The heap walk failed.";
+	else if (this->m_exhausted)
+		this->m_error = "The heap holds more objects than a dump can number.";
+	else if (!written)
+		this->m_error = "Cannot write the heap dump file.";
+	return this->m_error.empty();
+}
+
+const std::string& HeapDumper::error() const
+{
+	return this->m_error;
+}
+
+unsigned long long HeapDumper::bytes() const
+{
+	return this->m_writer.written();
+}
+
+std::vector<std::string> HeapDumper::report() const
+{
+	// the path is linked from the snapshot, so the visualizer can open the dump
+	std::string path(static_cast<size_t>(WideCharToMultiByte(CP_UTF8, 0, this->m_path.c_str(), static_cast<int>(this->m_path.size()), nullptr, 0, nullptr, nullptr)), '\0');
+	WideCharToMultiByte(CP_UTF8, 0, this->m_path.c_str(), static_cast<int>(this->m_path.size()), path.data(), static_cast<int>(path.size()), nullptr, nullptr);
+
+	const unsigned long long bytes = this->m_writer.written();
+	const long long per_second = this->m_nanos > 0 ? static_cast<long long>(static_cast<double>(bytes) * 1e9 / static_cast<double>(this->m_nanos)) : 0;
+	return {
+		"Heap Dump\a" + path + "\afile",
+		"Heap Dump Size\a" + std::to_string(bytes) + "\abytes",
+		"Heap Dump Objects\a" + std::to_string(this->m_objects) + "\acount",
+		"Heap Dump GC Roots\a" + std::to_string(this->m_roots) + "\acount",
+		"Heap Dump Time\a" + std::to_string(this->m_nanos) + "\ans",
+		"Heap Dump Throughput\a" + std::to_string(per_second) + "\abytes/s"
+	};
+}
+
+jlong HeapDumper::newTag(const jint length)
+{
+	if (++this->m_nextId > ID_MASK)
+		this->m_exhausted = true;
+	return static_cast<jlong>((length > 0 ? static_cast<unsigned long long>(length) << ID_BITS : 0) | (this->m_nextId & ID_MASK));
+}
+
+jlong HeapDumper::tagOf(jobject object, const bool isArray)
+{
+	if (object == nullptr)
+		return 0;
+
+	jlong tag = 0;
+	if (this->m_tags->GetTag(object, &tag) == JVMTI_ERROR_NONE && tag == 0)
+	{
+		tag = this->newTag(isArray ? this->m_env->GetArrayLength(static_cast<jarray>(object)) : -1);
+		static_cast<void>(this->m_tags->SetTag(object, tag));
+	}
+	return tag;
+}
+
+unsigned long long HeapDumper::stringId(const std::string_view text)
+{
+	// names repeat across classes, each is written once
+	const auto [entry, added] = this->m_strings.try_emplace(std::string(text), this->m_nextString + 1);
+	if (added)
+	{
+		this->m_nextString++;
+		this->m_writer.record(HprofWriter::STRING, 8 + text.size());
+		this->m_writer.u8(entry->second);
+		this->m_writer.bytes(text.data(), text.size());
+	}
+	return entry->second;
+}
+
+bool HeapDumper::readClasses()
+{
+	jint count;
+	jclass* classes;
+	if (this->m_jvmti->GetLoadedClasses(&count, &classes) != JVMTI_ERROR_NONE)
+		return false;
+
+	// tagged before any is described, so superclasses and interfaces are found by their tags
+	this->m_classes.resize(static_cast<size_t>(count));
+	for (jint i = 0; i < count; i++)
+		static_cast<void>(this->m_tags->SetTag(classes[i], ++this->m_nextId));
+	for (jint i = 0; i < count; i++)
+	{
+		this->describe(classes[i]);
+		this->m_env->DeleteLocalRef(classes[i]);
+	}
+	this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(classes));
+	return true;
+}
+
+const HeapDumper::ClassLayout* HeapDumper::describe(jclass klass)
+{
+	jlong id = 0;
+	if (this->m_tags->GetTag(klass, &id) != JVMTI_ERROR_NONE || id <= 0 || static_cast<size_t>(id) > this->m_classes.size())
+		return nullptr;
+
+	ClassLayout& layout = this->m_classes[static_cast<size_t>(id - 1)];
+	if (layout.described)
+		return &layout;
+	layout.described = true;
+
+	// the superclass is described first, its fields follow the class's own in the values of an instance
+	jclass super_class = this->m_env->GetSuperclass(klass);
+	const ClassLayout* super_layout = super_class != nullptr ? this->describe(super_class) : nullptr;
+	jlong super_id = 0;
+	if (super_class != nullptr)
+		static_cast<void>(this->m_tags->GetTag(super_class, &super_id));
+
+	// HPROF names classes in their internal form, arrays keep their signature
+	char* signature = nullptr;
+	std::string name = "unknown";
+	if (this->m_jvmti->GetClassSignature(klass, &signature, nullptr) == JVMTI_ERROR_NONE)
+	{
+		name = signature;
+		if (name.size() > 2 && name.front() == 'L')
+			name = name.substr(1, name.size() - 2);
+		else if (name.size() > 1 && name.front() == '[')
+			layout.arrayType = name[1] == '[' ? 'L' : name[1];
+		this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(signature));
+	}
+	if (name == "java/lang/Class")
+		this->m_classClass = id;
+
+	this->m_writer.record(HprofWriter::LOAD_CLASS, 4 + 8 + 4 + 8);
+	this->m_writer.u4(static_cast<unsigned int>(id));
+	this->m_writer.u8(static_cast<unsigned long long>(id));
+	this->m_writer.u4(NO_TRACE);
+	this->m_writer.u8(this->stringId(name));
+
+	// JVMTI numbers the fields of all implemented interfaces first, then those of every class from java.lang.Object down
+	std::vector<jlong> interfaces;
+	const auto count_interface_fields = [this, &layout, &interfaces](const auto& self, jclass type) -> void
+	{
+		jint interface_count = 0;
+		jclass* implemented = nullptr;
+		if (this->m_jvmti->GetImplementedInterfaces(type, &interface_count, &implemented) != JVMTI_ERROR_NONE)
+			return;
+		for (jint i = 0; i < interface_count; i++)
+		{
+			jlong tag = 0;
+			static_cast<void>(this->m_tags->GetTag(implemented[i], &tag));
+			if (std::find(interfaces.begin(), interfaces.end(), tag) == interfaces.end())
+			{
+				interfaces.push_back(tag);
+				jint field_count = 0;
+				jfieldID* fields = nullptr;
+				if (this->m_jvmti->GetClassFields(implemented[i], &field_count, &fields) == JVMTI_ERROR_NONE)
+				{
+					layout.interfaceFields += field_count;
+					this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(fields));
+				}
+				self(self, implemented[i]);
+			}
+			this->m_env->DeleteLocalRef(implemented[i]);
+		}
+		this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(implemented));
+	};
+	for (jclass type = klass; type != nullptr;)
+	{
+		count_interface_fields(count_interface_fields, type);
+		jclass next = this->m_env->GetSuperclass(type);
+		if (type != klass)
+			this->m_env->DeleteLocalRef(type);
+		type = next;
+	}
+
+	// classes that are not prepared yet report no fields, just like arrays
+	jint field_count = 0;
+	jfieldID* fields = nullptr;
+	if (this->m_jvmti->GetClassFields(klass, &field_count, &fields) != JVMTI_ERROR_NONE)
+		field_count = 0;
+
+	jint status = 0;
+	const bool initialized = this->m_jvmti->GetClassStatus(klass, &status) == JVMTI_ERROR_NONE && (status & JVMTI_CLASS_STATUS_INITIALIZED) != 0;
+
+	std::string statics, instance_fields;
+	unsigned short static_count = 0, instance_count = 0;
+	std::vector<FieldSlot> own_slots;
+	size_t own_bytes = 0;
+	for (jint i = 0; i < field_count; i++)
+	{
+		char* field_name = nullptr;
+		char* field_signature = nullptr;
+		jint modifiers = 0;
+		if (this->m_jvmti->GetFieldName(klass, fields[i], &field_name, &field_signature, nullptr) != JVMTI_ERROR_NONE)
+		{
+			own_slots.push_back({ STATIC_SLOT, 'I' });
+			continue;
+		}
+		static_cast<void>(this->m_jvmti->GetFieldModifiers(klass, fields[i], &modifiers));
+		const char type = field_signature[0] == '[' ? 'L' : field_signature[0];
+		const unsigned long long name_id = this->stringId(field_name);
+
+		// static values are read now, the ones of classes that are not initialized yet are left at zero
+		if ((modifiers & 0x0008) != 0)
+		{
+			own_slots.push_back({ STATIC_SLOT, type });
+			unsigned long long value = 0;
+			if (initialized)
+			{
+				jvalue jv = {};
+				switch (type)
+				{
+				case 'Z': jv.z = this->m_env->GetStaticBooleanField(klass, fields[i]); break;
+				case 'B': jv.b = this->m_env->GetStaticByteField(klass, fields[i]); break;
+				case 'C': jv.c = this->m_env->GetStaticCharField(klass, fields[i]); break;
+				case 'S': jv.s = this->m_env->GetStaticShortField(klass, fields[i]); break;
+				case 'I': jv.i = this->m_env->GetStaticIntField(klass, fields[i]); break;
+				case 'J': jv.j = this->m_env->GetStaticLongField(klass, fields[i]); break;
+				case 'F': jv.f = this->m_env->GetStaticFloatField(klass, fields[i]); break;
+				case 'D': jv.d = this->m_env->GetStaticDoubleField(klass, fields[i]); break;
+				default:
+				{
+					jobject object = this->m_env->GetStaticObjectField(klass, fields[i]);
+					value = static_cast<unsigned long long>(this->tagOf(object, field_signature[0] == '['));
+					this->m_env->DeleteLocalRef(object);
+					break;
+				}
+				}
+				if (type != 'L')
+					value = HeapDumper::primitiveBits(jv, type);
+			}
+			HeapDumper::appendBigEndian(statics, name_id, 8);
+			statics += static_cast<char>(HeapDumper::hprofType(type));
+			HeapDumper::appendBigEndian(statics, value, HeapDumper::valueSize(type));
+			static_count++;
+		}
+		else
+		{
+			own_slots.push_back({ own_bytes, type });
+			own_bytes += HeapDumper::valueSize(type);
+			HeapDumper::appendBigEndian(instance_fields, name_id, 8);
+			instance_fields += static_cast<char>(HeapDumper::hprofType(type));
+			instance_count++;
+		}
+		this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(field_name));
+		this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(field_signature));
+	}
+	if (fields != nullptr)
+		this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(fields));
+
+	// the values of an instance hold its own fields first and those of its superclasses after them
+	layout.instanceBytes = own_bytes + (super_layout != nullptr ? super_layout->instanceBytes : 0);
+	if (super_layout != nullptr)
+	{
+		for (const FieldSlot& slot : super_layout->slots)
+			layout.slots.push_back({ slot.offset == STATIC_SLOT ? STATIC_SLOT : slot.offset + own_bytes, slot.type });
+	}
+	layout.slots.insert(layout.slots.end(), own_slots.begin(), own_slots.end());
+
+	jobject loader = nullptr;
+	static_cast<void>(this->m_jvmti->GetClassLoader(klass, &loader));
+	const jlong loader_id = this->tagOf(loader, false);
+	if (loader != nullptr)
+		this->m_env->DeleteLocalRef(loader);
+	if (super_class != nullptr)
+		this->m_env->DeleteLocalRef(super_class);
+
+	// CLASS DUMP: class, stack trace, superclass, loader, signers, protection domain, two reserved IDs, instance size,
+	// an empty constant pool, then the static and instance fields
+	std::string& record = layout.classDump;
+	record += static_cast<char>(0x20);
+	HeapDumper::appendBigEndian(record, static_cast<unsigned long long>(id), 8);
+	HeapDumper::appendBigEndian(record, NO_TRACE, 4);
+	HeapDumper::appendBigEndian(record, static_cast<unsigned long long>(super_id), 8);
+	HeapDumper::appendBigEndian(record, static_cast<unsigned long long>(loader_id), 8);
+	record.append(32, '\0');
+	HeapDumper::appendBigEndian(record, layout.arrayType == 0 ? layout.instanceBytes : 0, 4);
+	HeapDumper::appendBigEndian(record, 0, 2);
+	HeapDumper::appendBigEndian(record, static_count, 2);
+	record += statics;
+	HeapDumper::appendBigEndian(record, instance_count, 2);
+	record += instance_fields;
+	return &layout;
+}
+
+void HeapDumper::writeStackTraces(jthread thread, const jvmtiFrameInfo* frames, const jint count, LineNumberCache& lines)
+{
+	this->m_writer.record(HprofWriter::STACK_TRACE, 12);
+	this->m_writer.u4(NO_TRACE);
+	this->m_writer.u4(0);
+	this->m_writer.u4(0);
+
+	// the captured thread's stack, so the dump shows where it was taken
+	this->m_thread = this->tagOf(thread, false);
+	std::vector<unsigned long long> frame_ids;
+	for (jint i = 0; i < count; i++)
+	{
+		char* method_name = nullptr;
+		char* method_signature = nullptr;
+		if (this->m_jvmti->GetMethodName(frames[i].method, &method_name, &method_signature, nullptr) != JVMTI_ERROR_NONE)
+			continue;
+
+		jclass declaring_class = nullptr;
+		jlong class_id = 0;
+		if (this->m_jvmti->GetMethodDeclaringClass(frames[i].method, &declaring_class) == JVMTI_ERROR_NONE)
+		{
+			static_cast<void>(this->m_tags->GetTag(declaring_class, &class_id));
+			this->m_env->DeleteLocalRef(declaring_class);
+		}
+
+		const unsigned long long name_id = this->stringId(method_name);
+		const unsigned long long signature_id = this->stringId(method_signature);
+		const jint line = lines.lineOf(this->m_jvmti, frames[i].method, frames[i].location);
+		frame_ids.push_back(++this->m_nextString);
+		this->m_writer.record(HprofWriter::FRAME, 8 * 4 + 4 + 4);
+		this->m_writer.u8(frame_ids.back());
+		this->m_writer.u8(name_id);
+		this->m_writer.u8(signature_id);
+		this->m_writer.u8(0);
+		this->m_writer.u4(static_cast<unsigned int>(class_id));
+		this->m_writer.u4(static_cast<unsigned int>(line > 0 ? line : -1));
+		this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(method_name));
+		this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(method_signature));
+	}
+
+	this->m_writer.record(HprofWriter::STACK_TRACE, 12 + 8 * frame_ids.size());
+	this->m_writer.u4(CAPTURED_TRACE);
+	this->m_writer.u4(static_cast<unsigned int>(this->m_thread & ID_MASK));
+	this->m_writer.u4(static_cast<unsigned int>(frame_ids.size()));
+	for (const unsigned long long frame_id : frame_ids)
+		this->m_writer.u8(frame_id);
+}
+
+void HeapDumper::begin(const jlong tag, const jlong classTag)
+{
+	if (tag == this->m_current)
+		return;
+	this->finish();
+	this->m_current = tag;
+
+	// classes are written from their layouts, instances of classes loaded since they were read are left out
+	if (classTag <= 0 || static_cast<size_t>(classTag) > this->m_classes.size() || classTag == this->m_classClass)
+		return;
+	this->m_layout = &this->m_classes[static_cast<size_t>(classTag - 1)];
+	this->m_objects++;
+
+	if (this->m_layout->arrayType == 0)
+	{
+		this->m_values.assign(this->m_layout->instanceBytes, 0);
+		this->m_pending = Pending::Instance;
+		return;
+	}
+
+	this->m_length = static_cast<size_t>(static_cast<unsigned long long>(tag) >> ID_BITS);
+	if (this->m_layout->arrayType != 'L')
+	{
+		this->m_pending = Pending::PrimitiveArray;
+		return;
+	}
+
+	// OBJ ARRAY DUMP: array, stack trace, length, array class, then the elements as they are reported
+	this->m_length = std::min(this->m_length, (MAX_RECORD - 25) / 8);
+	this->m_elements = 0;
+	this->m_writer.subRecord(25 + this->m_length * 8);
+	this->m_writer.u1(0x22);
+	this->m_writer.u8(static_cast<unsigned long long>(tag));
+	this->m_writer.u4(NO_TRACE);
+	this->m_writer.u4(static_cast<unsigned int>(this->m_length));
+	this->m_writer.u8(static_cast<unsigned long long>(classTag));
+	this->m_pending = Pending::ObjectArray;
+}
+
+void HeapDumper::finish()
+{
+	switch (this->m_pending)
+	{
+	case Pending::Instance:
+		// INSTANCE DUMP: object, stack trace, class, size of the values, then the values
+		this->m_writer.subRecord(25 + this->m_values.size());
+		this->m_writer.u1(0x21);
+		this->m_writer.u8(static_cast<unsigned long long>(this->m_current));
+		this->m_writer.u4(NO_TRACE);
+		this->m_writer.u8(static_cast<unsigned long long>(this->m_layout - this->m_classes.data() + 1));
+		this->m_writer.u4(static_cast<unsigned int>(this->m_values.size()));
+		this->m_writer.bytes(this->m_values.data(), this->m_values.size());
+		break;
+	case Pending::ObjectArray:
+		// null elements are not reported, the ones after the last reported element are written here
+		this->m_writer.zeros((this->m_length - this->m_elements) * 8);
+		break;
+	case Pending::PrimitiveArray:
+	{
+		// an array whose values were not reported is written as zeros, so its record is still whole
+		const size_t element_size = HeapDumper::valueSize(this->m_layout->arrayType);
+		const size_t length = std::min(this->m_length, (MAX_RECORD - 18) / element_size);
+		this->m_writer.subRecord(18 + length * element_size);
+		this->m_writer.u1(0x23);
+		this->m_writer.u8(static_cast<unsigned long long>(this->m_current));
+		this->m_writer.u4(NO_TRACE);
+		this->m_writer.u4(static_cast<unsigned int>(length));
+		this->m_writer.u1(HeapDumper::hprofType(this->m_layout->arrayType));
+		this->m_writer.zeros(length * element_size);
+		break;
+	}
+	default:
+		break;
+	}
+	this->m_pending = Pending::None;
+}
+
+void HeapDumper::setField(const jint index, const unsigned long long value)
+{
+	if (this->m_pending != Pending::Instance)
+		return;
+
+	const jint slot_index = index - this->m_layout->interfaceFields;
+	if (slot_index < 0 || static_cast<size_t>(slot_index) >= this->m_layout->slots.size())
+		return;
+	const FieldSlot& slot = this->m_layout->slots[static_cast<size_t>(slot_index)];
+	if (slot.offset == STATIC_SLOT)
+		return;
+
+	const size_t size = HeapDumper::valueSize(slot.type);
+	for (size_t i = 0; i < size; i++)
+		this->m_values[slot.offset + i] = static_cast<unsigned char>(value >> (8 * (size - 1 - i)));
+}
+
+void HeapDumper::setElement(const jint index, const jlong tag)
+{
+	// elements are reported in order, so the gaps left by nulls are filled as the walk goes
+	if (this->m_pending != Pending::ObjectArray || index < 0 || static_cast<size_t>(index) < this->m_elements || static_cast<size_t>(index) >= this->m_length)
+		return;
+	this->m_writer.zeros((static_cast<size_t>(index) - this->m_elements) * 8);
+	this->m_writer.u8(static_cast<unsigned long long>(tag));
+	this->m_elements = static_cast<size_t>(index) + 1;
+}
+
+void HeapDumper::root(const jvmtiHeapReferenceKind kind, const jvmtiHeapReferenceInfo* info, const jlong tag)
+{
+	// roots are reported before any object, thread serials are the IDs of the thread objects
+	this->finish();
+	this->m_current = 0;
+	this->m_roots++;
+	switch (kind)
+	{
+	case JVMTI_HEAP_REFERENCE_JNI_GLOBAL:
+		this->m_writer.subRecord(17);
+		this->m_writer.u1(0x01);
+		this->m_writer.u8(static_cast<unsigned long long>(tag));
+		this->m_writer.u8(0);
+		break;
+	case JVMTI_HEAP_REFERENCE_STACK_LOCAL:
+		this->m_writer.subRecord(17);
+		this->m_writer.u1(0x03);
+		this->m_writer.u8(static_cast<unsigned long long>(tag));
+		this->m_writer.u4(static_cast<unsigned int>(info->stack_local.thread_tag & ID_MASK));
+		this->m_writer.u4(static_cast<unsigned int>(info->stack_local.depth));
+		break;
+	case JVMTI_HEAP_REFERENCE_JNI_LOCAL:
+		this->m_writer.subRecord(17);
+		this->m_writer.u1(0x02);
+		this->m_writer.u8(static_cast<unsigned long long>(tag));
+		this->m_writer.u4(static_cast<unsigned int>(info->jni_local.thread_tag & ID_MASK));
+		this->m_writer.u4(static_cast<unsigned int>(info->jni_local.depth));
+		break;
+	case JVMTI_HEAP_REFERENCE_THREAD:
+		this->m_writer.subRecord(17);
+		this->m_writer.u1(0x08);
+		this->m_writer.u8(static_cast<unsigned long long>(tag));
+		this->m_writer.u4(static_cast<unsigned int>(tag & ID_MASK));
+		this->m_writer.u4(tag == this->m_thread ? CAPTURED_TRACE : NO_TRACE);
+		break;
+	default:
+		// system classes are sticky classes, monitors are monitors in use, anything else is an unknown root
+		this->m_writer.subRecord(9);
+		this->m_writer.u1(kind == JVMTI_HEAP_REFERENCE_SYSTEM_CLASS ? 0x05 : kind == JVMTI_HEAP_REFERENCE_MONITOR ? 0x07 : 0xFF);
+		this->m_writer.u8(static_cast<unsigned long long>(tag));
+		break;
+	}
+}
+
+unsigned char HeapDumper::hprofType(const char signature)
+{
+	switch (signature)
+	{
+	case 'Z': return 4;
+	case 'C': return 5;
+	case 'F': return 6;
+	case 'D': return 7;
+	case 'B': return 8;
+	case 'S': return 9;
+	case 'I': return 10;
+	case 'J': return 11;
+	default: return 2;
+	}
+}
+
+size_t HeapDumper::valueSize(const char signature)
+{
+	switch (signature)
+	{
+	case 'Z':
+	case 'B':
+		return 1;
+	case 'C':
+	case 'S':
+		return 2;
+	case 'I':
+	case 'F':
+		return 4;
+	default:
+		return 8;
+	}
+}
+
+unsigned long long HeapDumper::primitiveBits(const jvalue value, const char signature)
+{
+	switch (signature)
+	{
+	case 'Z': return value.z;
+	case 'B': return static_cast<unsigned char>(value.b);
+	case 'C': return value.c;
+	case 'S': return static_cast<unsigned short>(value.s);
+	case 'I': return static_cast<unsigned int>(value.i);
+	case 'F': return std::bit_cast<unsigned int>(value.f);
+	case 'D': return std::bit_cast<unsigned long long>(value.d);
+	default: return static_cast<unsigned long long>(value.j);
+	}
+}
+
+void HeapDumper::appendBigEndian(std::string& out, const unsigned long long value, const size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		out += static_cast<char>(value >> (8 * (size - 1 - i)));
+}
+
+// called while the VM is stopped, so nothing here may use JNI or call into JVMTI
+jint JNICALL HeapDumper::followReference(const jvmtiHeapReferenceKind kind, const jvmtiHeapReferenceInfo* info, const jlong class_tag, const jlong referrer_class_tag, const jlong size, jlong* tag_ptr, jlong* referrer_tag_ptr, const jint length, void* user_data)
+{
+	auto* dumper = static_cast<HeapDumper*>(user_data);
+	if (*tag_ptr == 0)
+		*tag_ptr = dumper->newTag(length);
+	if (dumper->m_exhausted)
+		return JVMTI_VISIT_ABORT;
+
+	if (referrer_tag_ptr == nullptr)
+	{
+		dumper->root(kind, info, *tag_ptr);
+		return JVMTI_VISIT_OBJECTS;
+	}
+
+	// every object reports its class first, so even one without fields starts its record here
+	if (*referrer_tag_ptr == 0)
+		*referrer_tag_ptr = dumper->newTag(-1);
+	dumper->begin(*referrer_tag_ptr, referrer_class_tag);
+	if (kind == JVMTI_HEAP_REFERENCE_FIELD)
+		dumper->setField(info->field.index, static_cast<unsigned long long>(*tag_ptr));
+	else if (kind == JVMTI_HEAP_REFERENCE_ARRAY_ELEMENT)
+		dumper->setElement(info->array.index, *tag_ptr);
+	return JVMTI_VISIT_OBJECTS;
+}
+
+jint JNICALL HeapDumper::primitiveField(const jvmtiHeapReferenceKind kind, const jvmtiHeapReferenceInfo* info, const jlong object_class_tag, jlong* object_tag_ptr, const jvalue value, const jvmtiPrimitiveType value_type, void* user_data)
+{
+	// static fields were read with their classes
+	auto* dumper = static_cast<HeapDumper*>(user_data);
+	if (kind != JVMTI_HEAP_REFERENCE_FIELD || *object_tag_ptr == 0)
+		return 0;
+	dumper->begin(*object_tag_ptr, object_class_tag);
+	dumper->setField(info->field.index, HeapDumper::primitiveBits(value, static_cast<char>(value_type)));
+	return 0;
+}
+
+jint JNICALL HeapDumper::arrayPrimitiveValues(const jlong class_tag, const jlong size, jlong* tag_ptr, const jint element_count, const jvmtiPrimitiveType element_type, const void* elements, void* user_data)
+{
+	auto* dumper = static_cast<HeapDumper*>(user_data);
+	if (*tag_ptr == 0)
+		return 0;
+	dumper->begin(*tag_ptr, class_tag);
+	if (dumper->m_pending != Pending::PrimitiveArray)
+		return 0;
+
+	// PRIM ARRAY DUMP: array, stack trace, length, element type, then the elements straight from the heap
+	const char type = static_cast<char>(element_type);
+	const size_t element_size = HeapDumper::valueSize(type);
+	const size_t length = std::min(static_cast<size_t>(std::max(element_count, 0)), (MAX_RECORD - 18) / element_size);
+	dumper->m_writer.subRecord(18 + length * element_size);
+	dumper->m_writer.u1(0x23);
+	dumper->m_writer.u8(static_cast<unsigned long long>(*tag_ptr));
+	dumper->m_writer.u4(NO_TRACE);
+	dumper->m_writer.u4(static_cast<unsigned int>(length));
+	dumper->m_writer.u1(HeapDumper::hprofType(type));
+	dumper->m_writer.swapped(elements, length, element_size);
+	dumper->m_pending = Pending::None;
+	return 0;
+}
\ No newline at end of file
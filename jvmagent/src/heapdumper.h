@@ -0,0 +1,163 @@
+#pragma once
+
+#ifndef HEAPDUMPER_H
+#define HEAPDUMPER_H
+
+#include "pch.h"
+#include "linebreakpoints.h"
+
+/*
+ * Writes HPROF files through one fixed-size buffer that goes to disk whenever it fills. Heap dump sub-records are
+ * grouped into HEAP DUMP SEGMENT records whose length is filled in just before the buffer is written, and a sub-record
+ * that does not fit into an empty buffer gets a segment of its own, so a dump of any size is written with the same
+ * amount of memory. Numbers are written big-endian, as the format requires.
+ */
+class HprofWriter
+{
+	static constexpr size_t NO_SEGMENT = std::numeric_limits<size_t>::max();
+	static constexpr size_t RECORD_HEADER = 9;
+
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	std::unique_ptr<unsigned char[]> m_buffer;
+	size_t m_capacity = 0;
+	size_t m_used = 0;
+	size_t m_segment = NO_SEGMENT;
+	unsigned long long m_written = 0;
+	bool m_failed = false;
+
+	void flush();
+	void closeSegment();
+
+public:
+	// record tags of the HPROF 1.0.2 format
+	static constexpr unsigned char STRING = 0x01;
+	static constexpr unsigned char LOAD_CLASS = 0x02;
+	static constexpr unsigned char FRAME = 0x04;
+	static constexpr unsigned char STACK_TRACE = 0x05;
+	static constexpr unsigned char HEAP_DUMP_SEGMENT = 0x1C;
+	static constexpr unsigned char HEAP_DUMP_END = 0x2C;
+
+	HprofWriter() = default;
+	~HprofWriter();
+	bool open(const std::wstring& path, size_t bufferBytes);
+	bool close();
+	void record(unsigned char tag, size_t length);
+	void subRecord(size_t length);
+	void u1(unsigned char value);
+	void u4(unsigned int value);
+	void u8(unsigned long long value);
+	void bytes(const void* data, size_t size);
+	void swapped(const void* elements, size_t count, size_t elementSize);
+	void zeros(size_t size);
+	unsigned long long written() const;
+};
+
+/*
+ * Heap dump in the HPROF format, written from inside a capture with the "hprof" option so it shows the heap as it was
+ * at the breakpoint. The loaded classes are read and tagged first, then a single FollowReferences pass walks every
+ * reachable object while the VM is stopped. HotSpot reports all references and fields of an object before it moves on
+ * to the next one, so each object is written as soon as the walk leaves it and nothing is kept per object: the object
+ * IDs are the tags of a JVMTI environment of the dump's own, which is disposed of afterwards and takes the tags with it.
+ */
+class HeapDumper
+{
+public:
+	static constexpr long long DEFAULT_BUFFER_MB = 4;
+
+private:
+	// a tag holds the object ID in its low bits and the length of an array above them, because the length of an object
+	// array is only reported where the array is referenced, while its record has to start with it
+	static constexpr unsigned ID_BITS = 32;
+	static constexpr unsigned long long ID_MASK = (1ULL << ID_BITS) - 1;
+
+	// the length of a record is a u4, longer arrays are cut off to fit
+	static constexpr size_t MAX_RECORD = std::numeric_limits<unsigned int>::max() - 64;
+
+	// static fields have no slot in the values of an instance
+	static constexpr size_t STATIC_SLOT = std::numeric_limits<size_t>::max();
+
+	// stack trace serials, objects are not attributed to an allocation site
+	static constexpr unsigned int NO_TRACE = 1;
+	static constexpr unsigned int CAPTURED_TRACE = 2;
+
+	typedef struct
+	{
+		size_t offset;
+		char type;
+	} FieldSlot;
+
+	typedef struct
+	{
+		bool described;
+		char arrayType;
+		jint interfaceFields;
+		size_t instanceBytes;
+		std::vector<FieldSlot> slots;
+		std::string classDump;
+	} ClassLayout;
+
+	enum class Pending
+	{
+		None,
+		Instance,
+		ObjectArray,
+		PrimitiveArray
+	};
+
+	jvmtiEnv* m_jvmti;
+	JNIEnv* m_env;
+	jvmtiEnv* m_tags = nullptr;
+	HprofWriter m_writer;
+	std::wstring m_path;
+	std::string m_error;
+
+	// classes have the IDs 1 to n, so their IDs double as the class serial numbers
+	std::vector<ClassLayout> m_classes;
+	std::unordered_map<std::string, unsigned long long> m_strings;
+	unsigned long long m_nextString = 0;
+	unsigned long long m_nextId = 0;
+	jlong m_classClass = 0;
+	jlong m_thread = 0;
+	bool m_exhausted = false;
+
+	// the object the walk is reporting, written out once it moves on to another one
+	jlong m_current = 0;
+	Pending m_pending = Pending::None;
+	const ClassLayout* m_layout = nullptr;
+	std::vector<unsigned char> m_values;
+	size_t m_length = 0;
+	size_t m_elements = 0;
+
+	unsigned long long m_objects = 0;
+	unsigned long long m_roots = 0;
+	long long m_nanos = 0;
+
+	jlong newTag(jint length);
+	jlong tagOf(jobject object, bool isArray);
+	unsigned long long stringId(std::string_view text);
+	bool readClasses();
+	const ClassLayout* describe(jclass klass);
+	void writeStackTraces(jthread thread, const jvmtiFrameInfo* frames, jint count, LineNumberCache& lines);
+	void begin(jlong tag, jlong classTag);
+	void finish();
+	void setField(jint index, unsigned long long value);
+	void setElement(jint index, jlong tag);
+	void root(jvmtiHeapReferenceKind kind, const jvmtiHeapReferenceInfo* info, jlong tag);
+	static unsigned char hprofType(char signature);
+	static size_t valueSize(char signature);
+	static unsigned long long primitiveBits(jvalue value, char signature);
+	static void appendBigEndian(std::string& out, unsigned long long value, size_t size);
+	static jint JNICALL followReference(jvmtiHeapReferenceKind kind, const jvmtiHeapReferenceInfo* info, jlong class_tag, jlong referrer_class_tag, jlong size, jlong* tag_ptr, jlong* referrer_tag_ptr, jint length, void* user_data);
+	static jint JNICALL primitiveField(jvmtiHeapReferenceKind kind, const jvmtiHeapReferenceInfo* info, jlong object_class_tag, jlong* object_tag_ptr, jvalue value, jvmtiPrimitiveType value_type, void* user_data);
+	static jint JNICALL arrayPrimitiveValues(jlong class_tag, jlong size, jlong* tag_ptr, jint element_count, jvmtiPrimitiveType element_type, const void* elements, void* user_data);
+
+public:
+	HeapDumper(jvmtiEnv* jvmti, JNIEnv* env);
+	~HeapDumper();
+	bool dump(const std::wstring& path, size_t bufferBytes, jthread thread, const jvmtiFrameInfo* frames, jint count, LineNumberCache& lines);
+	const std::string& error() const;
+	unsigned long long bytes() const;
+	std::vector<std::string> report() const;
+};
+
+#endif // HEAPDUMPER_H
\ No newline at end of file
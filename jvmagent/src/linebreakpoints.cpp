@@ -0,0 +1,174 @@
+#include "pch.h"
+#include "linebreakpoints.h"
+
+const std::vector<jvmtiLineNumberEntry>& LineNumberCache::table(jvmtiEnv* jvmti, jmethodID method)
+{
+	std::lock_guard lock(this->m_mutex);
+	const auto cached = this->m_tables.find(method);
+	if (cached != this->m_tables.end())
+		return cached->second;
+
+	// native and abstract methods, and classes compiled without debug information, have no table
+	std::vector<jvmtiLineNumberEntry> entries;
+	jint count;
+	jvmtiLineNumberEntry* table;
+	if (jvmti->GetLineNumberTable(method, &count, &table) == JVMTI_ERROR_NONE)
+	{
+		entries.assign(table, table + count);
+		jvmti->Deallocate(reinterpret_cast<unsigned char*>(table));
+	}
+
+	// map nodes never move, so the reference stays valid after the lock is released
+	return this->m_tables.emplace(method, std::move(entries)).first->second;
+}
+
+jint LineNumberCache::lineOf(jvmtiEnv* jvmti, jmethodID method, const jlocation location)
+{
+	// entries are not guaranteed to be sorted, the closest start at or before the location wins
+	jint line = -1;
+	jlocation closest = -1;
+	for (const jvmtiLineNumberEntry& entry : this->table(jvmti, method))
+	{
+		if (entry.start_location <= location && entry.start_location > closest)
+		{
+			closest = entry.start_location;
+			line = entry.line_number;
+		}
+	}
+	return line;
+}
+
+void LineBreakpoints::parse(const std::string& specs)
+{
+	// a configuration parses its breakpoints before it is published, attaching again builds a new one
+	std::lock_guard lock(this->m_mutex);
+	this->m_breakpoints.clear();
+
+	// breakpoints are separated by semicolons since commas separate agent options
+	std::stringstream stream(specs);
+	for (std::string spec; std::getline(stream, spec, ';');)
+	{
+		// an optional condition follows the line, com.foo.Bar:123 if i % 100 == 0
+		std::string condition;
+		const size_t clause = spec.find(" if ");
+		if (clause != std::string::npos)
+		{
+			condition = spec.substr(clause + 4);
+			spec.erase(clause);
+		}
+
+		const size_t separator = spec.rfind(':');
+		if (separator == std::string::npos || separator == 0)
+			continue;
+
+		const jint line = std::atoi(spec.c_str() + separator + 1);
+		if (line <= 0)
+			continue;
+
+		auto breakpoint = std::make_unique<LineBreakpoint>();
+		breakpoint->classSignature = 'L' + spec.substr(0, separator);
+		std::replace(breakpoint->classSignature.begin(), breakpoint->classSignature.end(), '.', '/');
+		breakpoint->line = line;
+		breakpoint->description = spec;
+		breakpoint->condition.parse(condition);
+		this->m_breakpoints.push_back(std::move(breakpoint));
+	}
+}
+
+bool LineBreakpoints::empty() const
+{
+	return this->m_breakpoints.empty();
+}
+
+void LineBreakpoints::arm(jvmtiEnv* jvmti, jclass klass, LineNumberCache& lines)
+{
+	char* signature = nullptr;
+	if (jvmti->GetClassSignature(klass, &signature, nullptr) != JVMTI_ERROR_NONE)
+		return;
+
+	// lambdas and anonymous classes written on the line live in nested classes, "Lcom/foo/Bar$1;"
+	const std::string_view class_signature = signature;
+	std::lock_guard lock(this->m_mutex);
+	for (const std::unique_ptr<LineBreakpoint>& breakpoint : this->m_breakpoints)
+	{
+		if (!class_signature.starts_with(breakpoint->classSignature) || class_signature.size() == breakpoint->classSignature.size())
+			continue;
+		const char next = class_signature[breakpoint->classSignature.size()];
+		if (next != ';' && next != '$')
+			continue;
+
+		jint count;
+		jmethodID* methods;
+		if (jvmti->GetClassMethods(klass, &count, &methods) != JVMTI_ERROR_NONE)
+			continue;
+
+		for (jint i = 0; i < count; i++)
+		{
+			// a line may be split over several table entries, the breakpoint goes on its first bytecode
+			jlocation first = -1;
+			for (const jvmtiLineNumberEntry& entry : lines.table(jvmti, methods[i]))
+			{
+				if (entry.line_number == breakpoint->line && (first == -1 || entry.start_location < first))
+					first = entry.start_location;
+			}
+
+			if (first != -1 && jvmti->SetBreakpoint(methods[i], first) == JVMTI_ERROR_NONE)
+				breakpoint->locations.push_back({ methods[i], first });
+		}
+		jvmti->Deallocate(reinterpret_cast<unsigned char*>(methods));
+	}
+	jvmti->Deallocate(reinterpret_cast<unsigned char*>(signature));
+}
+
+void LineBreakpoints::disarm(jvmtiEnv* jvmti)
+{
+	std::lock_guard lock(this->m_mutex);
+	for (const std::unique_ptr<LineBreakpoint>& breakpoint : this->m_breakpoints)
+	{
+		for (const BreakpointLocation& installed : breakpoint->locations)
+			static_cast<void>(jvmti->ClearBreakpoint(installed.method, installed.location));
+		breakpoint->locations.clear();
+	}
+}
+
+LineBreakpoint* LineBreakpoints::find(jmethodID method, const jlocation location)
+{
+	// only installed locations are reported, so this runs once per hit
+	std::lock_guard lock(this->m_mutex);
+	for (const std::unique_ptr<LineBreakpoint>& breakpoint : this->m_breakpoints)
+	{
+		for (const BreakpointLocation& installed : breakpoint->locations)
+		{
+			if (installed.method == method && installed.location == location)
+				return breakpoint.get();
+		}
+	}
+	return nullptr;
+}
+
+std::vector<std::string> LineBreakpoints::report() const
+{
+	// typed metrics: how often every breakpoint was hit and in how many methods it is installed
+	std::lock_guard lock(this->m_mutex);
+	std::vector<std::string> metrics;
+	for (const std::unique_ptr<LineBreakpoint>& breakpoint : this->m_breakpoints)
+	{
+		metrics.push_back("Breakpoint " + breakpoint->description + " Hits\a" + std::to_string(breakpoint->hits.load(std::memory_order_relaxed)) + "\acount");
+		metrics.push_back("Breakpoint " + breakpoint->description + " Locations\a" + std::to_string(breakpoint->locations.size()) + "\acount");
+		for (std::string& metric : breakpoint->condition.report("Breakpoint " + breakpoint->description))
+			metrics.push_back(std::move(metric));
+	}
+	return metrics;
+}
+
+std::vector<std::string> LineBreakpoints::conditionErrors() const
+{
+	std::lock_guard lock(this->m_mutex);
+	std::vector<std::string> errors;
+	for (const std::unique_ptr<LineBreakpoint>& breakpoint : this->m_breakpoints)
+	{
+		if (!breakpoint->condition.error().empty())
+			errors.push_back("Breakpoint " + breakpoint->description + ": " + breakpoint->condition.error());
+	}
+	return errors;
+}
\ No newline at end of file
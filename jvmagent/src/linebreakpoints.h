@@ -0,0 +1,63 @@
+#pragma once
+
+#ifndef LINEBREAKPOINTS_H
+#define LINEBREAKPOINTS_H
+
+#include "pch.h"
+#include "conditionexpression.h"
+
+/*
+ * Line number tables by method. Tables never change once a class is prepared,
+ * so every method is only asked for its table once, whether for installing breakpoints or for a capture.
+ */
+class LineNumberCache
+{
+	std::mutex m_mutex;
+	std::unordered_map<jmethodID, std::vector<jvmtiLineNumberEntry>> m_tables;
+
+public:
+	LineNumberCache() = default;
+	~LineNumberCache() = default;
+	const std::vector<jvmtiLineNumberEntry>& table(jvmtiEnv* jvmti, jmethodID method);
+	jint lineOf(jvmtiEnv* jvmti, jmethodID method, jlocation location);
+};
+
+typedef struct
+{
+	jmethodID method;
+	jlocation location;
+} BreakpointLocation;
+
+typedef struct
+{
+	std::string classSignature;
+	jint line;
+	std::string description;
+	std::vector<BreakpointLocation> locations;
+	ConditionExpression condition;
+	std::atomic<unsigned long long> hits;
+} LineBreakpoint;
+
+/*
+ * Breakpoints named by the "break" option, for example break=com.foo.Bar:123;com.foo.Baz:45 if i % 100 == 0.
+ * A breakpoint is installed with SetBreakpoint when its class, or a class nested in it, is prepared,
+ * at the first bytecode of the line in every method that has code on that line.
+ */
+class LineBreakpoints
+{
+	std::vector<std::unique_ptr<LineBreakpoint>> m_breakpoints;
+	mutable std::mutex m_mutex;
+
+public:
+	LineBreakpoints() = default;
+	~LineBreakpoints() = default;
+	void parse(const std::string& specs);
+	bool empty() const;
+	void arm(jvmtiEnv* jvmti, jclass klass, LineNumberCache& lines);
+	void disarm(jvmtiEnv* jvmti);
+	LineBreakpoint* find(jmethodID method, jlocation location);
+	std::vector<std::string> report() const;
+	std::vector<std::string> conditionErrors() const;
+};
+
+#endif // LINEBREAKPOINTS_H
\ No newline at end of file
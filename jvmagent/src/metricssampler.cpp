@@ -0,0 +1,137 @@
+#include "pch.h"
+#include "metricssampler.h"
+
+bool MetricsSampler::start(jvmtiEnv* jvmti, JNIEnv* env, const long long intervalMs)
+{
+	this->m_intervalMs = static_cast<DWORD>(std::clamp<long long>(intervalMs, 1, 60 * 1000));
+	return this->m_thread.start(jvmti, env, "memdbgvis metrics sampler", JVMTI_THREAD_MIN_PRIORITY, &MetricsSampler::run, this);
+}
+
+void MetricsSampler::stop()
+{
+	// the thread notices within one interval, samples already in the ring stay available
+	this->m_thread.stop();
+}
+
+void MetricsSampler::run(jvmtiEnv* jvmti, JNIEnv* env, void* owner, const unsigned long long generation)
+{
+	auto* sampler = static_cast<MetricsSampler*>(owner);
+	if (sampler->m_memoryBean == nullptr && !sampler->resolveBeans(env))
+		return;
+
+	// agent threads are daemons, the VM ends this loop when it exits unless the agent detaches first
+	while (sampler->m_thread.running(generation))
+	{
+		sampler->sample(env);
+		Sleep(sampler->m_intervalMs);
+	}
+}
+
+long long MetricsSampler::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+long long MetricsSampler::processCpuNanos()
+{
+	// kernel and user time are reported in 100 ns units
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0;
+
+	const auto ticks = [](const FILETIME& time) { return static_cast<long long>((static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime); };
+	return (ticks(kernel) + ticks(user)) * 100;
+}
+
+bool MetricsSampler::resolveBeans(JNIEnv* env)
+{
+	const jclass factory = env->FindClass("java/lang/management/ManagementFactory");
+	const jclass memory_bean_class = env->FindClass("java/lang/management/MemoryMXBean");
+	const jclass thread_bean_class = env->FindClass("java/lang/management/ThreadMXBean");
+	const jclass usage_class = env->FindClass("java/lang/management/MemoryUsage");
+	if (factory == nullptr || memory_bean_class == nullptr || thread_bean_class == nullptr || usage_class == nullptr)
+	{
+		env->ExceptionClear();
+		return false;
+	}
+
+	const jmethodID get_memory_bean = env->GetStaticMethodID(factory, "getMemoryMXBean", "()Ljava/lang/management/MemoryMXBean;");
+	const jmethodID get_thread_bean = env->GetStaticMethodID(factory, "getThreadMXBean", "()Ljava/lang/management/ThreadMXBean;");
+	this->m_getHeapUsage = env->GetMethodID(memory_bean_class, "getHeapMemoryUsage", "()Ljava/lang/management/MemoryUsage;");
+	this->m_getNonHeapUsage = env->GetMethodID(memory_bean_class, "getNonHeapMemoryUsage", "()Ljava/lang/management/MemoryUsage;");
+	this->m_getUsed = env->GetMethodID(usage_class, "getUsed", "()J");
+	this->m_getThreadCount = env->GetMethodID(thread_bean_class, "getThreadCount", "()I");
+	if (env->ExceptionCheck())
+	{
+		env->ExceptionClear();
+		return false;
+	}
+
+	this->m_memoryBean = env->NewGlobalRef(env->CallStaticObjectMethod(factory, get_memory_bean));
+	this->m_threadBean = env->NewGlobalRef(env->CallStaticObjectMethod(factory, get_thread_bean));
+	if (env->ExceptionCheck() || this->m_memoryBean == nullptr || this->m_threadBean == nullptr)
+	{
+		env->ExceptionClear();
+		return false;
+	}
+	return true;
+}
+
+void MetricsSampler::sample(JNIEnv* env)
+{
+	// the usage objects of every sample are released together
+	if (env->PushLocalFrame(8) != JNI_OK)
+	{
+		env->ExceptionClear();
+		return;
+	}
+
+	const jobject heap_usage = env->CallObjectMethod(this->m_memoryBean, this->m_getHeapUsage);
+	const jobject non_heap_usage = env->CallObjectMethod(this->m_memoryBean, this->m_getNonHeapUsage);
+	const jlong heap = heap_usage != nullptr ? env->CallLongMethod(heap_usage, this->m_getUsed) : 0;
+	const jlong non_heap = non_heap_usage != nullptr ? env->CallLongMethod(non_heap_usage, this->m_getUsed) : 0;
+	const jint threads = env->CallIntMethod(this->m_threadBean, this->m_getThreadCount);
+	env->PopLocalFrame(nullptr);
+	if (env->ExceptionCheck())
+	{
+		env->ExceptionClear();
+		return;
+	}
+
+	// the slot is filled before the counter moves past it
+	const unsigned long long index = this->m_written.load(std::memory_order_relaxed);
+	MetricsSample& slot = this->m_ring[index % CAPACITY];
+	slot.timeNanos.store(MetricsSampler::now(), std::memory_order_relaxed);
+	slot.heapBytes.store(heap, std::memory_order_relaxed);
+	slot.nonHeapBytes.store(non_heap, std::memory_order_relaxed);
+	slot.threads.store(threads, std::memory_order_relaxed);
+	slot.cpuNanos.store(MetricsSampler::processCpuNanos(), std::memory_order_relaxed);
+	this->m_written.store(index + 1, std::memory_order_release);
+}
+
+std::vector<std::string> MetricsSampler::window() const
+{
+	const long long capture_time = MetricsSampler::now();
+	const unsigned long long written = this->m_written.load(std::memory_order_acquire);
+	const unsigned long long first = written > CAPACITY ? written - CAPACITY : 0;
+
+	// every sample is "nanoseconds before the capture\aheap bytes\anon-heap bytes\athreads\aprocess CPU nanoseconds", oldest first
+	std::vector<std::string> lines;
+	lines.reserve(static_cast<size_t>(written - first));
+	for (unsigned long long i = first; i < written; i++)
+	{
+		const MetricsSample& slot = this->m_ring[i % CAPACITY];
+		lines.push_back(std::to_string(capture_time - slot.timeNanos.load(std::memory_order_relaxed)) + '\a'
+			+ std::to_string(slot.heapBytes.load(std::memory_order_relaxed)) + '\a'
+			+ std::to_string(slot.nonHeapBytes.load(std::memory_order_relaxed)) + '\a'
+			+ std::to_string(slot.threads.load(std::memory_order_relaxed)) + '\a'
+			+ std::to_string(slot.cpuNanos.load(std::memory_order_relaxed)));
+	}
+
+	// the oldest slots may have been overwritten while they were copied
+	const unsigned long long after = this->m_written.load(std::memory_order_acquire);
+	const unsigned long long valid = after + 1 > CAPACITY ? after + 1 - CAPACITY : 0;
+	if (valid > first)
+		lines.erase(lines.begin(), lines.begin() + static_cast<std::ptrdiff_t>(std::min<unsigned long long>(valid - first, lines.size())));
+	return lines;
+}
\ No newline at end of file
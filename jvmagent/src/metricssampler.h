@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef METRICSSAMPLER_H
+#define METRICSSAMPLER_H
+
+#include "pch.h"
+#include "agentthread.h"
+
+/*
+ * Samples heap and non-heap usage, the live thread count and the CPU time of the process on a JVMTI agent thread.
+ * Samples are written into a preallocated ring that is overwritten in place, and captures copy whatever the ring
+ * still holds, so every snapshot carries the last minute or so of history leading up to the breakpoint.
+ */
+class MetricsSampler
+{
+public:
+	static constexpr long long DEFAULT_INTERVAL_MS = 100;
+
+private:
+	static constexpr size_t CAPACITY = 600;
+
+	// the sampler thread is the only writer, fields are atomic so captures can copy them while it runs
+	typedef struct
+	{
+		std::atomic<long long> timeNanos;
+		std::atomic<long long> heapBytes;
+		std::atomic<long long> nonHeapBytes;
+		std::atomic<long long> threads;
+		std::atomic<long long> cpuNanos;
+	} MetricsSample;
+
+	std::array<MetricsSample, CAPACITY> m_ring{};
+	std::atomic<unsigned long long> m_written = 0;
+	DWORD m_intervalMs = DEFAULT_INTERVAL_MS;
+
+	AgentThread m_thread;
+
+	// management beans are looked up once by the sampler thread
+	jobject m_memoryBean = nullptr;
+	jobject m_threadBean = nullptr;
+	jmethodID m_getHeapUsage = nullptr;
+	jmethodID m_getNonHeapUsage = nullptr;
+	jmethodID m_getUsed = nullptr;
+	jmethodID m_getThreadCount = nullptr;
+
+	static void run(jvmtiEnv* jvmti, JNIEnv* env, void* owner, unsigned long long generation);
+	static long long now();
+	static long long processCpuNanos();
+	bool resolveBeans(JNIEnv* env);
+	void sample(JNIEnv* env);
+
+public:
+	MetricsSampler() = default;
+	~MetricsSampler() = default;
+	bool start(jvmtiEnv* jvmti, JNIEnv* env, long long intervalMs);
+	void stop();
+	std::vector<std::string> window() const;
+};
+
+#endif // METRICSSAMPLER_H
\ No newline at end of file
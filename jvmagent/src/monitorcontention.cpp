@@ -0,0 +1,404 @@
+#include "pch.h"
+#include "monitorcontention.h"
+#include "allocationsampler.h"
+
+thread_local long long MonitorContention::s_enterNanos = 0;
+
+MonitorGraph::MonitorGraph(jvmtiEnv* jvmti, JNIEnv* env)
+	: m_jvmti(jvmti), m_env(env)
+{
+}
+
+const char* MonitorGraph::stateName(const jint state)
+{
+	// the names of java.lang.Thread.State
+	if (state & JVMTI_THREAD_STATE_TERMINATED)
+		return "TERMINATED";
+	if (!(state & JVMTI_THREAD_STATE_ALIVE))
+		return "NEW";
+	if (state & JVMTI_THREAD_STATE_BLOCKED_ON_MONITOR_ENTER)
+		return "BLOCKED";
+	if (state & JVMTI_THREAD_STATE_WAITING_WITH_TIMEOUT)
+		return "TIMED_WAITING";
+	if (state & JVMTI_THREAD_STATE_WAITING_INDEFINITELY)
+		return "WAITING";
+	return "RUNNABLE";
+}
+
+std::string MonitorGraph::describe(jvmtiEnv* jvmti, JNIEnv* env, jobject monitor)
+{
+	// the class and identity hash, as Object.toString() prints them, since no Java code may run on a lock someone waits for
+	// a synchronized static method locks its class, which is named as such
+	std::string description = "<unknown>";
+	char* signature = nullptr;
+	if (jvmti->GetClassSignature(static_cast<jclass>(monitor), &signature, nullptr) == JVMTI_ERROR_NONE)
+	{
+		description = "class " + AllocationSampler::readableClassName(signature);
+		jvmti->Deallocate(reinterpret_cast<unsigned char*>(signature));
+		return description;
+	}
+
+	const jclass klass = env->GetObjectClass(monitor);
+	if (klass != nullptr && jvmti->GetClassSignature(klass, &signature, nullptr) == JVMTI_ERROR_NONE)
+		description = AllocationSampler::readableClassName(signature);
+	jvmti->Deallocate(reinterpret_cast<unsigned char*>(signature));
+	env->DeleteLocalRef(klass);
+
+	jint hash = 0;
+	if (jvmti->GetObjectHashCode(monitor, &hash) == JVMTI_ERROR_NONE)
+	{
+		char buffer[16];
+		description += '@';
+		description.append(buffer, std::to_chars(buffer, buffer + sizeof buffer, static_cast<unsigned int>(hash), 16).ptr);
+	}
+	return description;
+}
+
+MonitorGraph::MonitorState& MonitorGraph::monitorOf(ObjectTags& tags, jobject monitor, jlong& tag)
+{
+	// monitors are described once, the first time a thread is seen owning or waiting for them
+	tag = tags.tag(this->m_jvmti, monitor);
+	const auto [state, inserted] = this->m_monitors.try_emplace(tag);
+	if (inserted)
+	{
+		state->second.description = MonitorGraph::describe(this->m_jvmti, this->m_env, monitor);
+		state->second.owner = NO_THREAD;
+	}
+	return state->second;
+}
+
+std::string MonitorGraph::frameMethod(jthread thread, const jint depth) const
+{
+	// monitors entered by JNI code have no frame
+	if (depth < 0)
+		return "native code";
+
+	jmethodID method;
+	jlocation location;
+	if (this->m_jvmti->GetFrameLocation(thread, depth, &method, &location) != JVMTI_ERROR_NONE)
+		return "<unknown>";
+
+	std::string name = "<unknown>";
+	jclass klass;
+	char* class_signature = nullptr;
+	char* method_name = nullptr;
+	if (this->m_jvmti->GetMethodDeclaringClass(method, &klass) == JVMTI_ERROR_NONE && this->m_jvmti->GetClassSignature(klass, &class_signature, nullptr) == JVMTI_ERROR_NONE
+		&& this->m_jvmti->GetMethodName(method, &method_name, nullptr, nullptr) == JVMTI_ERROR_NONE)
+		name = AllocationSampler::readableClassName(class_signature) + '.' + method_name;
+
+	this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(class_signature));
+	this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(method_name));
+	return name;
+}
+
+bool MonitorGraph::capture(ObjectTags& tags)
+{
+	jint count = 0;
+	jthread* threads = nullptr;
+	if (this->m_jvmti->GetAllThreads(&count, &threads) != JVMTI_ERROR_NONE)
+		return false;
+
+	// the monitor every thread is blocked on, by tag, so the waits-for graph can be followed once every owner is known
+	std::vector<jlong> blocked_on(static_cast<size_t>(count), 0);
+	for (jint i = 0; i < count; i++)
+	{
+		std::string name = "<unknown>";
+		jvmtiThreadInfo info{};
+		if (this->m_jvmti->GetThreadInfo(threads[i], &info) == JVMTI_ERROR_NONE)
+		{
+			if (info.name != nullptr)
+				name = info.name;
+			this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(info.name));
+			this->m_env->DeleteLocalRef(info.thread_group);
+			this->m_env->DeleteLocalRef(info.context_class_loader);
+		}
+
+		jint state = 0;
+		static_cast<void>(this->m_jvmti->GetThreadState(threads[i], &state));
+		this->m_threads.push_back("THREAD\a" + std::to_string(i) + '\a' + name + '\a' + MonitorGraph::stateName(state));
+
+		// a monitor entered again by the same thread is listed once per entry, the first one names where it was acquired
+		jint owned_count = 0;
+		jvmtiMonitorStackDepthInfo* owned = nullptr;
+		if (this->m_jvmti->GetOwnedMonitorStackDepthInfo(threads[i], &owned_count, &owned) == JVMTI_ERROR_NONE)
+		{
+			for (jint j = 0; j < owned_count; j++)
+			{
+				jlong tag;
+				MonitorState& monitor = this->monitorOf(tags, owned[j].monitor, tag);
+				if (monitor.owner != i)
+				{
+					monitor.owner = i;
+					monitor.acquiredIn = this->frameMethod(threads[i], owned[j].stack_depth);
+					this->m_owned++;
+				}
+				this->m_env->DeleteLocalRef(owned[j].monitor);
+			}
+			this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(owned));
+		}
+
+		// a thread in Object.wait() has released the monitor it waits on, only a blocked thread waits for the owner
+		jobject contended = nullptr;
+		if (this->m_jvmti->GetCurrentContendedMonitor(threads[i], &contended) != JVMTI_ERROR_NONE || contended == nullptr)
+			continue;
+
+		jlong tag;
+		MonitorState& monitor = this->monitorOf(tags, contended, tag);
+		if (state & JVMTI_THREAD_STATE_BLOCKED_ON_MONITOR_ENTER)
+		{
+			monitor.blocked.push_back(i);
+			blocked_on[i] = tag;
+			this->m_blocked++;
+		}
+		else
+			monitor.waiting.push_back(i);
+		this->m_env->DeleteLocalRef(contended);
+	}
+
+	this->findDeadlocks(tags, threads, blocked_on);
+
+	for (jint i = 0; i < count; i++)
+		this->m_env->DeleteLocalRef(threads[i]);
+	this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(threads));
+	return true;
+}
+
+void MonitorGraph::findDeadlocks(ObjectTags& tags, const jthread* threads, const std::vector<jlong>& blockedOn)
+{
+	// the thread a blocked thread waits for is the owner of its monitor
+	const auto next = [this, &blockedOn](const jint thread)
+	{
+		const auto monitor = blockedOn[thread] != 0 ? this->m_monitors.find(blockedOn[thread]) : this->m_monitors.end();
+		return monitor != this->m_monitors.end() ? monitor->second.owner : NO_THREAD;
+	};
+
+	// a cycle only counts if all of its threads are still blocked on the same monitors
+	const auto confirmed = [this, &tags, threads, &blockedOn](const std::vector<jint>& cycle)
+	{
+		return std::all_of(cycle.begin(), cycle.end(), [this, &tags, threads, &blockedOn](const jint thread)
+		{
+			jobject contended = nullptr;
+			if (this->m_jvmti->GetCurrentContendedMonitor(threads[thread], &contended) != JVMTI_ERROR_NONE || contended == nullptr)
+				return false;
+			const jlong tag = tags.tag(this->m_jvmti, contended);
+			this->m_env->DeleteLocalRef(contended);
+			return tag == blockedOn[thread];
+		});
+	};
+
+	// 0 not visited yet, 1 on the walk being followed, 2 done; every thread has one edge at most, so a walk either ends
+	// at a thread that is not blocked, joins an earlier walk, or runs into itself and closes a cycle
+	std::vector<char> marks(blockedOn.size(), 0);
+	for (jint start = 0; start < static_cast<jint>(blockedOn.size()); start++)
+	{
+		jint thread = start;
+		while (thread != NO_THREAD && marks[thread] == 0)
+		{
+			marks[thread] = 1;
+			thread = next(thread);
+		}
+
+		if (thread != NO_THREAD && marks[thread] == 1)
+		{
+			std::vector<jint> cycle;
+			jint member = thread;
+			do
+			{
+				cycle.push_back(member);
+				member = next(member);
+			} while (member != thread);
+
+			if (confirmed(cycle))
+				this->m_deadlocks.push_back(std::move(cycle));
+		}
+
+		for (thread = start; thread != NO_THREAD && marks[thread] == 1; thread = next(thread))
+			marks[thread] = 2;
+	}
+}
+
+std::vector<std::string> MonitorGraph::serialize() const
+{
+	const auto join = [](const std::vector<jint>& threads)
+	{
+		std::string joined;
+		for (const jint thread : threads)
+			joined += (joined.empty() ? "" : ",") + std::to_string(thread);
+		return joined;
+	};
+
+	// "THREAD\aindex\aname\astate" for every thread, then
+	// "MONITOR\atag\adescription\aowner\aacquired in\ablocked threads\awaiting threads" and "DEADLOCK\athreads" by thread index
+	std::vector<std::string> lines = this->m_threads;
+	for (const auto& [tag, monitor] : this->m_monitors)
+	{
+		lines.push_back("MONITOR\a" + std::to_string(tag) + '\a' + monitor.description + '\a' + std::to_string(monitor.owner) + '\a' + monitor.acquiredIn
+			+ '\a' + join(monitor.blocked) + '\a' + join(monitor.waiting));
+	}
+	for (const std::vector<jint>& cycle : this->m_deadlocks)
+		lines.push_back("DEADLOCK\a" + join(cycle));
+	return lines;
+}
+
+std::vector<std::string> MonitorGraph::report() const
+{
+	size_t deadlocked = 0;
+	for (const std::vector<jint>& cycle : this->m_deadlocks)
+		deadlocked += cycle.size();
+
+	// every metric is "name\avalue\aunit"
+	return {
+		"Owned Monitors\a" + std::to_string(this->m_owned) + "\acount",
+		"Blocked Threads\a" + std::to_string(this->m_blocked) + "\acount",
+		"Deadlocked Threads\a" + std::to_string(deadlocked) + "\acount"
+	};
+}
+
+long long MonitorContention::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void MonitorContention::contendedEnter()
+{
+	MonitorContention::s_enterNanos = MonitorContention::now();
+}
+
+void MonitorContention::contendedEntered(const jlong tag)
+{
+	// an entry without an enter happens when the events were turned on while the thread was blocked
+	const long long start = MonitorContention::s_enterNanos;
+	if (start == 0)
+		return;
+	MonitorContention::s_enterNanos = 0;
+	const long long nanos = MonitorContention::now() - start;
+
+	// probing starts at a slot picked by the tag, and the first free slot on the way is claimed by swapping the tag in
+	// a tag of 0 marks a free slot, so monitors that could not be tagged go to the overflow slot with those that found no room
+	MonitorSlot* slot = &this->m_overflow;
+	const size_t home = static_cast<size_t>((static_cast<unsigned long long>(tag) * 0x9E3779B97F4A7C15ULL) >> 32);
+	for (size_t probe = 0; tag != 0 && probe < MAX_PROBES; probe++)
+	{
+		MonitorSlot& candidate = this->m_slots[(home + probe) % SLOTS];
+		jlong current = candidate.tag.load(std::memory_order_acquire);
+		if (current == 0 && candidate.tag.compare_exchange_strong(current, tag, std::memory_order_acq_rel))
+			current = tag;
+		if (current == tag)
+		{
+			slot = &candidate;
+			break;
+		}
+	}
+
+	// bucket i holds the waits below 2^i ns
+	const size_t bucket = std::min<size_t>(static_cast<size_t>(std::bit_width(static_cast<unsigned long long>(std::max(nanos, 0LL)))), BUCKETS - 1);
+	slot->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	slot->count.fetch_add(1, std::memory_order_relaxed);
+	slot->sumNanos.fetch_add(nanos, std::memory_order_relaxed);
+
+	long long max = slot->maxNanos.load(std::memory_order_relaxed);
+	while (nanos > max && !slot->maxNanos.compare_exchange_weak(max, nanos, std::memory_order_relaxed));
+}
+
+void MonitorContention::take(MonitorSlot& slot, SlotTotals& totals)
+{
+	// an entry recorded while the counters are taken may be split between two reports, which shifts a single wait at most
+	for (size_t i = 0; i < BUCKETS; i++)
+		totals.buckets[i] = slot.buckets[i].exchange(0, std::memory_order_relaxed);
+	totals.count = slot.count.exchange(0, std::memory_order_relaxed);
+	totals.sumNanos = slot.sumNanos.exchange(0, std::memory_order_relaxed);
+	totals.maxNanos = slot.maxNanos.exchange(0, std::memory_order_relaxed);
+}
+
+long long MonitorContention::percentile(const SlotTotals& totals, const double fraction)
+{
+	// reported as the upper bound of its bucket, at most twice the true value and never above the longest wait
+	const auto target = static_cast<unsigned long long>(std::ceil(fraction * static_cast<double>(totals.count)));
+	unsigned long long seen = 0;
+	size_t bucket = 0;
+	while (bucket < BUCKETS - 1 && (seen += totals.buckets[bucket]) < target)
+		bucket++;
+	return std::min(1LL << bucket, totals.maxNanos);
+}
+
+std::vector<std::string> MonitorContention::report(jvmtiEnv* jvmti, JNIEnv* env, const size_t limit)
+{
+	std::lock_guard lock(this->m_reportMutex);
+
+	// a slot nobody entered since the previous capture is given back, so monitors that are gone do not fill the table
+	// a monitor probing past a freed slot may claim a second one, its slots are summed here
+	std::vector<SlotTotals> monitors;
+	std::unordered_map<jlong, size_t> indices;
+	for (MonitorSlot& slot : this->m_slots)
+	{
+		jlong tag = slot.tag.load(std::memory_order_acquire);
+		if (tag == 0)
+			continue;
+
+		SlotTotals totals{};
+		totals.tag = tag;
+		MonitorContention::take(slot, totals);
+		if (totals.count == 0)
+		{
+			static_cast<void>(slot.tag.compare_exchange_strong(tag, 0, std::memory_order_acq_rel));
+			continue;
+		}
+
+		const auto [index, added] = indices.try_emplace(tag, monitors.size());
+		if (added)
+		{
+			monitors.push_back(totals);
+			continue;
+		}
+		SlotTotals& merged = monitors[index->second];
+		for (size_t i = 0; i < BUCKETS; i++)
+			merged.buckets[i] += totals.buckets[i];
+		merged.count += totals.count;
+		merged.sumNanos += totals.sumNanos;
+		merged.maxNanos = std::max(merged.maxNanos, totals.maxNanos);
+	}
+	SlotTotals overflow{};
+	MonitorContention::take(this->m_overflow, overflow);
+	if (overflow.count > 0)
+		monitors.push_back(overflow);
+
+	// the monitors threads waited for the longest, in total
+	const size_t top = std::min(limit, monitors.size());
+	std::partial_sort(monitors.begin(), monitors.begin() + static_cast<std::ptrdiff_t>(top), monitors.end(), [](const SlotTotals& a, const SlotTotals& b) { return a.sumNanos > b.sumNanos; });
+	monitors.resize(top);
+
+	// only the reported monitors are looked up by their tags, a monitor that has been collected is not found
+	std::vector<jlong> tags;
+	for (const SlotTotals& monitor : monitors)
+	{
+		if (monitor.tag != 0)
+			tags.push_back(monitor.tag);
+	}
+
+	std::unordered_map<jlong, std::string> descriptions;
+	jint found = 0;
+	jobject* objects = nullptr;
+	jlong* found_tags = nullptr;
+	if (!tags.empty() && jvmti->GetObjectsWithTags(static_cast<jint>(tags.size()), tags.data(), &found, &objects, &found_tags) == JVMTI_ERROR_NONE)
+	{
+		for (jint i = 0; i < found; i++)
+		{
+			descriptions[found_tags[i]] = MonitorGraph::describe(jvmti, env, objects[i]);
+			env->DeleteLocalRef(objects[i]);
+		}
+		jvmti->Deallocate(reinterpret_cast<unsigned char*>(objects));
+		jvmti->Deallocate(reinterpret_cast<unsigned char*>(found_tags));
+	}
+
+	// every monitor is "CONTENTION\atag\adescription\aentries\atotal ns\ap50 ns\ap99 ns\amax ns"
+	std::vector<std::string> lines;
+	for (const SlotTotals& monitor : monitors)
+	{
+		const auto description = descriptions.find(monitor.tag);
+		const std::string name = monitor.tag == 0 ? "Other monitors" : description != descriptions.end() ? description->second : "<collected>";
+		lines.push_back("CONTENTION\a" + std::to_string(monitor.tag) + '\a' + name + '\a' + std::to_string(monitor.count) + '\a' + std::to_string(monitor.sumNanos)
+			+ '\a' + std::to_string(MonitorContention::percentile(monitor, 0.50)) + '\a' + std::to_string(MonitorContention::percentile(monitor, 0.99))
+			+ '\a' + std::to_string(monitor.maxNanos));
+	}
+	return lines;
+}
\ No newline at end of file
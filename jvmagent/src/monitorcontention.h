@@ -0,0 +1,106 @@
+#pragma once
+
+#ifndef MONITORCONTENTION_H
+#define MONITORCONTENTION_H
+
+#include "pch.h"
+#include "objecttags.h"
+
+/*
+ * Owned and contended monitors of every thread at the moment of a capture, taken with the "monitors" option.
+ * Monitors are identified by their object tag, so a lock shows up once however many threads own or wait for it, and
+ * a thread blocked on a monitor is an edge to the thread that owns it. Every thread waits for at most one monitor, so
+ * the waits-for graph is followed from each blocked thread until it ends or comes back to itself, which is a deadlock.
+ * The threads are not suspended while they are read, so a cycle is only reported once its threads are still blocked
+ * on the same monitors when they are read a second time, which a real deadlock always is.
+ */
+class MonitorGraph
+{
+	static constexpr jint NO_THREAD = -1;
+
+	typedef struct
+	{
+		std::string description;
+		jint owner;
+		std::string acquiredIn;
+		std::vector<jint> blocked;
+		std::vector<jint> waiting;
+	} MonitorState;
+
+	jvmtiEnv* m_jvmti;
+	JNIEnv* m_env;
+	std::vector<std::string> m_threads;
+	std::map<jlong, MonitorState> m_monitors;
+	std::vector<std::vector<jint>> m_deadlocks;
+	size_t m_blocked = 0;
+	size_t m_owned = 0;
+
+	MonitorState& monitorOf(ObjectTags& tags, jobject monitor, jlong& tag);
+	std::string frameMethod(jthread thread, jint depth) const;
+	void findDeadlocks(ObjectTags& tags, const jthread* threads, const std::vector<jlong>& blockedOn);
+	static const char* stateName(jint state);
+
+public:
+	MonitorGraph(jvmtiEnv* jvmti, JNIEnv* env);
+	~MonitorGraph() = default;
+	bool capture(ObjectTags& tags);
+	std::vector<std::string> serialize() const;
+	std::vector<std::string> report() const;
+	static std::string describe(jvmtiEnv* jvmti, JNIEnv* env, jobject monitor);
+};
+
+/*
+ * Time threads spend blocked on contended monitors, recorded from the MonitorContendedEnter and MonitorContendedEntered
+ * events with the "contention" option. Every monitor gets a slot in a fixed-size open-addressed table, claimed with a
+ * compare-and-swap on its tag. Once the wait is over, an entry tags the monitor through GetTag, and SetTag the first
+ * time the monitor is seen, then takes two clock reads and a few atomic increments on a power-of-two histogram.
+ * Monitors that find no free slot share one. Captures take and reset the counters, give back the slots of monitors that
+ * were not entered since the previous capture, and report the monitors that threads waited for the longest.
+ */
+class MonitorContention
+{
+public:
+	static constexpr size_t DEFAULT_MONITORS = 10;
+
+private:
+	static constexpr size_t SLOTS = 1024;
+	static constexpr size_t MAX_PROBES = 16;
+	static constexpr size_t BUCKETS = 40;
+
+	typedef struct
+	{
+		std::atomic<jlong> tag;
+		std::array<std::atomic<unsigned long long>, BUCKETS> buckets;
+		std::atomic<unsigned long long> count;
+		std::atomic<long long> sumNanos;
+		std::atomic<long long> maxNanos;
+	} MonitorSlot;
+
+	typedef struct
+	{
+		jlong tag;
+		std::array<unsigned long long, BUCKETS> buckets;
+		unsigned long long count;
+		long long sumNanos;
+		long long maxNanos;
+	} SlotTotals;
+
+	static thread_local long long s_enterNanos;
+
+	std::array<MonitorSlot, SLOTS> m_slots{};
+	MonitorSlot m_overflow{};
+	std::mutex m_reportMutex;
+
+	static long long now();
+	static void take(MonitorSlot& slot, SlotTotals& totals);
+	static long long percentile(const SlotTotals& totals, double fraction);
+
+public:
+	MonitorContention() = default;
+	~MonitorContention() = default;
+	void contendedEnter();
+	void contendedEntered(jlong tag);
+	std::vector<std::string> report(jvmtiEnv* jvmti, JNIEnv* env, size_t limit);
+};
+
+#endif // MONITORCONTENTION_H
\ No newline at end of file
@@ -0,0 +1,907 @@
+#include "pch.h"
+#include "objectrenderer.h"
+
+ObjectRenderer::JdkTypes ObjectRenderer::s_types{};
+std::once_flag ObjectRenderer::s_resolveOnce;
+thread_local std::vector<jchar> ObjectRenderer::s_scratch;
+
+ObjectRenderer::ObjectRenderer(jvmtiEnv* jvmti, JNIEnv* env, const AgentOptions& options, CaptureMetrics& metrics)
+	: m_jvmti(jvmti), m_env(env), m_metrics(metrics)
+{
+	// budgets apply to every rendered value, the toString() time limit applies to the whole capture
+	// the time limit is soft: it is checked before each call, and a call that has started is never cut short
+	this->m_maxElements = static_cast<size_t>(std::max(1LL, options.getNumber("maxelements", 100)));
+	this->m_maxBytes = static_cast<size_t>(std::max(16LL, options.getNumber("maxbytes", 4096)));
+	this->m_maxScan = std::max(1LL, options.getNumber("arrayscan", 1000000));
+	this->m_allowToString = options.has("tostring");
+	this->m_toStringBudgetNanos = std::max(0LL, options.getNumber("tostringms", 50)) * 1000000;
+	std::call_once(ObjectRenderer::s_resolveOnce, &ObjectRenderer::resolveJdkTypes, env);
+}
+
+void ObjectRenderer::resolveJdkTypes(JNIEnv* env)
+{
+	JdkTypes& types = ObjectRenderer::s_types;
+
+	// JDK classes are never unloaded, so global references and field IDs stay valid for the life of the JVM
+	const auto global_class = [env](const char* name) -> jclass
+	{
+		const jclass local = env->FindClass(name);
+		if (local == nullptr)
+		{
+			env->ExceptionClear();
+			return nullptr;
+		}
+
+		const auto global = reinterpret_cast<jclass>(env->NewGlobalRef(local));
+		env->DeleteLocalRef(local);
+		return global;
+	};
+
+	// fields missing from a particular JDK release simply disable the renderer for that type
+	const auto field = [env](jclass klass, const char* name, const char* signature) -> jfieldID
+	{
+		if (klass == nullptr)
+			return nullptr;
+
+		const jfieldID id = env->GetFieldID(klass, name, signature);
+		if (id == nullptr)
+			env->ExceptionClear();
+		return id;
+	};
+
+	const auto nested_field = [env, &field](const char* klass, const char* name, const char* signature) -> jfieldID
+	{
+		const jclass local = env->FindClass(klass);
+		if (local == nullptr)
+		{
+			env->ExceptionClear();
+			return nullptr;
+		}
+
+		const jfieldID id = field(local, name, signature);
+		env->DeleteLocalRef(local);
+		return id;
+	};
+
+	types.objectClass = global_class("java/lang/Object");
+	types.stringClass = global_class("java/lang/String");
+	types.collectionClass = global_class("java/util/Collection");
+	types.mapClass = global_class("java/util/Map");
+	if (types.objectClass == nullptr || types.stringClass == nullptr || types.collectionClass == nullptr || types.mapClass == nullptr)
+		return;
+
+	types.toStringMethod = env->GetMethodID(types.objectClass, "toString", "()Ljava/lang/String;");
+
+	types.integerClass = global_class("java/lang/Integer");
+	types.longClass = global_class("java/lang/Long");
+	types.shortClass = global_class("java/lang/Short");
+	types.byteClass = global_class("java/lang/Byte");
+	types.doubleClass = global_class("java/lang/Double");
+	types.floatClass = global_class("java/lang/Float");
+	types.characterClass = global_class("java/lang/Character");
+	types.booleanClass = global_class("java/lang/Boolean");
+	types.integerValue = field(types.integerClass, "value", "I");
+	types.longValue = field(types.longClass, "value", "J");
+	types.shortValue = field(types.shortClass, "value", "S");
+	types.byteValue = field(types.byteClass, "value", "B");
+	types.doubleValue = field(types.doubleClass, "value", "D");
+	types.floatValue = field(types.floatClass, "value", "F");
+	types.characterValue = field(types.characterClass, "value", "C");
+	types.booleanValue = field(types.booleanClass, "value", "Z");
+
+	types.atomicIntegerClass = global_class("java/util/concurrent/atomic/AtomicInteger");
+	types.atomicLongClass = global_class("java/util/concurrent/atomic/AtomicLong");
+	types.atomicBooleanClass = global_class("java/util/concurrent/atomic/AtomicBoolean");
+	types.atomicIntegerValue = field(types.atomicIntegerClass, "value", "I");
+	types.atomicLongValue = field(types.atomicLongClass, "value", "J");
+	types.atomicBooleanValue = field(types.atomicBooleanClass, "value", "I");
+
+	types.arrayListClass = global_class("java/util/ArrayList");
+	types.arrayListElementData = field(types.arrayListClass, "elementData", "[Ljava/lang/Object;");
+	types.arrayListSize = field(types.arrayListClass, "size", "I");
+
+	types.linkedListClass = global_class("java/util/LinkedList");
+	types.linkedListFirst = field(types.linkedListClass, "first", "Ljava/util/LinkedList$Node;");
+	types.linkedListNodeItem = nested_field("java/util/LinkedList$Node", "item", "Ljava/lang/Object;");
+	types.linkedListNodeNext = nested_field("java/util/LinkedList$Node", "next", "Ljava/util/LinkedList$Node;");
+
+	types.arrayDequeClass = global_class("java/util/ArrayDeque");
+	types.arrayDequeElements = field(types.arrayDequeClass, "elements", "[Ljava/lang/Object;");
+	types.arrayDequeHead = field(types.arrayDequeClass, "head", "I");
+	types.arrayDequeTail = field(types.arrayDequeClass, "tail", "I");
+
+	types.hashMapClass = global_class("java/util/HashMap");
+	types.hashMapTable = field(types.hashMapClass, "table", "[Ljava/util/HashMap$Node;");
+	types.hashMapNodeKey = nested_field("java/util/HashMap$Node", "key", "Ljava/lang/Object;");
+	types.hashMapNodeValue = nested_field("java/util/HashMap$Node", "value", "Ljava/lang/Object;");
+	types.hashMapNodeNext = nested_field("java/util/HashMap$Node", "next", "Ljava/util/HashMap$Node;");
+
+	types.linkedHashMapClass = global_class("java/util/LinkedHashMap");
+	types.linkedHashMapHead = field(types.linkedHashMapClass, "head", "Ljava/util/LinkedHashMap$Entry;");
+	types.linkedHashMapEntryAfter = nested_field("java/util/LinkedHashMap$Entry", "after", "Ljava/util/LinkedHashMap$Entry;");
+
+	types.hashSetClass = global_class("java/util/HashSet");
+	types.hashSetMap = field(types.hashSetClass, "map", "Ljava/util/HashMap;");
+
+	types.treeMapClass = global_class("java/util/TreeMap");
+	types.treeMapRoot = field(types.treeMapClass, "root", "Ljava/util/TreeMap$Entry;");
+	types.treeMapEntryKey = nested_field("java/util/TreeMap$Entry", "key", "Ljava/lang/Object;");
+	types.treeMapEntryValue = nested_field("java/util/TreeMap$Entry", "value", "Ljava/lang/Object;");
+	types.treeMapEntryLeft = nested_field("java/util/TreeMap$Entry", "left", "Ljava/util/TreeMap$Entry;");
+	types.treeMapEntryRight = nested_field("java/util/TreeMap$Entry", "right", "Ljava/util/TreeMap$Entry;");
+	types.treeMapEntryParent = nested_field("java/util/TreeMap$Entry", "parent", "Ljava/util/TreeMap$Entry;");
+
+	types.resolved = true;
+}
+
+std::string ObjectRenderer::render(jobject obj)
+{
+	std::string out;
+	if (obj == nullptr)
+		return "null";
+
+	if (!this->renderNative(obj, out, 0) && !this->renderToString(obj, out))
+		this->renderIdentity(obj, out);
+
+	// cut at the byte budget without splitting a multi-byte UTF-8 sequence
+	if (out.size() > this->m_maxBytes)
+	{
+		size_t cut = this->m_maxBytes;
+		while (cut > 0 && (static_cast<unsigned char>(out[cut]) & 0xC0) == 0x80)
+			cut--;
+		out.resize(cut);
+		out += "...";
+	}
+
+	return out;
+}
+
+bool ObjectRenderer::renderNative(jobject obj, std::string& out, const int depth)
+{
+	const JdkTypes& types = ObjectRenderer::s_types;
+	JNIEnv* env = this->m_env;
+	if (!types.resolved)
+		return false;
+
+	this->m_metrics.count(CaptureCounter::JNICalls);
+	if (env->IsInstanceOf(obj, types.stringClass))
+	{
+		this->appendString(reinterpret_cast<jstring>(obj), out);
+		return true;
+	}
+
+	// boxed primitives and atomics print their value exactly like their toString() would
+	if (types.integerValue != nullptr && env->IsInstanceOf(obj, types.integerClass))
+		out += std::to_string(env->GetIntField(obj, types.integerValue));
+	else if (types.longValue != nullptr && env->IsInstanceOf(obj, types.longClass))
+		out += std::to_string(env->GetLongField(obj, types.longValue));
+	else if (types.doubleValue != nullptr && env->IsInstanceOf(obj, types.doubleClass))
+		ObjectRenderer::appendFloatingPoint(out, env->GetDoubleField(obj, types.doubleValue));
+	else if (types.floatValue != nullptr && env->IsInstanceOf(obj, types.floatClass))
+		ObjectRenderer::appendFloatingPoint(out, env->GetFloatField(obj, types.floatValue));
+	else if (types.booleanValue != nullptr && env->IsInstanceOf(obj, types.booleanClass))
+		out += env->GetBooleanField(obj, types.booleanValue) ? "true" : "false";
+	else if (types.shortValue != nullptr && env->IsInstanceOf(obj, types.shortClass))
+		out += std::to_string(env->GetShortField(obj, types.shortValue));
+	else if (types.byteValue != nullptr && env->IsInstanceOf(obj, types.byteClass))
+		out += std::to_string(env->GetByteField(obj, types.byteValue));
+	else if (types.characterValue != nullptr && env->IsInstanceOf(obj, types.characterClass))
+	{
+		const jchar ch = env->GetCharField(obj, types.characterValue);
+		char encoded[6];
+		out.append(encoded, ObjectRenderer::encodeEscaped(&ch, 1, encoded, encoded + sizeof encoded));
+	}
+	else if (types.atomicIntegerValue != nullptr && env->IsInstanceOf(obj, types.atomicIntegerClass))
+		out += std::to_string(env->GetIntField(obj, types.atomicIntegerValue));
+	else if (types.atomicLongValue != nullptr && env->IsInstanceOf(obj, types.atomicLongClass))
+		out += std::to_string(env->GetLongField(obj, types.atomicLongValue));
+	else if (types.atomicBooleanValue != nullptr && env->IsInstanceOf(obj, types.atomicBooleanClass))
+		out += env->GetIntField(obj, types.atomicBooleanValue) != 0 ? "true" : "false";
+	else if (types.arrayListElementData != nullptr && types.arrayListSize != nullptr && env->IsInstanceOf(obj, types.arrayListClass))
+	{
+		auto elements = reinterpret_cast<jobjectArray>(env->GetObjectField(obj, types.arrayListElementData));
+		const jint size = env->GetIntField(obj, types.arrayListSize);
+		out += '[';
+		if (elements != nullptr)
+			this->renderSequence(elements, 0, size, env->GetArrayLength(elements), out, depth);
+		out += ']';
+		env->DeleteLocalRef(elements);
+	}
+	else if (types.arrayDequeElements != nullptr && types.arrayDequeHead != nullptr && types.arrayDequeTail != nullptr && env->IsInstanceOf(obj, types.arrayDequeClass))
+	{
+		// the deque is a circular buffer that runs from head up to (but excluding) tail
+		auto elements = reinterpret_cast<jobjectArray>(env->GetObjectField(obj, types.arrayDequeElements));
+		const jint head = env->GetIntField(obj, types.arrayDequeHead);
+		const jint tail = env->GetIntField(obj, types.arrayDequeTail);
+		out += '[';
+		if (elements != nullptr)
+		{
+			const jint capacity = env->GetArrayLength(elements);
+			if (capacity > 0)
+				this->renderSequence(elements, head, ((tail - head) % capacity + capacity) % capacity, capacity, out, depth);
+		}
+		out += ']';
+		env->DeleteLocalRef(elements);
+	}
+	else if (types.linkedListFirst != nullptr && types.linkedListNodeItem != nullptr && types.linkedListNodeNext != nullptr && env->IsInstanceOf(obj, types.linkedListClass))
+	{
+		jobject node = env->GetObjectField(obj, types.linkedListFirst);
+		size_t rendered = 0;
+		out += '[';
+
+		while (node != nullptr)
+		{
+			if (rendered > 0)
+				out += ", ";
+
+			if (rendered == this->m_maxElements || this->overBudget(out))
+			{
+				out += "...";
+				env->DeleteLocalRef(node);
+				break;
+			}
+
+			jobject item = env->GetObjectField(node, types.linkedListNodeItem);
+			this->renderElement(item, out, depth);
+			env->DeleteLocalRef(item);
+
+			jobject next = env->GetObjectField(node, types.linkedListNodeNext);
+			env->DeleteLocalRef(node);
+			node = next;
+			rendered++;
+		}
+
+		out += ']';
+		this->m_metrics.count(CaptureCounter::JNICalls, static_cast<long long>(rendered) * 2);
+	}
+	else if (types.linkedHashMapClass != nullptr && env->IsInstanceOf(obj, types.linkedHashMapClass))
+		this->renderHashMap(obj, out, depth, false);
+	else if (types.hashMapClass != nullptr && env->IsInstanceOf(obj, types.hashMapClass))
+		this->renderHashMap(obj, out, depth, false);
+	else if (types.hashSetMap != nullptr && env->IsInstanceOf(obj, types.hashSetClass))
+	{
+		jobject map = env->GetObjectField(obj, types.hashSetMap);
+		if (map != nullptr)
+			this->renderHashMap(map, out, depth, true);
+		else
+			out += "[]";
+		env->DeleteLocalRef(map);
+	}
+	else if (types.treeMapClass != nullptr && env->IsInstanceOf(obj, types.treeMapClass))
+		this->renderTreeMap(obj, out, depth);
+	else
+		return false;
+
+	this->m_metrics.count(CaptureCounter::JNICalls, 3);
+	return true;
+}
+
+void ObjectRenderer::renderElement(jobject element, std::string& out, const int depth)
+{
+	if (element == nullptr)
+		out += "null";
+	else if (depth + 1 >= ObjectRenderer::MAX_DEPTH)
+		this->renderIdentity(element, out);
+	else if (!this->renderNative(element, out, depth + 1) && !this->renderToString(element, out))
+		this->renderIdentity(element, out);
+}
+
+void ObjectRenderer::renderSequence(jobjectArray elements, const jint begin, const jint end, const jint capacity, std::string& out, const int depth)
+{
+	// 'end' is the number of elements, read starting at 'begin' and wrapping around 'capacity'
+	for (jint i = 0; i < end; i++)
+	{
+		if (i > 0)
+			out += ", ";
+
+		if (static_cast<size_t>(i) == this->m_maxElements || this->overBudget(out))
+		{
+			out += "... " + std::to_string(end - i) + " more";
+			break;
+		}
+
+		jobject element = this->m_env->GetObjectArrayElement(elements, (begin + i) % capacity);
+		this->renderElement(element, out, depth);
+		this->m_env->DeleteLocalRef(element);
+		this->m_metrics.count(CaptureCounter::JNICalls);
+	}
+}
+
+void ObjectRenderer::renderHashMap(jobject map, std::string& out, const int depth, const bool keysOnly)
+{
+	const JdkTypes& types = ObjectRenderer::s_types;
+	JNIEnv* env = this->m_env;
+	size_t rendered = 0;
+	bool truncated = false;
+	out += keysOnly ? '[' : '{';
+
+	const auto render_entry = [&](jobject node) -> bool
+	{
+		if (rendered > 0)
+			out += ", ";
+
+		if (rendered == this->m_maxElements || this->overBudget(out))
+		{
+			out += "...";
+			return false;
+		}
+
+		jobject key = env->GetObjectField(node, types.hashMapNodeKey);
+		this->renderElement(key, out, depth);
+		env->DeleteLocalRef(key);
+
+		if (!keysOnly)
+		{
+			jobject value = env->GetObjectField(node, types.hashMapNodeValue);
+			out += '=';
+			this->renderElement(value, out, depth);
+			env->DeleteLocalRef(value);
+		}
+
+		rendered++;
+		return true;
+	};
+
+	// linked maps iterate in insertion order through their doubly linked entry list
+	if (types.linkedHashMapHead != nullptr && types.linkedHashMapEntryAfter != nullptr && env->IsInstanceOf(map, types.linkedHashMapClass))
+	{
+		jobject entry = env->GetObjectField(map, types.linkedHashMapHead);
+		while (entry != nullptr && !truncated)
+		{
+			truncated = !render_entry(entry);
+			jobject next = env->GetObjectField(entry, types.linkedHashMapEntryAfter);
+			env->DeleteLocalRef(entry);
+			entry = next;
+		}
+		env->DeleteLocalRef(entry);
+	}
+	else if (types.hashMapTable != nullptr && types.hashMapNodeKey != nullptr && types.hashMapNodeValue != nullptr && types.hashMapNodeNext != nullptr)
+	{
+		// plain hash maps iterate bucket by bucket, following each bucket's collision chain
+		auto table = reinterpret_cast<jobjectArray>(env->GetObjectField(map, types.hashMapTable));
+		const jint capacity = table == nullptr ? 0 : env->GetArrayLength(table);
+
+		for (jint i = 0; i < capacity && !truncated; i++)
+		{
+			jobject node = env->GetObjectArrayElement(table, i);
+			while (node != nullptr && !truncated)
+			{
+				truncated = !render_entry(node);
+				jobject next = env->GetObjectField(node, types.hashMapNodeNext);
+				env->DeleteLocalRef(node);
+				node = next;
+			}
+			env->DeleteLocalRef(node);
+		}
+
+		env->DeleteLocalRef(table);
+		this->m_metrics.count(CaptureCounter::JNICalls, capacity);
+	}
+
+	out += keysOnly ? ']' : '}';
+	this->m_metrics.count(CaptureCounter::JNICalls, static_cast<long long>(rendered) * 3);
+}
+
+void ObjectRenderer::renderTreeMap(jobject map, std::string& out, const int depth)
+{
+	const JdkTypes& types = ObjectRenderer::s_types;
+	JNIEnv* env = this->m_env;
+	out += '{';
+
+	if (types.treeMapRoot == nullptr || types.treeMapEntryKey == nullptr || types.treeMapEntryValue == nullptr || types.treeMapEntryLeft == nullptr || types.treeMapEntryRight == nullptr || types.treeMapEntryParent == nullptr)
+	{
+		out += '}';
+		return;
+	}
+
+	// descend to the leftmost entry, which holds the smallest key
+	const auto leftmost = [&](jobject entry) -> jobject
+	{
+		jobject left = env->GetObjectField(entry, types.treeMapEntryLeft);
+		while (left != nullptr)
+		{
+			env->DeleteLocalRef(entry);
+			entry = left;
+			left = env->GetObjectField(entry, types.treeMapEntryLeft);
+		}
+		return entry;
+	};
+
+	jobject entry = env->GetObjectField(map, types.treeMapRoot);
+	if (entry != nullptr)
+		entry = leftmost(entry);
+
+	size_t rendered = 0;
+	while (entry != nullptr)
+	{
+		if (rendered > 0)
+			out += ", ";
+
+		if (rendered == this->m_maxElements || this->overBudget(out))
+		{
+			out += "...";
+			env->DeleteLocalRef(entry);
+			break;
+		}
+
+		jobject key = env->GetObjectField(entry, types.treeMapEntryKey);
+		jobject value = env->GetObjectField(entry, types.treeMapEntryValue);
+		this->renderElement(key, out, depth);
+		out += '=';
+		this->renderElement(value, out, depth);
+		env->DeleteLocalRef(key);
+		env->DeleteLocalRef(value);
+		rendered++;
+
+		// in-order successor: leftmost entry of the right subtree, otherwise the first ancestor reached from the left
+		jobject right = env->GetObjectField(entry, types.treeMapEntryRight);
+		if (right != nullptr)
+		{
+			env->DeleteLocalRef(entry);
+			entry = leftmost(right);
+			continue;
+		}
+
+		jobject parent = env->GetObjectField(entry, types.treeMapEntryParent);
+		while (parent != nullptr)
+		{
+			jobject parent_right = env->GetObjectField(parent, types.treeMapEntryRight);
+			const bool from_right = env->IsSameObject(entry, parent_right);
+			env->DeleteLocalRef(parent_right);
+			if (!from_right)
+				break;
+
+			env->DeleteLocalRef(entry);
+			entry = parent;
+			parent = env->GetObjectField(entry, types.treeMapEntryParent);
+		}
+
+		env->DeleteLocalRef(entry);
+		entry = parent;
+	}
+
+	out += '}';
+	this->m_metrics.count(CaptureCounter::JNICalls, static_cast<long long>(rendered) * 5);
+}
+
+bool ObjectRenderer::renderToString(jobject obj, std::string& out)
+{
+	const JdkTypes& types = ObjectRenderer::s_types;
+	JNIEnv* env = this->m_env;
+	if (!types.resolved || this->m_nativeOnly || this->m_toStringBudgetNanos <= 0)
+		return false;
+
+	// user classes only run their toString() if the user asked for it
+	bool trusted = false;
+	const jclass klass = env->GetObjectClass(obj);
+	jobject loader = nullptr;
+	char* class_signature = nullptr;
+
+	if (this->m_jvmti->GetClassLoader(klass, &loader) == JVMTI_ERROR_NONE && loader == nullptr && this->m_jvmti->GetClassSignature(klass, &class_signature, nullptr) == JVMTI_ERROR_NONE)
+	{
+		// value types of the JDK are safe to print since their toString() never calls back into user code, the README lists this exception
+		// URL is left out, its toString() goes through a stream handler that the application may have installed
+		const std::string_view signature(class_signature);
+		for (const std::string_view prefix : { "Ljava/lang/", "Ljava/math/", "Ljava/time/", "Ljava/net/URI;", "Ljava/net/Inet", "Ljava/nio/", "Ljava/io/File;", "Ljava/util/UUID;", "Ljava/util/Date;", "Ljava/util/Locale;" })
+			trusted |= signature.starts_with(prefix);
+
+		trusted = trusted && !env->IsInstanceOf(obj, types.collectionClass) && !env->IsInstanceOf(obj, types.mapClass);
+		this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(class_signature));
+	}
+
+	env->DeleteLocalRef(loader);
+	env->DeleteLocalRef(klass);
+	this->m_metrics.count(CaptureCounter::JNICalls, 4);
+	if (!trusted && !this->m_allowToString)
+		return false;
+
+	// the time limit is shared by every toString() call of the capture, the JVM offers no way to stop one that runs long
+	const auto start = std::chrono::steady_clock::now();
+	auto jstr = reinterpret_cast<jstring>(env->CallObjectMethod(obj, types.toStringMethod));
+	this->m_toStringBudgetNanos -= std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	this->m_metrics.count(CaptureCounter::ObjectsStringified);
+	this->m_metrics.count(CaptureCounter::JNICalls);
+
+	// a throwing toString() must not leave an exception pending on the application thread
+	if (env->ExceptionCheck())
+	{
+		env->ExceptionClear();
+		return false;
+	}
+
+	if (jstr == nullptr)
+	{
+		out += "null";
+		return true;
+	}
+
+	this->appendString(jstr, out);
+	env->DeleteLocalRef(jstr);
+	this->m_metrics.count(CaptureCounter::JNICalls);
+	return true;
+}
+
+void ObjectRenderer::renderIdentity(jobject obj, std::string& out)
+{
+	// same format as Object::toString: binary class name, '@' and the identity hash in hex
+	const jclass klass = this->m_env->GetObjectClass(obj);
+	jint hash = 0;
+	out += this->className(klass);
+
+	static_cast<void>(this->m_jvmti->GetObjectHashCode(obj, &hash));
+	std::stringstream stream;
+	stream << std::hex << static_cast<unsigned>(hash);
+	out += '@' + stream.str();
+
+	this->m_env->DeleteLocalRef(klass);
+	this->m_metrics.count(CaptureCounter::JNICalls, 3);
+}
+
+std::string ObjectRenderer::className(jclass klass)
+{
+	// binary name as returned by Class::getName, e.g. "java.lang.String" or "[I"
+	char* class_signature = nullptr;
+	if (this->m_jvmti->GetClassSignature(klass, &class_signature, nullptr) != JVMTI_ERROR_NONE)
+		return "?";
+
+	std::string name(class_signature);
+	if (name.front() == 'L')
+		name = name.substr(1, name.size() - 2);
+	std::ranges::replace(name, '/', '.');
+	this->m_jvmti->Deallocate(reinterpret_cast<unsigned char*>(class_signature));
+	return name;
+}
+
+std::string ObjectRenderer::summarizeArray(jobjectArray array)
+{
+	JNIEnv* env = this->m_env;
+	const jsize length = env->GetArrayLength(array);
+
+	// arrays longer than the scan limit are summarized from evenly strided elements and the counts are scaled up
+	const long long stride = std::max(1LL, (length + this->m_maxScan - 1) / this->m_maxScan);
+	std::vector<std::pair<jclass, long long>> classes;
+	long long nulls = 0, other = 0, scanned = 0;
+	size_t last = 0;
+
+	// a single pass of plain JNI reads, local references are released a chunk at a time
+	for (long long base = 0; base < length; base += ObjectRenderer::SCAN_CHUNK * stride)
+	{
+		if (env->PushLocalFrame(ObjectRenderer::SCAN_CHUNK * 2) != JNI_OK)
+		{
+			env->ExceptionClear();
+			break;
+		}
+
+		for (long long i = base; i < length && i < base + ObjectRenderer::SCAN_CHUNK * stride; i += stride)
+		{
+			jobject element = env->GetObjectArrayElement(array, static_cast<jsize>(i));
+			scanned++;
+			if (element == nullptr)
+			{
+				nulls++;
+				continue;
+			}
+
+			// neighbouring elements usually share a class, so the previous match is tried first
+			const jclass klass = env->GetObjectClass(element);
+			if (last < classes.size() && env->IsSameObject(klass, classes[last].first))
+			{
+				classes[last].second++;
+				continue;
+			}
+
+			last = 0;
+			while (last < classes.size() && !env->IsSameObject(klass, classes[last].first))
+				last++;
+
+			if (last < classes.size())
+				classes[last].second++;
+			else if (classes.size() < ObjectRenderer::SUMMARY_CLASSES)
+				classes.emplace_back(reinterpret_cast<jclass>(env->NewGlobalRef(klass)), 1);
+			else
+				other++;
+		}
+
+		env->PopLocalFrame(nullptr);
+	}
+
+	this->m_metrics.count(CaptureCounter::JNICalls, scanned * 3 + (scanned / ObjectRenderer::SCAN_CHUNK + 1) * 2);
+
+	// the summary is written as lines separated by the payload delimiter, which element values can never contain
+	const std::string approximate = stride > 1 ? "~" : "";
+	std::string out = "{ length: " + std::to_string(length) + ", null: " + approximate + std::to_string(nulls * stride);
+	if (stride > 1)
+		out += ", scanned every " + std::to_string(stride) + " elements";
+	out += " }";
+
+	std::ranges::sort(classes, [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+	for (const auto& [klass, count] : classes)
+	{
+		out += '\a' + this->className(klass) + ": " + approximate + std::to_string(count * stride);
+		env->DeleteGlobalRef(klass);
+	}
+
+	if (other > 0)
+		out += "\aother classes: " + approximate + std::to_string(other * stride);
+
+	// head, tail and evenly strided samples, rendered without calling into Java
+	std::vector<long long> samples;
+	for (long long i = 0; i < ObjectRenderer::SUMMARY_HEAD; i++)
+		samples.push_back(i);
+	for (long long i = 1; i <= ObjectRenderer::SUMMARY_STRIDED; i++)
+		samples.push_back(length * i / (ObjectRenderer::SUMMARY_STRIDED + 1));
+	for (long long i = length - ObjectRenderer::SUMMARY_TAIL; i < length; i++)
+		samples.push_back(i);
+
+	std::ranges::sort(samples);
+	const auto [first, end] = std::ranges::unique(samples);
+	samples.erase(first, end);
+
+	long long previous = -1;
+	this->m_nativeOnly = true;
+	for (const long long index : samples)
+	{
+		if (index < 0 || index >= length)
+			continue;
+
+		if (index != previous + 1)
+			out += "\a...";
+		previous = index;
+
+		std::string value;
+		jobject element = env->GetObjectArrayElement(array, static_cast<jsize>(index));
+		if (element == nullptr)
+			value = "null";
+		else if (!this->renderNative(element, value, 0))
+			this->renderIdentity(element, value);
+
+		out += "\a[" + std::to_string(index) + "] " + value;
+		env->DeleteLocalRef(element);
+		this->m_metrics.count(CaptureCounter::JNICalls, 2);
+	}
+
+	this->m_nativeOnly = false;
+	if (previous != length - 1)
+		out += "\a...";
+
+	return out;
+}
+
+std::string ObjectRenderer::renderPrimitive(const jvalue value, const char type)
+{
+	// 'type' is the JVM signature of the primitive, e.g. 'I' for int
+	std::string out;
+	switch (type)
+	{
+	case 'Z':
+		return value.z ? "true" : "false";
+	case 'B':
+		return std::to_string(value.b);
+	case 'C':
+	{
+		char encoded[6];
+		out += '\'';
+		out.append(encoded, ObjectRenderer::encodeEscaped(&value.c, 1, encoded, encoded + sizeof encoded));
+		return out + '\'';
+	}
+	case 'S':
+		return std::to_string(value.s);
+	case 'I':
+		return std::to_string(value.i);
+	case 'J':
+		return std::to_string(value.j);
+	case 'F':
+		ObjectRenderer::appendFloatingPoint(out, value.f);
+		return out;
+	case 'D':
+		ObjectRenderer::appendFloatingPoint(out, value.d);
+		return out;
+	default:
+		return "?";
+	}
+}
+
+bool ObjectRenderer::overBudget(const std::string& out) const
+{
+	return out.size() >= this->m_maxBytes;
+}
+
+void ObjectRenderer::appendString(jstring str, std::string& out)
+{
+	JNIEnv* env = this->m_env;
+	if (this->overBudget(out))
+		return;
+
+	// every UTF-16 unit produces at least one byte, so nothing past the byte budget is ever read
+	const auto start = std::chrono::steady_clock::now();
+	const size_t budget = this->m_maxBytes - out.size();
+	const jsize length = env->GetStringLength(str);
+	const auto count = static_cast<jsize>(std::min<size_t>(length, budget));
+	const size_t offset = out.size();
+	size_t written = 0;
+
+	// an escape sequence is the longest output of a single unit, so six bytes per unit can never overflow
+	out.resize(offset + std::min<size_t>(budget, static_cast<size_t>(count) * 6));
+	char* const dst = out.data() + offset;
+	char* const limit = out.data() + out.size();
+
+	if (count <= ObjectRenderer::SCRATCH_UNITS)
+	{
+		// short prefixes are copied into a scratch buffer that is reused by every capture on this thread
+		std::vector<jchar>& scratch = ObjectRenderer::s_scratch;
+		if (scratch.size() < static_cast<size_t>(count))
+			scratch.resize(count);
+
+		env->GetStringRegion(str, 0, count, scratch.data());
+		const bool split_pair = count < length && count > 0 && scratch[count - 1] >= 0xD800 && scratch[count - 1] <= 0xDBFF;
+		written = ObjectRenderer::encodeEscaped(scratch.data(), count - (split_pair ? 1 : 0), dst, limit);
+	}
+	else
+	{
+		// large budgets read the string in place, no other JNI function may be called until it is released
+		const jchar* chars = env->GetStringCritical(str, nullptr);
+		if (chars != nullptr)
+		{
+			const bool split_pair = count < length && chars[count - 1] >= 0xD800 && chars[count - 1] <= 0xDBFF;
+			written = ObjectRenderer::encodeEscaped(chars, count - (split_pair ? 1 : 0), dst, limit);
+			env->ReleaseStringCritical(str, chars);
+		}
+	}
+
+	out.resize(offset + written);
+	this->m_metrics.count(CaptureCounter::JNICalls, 2);
+	this->m_metrics.count(CaptureCounter::StringBytes, static_cast<long long>(count) * 2);
+	this->m_metrics.count(CaptureCounter::StringNanos, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+size_t ObjectRenderer::encodeEscaped(const jchar* src, const size_t length, char* dst, const char* limit)
+{
+	// converts UTF-16 to UTF-8 and escapes control characters so a value never breaks a line or the '\a' delimiter
+	static constexpr char HEX[] = "0123456789abcdef";
+	char* const begin = dst;
+	size_t i = 0;
+
+	while (i < length)
+	{
+#ifdef MEMDBGVIS_SSE2
+		// fast path: copy eight printable ASCII units at once by narrowing them to bytes
+		if (i + 8 <= length && limit - dst >= 8)
+		{
+			const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			const __m128i printable = _mm_and_si128(_mm_cmpgt_epi16(units, _mm_set1_epi16(0x1F)), _mm_cmplt_epi16(units, _mm_set1_epi16(0x7F)));
+			if (_mm_movemask_epi8(printable) == 0xFFFF)
+			{
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(units, units));
+				dst += 8;
+				i += 8;
+				continue;
+			}
+		}
+#endif
+
+		const jchar unit = src[i];
+		char sequence[6];
+		size_t size = 0, consumed = 1;
+
+		if (unit >= 0x20 && unit < 0x7F)
+			sequence[size++] = static_cast<char>(unit);
+		else if (unit < 0x20 || unit == 0x7F)
+		{
+			sequence[size++] = '\\';
+			switch (unit)
+			{
+			case '\a': sequence[size++] = 'a'; break;
+			case '\b': sequence[size++] = 'b'; break;
+			case '\t': sequence[size++] = 't'; break;
+			case '\n': sequence[size++] = 'n'; break;
+			case '\v': sequence[size++] = 'v'; break;
+			case '\f': sequence[size++] = 'f'; break;
+			case '\r': sequence[size++] = 'r'; break;
+			default:
+				sequence[size++] = 'u';
+				sequence[size++] = '0';
+				sequence[size++] = '0';
+				sequence[size++] = HEX[unit >> 4];
+				sequence[size++] = HEX[unit & 0xF];
+				break;
+			}
+		}
+		else if (unit < 0x800)
+		{
+			sequence[size++] = static_cast<char>(0xC0 | unit >> 6);
+			sequence[size++] = static_cast<char>(0x80 | (unit & 0x3F));
+		}
+		else if (unit >= 0xD800 && unit <= 0xDBFF && i + 1 < length && src[i + 1] >= 0xDC00 && src[i + 1] <= 0xDFFF)
+		{
+			// surrogate pairs combine into a single supplementary code point
+			const char32_t code_point = 0x10000 + ((unit - 0xD800) << 10) + (src[i + 1] - 0xDC00);
+			sequence[size++] = static_cast<char>(0xF0 | code_point >> 18);
+			sequence[size++] = static_cast<char>(0x80 | (code_point >> 12 & 0x3F));
+			sequence[size++] = static_cast<char>(0x80 | (code_point >> 6 & 0x3F));
+			sequence[size++] = static_cast<char>(0x80 | (code_point & 0x3F));
+			consumed = 2;
+		}
+		else
+		{
+			// unpaired surrogates are not valid UTF-8 and become the replacement character
+			const char32_t code_point = unit >= 0xD800 && unit <= 0xDFFF ? 0xFFFD : unit;
+			sequence[size++] = static_cast<char>(0xE0 | code_point >> 12);
+			sequence[size++] = static_cast<char>(0x80 | (code_point >> 6 & 0x3F));
+			sequence[size++] = static_cast<char>(0x80 | (code_point & 0x3F));
+		}
+
+		// never split a sequence at the end of the budget
+		if (static_cast<size_t>(limit - dst) < size)
+			break;
+
+		dst = std::copy_n(sequence, size, dst);
+		i += consumed;
+	}
+
+	return static_cast<size_t>(dst - begin);
+}
+
+template <typename T>
+void ObjectRenderer::appendFloatingPoint(std::string& out, const T value)
+{
+	if (std::isnan(value))
+	{
+		out += "NaN";
+		return;
+	}
+
+	if (std::isinf(value))
+	{
+		out += value > 0 ? "Infinity" : "-Infinity";
+		return;
+	}
+
+	// shortest round-trip digits in the value's own precision, "-1.2345e+07" -> sign, "12345" and exponent 7
+	char buffer[32];
+	const auto result = std::to_chars(buffer, buffer + sizeof buffer, value, std::chars_format::scientific);
+	const std::string_view scientific(buffer, result.ptr);
+	const size_t exponent_start = scientific.find('e');
+	int exponent = 0;
+	std::from_chars(scientific.data() + exponent_start + (scientific[exponent_start + 1] == '+' ? 2 : 1), scientific.data() + scientific.size(), exponent);
+
+	std::string digits;
+	for (const char c : scientific.substr(0, exponent_start))
+	{
+		if (c == '-')
+			out += c;
+		else if (c != '.')
+			digits += c;
+	}
+
+	// like Double::toString, magnitudes from 10^-3 up to 10^7 are written out with at least one fractional digit
+	if (exponent < -3 || exponent >= 7)
+	{
+		// "1.0E7", "1.2345E-5"
+		out += digits[0];
+		out += '.';
+		out += digits.size() > 1 ? std::string_view(digits).substr(1) : "0";
+		out += 'E';
+		out += std::to_string(exponent);
+	}
+	else if (exponent < 0)
+	{
+		// "0.00123"
+		out += "0.";
+		out.append(static_cast<size_t>(-exponent - 1), '0');
+		out += digits;
+	}
+	else
+	{
+		// "1234.5", "1000000.0"
+		const auto whole = static_cast<size_t>(exponent) + 1;
+		if (digits.size() < whole)
+			digits.append(whole - digits.size(), '0');
+		out.append(digits, 0, whole);
+		out += '.';
+		out += digits.size() > whole ? std::string_view(digits).substr(whole) : "0";
+	}
+}
+
+// heap copies of float and double arrays are formatted by the agent, outside this file
+template void ObjectRenderer::appendFloatingPoint<jfloat>(std::string& out, jfloat value);
+template void ObjectRenderer::appendFloatingPoint<jdouble>(std::string& out, jdouble value);
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef OBJECTRENDERER_H
+#define OBJECTRENDERER_H
+
+#include "pch.h"
+#include "agentoptions.h"
+#include "capturemetrics.h"
+
+/*
+ * Renders objects as text without running user code on the suspended thread.
+ * Strings, boxed primitives, atomics and the common java.util collections are read field by field through JNI,
+ * and their output is truncated to an element and byte budget. Any other object is shown the way Object::toString
+ * would show it (class name and identity hash) unless the "tostring" option allows calling its toString() method.
+ * Object arrays are summarized rather than listed, so their cost does not grow with their length.
+ */
+class ObjectRenderer
+{
+	// JNI handles of the JDK types rendered natively, resolved once per JVM
+	typedef struct
+	{
+		jclass objectClass, stringClass, collectionClass, mapClass;
+		jclass integerClass, longClass, shortClass, byteClass, doubleClass, floatClass, characterClass, booleanClass;
+		jclass atomicIntegerClass, atomicLongClass, atomicBooleanClass;
+		jclass arrayListClass, linkedListClass, arrayDequeClass, hashMapClass, linkedHashMapClass, hashSetClass, treeMapClass;
+		jmethodID toStringMethod;
+		jfieldID integerValue, longValue, shortValue, byteValue, doubleValue, floatValue, characterValue, booleanValue;
+		jfieldID atomicIntegerValue, atomicLongValue, atomicBooleanValue;
+		jfieldID arrayListElementData, arrayListSize;
+		jfieldID linkedListFirst, linkedListNodeItem, linkedListNodeNext;
+		jfieldID arrayDequeElements, arrayDequeHead, arrayDequeTail;
+		jfieldID hashMapTable, hashMapNodeKey, hashMapNodeValue, hashMapNodeNext;
+		jfieldID linkedHashMapHead, linkedHashMapEntryAfter;
+		jfieldID hashSetMap;
+		jfieldID treeMapRoot, treeMapEntryKey, treeMapEntryValue, treeMapEntryLeft, treeMapEntryRight, treeMapEntryParent;
+		bool resolved;
+	} JdkTypes;
+
+	static constexpr int MAX_DEPTH = 3;
+	static constexpr jsize SCRATCH_UNITS = 64 * 1024;
+	static constexpr jsize SCAN_CHUNK = 1024;
+	static constexpr size_t SUMMARY_CLASSES = 16;
+	static constexpr long long SUMMARY_HEAD = 8, SUMMARY_STRIDED = 16, SUMMARY_TAIL = 8;
+	static JdkTypes s_types;
+	static std::once_flag s_resolveOnce;
+	static thread_local std::vector<jchar> s_scratch;
+
+	jvmtiEnv* m_jvmti;
+	JNIEnv* m_env;
+	CaptureMetrics& m_metrics;
+	size_t m_maxElements;
+	size_t m_maxBytes;
+	long long m_maxScan;
+	bool m_allowToString;
+	bool m_nativeOnly = false;
+	long long m_toStringBudgetNanos;
+
+	static void resolveJdkTypes(JNIEnv* env);
+	bool renderNative(jobject obj, std::string& out, int depth);
+	void renderElement(jobject element, std::string& out, int depth);
+	void renderSequence(jobjectArray elements, jint begin, jint end, jint capacity, std::string& out, int depth);
+	void renderHashMap(jobject map, std::string& out, int depth, bool keysOnly);
+	void renderTreeMap(jobject map, std::string& out, int depth);
+	bool renderToString(jobject obj, std::string& out);
+	void renderIdentity(jobject obj, std::string& out);
+	std::string className(jclass klass);
+	bool overBudget(const std::string& out) const;
+	void appendString(jstring str, std::string& out);
+
+public:
+	ObjectRenderer(jvmtiEnv* jvmti, JNIEnv* env, const AgentOptions& options, CaptureMetrics& metrics);
+	~ObjectRenderer() = default;
+	std::string render(jobject obj);
+	std::string summarizeArray(jobjectArray array);
+	static std::string renderPrimitive(jvalue value, char type);
+	static size_t encodeEscaped(const jchar* src, size_t length, char* dst, const char* limit);
+	template <typename T> static void appendFloatingPoint(std::string& out, T value);
+};
+
+#endif // OBJECTRENDERER_H
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "pch.h"
+#include "objecttags.h"
+
+jlong ObjectTags::tag(jvmtiEnv* jvmti, jobject object)
+{
+	// tags belong to the agent's environment, so an object keeps its ID for as long as it lives
+	jlong tag = 0;
+	if (jvmti->GetTag(object, &tag) != JVMTI_ERROR_NONE)
+		return 0;
+	if (tag != 0)
+		return tag;
+
+	tag = this->m_nextTag.fetch_add(1, std::memory_order_relaxed);
+	return jvmti->SetTag(object, tag) == JVMTI_ERROR_NONE ? tag : 0;
+}
+
+bool ObjectTags::find(const jlong tag, const unsigned long long hash, TaggedContent& content)
+{
+	std::lock_guard lock(this->m_mutex);
+	const auto found = this->m_contents.find(tag);
+	if (found == this->m_contents.end() || found->second.hash != hash)
+		return false;
+
+	content = found->second;
+	return true;
+}
+
+void ObjectTags::remember(const jlong tag, const TaggedContent& content)
+{
+	std::lock_guard lock(this->m_mutex);
+	this->m_contents[tag] = content;
+}
+
+void ObjectTags::referenced(const size_t bytes)
+{
+	this->m_references.fetch_add(1, std::memory_order_relaxed);
+	this->m_referencedBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void ObjectTags::forget(const jlong tag)
+{
+	// called from ObjectFree, which may not call JNI but may take a lock that is never held across a JNI call
+	std::lock_guard lock(this->m_mutex);
+	this->m_contents.erase(tag);
+}
+
+void ObjectTags::clear()
+{
+	std::lock_guard lock(this->m_mutex);
+	this->m_contents.clear();
+}
+
+std::vector<std::string> ObjectTags::report()
+{
+	size_t tracked;
+	{
+		std::lock_guard lock(this->m_mutex);
+		tracked = this->m_contents.size();
+	}
+
+	// every metric is "name\avalue\aunit"
+	std::vector<std::string> metrics;
+	metrics.push_back("Tagged Objects\a" + std::to_string(this->m_nextTag.load(std::memory_order_relaxed) - 1) + "\acount");
+	if (tracked == 0 && this->m_references.load(std::memory_order_relaxed) == 0)
+		return metrics;
+	metrics.push_back("Archived Object Contents\a" + std::to_string(tracked) + "\acount");
+	metrics.push_back("Unchanged Objects Referenced\a" + std::to_string(this->m_references.load(std::memory_order_relaxed)) + "\acount");
+	metrics.push_back("Unchanged Bytes Not Rewritten\a" + std::to_string(this->m_referencedBytes.load(std::memory_order_relaxed)) + "\abytes");
+	return metrics;
+}
\ No newline at end of file
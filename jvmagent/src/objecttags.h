@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef OBJECTTAGS_H
+#define OBJECTTAGS_H
+
+#include "pch.h"
+
+// content of a tagged object as it was last archived in full
+typedef struct
+{
+	unsigned long long hash;
+	unsigned long long snapshot;
+	unsigned int segment;
+} TaggedContent;
+
+/*
+ * Stable identity for captured objects. Every object that appears in a snapshot is tagged with an ID through SetTag the
+ * first time it is seen, so later hits recognize it by identity rather than by its toString() text, which is the same
+ * for objects that merely look alike. With the "incremental" option the content hash of the last archived copy of every
+ * object is kept, and arrays and objects that have not changed since are written as a reference to that snapshot.
+ */
+class ObjectTags
+{
+	std::atomic<jlong> m_nextTag = 1;
+	std::mutex m_mutex;
+	std::unordered_map<jlong, TaggedContent> m_contents;
+	std::atomic<unsigned long long> m_references = 0;
+	std::atomic<unsigned long long> m_referencedBytes = 0;
+
+public:
+	ObjectTags() = default;
+	~ObjectTags() = default;
+	jlong tag(jvmtiEnv* jvmti, jobject object);
+	bool find(jlong tag, unsigned long long hash, TaggedContent& content);
+	void remember(jlong tag, const TaggedContent& content);
+	void referenced(size_t bytes);
+	void forget(jlong tag);
+	void clear();
+	std::vector<std::string> report();
+};
+
+#endif // OBJECTTAGS_H
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "pch.h"
+#include "payloadarena.h"
+
+char* PayloadArena::reserve(const size_t size)
+{
+	// room for up to size bytes at the end of the arena, only what commit() is given is kept
+	while (this->m_block < this->m_blocks.size() && this->m_blocks[this->m_block].size - this->m_used < size)
+	{
+		this->m_block++;
+		this->m_used = 0;
+	}
+
+	// blocks double in size up to a limit, anything larger gets a block of its own
+	if (this->m_block == this->m_blocks.size())
+	{
+		const size_t previous = this->m_blocks.empty() ? FIRST_BLOCK / 2 : this->m_blocks.back().size;
+		const size_t block_size = std::max(size, std::min(previous * 2, LARGEST_BLOCK));
+		this->m_blocks.push_back({ std::make_unique_for_overwrite<char[]>(block_size), block_size });
+		this->m_allocations++;
+	}
+
+	return this->m_blocks[this->m_block].data.get() + this->m_used;
+}
+
+std::string_view PayloadArena::commit(const char* end)
+{
+	const char* begin = this->m_blocks[this->m_block].data.get() + this->m_used;
+	const auto size = static_cast<size_t>(end - begin);
+	this->m_used += size;
+	this->m_bytes += size;
+	return { begin, size };
+}
+
+std::string_view PayloadArena::store(const std::string_view text)
+{
+	char* out = this->reserve(text.size());
+	std::memcpy(out, text.data(), text.size());
+	return this->commit(out + text.size());
+}
+
+std::string_view PayloadArena::join(const std::initializer_list<Field> fields, const std::string_view delimiter)
+{
+	// the entry is measured first, so it is written in one piece without growing anything
+	size_t size = fields.size() > 0 ? (fields.size() - 1) * delimiter.size() : 0;
+	for (const Field& field : fields)
+		size += field.text().size();
+
+	char* out = this->reserve(size);
+	for (const Field& field : fields)
+	{
+		if (&field != fields.begin())
+			out = std::copy(delimiter.begin(), delimiter.end(), out);
+		const std::string_view text = field.text();
+		out = std::copy(text.begin(), text.end(), out);
+	}
+	return this->commit(out);
+}
+
+std::string_view PayloadArena::concat(const std::initializer_list<Field> fields)
+{
+	return this->join(fields, std::string_view());
+}
+
+void PayloadArena::reset(const size_t keepBytes)
+{
+	// the largest blocks are the last ones, they go first
+	size_t capacity = this->capacity();
+	while (this->m_blocks.size() > 1 && capacity > keepBytes)
+	{
+		capacity -= this->m_blocks.back().size;
+		this->m_blocks.pop_back();
+	}
+
+	this->m_block = 0;
+	this->m_used = 0;
+	this->m_bytes = 0;
+	this->m_allocations = 0;
+}
+
+size_t PayloadArena::bytes() const
+{
+	return this->m_bytes;
+}
+
+size_t PayloadArena::capacity() const
+{
+	size_t capacity = 0;
+	for (const Block& block : this->m_blocks)
+		capacity += block.size;
+	return capacity;
+}
+
+unsigned long long PayloadArena::allocations() const
+{
+	return this->m_allocations;
+}
+
+std::unique_ptr<PayloadArena> ArenaPool::acquire()
+{
+	std::lock_guard lock(this->m_mutex);
+	if (this->m_arenas.empty())
+		return std::make_unique<PayloadArena>();
+
+	std::unique_ptr<PayloadArena> arena = std::move(this->m_arenas.back());
+	this->m_arenas.pop_back();
+	return arena;
+}
+
+void ArenaPool::release(std::unique_ptr<PayloadArena> arena)
+{
+	arena->reset(KEEP_BYTES);
+	std::lock_guard lock(this->m_mutex);
+	this->m_arenas.push_back(std::move(arena));
+}
+
+std::string_view InternedStrings::intern(const std::string_view key, const std::function<std::string()>& make)
+{
+	std::lock_guard lock(this->m_mutex);
+	if (const auto interned = this->m_strings.find(key); interned != this->m_strings.end())
+		return interned->second;
+
+	// key and string live in the arena, which is never reset, so the views stay valid for good
+	const std::string_view value = this->m_arena.store(make());
+	this->m_strings.emplace(this->m_arena.store(key), value);
+	return value;
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#ifndef PAYLOADARENA_H
+#define PAYLOADARENA_H
+
+#include "pch.h"
+
+/*
+ * Bump-pointer arena that holds the entries of one payload. Entries are written straight into large blocks and kept as
+ * string_views into them, so a capture makes a handful of allocations however many values it holds. Nothing is freed
+ * on its own: the arena is reset as a whole once the snapshot is written, and its blocks are reused by the next capture.
+ */
+class PayloadArena
+{
+public:
+	// one field of an entry, numbers are formatted in place so they never become a string of their own
+	class Field
+	{
+		std::string_view m_text;
+		size_t m_size = 0;
+		bool m_formatted = false;
+
+		// wide enough for any double in fixed notation
+		char m_digits[320];
+
+	public:
+		Field(const std::string_view text) : m_text(text) {}
+		Field(const char* text) : m_text(text) {}
+		Field(const std::string& text) : m_text(text) {}
+		Field(const Field&) = delete;
+
+		template<typename T> requires (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+		Field(const T value) : m_formatted(true)
+		{
+			this->m_size = static_cast<size_t>(std::to_chars(this->m_digits, this->m_digits + sizeof this->m_digits, value).ptr - this->m_digits);
+		}
+
+		// same digits as std::to_string
+		template<typename T> requires std::is_floating_point_v<T>
+		Field(const T value) : m_formatted(true)
+		{
+			this->m_size = static_cast<size_t>(std::to_chars(this->m_digits, this->m_digits + sizeof this->m_digits, value, std::chars_format::fixed, 6).ptr - this->m_digits);
+		}
+
+		std::string_view text() const
+		{
+			return this->m_formatted ? std::string_view(this->m_digits, this->m_size) : this->m_text;
+		}
+	};
+
+private:
+	static constexpr size_t FIRST_BLOCK = 64 << 10;
+	static constexpr size_t LARGEST_BLOCK = 16 << 20;
+
+	typedef struct
+	{
+		std::unique_ptr<char[]> data;
+		size_t size;
+	} Block;
+
+	std::vector<Block> m_blocks;
+	size_t m_block = 0;
+	size_t m_used = 0;
+	size_t m_bytes = 0;
+	unsigned long long m_allocations = 0;
+
+public:
+	PayloadArena() = default;
+	~PayloadArena() = default;
+	char* reserve(size_t size);
+	std::string_view commit(const char* end);
+	std::string_view store(std::string_view text);
+	std::string_view join(std::initializer_list<Field> fields, std::string_view delimiter = "\a");
+	std::string_view concat(std::initializer_list<Field> fields);
+	void reset(size_t keepBytes);
+	size_t bytes() const;
+	size_t capacity() const;
+	unsigned long long allocations() const;
+};
+
+/*
+ * Arenas of finished captures, reset and handed to the next ones so their blocks are only allocated once. Captures
+ * that overlap on different threads or in the capture pipeline each get an arena of their own.
+ */
+class ArenaPool
+{
+	// blocks beyond this are freed when an arena comes back, so one huge capture does not pin its memory for good
+	static constexpr size_t KEEP_BYTES = 32 << 20;
+
+	std::mutex m_mutex;
+	std::vector<std::unique_ptr<PayloadArena>> m_arenas;
+
+public:
+	ArenaPool() = default;
+	~ArenaPool() = default;
+	std::unique_ptr<PayloadArena> acquire();
+	void release(std::unique_ptr<PayloadArena> arena);
+};
+
+/*
+ * Strings that repeat from one hit to the next, such as the decoded declarations of locals, fields and methods. Each
+ * is built once and kept for the lifetime of the agent, so a hit on a known frame only looks them up.
+ */
+class InternedStrings
+{
+	std::mutex m_mutex;
+	PayloadArena m_arena;
+	std::unordered_map<std::string_view, std::string_view> m_strings;
+
+public:
+	InternedStrings() = default;
+	~InternedStrings() = default;
+	std::string_view intern(std::string_view key, const std::function<std::string()>& make);
+};
+
+#endif // PAYLOADARENA_H
\ No newline at end of file
@@ -5,9 +5,38 @@
 
 #include <jvmti.h>
 #include <Windows.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <sstream>
-#include <regex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
+
+// every x86 and x64 target of the agent supports SSE2
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MEMDBGVIS_SSE2
+#include <emmintrin.h>
+#endif
 
 #endif // PCH_H
\ No newline at end of file
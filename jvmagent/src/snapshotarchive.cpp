@@ -0,0 +1,205 @@
+#include "pch.h"
+#include "snapshotarchive.h"
+
+SnapshotArchive::~SnapshotArchive()
+{
+	if (this->m_segment != INVALID_HANDLE_VALUE)
+		CloseHandle(this->m_segment);
+	if (this->m_index != INVALID_HANDLE_VALUE)
+		CloseHandle(this->m_index);
+}
+
+bool SnapshotArchive::open(const std::wstring& directory, const long long segmentBytes, const long long segmentsKept)
+{
+	std::lock_guard lock(this->m_mutex);
+	if (this->isOpen())
+		return true;
+
+	this->m_directory = directory;
+	this->m_error.clear();
+	this->m_segmentLimit = static_cast<unsigned long long>(std::max(segmentBytes, 1LL << 20));
+	this->m_segmentsKept = static_cast<unsigned int>(std::clamp<long long>(segmentsKept, 1, std::numeric_limits<int>::max()));
+	CreateDirectory(directory.c_str(), nullptr);
+
+	if (this->openIndex() && this->openSegment())
+		return true;
+
+	// an index written by another version or an unwritable directory leaves archiving off
+	if (this->m_index != INVALID_HANDLE_VALUE)
+		CloseHandle(this->m_index);
+	this->m_index = INVALID_HANDLE_VALUE;
+	return false;
+}
+
+bool SnapshotArchive::isOpen() const
+{
+	return this->m_index != INVALID_HANDLE_VALUE;
+}
+
+const std::wstring& SnapshotArchive::directory() const
+{
+	return this->m_directory;
+}
+
+const std::wstring& SnapshotArchive::error() const
+{
+	return this->m_error;
+}
+
+bool SnapshotArchive::retains(const unsigned int segment)
+{
+	// true if the segment survives the next rotation, so a snapshot written now can still refer to it
+	std::lock_guard lock(this->m_mutex);
+	return this->isOpen() && segment + this->m_segmentsKept > this->m_segmentNumber + 1;
+}
+
+std::wstring SnapshotArchive::segmentPath(const unsigned int segment) const
+{
+	const std::wstring number = std::to_wstring(segment);
+	return this->m_directory + L"\\segment-" + std::wstring(8 - std::min<size_t>(8, number.size()), L'0') + number + L".dat";
+}
+
+bool SnapshotArchive::openIndex()
+{
+	// the visualizer maps the index while snapshots are appended, so it is shared for reading and writing
+	this->m_index = CreateFile((this->m_directory + L"\\index.bin").c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER size{};
+	if (this->m_index == INVALID_HANDLE_VALUE || !GetFileSizeEx(this->m_index, &size))
+		return false;
+
+	// header: magic, format version and record size
+	char header[HEADER_SIZE]{};
+	unsigned int version = VERSION;
+	unsigned int record_size = sizeof(ArchiveRecord);
+	if (size.QuadPart == 0)
+	{
+		std::memcpy(header, MAGIC, sizeof MAGIC);
+		std::memcpy(header + 8, &version, sizeof version);
+		std::memcpy(header + 12, &record_size, sizeof record_size);
+		this->m_indexBytes = HEADER_SIZE;
+		return SnapshotArchive::writeAll(this->m_index, header, HEADER_SIZE);
+	}
+
+	DWORD read = 0;
+	if (!ReadFile(this->m_index, header, HEADER_SIZE, &read, nullptr) || read != HEADER_SIZE)
+		return false;
+	std::memcpy(&version, header + 8, sizeof version);
+	std::memcpy(&record_size, header + 12, sizeof record_size);
+	if (std::memcmp(header, MAGIC, sizeof MAGIC) != 0)
+	{
+		this->m_error = L"index.bin is not a snapshot archive index.";
+		return false;
+	}
+	if (version != VERSION || record_size != sizeof(ArchiveRecord))
+	{
+		this->m_error = L"index.bin was written in archive format version " + std::to_wstring(version) + L", this agent writes version " + std::to_wstring(VERSION) + L". Move the old archive away or choose another directory.";
+		return false;
+	}
+
+	// numbering continues after the last complete record, a record cut short by a crash is overwritten by the next one
+	const unsigned long long records = (static_cast<unsigned long long>(size.QuadPart) - HEADER_SIZE) / sizeof(ArchiveRecord);
+	this->m_indexBytes = HEADER_SIZE + records * sizeof(ArchiveRecord);
+	if (records == 0)
+		return true;
+
+	ArchiveRecord last{};
+	LARGE_INTEGER position{};
+	position.QuadPart = static_cast<LONGLONG>(this->m_indexBytes - sizeof(ArchiveRecord));
+	if (!SetFilePointerEx(this->m_index, position, nullptr, FILE_BEGIN) || !ReadFile(this->m_index, &last, sizeof last, &read, nullptr) || read != sizeof last)
+		return false;
+
+	this->m_nextId = last.id + 1;
+	this->m_segmentNumber = std::max(last.segment, 1u);
+	return true;
+}
+
+bool SnapshotArchive::openSegment()
+{
+	// segments are only ever appended to, and may be deleted by a rotation while the visualizer reads them
+	this->m_segment = CreateFile(this->segmentPath(this->m_segmentNumber).c_str(), FILE_APPEND_DATA | FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER size{};
+	if (this->m_segment == INVALID_HANDLE_VALUE || !GetFileSizeEx(this->m_segment, &size))
+		return false;
+
+	this->m_segmentBytes = static_cast<unsigned long long>(size.QuadPart);
+	return true;
+}
+
+void SnapshotArchive::rotate()
+{
+	CloseHandle(this->m_segment);
+	this->m_segment = INVALID_HANDLE_VALUE;
+	this->m_segmentNumber++;
+
+	// segments that fell out of the window are deleted, one still open in a visualizer is tried again on the next rotation
+	for (unsigned int segment = this->m_segmentNumber > this->m_segmentsKept ? this->m_segmentNumber - this->m_segmentsKept : 0; segment > 0; segment--)
+	{
+		const std::wstring path = this->segmentPath(segment);
+		if (GetFileAttributes(path.c_str()) == INVALID_FILE_ATTRIBUTES)
+			break;
+		DeleteFile(path.c_str());
+	}
+
+	if (!this->openSegment() && this->m_segment != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(this->m_segment);
+		this->m_segment = INVALID_HANDLE_VALUE;
+	}
+}
+
+bool SnapshotArchive::writeAll(HANDLE file, const void* data, const size_t size)
+{
+	const auto* bytes = static_cast<const char*>(data);
+	for (size_t written = 0; written < size;)
+	{
+		DWORD chunk = 0;
+		if (!WriteFile(file, bytes + written, static_cast<DWORD>(std::min<size_t>(size - written, 1u << 30)), &chunk, nullptr) || chunk == 0)
+			return false;
+		written += chunk;
+	}
+	return true;
+}
+
+bool SnapshotArchive::append(const std::string& snapshot, ArchiveRecord& record)
+{
+	std::lock_guard lock(this->m_mutex);
+	if (!this->isOpen())
+		return false;
+
+	if (this->m_segmentBytes > 0 && this->m_segmentBytes + snapshot.size() > this->m_segmentLimit)
+		this->rotate();
+	if (this->m_segment == INVALID_HANDLE_VALUE)
+		return false;
+
+	record.id = this->m_nextId;
+	record.timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	record.segment = this->m_segmentNumber;
+	record.offset = this->m_segmentBytes;
+	if (!SnapshotArchive::writeAll(this->m_segment, snapshot.data(), snapshot.size()))
+	{
+		// a partial write still moved the end of the segment
+		LARGE_INTEGER size{};
+		if (GetFileSizeEx(this->m_segment, &size))
+			this->m_segmentBytes = static_cast<unsigned long long>(size.QuadPart);
+		return false;
+	}
+	this->m_segmentBytes += snapshot.size();
+
+	// the record goes in last, so readers of the index never see a snapshot that is still being written
+	LARGE_INTEGER position{};
+	position.QuadPart = static_cast<LONGLONG>(this->m_indexBytes);
+	if (!SetFilePointerEx(this->m_index, position, nullptr, FILE_BEGIN) || !SnapshotArchive::writeAll(this->m_index, &record, sizeof record))
+		return false;
+
+	this->m_indexBytes += sizeof record;
+	this->m_nextId++;
+	return true;
+}
+
+void SnapshotArchive::copyText(char* field, const size_t size, const std::string_view value)
+{
+	// text fields of a record are truncated to their fixed size and always null terminated
+	const size_t length = std::min(value.size(), size - 1);
+	std::memcpy(field, value.data(), length);
+	field[length] = '\0';
+}
\ No newline at end of file
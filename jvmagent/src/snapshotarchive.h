@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef SNAPSHOTARCHIVE_H
+#define SNAPSHOTARCHIVE_H
+
+#include "pch.h"
+
+// sections of a snapshot, section 0 holds the runtime metrics that follow the header lines
+// every section has its own offset, the offset after the last one is the end of the snapshot
+constexpr size_t ARCHIVE_SECTIONS = 12;
+
+// one fixed-size record per snapshot in index.bin, laid out without padding so the visualizer can map the file as an array
+typedef struct
+{
+	unsigned long long id;
+	long long timestampMs;
+	unsigned long long offset;
+	unsigned int segment;
+	int line;
+	unsigned int sections[ARCHIVE_SECTIONS + 1];
+	char thread[48];
+	char callSite[160];
+	char trigger[92];
+} ArchiveRecord;
+
+static_assert(sizeof(ArchiveRecord) == 384, "the visualizer maps index records with the same layout");
+
+/*
+ * Append-only archive of every snapshot, enabled with the "archive" option. Snapshots are appended to numbered segment
+ * files and described by a fixed-size record in index.bin, with their thread, call site and the offset of every section.
+ * A record is only written after its snapshot, so the index never points at a partial snapshot, and once the current
+ * segment would grow past its size limit a new one is started and the oldest segments beyond the limit are deleted.
+ */
+class SnapshotArchive
+{
+public:
+	static constexpr long long DEFAULT_SEGMENT_MB = 64;
+	static constexpr long long DEFAULT_SEGMENTS = 16;
+
+private:
+	static constexpr char MAGIC[8] = { 'M', 'D', 'V', 'I', 'N', 'D', 'E', 'X' };
+	// version 2 added the monitors and profile offsets, version 1 indexes are refused rather than misread
+	static constexpr unsigned int VERSION = 2;
+	static constexpr size_t HEADER_SIZE = 16;
+
+	std::mutex m_mutex;
+	std::wstring m_directory;
+	HANDLE m_index = INVALID_HANDLE_VALUE;
+	HANDLE m_segment = INVALID_HANDLE_VALUE;
+	unsigned int m_segmentNumber = 1;
+	unsigned long long m_segmentBytes = 0;
+	unsigned long long m_segmentLimit = DEFAULT_SEGMENT_MB << 20;
+	unsigned int m_segmentsKept = DEFAULT_SEGMENTS;
+	unsigned long long m_nextId = 1;
+	unsigned long long m_indexBytes = HEADER_SIZE;
+	std::wstring m_error;
+
+	std::wstring segmentPath(unsigned int segment) const;
+	bool openIndex();
+	bool openSegment();
+	void rotate();
+	static bool writeAll(HANDLE file, const void* data, size_t size);
+
+public:
+	SnapshotArchive() = default;
+	~SnapshotArchive();
+	bool open(const std::wstring& directory, long long segmentBytes, long long segmentsKept);
+	bool isOpen() const;
+	const std::wstring& directory() const;
+	const std::wstring& error() const;
+	bool retains(unsigned int segment);
+	bool append(const std::string& snapshot, ArchiveRecord& record);
+	static void copyText(char* field, size_t size, std::string_view value);
+};
+
+#endif // SNAPSHOTARCHIVE_H
\ No newline at end of file
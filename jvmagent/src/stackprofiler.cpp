@@ -0,0 +1,205 @@
+#include "pch.h"
+#include "stackprofiler.h"
+#include "allocationsampler.h"
+
+bool StackProfiler::start(jvmtiEnv* jvmti, JNIEnv* env, const long long intervalMs, const jint depth)
+{
+	this->m_intervalMs = static_cast<DWORD>(std::clamp<long long>(intervalMs, 1, 60 * 1000));
+	this->m_depth = std::clamp<jint>(depth, 1, 1024);
+
+	// the arena and the method table are allocated once and kept across detaches, a restarted sampler goes on filling them
+	if (this->m_trees == nullptr)
+	{
+		this->m_methods = std::make_unique<jmethodID[]>(METHODS);
+		this->m_methodSlots = std::make_unique<unsigned int[]>(METHOD_SLOTS);
+		this->m_methodCount = OUTER_FRAMES + 1;
+		this->m_trees = std::make_unique<ProfileTree[]>(2);
+		StackProfiler::reset(this->m_trees[0]);
+		StackProfiler::reset(this->m_trees[1]);
+	}
+
+	// the sampler runs at the highest priority, so busy threads do not push its samples back
+	return this->m_thread.start(jvmti, env, "memdbgvis stack profiler", JVMTI_THREAD_MAX_PRIORITY, &StackProfiler::run, this);
+}
+
+void StackProfiler::stop()
+{
+	// the thread notices within one interval, the samples already taken are reported by the next capture
+	this->m_thread.stop();
+}
+
+void StackProfiler::run(jvmtiEnv* jvmti, JNIEnv* env, void* owner, const unsigned long long generation)
+{
+	auto* profiler = static_cast<StackProfiler*>(owner);
+
+	// the time taken by a batch comes off the next sleep, so the rate holds as long as the timer resolution allows
+	while (profiler->m_thread.running(generation))
+	{
+		const long long started = StackProfiler::now();
+		profiler->sample(jvmti, env);
+		const long long elapsed_ms = (StackProfiler::now() - started) / 1000000;
+		Sleep(static_cast<DWORD>(std::max<long long>(static_cast<long long>(profiler->m_intervalMs) - elapsed_ms, 1)));
+	}
+}
+
+long long StackProfiler::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void StackProfiler::reset(ProfileTree& tree)
+{
+	// nodes past the used ones are overwritten when they are handed out, so clearing the root empties the tree
+	tree.nodes[0] = { NONE, NONE, NONE, 0, 0 };
+	tree.used = 1;
+	tree.batches = 0;
+	tree.truncated = 0;
+	tree.startNanos = StackProfiler::now();
+	tree.samplingNanos = 0;
+}
+
+unsigned int StackProfiler::intern(jmethodID method)
+{
+	// open addressing on the pointer, slots hold the method index plus one so zero is free
+	const auto hash = static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(method)) * 0x9E3779B97F4A7C15ULL;
+	for (unsigned int probe = 0; probe < MAX_PROBES; probe++)
+	{
+		unsigned int& slot = this->m_methodSlots[(static_cast<unsigned int>(hash >> 40) + probe) % METHOD_SLOTS];
+		if (slot != 0 && this->m_methods[slot - 1] == method)
+			return slot - 1;
+		if (slot == 0)
+		{
+			if (this->m_methodCount == METHODS)
+				return OTHER_METHODS;
+			this->m_methods[this->m_methodCount] = method;
+			slot = ++this->m_methodCount;
+			return slot - 1;
+		}
+	}
+	return OTHER_METHODS;
+}
+
+unsigned int StackProfiler::child(ProfileTree& tree, const unsigned int parent, const unsigned int method)
+{
+	for (unsigned int node = tree.nodes[parent].firstChild; node != NONE; node = tree.nodes[node].nextSibling)
+	{
+		if (tree.nodes[node].method == method)
+			return node;
+	}
+
+	if (tree.used == NODES)
+		return NONE;
+	tree.nodes[tree.used] = { method, NONE, tree.nodes[parent].firstChild, 0, 0 };
+	tree.nodes[parent].firstChild = tree.used;
+	return tree.used++;
+}
+
+void StackProfiler::sample(jvmtiEnv* jvmti, JNIEnv* env)
+{
+	// one call stops every thread at the same safepoint, instead of one stop per thread
+	const long long started = StackProfiler::now();
+	jint count = 0;
+	jvmtiStackInfo* stacks = nullptr;
+	if (jvmti->GetAllStackTraces(this->m_depth, &stacks, &count) != JVMTI_ERROR_NONE)
+		return;
+
+	{
+		std::lock_guard lock(this->m_treeMutex);
+		ProfileTree& tree = this->m_trees[this->m_active];
+		for (jint i = 0; i < count; i++)
+		{
+			// agent threads have no Java frames, and threads that wait or sleep are left out so the profile shows where time goes
+			const jvmtiStackInfo& stack = stacks[i];
+			if (stack.frame_count == 0 || !(stack.state & JVMTI_THREAD_STATE_RUNNABLE))
+				continue;
+
+			// frames come innermost first, the tree is walked from the outermost
+			unsigned int node = 0;
+			tree.nodes[0].total++;
+			const bool cut = stack.frame_count == this->m_depth;
+			for (jint j = stack.frame_count - (cut ? 0 : 1); j >= 0; j--)
+			{
+				const unsigned int next = StackProfiler::child(tree, node, j == stack.frame_count ? OUTER_FRAMES : this->intern(stack.frame_buffer[j].method));
+				if (next == NONE)
+				{
+					tree.truncated++;
+					break;
+				}
+				node = next;
+				tree.nodes[node].total++;
+			}
+			tree.nodes[node].self++;
+		}
+		tree.batches++;
+		tree.samplingNanos += StackProfiler::now() - started;
+	}
+
+	// the stacks and their frames are a single allocation, only the thread references have to be released one by one
+	for (jint i = 0; i < count; i++)
+		env->DeleteLocalRef(stacks[i].thread);
+	jvmti->Deallocate(reinterpret_cast<unsigned char*>(stacks));
+}
+
+const std::string& StackProfiler::methodName(jvmtiEnv* jvmti, const unsigned int method)
+{
+	// every method is resolved once, the first time a capture reports it
+	if (this->m_methodNames.size() <= method)
+		this->m_methodNames.resize(method + 1);
+	std::string& name = this->m_methodNames[method];
+	if (!name.empty())
+		return name;
+
+	if (method == OTHER_METHODS)
+		return name = "<other methods>";
+	if (method == OUTER_FRAMES)
+		return name = "<outer frames>";
+
+	name = "<unloaded>";
+	jclass klass;
+	char* class_signature = nullptr;
+	char* method_name = nullptr;
+	if (jvmti->GetMethodDeclaringClass(this->m_methods[method], &klass) == JVMTI_ERROR_NONE && jvmti->GetClassSignature(klass, &class_signature, nullptr) == JVMTI_ERROR_NONE && jvmti->GetMethodName(this->m_methods[method], &method_name, nullptr, nullptr) == JVMTI_ERROR_NONE)
+		name = AllocationSampler::readableClassName(class_signature) + '.' + method_name;
+
+	jvmti->Deallocate(reinterpret_cast<unsigned char*>(class_signature));
+	jvmti->Deallocate(reinterpret_cast<unsigned char*>(method_name));
+	return name;
+}
+
+std::vector<std::string> StackProfiler::report(jvmtiEnv* jvmti)
+{
+	std::lock_guard report_lock(this->m_reportMutex);
+	if (this->m_trees == nullptr)
+		return {};
+
+	// the tree of the previous capture was reported already, it is emptied and takes over from the one reported now
+	ProfileTree* tree;
+	{
+		std::lock_guard lock(this->m_treeMutex);
+		tree = &this->m_trees[this->m_active];
+		this->m_active ^= 1;
+		StackProfiler::reset(this->m_trees[this->m_active]);
+	}
+
+	// the first line holds the totals: "PROFILE\asamples\ananoseconds covered\ainterval ms\abatches\asampler nanoseconds\atruncated samples"
+	std::vector<std::string> lines;
+	lines.reserve(tree->used + 1);
+	lines.push_back("PROFILE\a" + std::to_string(tree->nodes[0].total) + '\a' + std::to_string(StackProfiler::now() - tree->startNanos) + '\a' + std::to_string(this->m_intervalMs)
+		+ '\a' + std::to_string(tree->batches) + '\a' + std::to_string(tree->samplingNanos) + '\a' + std::to_string(tree->truncated));
+
+	// every node below the root is "depth\amethod\atotal samples\aself samples", parents before their children
+	std::vector<std::pair<unsigned int, unsigned int>> pending;
+	for (unsigned int node = tree->nodes[0].firstChild; node != NONE; node = tree->nodes[node].nextSibling)
+		pending.emplace_back(node, 0);
+	while (!pending.empty())
+	{
+		const auto [node, depth] = pending.back();
+		pending.pop_back();
+
+		const ProfileNode& entry = tree->nodes[node];
+		lines.push_back(std::to_string(depth) + '\a' + this->methodName(jvmti, entry.method) + '\a' + std::to_string(entry.total) + '\a' + std::to_string(entry.self));
+		for (unsigned int next = entry.firstChild; next != NONE; next = tree->nodes[next].nextSibling)
+			pending.emplace_back(next, depth + 1);
+	}
+	return lines;
+}
\ No newline at end of file
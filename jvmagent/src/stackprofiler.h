@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef STACKPROFILER_H
+#define STACKPROFILER_H
+
+#include "pch.h"
+#include "agentthread.h"
+
+/*
+ * Sampling profiler enabled with the "profile" option. An agent thread takes the stacks of all threads in one batched
+ * GetAllStackTraces call at every interval and adds the runnable ones to a calling-context tree, in which a node is a
+ * method reached through the path of its parents. Methods are interned into a fixed table, so a node only holds the
+ * index of its method, and nodes come from an arena allocated once. Two trees take turns: captures swap them, report
+ * the profile collected since the previous capture and leave the tree empty for the one after.
+ */
+class StackProfiler
+{
+public:
+	static constexpr long long DEFAULT_INTERVAL_MS = 10;
+	static constexpr jint DEFAULT_DEPTH = 64;
+
+private:
+	static constexpr unsigned int NODES = 1 << 16;
+	static constexpr unsigned int METHODS = 1 << 15;
+	static constexpr unsigned int METHOD_SLOTS = 2 * METHODS;
+	static constexpr unsigned int MAX_PROBES = 16;
+	static constexpr unsigned int NONE = std::numeric_limits<unsigned int>::max();
+
+	// stand-ins for the methods that do not fit the table and for the outer frames of a stack cut at the depth limit
+	// a cut stack keeps its innermost frames, so the frames it lost are its callers and their stand-in sits at the root
+	static constexpr unsigned int OTHER_METHODS = 0;
+	static constexpr unsigned int OUTER_FRAMES = 1;
+
+	// children of a node are a list through their siblings, the newest first
+	typedef struct
+	{
+		unsigned int method;
+		unsigned int firstChild;
+		unsigned int nextSibling;
+		unsigned int self;
+		unsigned int total;
+	} ProfileNode;
+
+	// node 0 is the root, the samples that did not fit the arena end at the deepest node that did
+	typedef struct
+	{
+		std::array<ProfileNode, NODES> nodes;
+		unsigned int used;
+		unsigned long long batches;
+		unsigned long long truncated;
+		long long startNanos;
+		long long samplingNanos;
+	} ProfileTree;
+
+	// the sampler thread is the only one to intern methods, captures only read the IDs of methods already in a tree
+	std::unique_ptr<jmethodID[]> m_methods;
+	std::unique_ptr<unsigned int[]> m_methodSlots;
+	unsigned int m_methodCount = 0;
+
+	// the trees are swapped under the mutex, the retired one belongs to the capture until the next swap
+	std::unique_ptr<ProfileTree[]> m_trees;
+	unsigned int m_active = 0;
+	std::mutex m_treeMutex;
+	std::mutex m_reportMutex;
+	std::vector<std::string> m_methodNames;
+
+	DWORD m_intervalMs = DEFAULT_INTERVAL_MS;
+	jint m_depth = DEFAULT_DEPTH;
+
+	AgentThread m_thread;
+
+	static void run(jvmtiEnv* jvmti, JNIEnv* env, void* owner, unsigned long long generation);
+	static long long now();
+	static void reset(ProfileTree& tree);
+	unsigned int intern(jmethodID method);
+	static unsigned int child(ProfileTree& tree, unsigned int parent, unsigned int method);
+	void sample(jvmtiEnv* jvmti, JNIEnv* env);
+	const std::string& methodName(jvmtiEnv* jvmti, unsigned int method);
+
+public:
+	StackProfiler() = default;
+	~StackProfiler() = default;
+	bool start(jvmtiEnv* jvmti, JNIEnv* env, long long intervalMs, jint depth);
+	void stop();
+	std::vector<std::string> report(jvmtiEnv* jvmti);
+};
+
+#endif // STACKPROFILER_H
\ No newline at end of file
@@ -29,16 +29,26 @@ void VisualizerProcComm::displayErrorDialog(const LPCWSTR message, HWND hWnd)
 		throw std::exception("Message box dialog cannot be initialized.");
 }
 
-void VisualizerProcComm::launch()
+void VisualizerProcComm::launch(DrillDownSession* session, const DrillDownHandler& handler, const std::wstring& archive)
 {
 	ZeroMemory(&this->m_piProcInfo, sizeof(PROCESS_INFORMATION));
 	ZeroMemory(&this->m_siStartInfo, sizeof(STARTUPINFO));
 	this->m_siStartInfo.cb = sizeof(STARTUPINFO);
 
+	// the visualizer explores objects on demand if it is told where the drill-down channel is
+	const bool interactive = session != nullptr && handler != nullptr && session->open();
+	std::wstring command_line = L'"' + std::wstring(this->m_exepath) + L'"';
+	if (interactive)
+		command_line += L" --session " + session->pipeName();
+
+	// incremental snapshots refer to contents in the archive, which the visualizer reads them from
+	if (!archive.empty())
+		command_line += L" --references \"" + archive + L'"';
+
 	// launch visualizer executable
 	const BOOL success = CreateProcess(
 		this->m_exepath, 
-		nullptr, 
+		command_line.data(), 
 		nullptr, 
 		nullptr, 
 		FALSE, 
@@ -53,75 +63,139 @@ void VisualizerProcComm::launch()
 	if (!success)
 		VisualizerProcComm::displayErrorDialog((L"Cannot start process: " + std::wstring(this->m_exepath)).c_str());
 
-	// pause current thread until user closes visualizer window
-	do Sleep(999);
-	while (WaitForSingleObject(this->m_piProcInfo.hProcess, 0) == WAIT_TIMEOUT);
+	// pause current thread until user closes visualizer window, answering its requests in the meantime
+	if (success && interactive)
+		session->serve(this->m_piProcInfo.hProcess, handler);
+	else if (success)
+	{
+		do Sleep(999);
+		while (WaitForSingleObject(this->m_piProcInfo.hProcess, 0) == WAIT_TIMEOUT);
+	}
 
 	// resource cleanup
 	CloseHandle(this->m_piProcInfo.hProcess);
 	CloseHandle(this->m_piProcInfo.hThread);
 }
 
-void VisualizerProcComm::serializeDataStruct(const VisualizerPayload& data)
+std::wstring VisualizerProcComm::dataFilePath(const std::wstring& extension) const
 {
-	// setup file object for writing
 	auto filepath = std::wstring(this->m_exepath);
 	filepath.erase(filepath.size() - 3); // remove 'exe' extension
-	filepath += L"dat"; // replace extension with .dat
-
-	/*
-	 * The line number of invocation is not easily accessible by using JVMTI.
-	 * Therefore, the java exception wrapper class that is responsible
-	 * for invoking this agent writes the line number to the data file first.
-	 * Before this agent overwrites that information, the agent needs to store
-	 * the line number in its working memory then rewrite it back to the data file.
-	 * This redundant setup ensures the files are synchronized for access.
-	 */
-	std::ifstream input_filestream(filepath);
-	std::string line_num;
-	input_filestream >> line_num;
-	input_filestream.close();
+	return filepath + extension;
+}
 
-	// overwrite previous contents when opening new file stream
-	std::ofstream output_filestream(filepath);
-	output_filestream << line_num << '\n';
-	output_filestream << "NAME: " << data.threadInfo.name << '\n';
+void VisualizerProcComm::retainSnapshot() const
+{
+	// the next hit overwrites memdbgvis.dat, so keep this one around for the visualizer to diff against
+	CopyFile(this->dataFilePath(L"dat").c_str(), this->dataFilePath(L"prev.dat").c_str(), FALSE);
+}
+
+size_t VisualizerProcComm::serializeDataStruct(const VisualizerPayload& data, SnapshotArchive* archive, ArchiveRecord* archived)
+{
+	// the snapshot is built in memory once, then written to memdbgvis.dat and appended to the archive
+	// its size is known up front, so it is written into a single buffer that never has to grow
+	const std::vector<std::string_view>* entries[] = { &data.metrics, &data.methodNames, &data.localVars, &data.staticFields, &data.heapByteData,
+		&data.captureMetrics, &data.arrayBlockHashes, &data.allocationSites, &data.metricsWindow, &data.monitors, &data.profile };
+	size_t size = 64 + (data.threadInfo.name != nullptr ? std::strlen(data.threadInfo.name) : 0) + (ARCHIVE_SECTIONS + 1) * sizeof "SECTION_END_BEGIN_NEW" + data.trigger.size();
+	for (const std::vector<std::string_view>* section : entries)
+	{
+		for (const std::string_view entry : *section)
+			size += entry.size() + 1;
+	}
+
+	std::string snapshot;
+	snapshot.reserve(size);
+	std::vector<unsigned int> sections;
+	const auto append_lines = [&snapshot](const std::vector<std::string_view>& lines)
+	{
+		for (const std::string_view line : lines)
+			snapshot.append(line) += '\n';
+	};
+
+	snapshot.append(std::to_string(data.lineNum)) += '\n';
+	snapshot.append("NAME: ").append(data.threadInfo.name != nullptr ? data.threadInfo.name : "") += '\n';
 	
 	switch (data.threadInfo.priority)
 	{
 	case JVMTI_THREAD_MIN_PRIORITY:
-		output_filestream << "PRIORITY: MINIMUM\n";
+		snapshot += "PRIORITY: MINIMUM\n";
 		break;
 	case JVMTI_THREAD_NORM_PRIORITY:
-		output_filestream << "PRIORITY: NORMAL\n";
+		snapshot += "PRIORITY: NORMAL\n";
 		break;
 	case JVMTI_THREAD_MAX_PRIORITY:
-		output_filestream << "PRIORITY: MAXIMUM\n";
+		snapshot += "PRIORITY: MAXIMUM\n";
 		break;
 	default:
-		output_filestream << "PRIORITY: UNKNOWN\n";
+		snapshot += "PRIORITY: UNKNOWN\n";
 	}
 
-	// serialize runtime metrics
-	output_filestream << data.metrics << '\n';
+	// serialize runtime metrics, the call stack delimiter ends them
+	sections.push_back(static_cast<unsigned int>(snapshot.size()));
+	append_lines(data.metrics);
 
 	// serialize call stack view
 	NEW_SECTION
-	for (const std::string& method_name : data.methodNames)
-		output_filestream << method_name << '\n';
+	append_lines(data.methodNames);
 
 	// serialize local variable table
 	NEW_SECTION
-	for (const std::string& var : data.localVars)
-		output_filestream << var << '\n';
+	append_lines(data.localVars);
 
 	// serialize class field table
 	NEW_SECTION
-	for (const std::string& field : data.staticFields)
-		output_filestream << field << '\n';
+	append_lines(data.staticFields);
 
 	// serialize heap data
 	NEW_SECTION
-	for (const std::string& bytes : data.heapByteData)
-		output_filestream << bytes << '\n';
+	append_lines(data.heapByteData);
+
+	// serialize agent capture metrics
+	NEW_SECTION
+	append_lines(data.captureMetrics);
+
+	// serialize block hashes of primitive arrays
+	NEW_SECTION
+	append_lines(data.arrayBlockHashes);
+
+	// serialize sampled allocation sites
+	NEW_SECTION
+	append_lines(data.allocationSites);
+
+	// serialize the samples of the metrics sampler thread
+	NEW_SECTION
+	append_lines(data.metricsWindow);
+
+	// serialize what triggered the capture
+	NEW_SECTION
+	snapshot.append(data.trigger) += '\n';
+
+	// serialize the monitors of every thread and their contention
+	NEW_SECTION
+	append_lines(data.monitors);
+
+	// serialize the sampled profile
+	NEW_SECTION
+	append_lines(data.profile);
+	sections.push_back(static_cast<unsigned int>(snapshot.size()));
+
+	// overwrite previous contents when opening new file stream
+	std::ofstream output_datafile(this->dataFilePath(L"dat"));
+	output_datafile << snapshot;
+
+	// the index record describes the snapshot well enough to list and filter without reading it
+	if (archive != nullptr && archive->isOpen() && sections.size() == ARCHIVE_SECTIONS + 1)
+	{
+		ArchiveRecord record{};
+		record.line = data.lineNum;
+		std::copy(sections.begin(), sections.end(), record.sections);
+		SnapshotArchive::copyText(record.thread, sizeof record.thread, data.threadInfo.name != nullptr ? data.threadInfo.name : "");
+		SnapshotArchive::copyText(record.callSite, sizeof record.callSite, data.methodNames.empty() ? "" : data.methodNames.front());
+		SnapshotArchive::copyText(record.trigger, sizeof record.trigger, data.trigger);
+		if (archive->append(snapshot, record) && archived != nullptr)
+			*archived = record;
+	}
+
+	// report the payload size to the caller
+	return static_cast<size_t>(output_datafile.tellp());
 }
\ No newline at end of file
@@ -4,19 +4,30 @@
 #define VISUALIZERPROCCOMM_H
 
 #include "pch.h"
+#include "drilldownsession.h"
+#include "snapshotarchive.h"
 
-#define NEW_SECTION output_filestream << "SECTION_END_BEGIN_NEW\n";
+#define NEW_SECTION snapshot += "SECTION_END_BEGIN_NEW\n"; sections.push_back(static_cast<unsigned int>(snapshot.size()));
 
 EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 
+// every entry is a view into the arena of its capture or into the interned declarations
 typedef struct
 {
+	jint lineNum;
+	std::string trigger;
 	jvmtiThreadInfo threadInfo;
-	std::string metrics;
-	std::vector<std::string> methodNames;
-	std::vector<std::string> localVars;
-	std::vector<std::string> staticFields;
-	std::vector<std::string> heapByteData;
+	std::vector<std::string_view> metrics;
+	std::vector<std::string_view> methodNames;
+	std::vector<std::string_view> localVars;
+	std::vector<std::string_view> staticFields;
+	std::vector<std::string_view> heapByteData;
+	std::vector<std::string_view> captureMetrics;
+	std::vector<std::string_view> arrayBlockHashes;
+	std::vector<std::string_view> allocationSites;
+	std::vector<std::string_view> metricsWindow;
+	std::vector<std::string_view> monitors;
+	std::vector<std::string_view> profile;
 } VisualizerPayload;
 
 class VisualizerProcComm
@@ -30,8 +41,10 @@ public:
 	VisualizerProcComm();
 	~VisualizerProcComm() = default;
 	static void displayErrorDialog(LPCWSTR message, HWND hWnd = nullptr);
-	void launch();
-	void serializeDataStruct(const VisualizerPayload& data);
+	void launch(DrillDownSession* session = nullptr, const DrillDownHandler& handler = nullptr, const std::wstring& archive = std::wstring());
+	std::wstring dataFilePath(const std::wstring& extension) const;
+	size_t serializeDataStruct(const VisualizerPayload& data, SnapshotArchive* archive = nullptr, ArchiveRecord* archived = nullptr);
+	void retainSnapshot() const;
 };
 
 #endif // VISUALIZERPROCCOMM_H
\ No newline at end of file
@@ -4,97 +4,380 @@ DebugVisualizer::DebugVisualizer(QWidget *parent)
     : QMainWindow(parent)
 {
     // the constructor is responsible for setting up UI, connecting button events, deserializing payload, and populating views 
+    this->setupWindow();
+    const QString data_dir = QCoreApplication::applicationDirPath();
+    DebugVisualizer::deserializePayloadData(data_dir + "/memdbgvis.dat", this->m_agentData);
+
+    // the previous snapshot is only comparable when it was taken at the same visualize() call
+    this->m_hasPrevious = DebugVisualizer::deserializePayloadData(data_dir + "/memdbgvis.prev.dat", this->m_previousData)
+        && this->m_previousData.lineNum == this->m_agentData.lineNum
+        && this->m_previousData.methodNames.value(0) == this->m_agentData.methodNames.value(0);
+
+    // incremental snapshots leave unchanged contents in the archive the agent names
+    const QStringList arguments = QCoreApplication::arguments();
+    const qsizetype references_idx = arguments.indexOf("--references");
+    if (references_idx >= 0 && references_idx + 1 < arguments.size())
+    {
+        const SnapshotArchive archive(arguments[references_idx + 1]);
+        DebugVisualizer::resolveHeapReferences(archive, this->m_agentData);
+        DebugVisualizer::resolveHeapReferences(archive, this->m_previousData);
+    }
+    this->populateViews();
+}
+
+DebugVisualizer::DebugVisualizer(const VisualizerPayload& payload, const QString& title, QWidget* parent)
+    : QMainWindow(parent), m_agentData(payload)
+{
+    // archived snapshots are shown on their own, there is no program to drill down into and nothing to diff against
+    this->setupWindow();
+    this->setWindowTitle(this->windowTitle() + " - " + title);
+    this->populateViews();
+}
+
+void DebugVisualizer::setupWindow()
+{
     this->ui.setupUi(this);
     connect(this->ui.pushButton, SIGNAL(clicked()), SLOT(onInspectButtonClicked()));
+    connect(this->ui.objectExplorerTree, &QTreeWidget::itemExpanded, this, &DebugVisualizer::onExplorerItemExpanded);
+    connect(this->ui.objectExplorerTree, &QTreeWidget::itemDoubleClicked, this, &DebugVisualizer::onExplorerItemActivated);
     connect(this->ui.learnMoreThreads, &QCommandLinkButton::clicked, this, [this] { QMessageBox::information(this, "Memory Debug Visualizer", "In computer science, a thread is a sequential flow of instructions for the processor to execute. Many basic programs utilize a single thread. For example, a program that repeatedly adds numbers will have just one thread dedicated to it. Nowadays, it is common for an application to have multiple threads. For example, a web browser may have a thread dedicated to rendering videos while another thread may be used to download files in the background without interruption."); });
     connect(this->ui.learnMoreObjRef, &QCommandLinkButton::clicked, this, [this] { QMessageBox::information(this, "Memory Debug Visualizer", "In Java, the heap is broken down into pieces and chunks in memory. Unlike the stack, which is contiguous, the heap is often fragmented. As a result, the JVM will not know where an object's data is located without a reference pointing to it. In the local variable table view, object reference values are displayed as a string returned by Object::toString. If you want a more thorough examination of a certain object, navigate to the 'Heap Inspection' tab."); });
-    this->deserializePayloadData();
+
+    // links in the runtime metrics open files such as heap dumps with the program registered for them
+    this->ui.runtimeMetricsView->setOpenLinks(false);
+    connect(this->ui.runtimeMetricsView, &QTextBrowser::anchorClicked, this, [](const QUrl& url) { QDesktopServices::openUrl(url); });
+}
+
+void DebugVisualizer::populateViews()
+{
+    // every tab is timed on its own, the benchmark reports where opening a large snapshot goes
+    QElapsedTimer timer;
+    timer.start();
+    const auto lap = [this, &timer](const QString& view)
+    {
+        this->m_viewNanos.push_back({ view, timer.nsecsElapsed() });
+        timer.restart();
+    };
+
     this->populateCallStackThreadView();
+    lap("call_stack");
+    this->populateCaptureMetricsView();
+    lap("capture_metrics");
     this->populateLocalVarTable();
-    this->populateStaticFieldTable();
     this->ui.localVarTableWidget->resizeColumnsToContents();
+    lap("local_variables");
+    this->populateStaticFieldTable();
     this->ui.staticFieldsTable->resizeColumnsToContents();
+    lap("static_fields");
+    this->populateObjectExplorer();
+    lap("object_explorer");
+    this->populateAllocationView();
+    lap("allocations");
+    this->populateLockView();
+    lap("locks");
+    this->ui.metricsChart->setSamples(this->m_agentData.metricsWindow);
+    lap("metrics_chart");
+    this->populateProfileView();
+    lap("flame_graph");
 }
 
-void DebugVisualizer::deserializePayloadData()
+bool DebugVisualizer::deserializePayloadData(const QString& filepath, VisualizerPayload& payload)
 {
     // setup and initialize input file stream
-    QFile input_datafile(QCoreApplication::applicationDirPath() + "/memdbgvis.dat");
+    QFile input_datafile(filepath);
 
     // deserialize and load payload into member struct
     if (input_datafile.open(QIODevice::ReadOnly))
+        DebugVisualizer::deserializePayload(input_datafile.readAll(), payload);
+
+    return input_datafile.isOpen();
+}
+
+void DebugVisualizer::deserializePayload(const QByteArray& data, VisualizerPayload& payload)
+{
+    // the same text format is read from memdbgvis.dat and from snapshots in an archive
+    // the payload keeps the data and only records where every entry is, nothing is copied or converted to UTF-16 up front
+    payload.data = data;
+    const QByteArrayView text(payload.data);
+    unsigned data_section_idx = 0;
+    qsizetype line_idx = 0;
+
+    for (qsizetype line_begin = 0; line_begin < text.size(); line_idx++)
     {
-	    unsigned data_section_idx = 0;
-	    QTextStream input_textstream(&input_datafile);
-        this->m_agentData.lineNum = input_textstream.readLine().toInt();
-        this->m_agentData.threadName = input_textstream.readLine();
-        this->m_agentData.threadPriority = input_textstream.readLine();
+        // memdbgvis.dat is written in text mode, so its lines may end with a carriage return as well
+        qsizetype line_end = text.indexOf('\n', line_begin);
+        if (line_end < 0)
+            line_end = text.size();
+        QByteArrayView cur_line = text.sliced(line_begin, line_end - line_begin);
+        line_begin = line_end + 1;
+        if (cur_line.endsWith('\r'))
+            cur_line.chop(1);
 
-        // seven lines of JVM metrics
-        for (short i = 0; i < 7; i++)
-			this->m_agentData.metrics += input_textstream.readLine() + '\n';
+        // the header holds the line number, thread name and thread priority
+        if (line_idx < 3)
+        {
+            if (line_idx == 0)
+                payload.lineNum = cur_line.toInt();
+            else if (line_idx == 1)
+                payload.threadName = QString::fromUtf8(cur_line);
+            else
+                payload.threadPriority = QString::fromUtf8(cur_line);
+            continue;
+        }
 
-        while (!input_textstream.atEnd())
+        // advance to the next section
+        if (cur_line == "SECTION_END_BEGIN_NEW")
         {
-            // readLine() must only be called once each iteration; otherwise, it may advance to the next line
-            QString cur_line = input_textstream.readLine();
+            data_section_idx++;
+            continue; // advance to the next line as to not process the delimiter
+        }
+
+        // entries keyed by a reference code hold the key up to the first delimiter
+        const qsizetype key_end = cur_line.indexOf('\a');
+        const QByteArrayView key = key_end < 0 ? cur_line : cur_line.first(key_end);
+        const QByteArrayView value = key_end < 0 ? QByteArrayView() : cur_line.sliced(key_end + 1);
 
-            // advance to the next section
-            if (cur_line == "SECTION_END_BEGIN_NEW")
+        /*
+		 * DATA SECTION index for deserializing file contents to the payload struct.
+		 * 0 : Runtime Metrics
+		 * 1 : Call Stack Data
+		 * 2 : Local Variable Data
+		 * 3 : Class Field Data
+		 * 4 : Heap Object Data
+		 * 5 : Agent Capture Metrics
+		 * 6 : Array Block Hashes
+		 * 7 : Sampled Allocation Sites
+		 * 8 : Metrics Sampler Window
+		 * 9 : Capture Trigger
+		 * 10 : Thread Monitors
+		 * 11 : Sampled Profile
+		 */
+    	switch (data_section_idx)
+    	{
+		case 0:
+			payload.metrics.push_back(cur_line);
+			continue;
+		case 1:
+			payload.methodNames.push_back(cur_line);
+			continue;
+		case 2:
+			payload.localVars.push_back(cur_line);
+    		continue;
+        case 3:
+            payload.staticFields.push_back(cur_line);
+            continue;
+        case 4:
+        {
+            // contents that did not change since an archived snapshot are a reference to it, resolved from the archive
+            if (cur_line.startsWith("=#"))
             {
-                data_section_idx++;
-                continue; // advance to the next line as to not process the delimiter
+                payload.heapReferences[key.sliced(1)] = value.toULongLong();
+                continue;
             }
 
-            /*
-			 * DATA SECTION index for deserializing file contents to the payload struct.
-			 * 1 : Call Stack Data
-			 * 2 : Local Variable Data
-			 * 3 : Class Field Data
-			 * default : Heap Object Data
-			 */
-        	switch (data_section_idx)
-        	{
-			case 1:
-				this->m_agentData.methodNames.push_back(cur_line);
-				continue;
-			case 2:
-				this->m_agentData.localVars.push_back(cur_line);
-        		continue;
-            case 3:
-                this->m_agentData.staticFields.push_back(cur_line);
-                continue;
-			default:
-                QStringList components = cur_line.split('\a');
-                this->m_agentData.heapByteMap[components[0]] = components[1];
-        	}
+            // object array summaries continue with one delimited field per line of the summary, split when they are shown
+            payload.heapByteMap[key] = value;
+            continue;
+        }
+		case 5:
+			payload.captureMetrics.push_back(cur_line);
+			continue;
+        case 6:
+        {
+            // block size and comma separated hashes, keyed by the array's reference code
+            payload.arrayBlockHashes[key] = value;
+            continue;
+        }
+        case 7:
+            payload.allocationSites.push_back(cur_line);
+            continue;
+        case 8:
+            payload.metricsWindow.push_back(cur_line);
+            continue;
+        case 9:
+            payload.trigger = QString::fromUtf8(cur_line);
+            continue;
+        case 10:
+            payload.monitors.push_back(cur_line);
+            continue;
+        case 11:
+            payload.profile.push_back(cur_line);
+            continue;
+		default:
+			continue; // sections written by a newer agent are ignored
+    	}
+    }
+}
+
+void DebugVisualizer::resolveHeapReferences(const SnapshotArchive& archive, VisualizerPayload& payload)
+{
+    // the heap and block hash sections of every referenced snapshot are read once, however many objects refer to it
+    // the payload keeps their data next to its own, since its entries now point into it
+    QHash<quint64, VisualizerPayload> referenced;
+    for (auto reference = payload.heapReferences.cbegin(); reference != payload.heapReferences.cend(); ++reference)
+    {
+        const qsizetype row = archive.isOpen() ? archive.rowOf(reference.value()) : -1;
+        if (row < 0)
+        {
+            payload.referencedData.push_back(QString("Unchanged since snapshot %1, which is no longer in the archive.").arg(reference.value()).toUtf8());
+            payload.heapByteMap[reference.key()] = payload.referencedData.last();
+            continue;
+        }
+
+        auto snapshot = referenced.find(reference.value());
+        if (snapshot == referenced.end())
+        {
+            // sections 4 to 6 are read as a snapshot of their own, behind empty header lines and sections
+            snapshot = referenced.insert(reference.value(), VisualizerPayload{});
+            DebugVisualizer::deserializePayload("0\n\n\n" + QByteArray("SECTION_END_BEGIN_NEW\n").repeated(4) + archive.readSections(row, 4, 6), snapshot.value());
+            payload.referencedData.push_back(snapshot->data);
         }
+
+        payload.heapByteMap[reference.key()] = snapshot->heapByteMap.value(reference.key());
+        if (snapshot->arrayBlockHashes.contains(reference.key()))
+            payload.arrayBlockHashes[reference.key()] = snapshot->arrayBlockHashes.value(reference.key());
     }
 }
 
+QStringList DebugVisualizer::fields(QByteArrayView entry)
+{
+    // entries are only decoded once they are shown
+    return QString::fromUtf8(entry).split('\a');
+}
+
+QString DebugVisualizer::heapKey(const QStringList& components)
+{
+    // objects are keyed by the tag the agent gave them, older snapshots and untagged objects by their rendered text
+    if (components.size() >= 5 && components[4].toLongLong() != 0)
+        return '#' + components[4];
+    return components.value(2);
+}
+
 void DebugVisualizer::populateCallStackThreadView()
 {
     // populate the thread and metrics view
     this->ui.threadNameView->setText(this->m_agentData.threadName + '\n' + this->m_agentData.threadPriority);
+    if (!this->m_agentData.trigger.isEmpty())
+        this->ui.threadNameView->append("STOPPED BY: " + this->m_agentData.trigger);
     this->ui.lineNum->display(this->m_agentData.lineNum);
-	this->ui.runtimeMetricsView->setText(this->m_agentData.metrics);
+
+    // every metric holds: name, raw value, unit
+    QString metrics;
+    QStringList files;
+    for (const QByteArrayView metric : this->m_agentData.metrics)
+    {
+        const QStringList components = DebugVisualizer::fields(metric);
+        if (components.size() >= 3)
+            metrics += components[0] + ": " + DebugVisualizer::formatMetric(components[1], components[2]) + '\n';
+        if (components.size() >= 3 && components[2] == "file")
+            files.append(components[1]);
+    }
+	this->ui.runtimeMetricsView->setText(metrics);
+
+    // files written along with the snapshot, such as the heap dump, are linked below the metrics
+    for (const QString& file : files)
+        this->ui.runtimeMetricsView->append(QString("<a href=\"%1\">Open %2</a>").arg(QUrl::fromLocalFile(file).toString(), QFileInfo(file).fileName().toHtmlEscaped()));
 
     // populate call stack view
-    for (QString& method_name : this->m_agentData.methodNames)
-        this->ui.callStackWidget->addItem(method_name);
+    for (const QByteArrayView method_name : this->m_agentData.methodNames)
+        this->ui.callStackWidget->addItem(QString::fromUtf8(method_name));
+
+    // frames are aligned from the bottom of the stack, so callers that changed since the previous hit stand out
+    if (this->m_hasPrevious)
+    {
+        const qsizetype current_depth = this->m_agentData.methodNames.size(), previous_depth = this->m_previousData.methodNames.size();
+        for (qsizetype i = 1; i < current_depth; i++)
+        {
+            const qsizetype previous_idx = previous_depth - (current_depth - i);
+            if (previous_idx < 0 || this->m_previousData.methodNames[previous_idx] != this->m_agentData.methodNames[i])
+            {
+                this->ui.callStackWidget->item(i)->setBackground(QColor(255, 235, 150));
+                this->ui.callStackWidget->item(i)->setToolTip("This frame differs from the previous hit.");
+            }
+        }
+        this->ui.runtimeMetricsView->append("Compared with the previous hit of this line.");
+    }
+    else if (!this->m_previousData.methodNames.isEmpty())
+        this->ui.runtimeMetricsView->append("The previous hit was elsewhere, nothing to compare.");
 
     // emphasize the current stack frame
     this->ui.callStackWidget->item(0)->setFont(QFont("Consolas", this->ui.callStackWidget->font().pointSize(), QFont::Bold));
     this->ui.callStackWidget->item(0)->setBackground(Qt::yellow);
 }
 
+QString DebugVisualizer::formatMetric(const QString& value, const QString& unit)
+{
+    if (unit == "bytes")
+        return QString("%1 KiB").arg(value.toLongLong() >> 10);
+    if (unit == "ns")
+        return QString("%1 ms").arg(value.toDouble() / 1e6, 0, 'f', 3);
+    if (unit == "percent")
+        return QString("%1%").arg(value.toDouble(), 0, 'f', 2);
+    if (unit == "bytes/s")
+        return QString("%1 MiB/s").arg(value.toDouble() / (1 << 20), 0, 'f', 1);
+    return value;
+}
+
+void DebugVisualizer::populateCaptureMetricsView()
+{
+    if (this->m_agentData.captureMetrics.isEmpty())
+        return;
+
+    // each line holds: phase, nanoseconds, bytes produced, JNI calls, objects stringified, string bytes read, string nanoseconds,
+    // heap allocations of the agent and the bytes they asked for
+    QString summary = "\nCapture Phases:\n", details;
+    qlonglong total_nanos = 0, total_bytes = 0, total_jni_calls = 0, total_stringified = 0, string_bytes = 0, string_nanos = 0, allocations = 0, allocated_bytes = 0;
+
+    for (const QByteArrayView phase : this->m_agentData.captureMetrics)
+    {
+        const QStringList components = DebugVisualizer::fields(phase);
+        if (components.size() < 5)
+            continue;
+
+        const qlonglong nanos = components[1].toLongLong();
+        total_nanos += nanos;
+        total_bytes += components[2].toLongLong();
+        total_jni_calls += components[3].toLongLong();
+        total_stringified += components[4].toLongLong();
+        if (components.size() >= 7)
+        {
+            string_bytes += components[5].toLongLong();
+            string_nanos += components[6].toLongLong();
+        }
+        if (components.size() >= 9)
+        {
+            allocations += components[7].toLongLong();
+            allocated_bytes += components[8].toLongLong();
+        }
+
+        // serialization and launch happen after the snapshot is written
+        if (nanos == 0)
+            continue;
+
+        QString name = components[0];
+        name.replace('_', ' ');
+        summary += QString("%1: %2 ms\n").arg(name).arg(nanos / 1e6, 0, 'f', 3);
+        details += QString("%1: %2 ms, %3 bytes, %4 JNI calls, %5 objects stringified\n").arg(name).arg(nanos / 1e6, 0, 'f', 3).arg(components[2], components[3], components[4]);
+    }
+
+    summary += QString("Capture Time: %1 ms\nPayload: %2 KiB\nJNI Calls: %3\nStringified: %4").arg(total_nanos / 1e6, 0, 'f', 3).arg(total_bytes >> 10).arg(total_jni_calls).arg(total_stringified);
+
+    // bytes per nanosecond is the same as gigabytes per second
+    if (string_nanos > 0)
+        summary += QString("\nString Capture: %1 GB/s (%2 KiB)").arg(static_cast<double>(string_bytes) / string_nanos, 0, 'f', 2).arg(string_bytes >> 10);
+    if (allocations > 0)
+        summary += QString("\nAgent Allocations: %1 (%2 KiB)").arg(allocations).arg(allocated_bytes >> 10);
+    this->ui.runtimeMetricsView->append(summary);
+    this->ui.runtimeMetricsView->setToolTip(details.trimmed());
+}
+
 void DebugVisualizer::populateLocalVarTable()
 {
 	QTableWidget* local_var_table = this->ui.localVarTableWidget;
 
-    for (QString& var : this->m_agentData.localVars)
+    for (const QByteArrayView var : this->m_agentData.localVars)
     {
-        QStringList var_components = var.split('\a');
+        QStringList var_components = DebugVisualizer::fields(var);
         local_var_table->insertRow(local_var_table->rowCount());
 
         // display the unicode view rather than the raw byte
@@ -118,14 +401,17 @@ void DebugVisualizer::populateLocalVarTable()
             if (var_components[1] == "this") /* give special highlighting to 'this' reference */
                 local_var_table->item(local_var_table->rowCount() - 1, i)->setBackground(Qt::cyan);
         }
+        if (!this->m_heapKeys.contains(var_components[2]))
+            this->m_heapKeys[var_components[2]] = DebugVisualizer::heapKey(var_components);
+        this->markChangedRow(local_var_table, local_var_table->rowCount() - 1, var, this->m_previousData.localVars);
     }
 }
 
 void DebugVisualizer::populateStaticFieldTable()
 {
-    for (QString& global : this->m_agentData.staticFields)
+    for (const QByteArrayView global : this->m_agentData.staticFields)
     {
-        QStringList components = global.split('\a');
+        QStringList components = DebugVisualizer::fields(global);
         this->ui.staticFieldsTable->insertRow(this->ui.staticFieldsTable->rowCount());
 
         // display the unicode view rather than the raw byte
@@ -145,25 +431,352 @@ void DebugVisualizer::populateStaticFieldTable()
 
         for (int i = 0; i < 3; i++)
             this->ui.staticFieldsTable->setItem(this->ui.staticFieldsTable->rowCount() - 1, i, new QTableWidgetItem(components[i]));
+        if (!this->m_heapKeys.contains(components[2]))
+            this->m_heapKeys[components[2]] = DebugVisualizer::heapKey(components);
+        this->markChangedRow(this->ui.staticFieldsTable, this->ui.staticFieldsTable->rowCount() - 1, global, this->m_previousData.staticFields);
     }
 }
 
+void DebugVisualizer::markChangedRow(QTableWidget* table, const int row, const QByteArrayView entry, const QVector<QByteArrayView>& previousEntries)
+{
+    if (!this->m_hasPrevious)
+        return;
+
+    // variables are matched by data type and name since their order may change between hits
+    const QStringList components = DebugVisualizer::fields(entry);
+    for (const QByteArrayView previous_entry : previousEntries)
+    {
+        const QStringList previous = DebugVisualizer::fields(previous_entry);
+        if (previous.size() < 3 || components.size() < 3 || previous[0] != components[0] || previous[1] != components[1])
+            continue;
+
+        QString tooltip;
+        const QString key = DebugVisualizer::heapKey(components), previous_key = DebugVisualizer::heapKey(previous);
+        const QByteArray key_bytes = key.toUtf8(), previous_key_bytes = previous_key.toUtf8();
+        const bool same_object = previous_key == key && previous[2] == components[2];
+        if (this->m_agentData.heapByteMap.contains(key_bytes) && this->m_previousData.heapByteMap.contains(previous_key_bytes))
+        {
+            // object references are compared by content, a mutated array keeps its tag and its reference code
+            const QByteArrayView before = this->m_previousData.heapByteMap.value(previous_key_bytes);
+            const QByteArrayView after = this->m_agentData.heapByteMap.value(key_bytes);
+            if (before == after && same_object)
+                return;
+
+            const QVector<IndexRange> ranges = SnapshotDiff::diffArrays(before, after, this->m_previousData.arrayBlockHashes.value(previous_key_bytes), this->m_agentData.arrayBlockHashes.value(key_bytes));
+            if (!ranges.isEmpty())
+            {
+                this->m_arrayChanges[key] = ranges;
+                tooltip = QString("%1 elements changed: %2").arg(SnapshotDiff::countElements(ranges)).arg(SnapshotDiff::describeRanges(ranges, 8));
+            }
+            else if (before != after)
+                tooltip = "Contents changed since the previous hit.";
+            else if (previous[2] == components[2])
+                tooltip = "Same contents, but a different object than at the previous hit.";
+            else
+                tooltip = "Previous value: " + previous[2];
+        }
+        else if (same_object)
+            return;
+        else if (previous[2] == components[2])
+            tooltip = "Same value, but a different object than at the previous hit.";
+        else
+            tooltip = "Previous value: " + previous[2];
+
+        for (int i = 0; i < table->columnCount(); i++)
+        {
+            if (QTableWidgetItem* item = table->item(row, i))
+            {
+                item->setBackground(QColor(255, 235, 150));
+                item->setToolTip(tooltip);
+            }
+        }
+        return;
+    }
+
+    // not present at the previous hit
+    for (int i = 0; i < table->columnCount(); i++)
+    {
+        if (QTableWidgetItem* item = table->item(row, i))
+        {
+            item->setBackground(QColor(200, 240, 200));
+            item->setToolTip("New since the previous hit.");
+        }
+    }
+}
+
+void DebugVisualizer::populateObjectExplorer()
+{
+    // the agent passes the name of its drill-down channel when it waits for requests
+    const QStringList arguments = QCoreApplication::arguments();
+    const qsizetype session_idx = arguments.indexOf("--session");
+    if (session_idx >= 0 && session_idx + 1 < arguments.size())
+        this->m_drillDown = std::make_unique<DrillDownClient>(arguments[session_idx + 1]);
+
+    QTreeWidget* tree = this->ui.objectExplorerTree;
+    if (this->m_drillDown == nullptr || !this->m_drillDown->isConnected())
+    {
+        tree->addTopLevelItem(new QTreeWidgetItem(QStringList{ "Objects can only be explored while the program is paused by memdbgvis." }));
+        tree->setEnabled(false);
+        return;
+    }
+
+    // every object in the snapshot carries the handle the agent pinned it with
+    const auto add_group = [tree](const QString& title, const QVector<QByteArrayView>& entries)
+    {
+        auto* group = new QTreeWidgetItem(tree, QStringList{ title });
+        for (const QByteArrayView entry : entries)
+        {
+            const QStringList components = DebugVisualizer::fields(entry);
+            if (components.size() < 4 || components[3].toULongLong() == 0)
+                continue;
+
+            auto* item = new QTreeWidgetItem(group, QStringList{ components[1], components[0], components[2] });
+            DebugVisualizer::setupExplorerItem(item, components[0], components[3].toULongLong());
+        }
+        group->setExpanded(true);
+    };
+
+    add_group("Local Variables", this->m_agentData.localVars);
+    add_group("Static Fields", this->m_agentData.staticFields);
+}
+
+void DebugVisualizer::populateAllocationView()
+{
+    QTreeWidget* tree = this->ui.allocationTree;
+    if (this->m_agentData.allocationSites.isEmpty())
+    {
+        tree->addTopLevelItem(new QTreeWidgetItem(QStringList{ "Start the agent with the allocsample option to sample allocations." }));
+        tree->setEnabled(false);
+        return;
+    }
+
+    // the first line holds the totals since the previous hit: bytes, samples, sampling interval
+    const QStringList totals = DebugVisualizer::fields(this->m_agentData.allocationSites.first());
+    if (totals.size() >= 4 && totals[0] == "TOTAL")
+        this->ui.runtimeMetricsView->append(QString("Sampled Allocations: %1 KiB in %2 samples (one every %3 KiB)").arg(totals[1].toLongLong() >> 10).arg(totals[2]).arg(totals[3].toLongLong() >> 10));
+
+    // every site holds: bytes, samples, class, then its frames with the allocating method first
+    for (const QByteArrayView line : this->m_agentData.allocationSites.mid(1))
+    {
+        const QStringList components = DebugVisualizer::fields(line);
+        if (components.size() < 4)
+            continue;
+
+        auto* site = new QTreeWidgetItem(tree, QStringList{ components[3], components[2] });
+        site->setData(2, Qt::DisplayRole, components[0].toLongLong());
+        site->setData(3, Qt::DisplayRole, components[1].toLongLong());
+        site->setToolTip(0, components.mid(3).join('\n'));
+        for (const QString& frame : components.mid(4))
+            new QTreeWidgetItem(site, QStringList{ frame });
+    }
+
+    // numeric columns sort by value, largest first
+    tree->sortByColumn(2, Qt::DescendingOrder);
+    tree->resizeColumnToContents(0);
+}
+
+void DebugVisualizer::populateLockView()
+{
+    QTreeWidget* tree = this->ui.lockTree;
+    if (this->m_agentData.monitors.isEmpty())
+    {
+        tree->addTopLevelItem(new QTreeWidgetItem(QStringList{ "Start the agent with the monitors or contention option to see the locks of every thread." }));
+        tree->setEnabled(false);
+        return;
+    }
+
+    // threads are referred to by their index, monitors by their tag, and contention may be recorded for monitors nobody holds right now
+    QHash<int, QString> threads;
+    QVector<QStringList> deadlocks;
+    QMap<QString, QTreeWidgetItem*> monitors;
+    QSet<QString> deadlocked;
+    const auto thread_names = [&threads](const QString& indices)
+    {
+        QStringList names;
+        for (const QString& index : indices.split(',', Qt::SkipEmptyParts))
+            names.push_back(threads.value(index.toInt(), "thread " + index));
+        return names;
+    };
+    const auto monitor_item = [tree, &monitors](const QString& tag, const QString& description)
+    {
+        QTreeWidgetItem*& item = monitors[tag];
+        if (item == nullptr)
+            item = new QTreeWidgetItem(tree, QStringList{ description });
+        return item;
+    };
+
+    for (const QByteArrayView line : this->m_agentData.monitors)
+    {
+        const QStringList components = DebugVisualizer::fields(line);
+        if (components.size() >= 4 && components[0] == "THREAD")
+            threads.insert(components[1].toInt(), QString("%1 (%2)").arg(components[2], components[3]));
+        else if (components.size() >= 2 && components[0] == "DEADLOCK")
+        {
+            deadlocks.push_back(thread_names(components[1]));
+            for (const QString& index : components[1].split(',', Qt::SkipEmptyParts))
+                deadlocked.insert(index);
+        }
+        else if (components.size() >= 7 && components[0] == "MONITOR")
+        {
+            // the owner, then the threads blocked entering the monitor and those waiting in Object.wait() on it
+            QTreeWidgetItem* monitor = monitor_item(components[1], components[2]);
+            const QStringList blocked = thread_names(components[5]), waiting = thread_names(components[6]);
+            if (components[3].toInt() >= 0)
+            {
+                const QString owner = threads.value(components[3].toInt(), "thread " + components[3]);
+                monitor->setText(1, owner);
+                new QTreeWidgetItem(monitor, QStringList{ "Owned by " + owner + (components[4].isEmpty() ? QString() : " in " + components[4]) });
+            }
+            monitor->setData(2, Qt::DisplayRole, blocked.size());
+            monitor->setData(3, Qt::DisplayRole, waiting.size());
+            for (const QString& thread : blocked)
+                new QTreeWidgetItem(monitor, QStringList{ "Blocked: " + thread });
+            for (const QString& thread : waiting)
+                new QTreeWidgetItem(monitor, QStringList{ "Waiting: " + thread });
+        }
+        else if (components.size() >= 8 && components[0] == "CONTENTION")
+        {
+            // entries, total, median, 99th percentile and longest wait in nanoseconds since the previous hit
+            QTreeWidgetItem* monitor = monitor_item(components[1], components[2]);
+            monitor->setData(4, Qt::DisplayRole, components[3].toLongLong());
+            monitor->setData(5, Qt::DisplayRole, components[4].toLongLong() / 1000);
+            monitor->setData(6, Qt::DisplayRole, components[7].toLongLong() / 1000);
+            monitor->setToolTip(0, QString("Median wait: %1 \u00B5s\n99th percentile: %2 \u00B5s").arg(components[5].toLongLong() / 1000).arg(components[6].toLongLong() / 1000));
+        }
+    }
+
+    // every deadlock is listed with the runtime metrics, and the monitors its threads hold are shown in red
+    for (const QStringList& cycle : deadlocks)
+    {
+        if (!cycle.isEmpty())
+            this->ui.runtimeMetricsView->append("Deadlock: " + cycle.join(" -> ") + " -> " + cycle.first());
+    }
+    for (const QByteArrayView line : this->m_agentData.monitors)
+    {
+        const QStringList components = DebugVisualizer::fields(line);
+        if (components.size() < 7 || components[0] != "MONITOR" || !deadlocked.contains(components[3]))
+            continue;
+
+        QTreeWidgetItem* monitor = monitors.value(components[1]);
+        monitor->setForeground(0, Qt::red);
+        monitor->setForeground(1, Qt::red);
+        monitor->setExpanded(true);
+    }
+
+    // the monitors threads waited for the longest come first
+    tree->sortByColumn(5, Qt::DescendingOrder);
+    tree->resizeColumnToContents(0);
+}
+
+void DebugVisualizer::populateProfileView()
+{
+    this->ui.flameGraph->setProfile(this->m_agentData.profile);
+
+    // the first line holds the totals since the previous hit: samples, nanoseconds covered, interval, batches, sampler nanoseconds, truncated samples
+    const QStringList totals = this->m_agentData.profile.isEmpty() ? QStringList() : DebugVisualizer::fields(this->m_agentData.profile.first());
+    if (totals.size() < 7 || totals[0] != "PROFILE" || totals[2].toLongLong() <= 0)
+        return;
+
+    const double seconds = totals[2].toDouble() / 1e9;
+    this->ui.runtimeMetricsView->append(QString("Profile: %1 samples over %2 s, %3 stack batches per second (one every %4 ms requested)").arg(totals[1]).arg(seconds, 0, 'f', 1).arg(totals[4].toDouble() / seconds, 0, 'f', 1).arg(totals[3]));
+    this->ui.runtimeMetricsView->append(QString("Profiler Overhead: %1% of the time spent taking stacks").arg(totals[5].toDouble() / totals[2].toDouble() * 100, 0, 'f', 2));
+    if (totals[6].toLongLong() > 0)
+        this->ui.runtimeMetricsView->append(QString("Profile Truncated: %1 samples did not fit the agent's tree").arg(totals[6]));
+}
+
+void DebugVisualizer::setupExplorerItem(QTreeWidgetItem* item, const QString& type, const qulonglong handle)
+{
+    item->setData(0, HANDLE_ROLE, handle);
+    item->setData(0, ARRAY_ROLE, type.endsWith("[]"));
+    item->setToolTip(2, item->text(2));
+    if (handle != 0)
+        item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+}
+
+void DebugVisualizer::loadExplorerChildren(QTreeWidgetItem* item, const int offset)
+{
+    const QString handle = QString::number(item->data(0, HANDLE_ROLE).toULongLong());
+    const bool is_array = item->data(0, ARRAY_ROLE).toBool();
+    QString error;
+
+    // arrays are requested one page at a time, objects with all of their fields
+    const QStringList lines = is_array
+        ? this->m_drillDown->request({ "RANGE", handle, QString::number(offset), QString::number(PAGE_SIZE) }, error)
+        : this->m_drillDown->request({ "FIELDS", handle }, error);
+
+    if (!error.isEmpty())
+    {
+        new QTreeWidgetItem(item, QStringList{ error });
+        return;
+    }
+
+    int length = 0;
+    for (const QString& line : lines)
+    {
+        // each line holds: data type, name, value, handle
+        const QStringList components = line.split('\a');
+        if (components[0] == "LENGTH")
+            length = components.value(1).toInt();
+        else if (components.size() >= 4)
+            DebugVisualizer::setupExplorerItem(new QTreeWidgetItem(item, QStringList{ components[1], components[0], components[2] }), components[0], components[3].toULongLong());
+    }
+
+    if (is_array && offset + PAGE_SIZE < length)
+    {
+        auto* more = new QTreeWidgetItem(item, QStringList{ QString("Show elements %1 to %2 of %3...").arg(offset + PAGE_SIZE).arg(std::min(offset + 2 * PAGE_SIZE, length) - 1).arg(length) });
+        more->setData(0, OFFSET_ROLE, offset + PAGE_SIZE);
+    }
+}
+
+void DebugVisualizer::onExplorerItemExpanded(QTreeWidgetItem* item)
+{
+    // children are requested from the agent the first time an object is expanded
+    if (item->data(0, HANDLE_ROLE).toULongLong() == 0 || item->data(0, LOADED_ROLE).toBool())
+        return;
+
+    item->setData(0, LOADED_ROLE, true);
+    this->loadExplorerChildren(item, 0);
+}
+
+void DebugVisualizer::onExplorerItemActivated(QTreeWidgetItem* item)
+{
+    // the "Show elements" row is replaced by the next page of its array
+    const int offset = item->data(0, OFFSET_ROLE).toInt();
+    if (offset == 0 || item->parent() == nullptr)
+        return;
+
+    QTreeWidgetItem* parent = item->parent();
+    delete item;
+    this->loadExplorerChildren(parent, offset);
+}
+
 void DebugVisualizer::onInspectButtonClicked()
 {
     // user input
-	const QString ref_code = this->ui.plainTextEdit->toPlainText();
+	const QString input = this->ui.plainTextEdit->toPlainText();
+
+    // a reference code from the tables is looked up by the tag of its object, a tag can also be entered as #id
+    const QString ref_code = this->m_heapKeys.value(input, input);
+    const QByteArray ref_key = ref_code.toUtf8();
 
     // object reference code not found
-    if (this->m_agentData.heapByteMap[ref_code] == nullptr)
+    if (!this->m_agentData.heapByteMap.contains(ref_key))
     {
         this->ui.textBrowser->setText("Invalid object reference! Make sure you are taking object reference codes from the 'Local Variables' and 'Static Fields' tabs ONLY.");
         return;
     }
 
+    // only the object that is shown is decoded, summaries of object arrays list one field per line
+    const QString contents = QString::fromUtf8(this->m_agentData.heapByteMap.value(ref_key)).replace('\a', '\n');
+
     // display array references
-	if (this->m_agentData.heapByteMap[ref_code].contains('{'))
+	if (contents.contains('{'))
 	{
-		this->ui.textBrowser->setText(this->m_agentData.heapByteMap[ref_code]);
+        // elements that changed since the previous hit are listed ahead of the contents
+        QString changes;
+        if (this->m_arrayChanges.contains(ref_code))
+            changes = QString("Changed since the previous hit: %1\n\n").arg(SnapshotDiff::describeRanges(this->m_arrayChanges[ref_code], 32));
+		this->ui.textBrowser->setText(changes + contents);
         return;
 	}
 
@@ -171,7 +784,7 @@ void DebugVisualizer::onInspectButtonClicked()
     QString hexdump, formatted_str, formatted;
     QVector<QChar> unicodes;
     bool isSpace = false;
-    QStringList bytes = this->m_agentData.heapByteMap[ref_code].split(' ');
+    QStringList bytes = contents.split(' ');
 
     // group the bytes into 2 hex digits
     for (const QString& byte_grouping : bytes)
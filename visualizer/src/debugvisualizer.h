@@ -5,37 +5,84 @@
 
 #include <QtWidgets>
 #include "ui_debugvisualizer.h"
+#include "drilldownclient.h"
+#include "snapshotarchive.h"
+#include "snapshotdiff.h"
 
+// the snapshot is kept as one buffer as it was read, every entry is a view into it or into an archived snapshot it refers to
 typedef struct
 {
+    QByteArray data;
+    QVector<QByteArray> referencedData;
     int lineNum;
     QString threadName;
     QString threadPriority;
-    QString metrics;
-    QVector<QString> methodNames;
-    QVector<QString> localVars;
-    QVector<QString> staticFields;
-    QMap<QString, QString> heapByteMap;
+    QVector<QByteArrayView> metrics;
+    QVector<QByteArrayView> methodNames;
+    QVector<QByteArrayView> localVars;
+    QVector<QByteArrayView> staticFields;
+    QHash<QByteArrayView, QByteArrayView> heapByteMap;
+    QHash<QByteArrayView, quint64> heapReferences;
+    QVector<QByteArrayView> captureMetrics;
+    QHash<QByteArrayView, QByteArrayView> arrayBlockHashes;
+    QVector<QByteArrayView> allocationSites;
+    QVector<QByteArrayView> metricsWindow;
+    QString trigger;
+    QVector<QByteArrayView> monitors;
+    QVector<QByteArrayView> profile;
 } VisualizerPayload;
 
 class DebugVisualizer final : public QMainWindow
 {
     Q_OBJECT
+    friend class VisualizerBenchmark;
 
 public:
     explicit DebugVisualizer(QWidget *parent = Q_NULLPTR);
+    DebugVisualizer(const VisualizerPayload& payload, const QString& title, QWidget *parent = Q_NULLPTR);
     ~DebugVisualizer() Q_DECL_OVERRIDE Q_DECL_EQ_DEFAULT;
-    void deserializePayloadData();
+    static bool deserializePayloadData(const QString& filepath, VisualizerPayload& payload);
+    static void deserializePayload(const QByteArray& data, VisualizerPayload& payload);
+    static void resolveHeapReferences(const SnapshotArchive& archive, VisualizerPayload& payload);
     void populateCallStackThreadView();
+    void populateCaptureMetricsView();
     void populateLocalVarTable();
     void populateStaticFieldTable();
+    void populateObjectExplorer();
+    void populateAllocationView();
+    void populateLockView();
+    void populateProfileView();
 
 private slots:
     void onInspectButtonClicked();
+    void onExplorerItemExpanded(QTreeWidgetItem* item);
+    void onExplorerItemActivated(QTreeWidgetItem* item);
 
 private:
+    // item data roles of the object explorer tree
+    static constexpr int HANDLE_ROLE = Qt::UserRole;
+    static constexpr int ARRAY_ROLE = Qt::UserRole + 1;
+    static constexpr int LOADED_ROLE = Qt::UserRole + 2;
+    static constexpr int OFFSET_ROLE = Qt::UserRole + 3;
+    static constexpr int PAGE_SIZE = 100;
+
     Ui::DebugVisualizerClass ui{};
     VisualizerPayload m_agentData;
+    VisualizerPayload m_previousData;
+    bool m_hasPrevious = false;
+    QMap<QString, QVector<IndexRange>> m_arrayChanges;
+    QMap<QString, QString> m_heapKeys;
+    std::unique_ptr<DrillDownClient> m_drillDown;
+    QVector<QPair<QString, qint64>> m_viewNanos;
+
+    void setupWindow();
+    void populateViews();
+    static QString formatMetric(const QString& value, const QString& unit);
+    static QStringList fields(QByteArrayView entry);
+    static QString heapKey(const QStringList& components);
+    static void setupExplorerItem(QTreeWidgetItem* item, const QString& type, qulonglong handle);
+    void loadExplorerChildren(QTreeWidgetItem* item, int offset);
+    void markChangedRow(QTableWidget* table, int row, QByteArrayView entry, const QVector<QByteArrayView>& previousEntries);
 };
 
 #endif // DEBUGVISUALIZER_H
\ No newline at end of file
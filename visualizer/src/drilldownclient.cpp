@@ -0,0 +1,50 @@
+#include "drilldownclient.h"
+
+DrillDownClient::DrillDownClient(const QString& sessionName)
+{
+    // the agent creates the pipe before launching the visualizer, so it is already listening
+    this->m_socket.connectToServer(sessionName);
+    this->m_socket.waitForConnected(TIMEOUT_MS);
+}
+
+bool DrillDownClient::isConnected() const
+{
+    return this->m_socket.state() == QLocalSocket::ConnectedState;
+}
+
+QStringList DrillDownClient::request(const QStringList& arguments, QString& error)
+{
+    QStringList lines;
+    if (!this->isConnected())
+    {
+        error = "The program is no longer paused.";
+        return lines;
+    }
+
+    this->m_socket.write((arguments.join('\a') + '\n').toUtf8());
+    this->m_socket.flush();
+
+    // responses are read line by line until the terminator arrives
+    forever
+    {
+        while (!this->m_socket.canReadLine())
+        {
+            if (!this->m_socket.waitForReadyRead(TIMEOUT_MS))
+            {
+                error = "The program did not answer in time.";
+                return {};
+            }
+        }
+
+        const QString line = QString::fromUtf8(this->m_socket.readLine()).chopped(1);
+        if (line == "END")
+            break;
+
+        if (line.startsWith("ERROR\a"))
+            error = line.section('\a', 1);
+        else
+            lines.push_back(line);
+    }
+
+    return lines;
+}
\ No newline at end of file
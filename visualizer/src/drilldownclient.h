@@ -0,0 +1,24 @@
+#pragma once
+
+#ifndef DRILLDOWNCLIENT_H
+#define DRILLDOWNCLIENT_H
+
+#include <QtNetwork>
+
+/*
+ * Visualizer side of the agent's drill-down channel. Requests are sent while the Java thread is suspended,
+ * so every call blocks until the agent has answered with its "END" line or the timeout expires.
+ */
+class DrillDownClient
+{
+    static constexpr int TIMEOUT_MS = 5000;
+    QLocalSocket m_socket;
+
+public:
+    explicit DrillDownClient(const QString& sessionName);
+    ~DrillDownClient() = default;
+    bool isConnected() const;
+    QStringList request(const QStringList& arguments, QString& error);
+};
+
+#endif // DRILLDOWNCLIENT_H
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "flamegraph.h"
+
+FlameGraph::FlameGraph(QWidget* parent)
+    : QWidget(parent)
+{
+    this->setAutoFillBackground(true);
+    this->setBackgroundRole(QPalette::Base);
+    this->setFocusPolicy(Qt::ClickFocus);
+}
+
+void FlameGraph::setProfile(const QVector<QByteArrayView>& profile)
+{
+    // every node below the first line holds: depth, method, total samples, self samples, listed with parents before their children
+    QVector<FlameFrame> nodes;
+    QVector<QVector<int>> children;
+    QVector<int> roots, path;
+    for (const QByteArrayView line : profile)
+    {
+        const QStringList components = QString::fromUtf8(line).split('\a');
+        if (components.size() < 4 || components[0] == "PROFILE")
+            continue;
+
+        const int depth = components[0].toInt();
+        if (depth < 0 || depth > path.size())
+            continue;
+
+        path.resize(depth);
+        const int index = static_cast<int>(nodes.size());
+        nodes.push_back({ components[1], depth, 0, components[2].toLongLong(), components[3].toLongLong() });
+        children.push_back({});
+        (depth == 0 ? roots : children[path.last()]).push_back(index);
+        path.push_back(index);
+    }
+
+    // siblings are laid out side by side from their parent's left edge, the hottest first
+    this->m_frames.clear();
+    this->m_frames.reserve(nodes.size());
+    this->m_depth = 0;
+    const auto by_samples = [&nodes](const int a, const int b) { return nodes[a].total > nodes[b].total; };
+    const auto layout = [&](const auto& self, QVector<int>& siblings, qint64 begin) -> void
+    {
+        std::sort(siblings.begin(), siblings.end(), by_samples);
+        for (const int index : siblings)
+        {
+            nodes[index].begin = begin;
+            this->m_frames.push_back(nodes[index]);
+            this->m_depth = qMax(this->m_depth, nodes[index].depth + 1);
+            self(self, children[index], begin);
+            begin += nodes[index].total;
+        }
+    };
+    layout(layout, roots, 0);
+
+    this->m_samples = 0;
+    for (const int root : roots)
+        this->m_samples += nodes[root].total;
+    this->m_scroll = 0;
+    this->zoom(0, static_cast<double>(this->m_samples));
+}
+
+QRectF FlameGraph::frameRect(const FlameFrame& frame) const
+{
+    // the outermost frames sit on the bottom row, scrolling moves the rows down to reveal deep stacks
+    const QRect area = this->rect().adjusted(MARGIN, MARGIN, -MARGIN, -MARGIN);
+    const double scale = area.width() / qMax(this->m_viewEnd - this->m_viewBegin, 1.0);
+    const double left = area.left() + (static_cast<double>(frame.begin) - this->m_viewBegin) * scale;
+    const double top = area.bottom() - (frame.depth + 1) * ROW_HEIGHT + this->m_scroll;
+    return QRectF(left, top, static_cast<double>(frame.total) * scale, ROW_HEIGHT).intersected(QRectF(area));
+}
+
+const FlameFrame* FlameGraph::frameAt(const QPoint& position) const
+{
+    for (const FlameFrame& frame : this->m_frames)
+    {
+        if (this->frameRect(frame).contains(position))
+            return &frame;
+    }
+    return nullptr;
+}
+
+void FlameGraph::zoom(const double begin, const double end)
+{
+    // the view never narrows below a single sample or leaves the profile
+    const double width = qBound(1.0, end - begin, qMax(static_cast<double>(this->m_samples), 1.0));
+    this->m_viewBegin = qBound(0.0, begin, qMax(static_cast<double>(this->m_samples) - width, 0.0));
+    this->m_viewEnd = this->m_viewBegin + width;
+    this->update();
+}
+
+QColor FlameGraph::frameColor(const QString& method)
+{
+    // warm colours picked by the method name, so a method keeps its colour across zooms and snapshots
+    // the agent's stand-ins for methods it could not keep apart are grey
+    if (method.startsWith('<'))
+        return QColor(180, 180, 180);
+    const size_t hash = qHash(method);
+    return QColor::fromHsv(static_cast<int>(hash % 50), 170 + static_cast<int>((hash >> 8) % 60), 225 + static_cast<int>((hash >> 16) % 30));
+}
+
+bool FlameGraph::event(QEvent* event)
+{
+    if (event->type() != QEvent::ToolTip)
+        return QWidget::event(event);
+
+    const auto* help = static_cast<QHelpEvent*>(event);
+    const FlameFrame* frame = this->frameAt(help->pos());
+    if (frame == nullptr)
+    {
+        QToolTip::hideText();
+        event->ignore();
+        return true;
+    }
+
+    const double percent = this->m_samples > 0 ? 100.0 * static_cast<double>(frame->total) / static_cast<double>(this->m_samples) : 0;
+    QToolTip::showText(help->globalPos(), QString("%1\n%2 samples (%3%), %4 in the method itself").arg(frame->method).arg(frame->total).arg(percent, 0, 'f', 2).arg(frame->self), this);
+    return true;
+}
+
+void FlameGraph::paintEvent(QPaintEvent* event)
+{
+    QPainter painter(this);
+    if (this->m_samples == 0)
+    {
+        painter.drawText(this->rect(), Qt::AlignCenter, "No samples. Start the agent with the profile option to sample the stacks of all threads.");
+        return;
+    }
+
+    // frames narrower than a pixel are left out, and so are their callees, which are narrower still
+    const QRect area = this->rect().adjusted(MARGIN, MARGIN, -MARGIN, -MARGIN);
+    const QFontMetrics metrics = painter.fontMetrics();
+    for (const FlameFrame& frame : this->m_frames)
+    {
+        const QRectF bounds = this->frameRect(frame);
+        if (bounds.width() < 1 || bounds.height() < 1 || !bounds.intersects(QRectF(area)))
+            continue;
+
+        painter.fillRect(bounds.adjusted(0, 0, -1, -1), FlameGraph::frameColor(frame.method));
+        if (bounds.width() > 30)
+        {
+            painter.setPen(Qt::black);
+            painter.drawText(bounds.adjusted(4, 0, -4, 0), Qt::AlignLeft | Qt::AlignVCenter, metrics.elidedText(frame.method, Qt::ElideRight, static_cast<int>(bounds.width()) - 8));
+        }
+    }
+}
+
+void FlameGraph::mousePressEvent(QMouseEvent* event)
+{
+    if (event->button() == Qt::RightButton)
+    {
+        this->zoom(0, static_cast<double>(this->m_samples));
+        return;
+    }
+
+    const FlameFrame* frame = this->frameAt(event->position().toPoint());
+    if (event->button() == Qt::LeftButton && frame != nullptr)
+        this->zoom(static_cast<double>(frame->begin), static_cast<double>(frame->begin + frame->total));
+}
+
+void FlameGraph::wheelEvent(QWheelEvent* event)
+{
+    const QRect area = this->rect().adjusted(MARGIN, MARGIN, -MARGIN, -MARGIN);
+    const double steps = event->angleDelta().y() / 120.0;
+    if (event->modifiers() & Qt::ControlModifier)
+    {
+        // the sample under the cursor stays where it is
+        const double anchor = this->m_viewBegin + (event->position().x() - area.left()) / qMax(area.width(), 1) * (this->m_viewEnd - this->m_viewBegin);
+        const double factor = std::pow(0.8, steps);
+        this->zoom(anchor - (anchor - this->m_viewBegin) * factor, anchor + (this->m_viewEnd - anchor) * factor);
+        return;
+    }
+
+    this->m_scroll = qBound(0, this->m_scroll + static_cast<int>(steps * 3 * ROW_HEIGHT), qMax(this->m_depth * ROW_HEIGHT - area.height(), 0));
+    this->update();
+}
+
+void FlameGraph::keyPressEvent(QKeyEvent* event)
+{
+    if (event->key() != Qt::Key_Escape)
+    {
+        QWidget::keyPressEvent(event);
+        return;
+    }
+    this->zoom(0, static_cast<double>(this->m_samples));
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#ifndef FLAMEGRAPH_H
+#define FLAMEGRAPH_H
+
+#include <QtWidgets>
+
+// a node of the calling-context tree, laid out in samples from the left edge of the whole profile
+typedef struct
+{
+    QString method;
+    int depth;
+    qint64 begin;
+    qint64 total;
+    qint64 self;
+} FlameFrame;
+
+/*
+ * Flame graph of the agent's stack profiler. Every frame is as wide as the samples that went through it, with its
+ * callers below it and the methods it called above, siblings ordered by samples so the hottest paths are on the left.
+ * Clicking a frame zooms into it, the mouse wheel zooms around the cursor with Ctrl held and scrolls deep stacks
+ * otherwise, and a right click or Escape returns to the whole profile.
+ */
+class FlameGraph final : public QWidget
+{
+    static constexpr int MARGIN = 12;
+    static constexpr int ROW_HEIGHT = 22;
+
+    QVector<FlameFrame> m_frames;
+    qint64 m_samples = 0;
+    int m_depth = 0;
+    double m_viewBegin = 0;
+    double m_viewEnd = 0;
+    int m_scroll = 0;
+
+    QRectF frameRect(const FlameFrame& frame) const;
+    const FlameFrame* frameAt(const QPoint& position) const;
+    void zoom(double begin, double end);
+    static QColor frameColor(const QString& method);
+
+public:
+    explicit FlameGraph(QWidget* parent = Q_NULLPTR);
+    ~FlameGraph() Q_DECL_OVERRIDE Q_DECL_EQ_DEFAULT;
+    void setProfile(const QVector<QByteArrayView>& profile);
+
+protected:
+    bool event(QEvent* event) Q_DECL_OVERRIDE;
+    void paintEvent(QPaintEvent* event) Q_DECL_OVERRIDE;
+    void mousePressEvent(QMouseEvent* event) Q_DECL_OVERRIDE;
+    void wheelEvent(QWheelEvent* event) Q_DECL_OVERRIDE;
+    void keyPressEvent(QKeyEvent* event) Q_DECL_OVERRIDE;
+};
+
+#endif // FLAMEGRAPH_H
\ No newline at end of file
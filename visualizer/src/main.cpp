@@ -1,14 +1,111 @@
 #include "debugvisualizer.h"
+#include "snapshotbrowser.h"
+#include "snapshotgenerator.h"
+#include "visualizerbenchmark.h"
+
+static int runBenchmark(const QStringList& arguments)
+{
+    // "--benchmark file.dat" measures a snapshot from disk, a bare "--benchmark" one generated from the shape options
+    const qsizetype benchmark_idx = arguments.indexOf("--benchmark");
+    const auto value = [&arguments](const QString& name)
+    {
+        const qsizetype idx = arguments.indexOf(name);
+        return idx >= 0 && idx + 1 < arguments.size() ? arguments[idx + 1] : QString();
+    };
+
+    QByteArray snapshot;
+    if (benchmark_idx + 1 < arguments.size() && !arguments[benchmark_idx + 1].startsWith("--"))
+    {
+        QFile input_datafile(arguments[benchmark_idx + 1]);
+        if (!input_datafile.open(QIODevice::ReadOnly))
+        {
+            qCritical().noquote() << "Cannot open the snapshot" << arguments[benchmark_idx + 1];
+            return 1;
+        }
+        snapshot = input_datafile.readAll();
+    }
+    else
+        snapshot = SnapshotGenerator::generate(SnapshotGenerator::parseShape(arguments));
+
+    const QString iterations = value("--iterations");
+    const QJsonObject results = VisualizerBenchmark(snapshot, iterations.isEmpty() ? 5 : iterations.toInt()).run();
+    const QByteArray json = QJsonDocument(results).toJson(QJsonDocument::Compact) + '\n';
+
+    // the results go to standard output unless a file is given
+    QFile output_file(value("--out"));
+    if (!(output_file.fileName().isEmpty() ? output_file.open(stdout, QIODevice::WriteOnly) : output_file.open(QIODevice::WriteOnly)))
+    {
+        qCritical().noquote() << "Cannot write the results to" << output_file.fileName();
+        return 1;
+    }
+    output_file.write(json);
+    output_file.close();
+
+    // with a baseline the benchmark fails when any step got slower or larger by more than the tolerance
+    if (value("--baseline").isEmpty())
+        return 0;
+
+    QFile baseline_file(value("--baseline"));
+    if (!baseline_file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Cannot open the baseline" << value("--baseline");
+        return 1;
+    }
+
+    const QString tolerance = value("--tolerance");
+    const QStringList regressions = VisualizerBenchmark::compare(results, QJsonDocument::fromJson(baseline_file.readAll()).object(), tolerance.isEmpty() ? 10 : tolerance.toDouble());
+    for (const QString& regression : regressions)
+        qCritical().noquote() << regression;
+    return regressions.isEmpty() ? 0 : 2;
+}
 
 int main(int argc, char *argv[])
 {
+    // snapshots are generated without a window, benchmarks run offscreen unless another platform is asked for
+    QStringList command_line;
+    for (int i = 0; i < argc; i++)
+        command_line.push_back(QString::fromLocal8Bit(argv[i]));
+
+    const qsizetype generate_idx = command_line.indexOf("--generate");
+    if (generate_idx >= 0 && generate_idx + 1 < command_line.size())
+        return SnapshotGenerator::write(command_line[generate_idx + 1], SnapshotGenerator::parseShape(command_line)) ? 0 : 1;
+    if (command_line.contains("--benchmark") && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
     QApplication app(argc, argv);
-    DebugVisualizer window;
+    if (command_line.contains("--benchmark"))
+        return runBenchmark(QCoreApplication::arguments());
+
+    std::unique_ptr<DebugVisualizer> window;
+
+    // with --archive a snapshot is picked from the agent's archive instead of showing the latest capture
+    const QStringList arguments = QCoreApplication::arguments();
+    const qsizetype archive_idx = arguments.indexOf("--archive");
+    if (archive_idx >= 0 && archive_idx + 1 < arguments.size())
+    {
+        const SnapshotArchive archive(arguments[archive_idx + 1]);
+        if (!archive.isOpen())
+        {
+            QMessageBox::critical(Q_NULLPTR, "Memory Debug Visualizer", "Cannot open the snapshot archive in " + arguments[archive_idx + 1] + ".\n" + archive.errorString());
+            return 1;
+        }
+
+        SnapshotBrowser browser(archive);
+        if (browser.exec() != QDialog::Accepted || browser.selectedSnapshot() < 0)
+            return 0;
+
+        VisualizerPayload payload;
+        DebugVisualizer::deserializePayload(archive.readSnapshot(browser.selectedSnapshot()), payload);
+        DebugVisualizer::resolveHeapReferences(archive, payload);
+        window = std::make_unique<DebugVisualizer>(payload, browser.describeSnapshot(browser.selectedSnapshot()));
+    }
+    else
+        window = std::make_unique<DebugVisualizer>();
 
     // adjust for screen size
     if (QGuiApplication::primaryScreen()->geometry().width() <= 1920)
-        window.setWindowState(Qt::WindowMaximized);
+        window->setWindowState(Qt::WindowMaximized);
 
-    window.show();
+    window->show();
     return QApplication::exec();
 }
\ No newline at end of file
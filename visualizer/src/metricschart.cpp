@@ -0,0 +1,95 @@
+#include "metricschart.h"
+
+namespace
+{
+    const char* const SERIES_NAMES[] = { "Heap Usage (MiB)", "Non-Heap Usage (MiB)", "Live Threads", "CPU (% of one core)" };
+    const QColor SERIES_COLORS[] = { QColor(52, 120, 198), QColor(122, 82, 170), QColor(60, 150, 80), QColor(214, 112, 40) };
+}
+
+MetricsChart::MetricsChart(QWidget* parent)
+    : QWidget(parent)
+{
+    this->setAutoFillBackground(true);
+    this->setBackgroundRole(QPalette::Base);
+}
+
+void MetricsChart::setSamples(const QVector<QByteArrayView>& samples)
+{
+    // every sample holds: nanoseconds before the breakpoint, heap bytes, non-heap bytes, threads, process CPU nanoseconds
+    this->m_points.clear();
+    double previous_cpu = -1, previous_seconds = 0;
+    for (const QByteArrayView sample : samples)
+    {
+        const QStringList components = QString::fromLatin1(sample).split('\a');
+        if (components.size() < 5)
+            continue;
+
+        const double seconds = -components[0].toDouble() / 1e9;
+        const double cpu = components[4].toDouble();
+
+        // CPU usage is the CPU time spent between two samples relative to the wall time between them
+        double cpu_percent = 0;
+        if (previous_cpu >= 0 && seconds > previous_seconds)
+            cpu_percent = (cpu - previous_cpu) / 1e9 / (seconds - previous_seconds) * 100;
+        previous_cpu = cpu;
+        previous_seconds = seconds;
+
+        this->m_points.push_back({ seconds, { components[1].toDouble() / (1 << 20), components[2].toDouble() / (1 << 20), components[3].toDouble(), qMax(cpu_percent, 0.0) } });
+    }
+    this->update();
+}
+
+void MetricsChart::paintEvent(QPaintEvent* event)
+{
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    if (this->m_points.size() < 2)
+    {
+        painter.drawText(this->rect(), Qt::AlignCenter, "No samples. The metrics sampler is disabled with sampler=0 or has not run yet.");
+        return;
+    }
+
+    // strips share the space above the time axis
+    const QRect area = this->rect().adjusted(MARGIN, MARGIN, -MARGIN, -MARGIN - AXIS_HEIGHT);
+    const int strip_height = area.height() / SERIES;
+    const double earliest = this->m_points.first().seconds;
+    for (int i = 0; i < SERIES; i++)
+        this->paintStrip(painter, QRect(area.left(), area.top() + i * strip_height, area.width(), strip_height - MARGIN), i, earliest);
+
+    // time axis, in seconds before the breakpoint
+    painter.setPen(this->palette().color(QPalette::Text));
+    const int axis_y = area.bottom() + AXIS_HEIGHT / 2;
+    for (int tick = 0; tick <= 4; tick++)
+    {
+        const double seconds = earliest * (4 - tick) / 4;
+        const int x = area.left() + area.width() * tick / 4;
+        painter.drawText(QRect(x - 60, axis_y - 10, 120, 20), Qt::AlignCenter, QString("%1 s").arg(seconds, 0, 'f', 1));
+    }
+}
+
+void MetricsChart::paintStrip(QPainter& painter, const QRect& strip, const int series, const double earliest) const
+{
+    double maximum = 0;
+    for (const MetricsPoint& point : this->m_points)
+        maximum = qMax(maximum, point.values[series]);
+    const double scale = maximum > 0 ? maximum * 1.1 : 1;
+
+    painter.setPen(this->palette().color(QPalette::Mid));
+    painter.drawRect(strip);
+
+    // one polyline per series, the last sample sits on the right edge
+    QPolygonF line;
+    line.reserve(this->m_points.size());
+    for (const MetricsPoint& point : this->m_points)
+    {
+        const double x = strip.left() + strip.width() * (1 - point.seconds / earliest);
+        const double y = strip.bottom() - strip.height() * point.values[series] / scale;
+        line.push_back(QPointF(earliest < 0 ? x : strip.right(), y));
+    }
+    painter.setPen(QPen(SERIES_COLORS[series], 2));
+    painter.drawPolyline(line);
+
+    painter.setPen(this->palette().color(QPalette::Text));
+    painter.drawText(strip.adjusted(6, 4, -6, -4), Qt::AlignLeft | Qt::AlignTop, QString("%1: %2 (max %3)").arg(SERIES_NAMES[series]).arg(this->m_points.last().values[series], 0, 'f', 1).arg(maximum, 0, 'f', 1));
+}
\ No newline at end of file
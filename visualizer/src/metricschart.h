@@ -0,0 +1,37 @@
+#pragma once
+
+#ifndef METRICSCHART_H
+#define METRICSCHART_H
+
+#include <QtWidgets>
+
+typedef struct
+{
+    double seconds;
+    double values[4];
+} MetricsPoint;
+
+/*
+ * Time-series chart of the agent's metrics sampler. Every series is drawn in its own strip scaled to its own maximum,
+ * sharing the time axis, which counts the seconds before the breakpoint was hit.
+ */
+class MetricsChart final : public QWidget
+{
+    static constexpr int SERIES = 4;
+    static constexpr int MARGIN = 12;
+    static constexpr int AXIS_HEIGHT = 30;
+
+    QVector<MetricsPoint> m_points;
+
+    void paintStrip(QPainter& painter, const QRect& strip, int series, double earliest) const;
+
+public:
+    explicit MetricsChart(QWidget* parent = Q_NULLPTR);
+    ~MetricsChart() Q_DECL_OVERRIDE Q_DECL_EQ_DEFAULT;
+    void setSamples(const QVector<QByteArrayView>& samples);
+
+protected:
+    void paintEvent(QPaintEvent* event) Q_DECL_OVERRIDE;
+};
+
+#endif // METRICSCHART_H
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "snapshotarchive.h"
+
+SnapshotArchive::SnapshotArchive(const QString& directory)
+    : m_directory(directory), m_index(QDir(directory).filePath("index.bin"))
+{
+    if (!this->m_index.open(QIODevice::ReadOnly) || this->m_index.size() < HEADER_SIZE)
+    {
+        this->m_error = "There is no readable index.bin in " + directory + '.';
+        return;
+    }
+
+    // header: magic, format version and record size
+    const QByteArray header = this->m_index.read(HEADER_SIZE);
+    quint32 version = 0, record_size = 0;
+    std::memcpy(&version, header.constData() + 8, sizeof version);
+    std::memcpy(&record_size, header.constData() + 12, sizeof record_size);
+    if (!header.startsWith("MDVINDEX"))
+    {
+        this->m_error = "index.bin in " + directory + " is not a snapshot archive index.";
+        return;
+    }
+
+    // version 1 records had no offsets for the monitors and profile sections, they are refused rather than misread
+    if (version != VERSION || record_size != sizeof(ArchiveRecord))
+    {
+        this->m_error = QString("index.bin in %1 was written in archive format version %2, this visualizer reads version %3.").arg(directory).arg(version).arg(VERSION);
+        return;
+    }
+    this->m_valid = true;
+
+    // only complete records are mapped, the agent may be appending the next one right now
+    const qint64 count = (this->m_index.size() - HEADER_SIZE) / static_cast<qint64>(sizeof(ArchiveRecord));
+    if (count == 0)
+        return;
+    const uchar* mapped = this->m_index.map(HEADER_SIZE, count * static_cast<qint64>(sizeof(ArchiveRecord)));
+    if (mapped == nullptr)
+        return;
+    this->m_records = reinterpret_cast<const ArchiveRecord*>(mapped);
+
+    // segments are checked once each, not once per record
+    QHash<quint32, bool> segments;
+    this->m_available.reserve(count);
+    for (qsizetype i = 0; i < count; i++)
+    {
+        const quint32 segment = this->m_records[i].segment;
+        auto exists = segments.find(segment);
+        if (exists == segments.end())
+            exists = segments.insert(segment, QFileInfo::exists(this->segmentPath(segment)));
+        if (exists.value())
+            this->m_available.push_back(i);
+    }
+}
+
+QString SnapshotArchive::segmentPath(const quint32 segment) const
+{
+    return this->m_directory.filePath(QString("segment-%1.dat").arg(segment, 8, 10, QChar('0')));
+}
+
+bool SnapshotArchive::isOpen() const
+{
+    return this->m_valid;
+}
+
+QString SnapshotArchive::errorString() const
+{
+    return this->m_error;
+}
+
+qsizetype SnapshotArchive::count() const
+{
+    return this->m_available.size();
+}
+
+const ArchiveRecord& SnapshotArchive::record(const qsizetype row) const
+{
+    return this->m_records[this->m_available[row]];
+}
+
+qsizetype SnapshotArchive::rowOf(const quint64 id) const
+{
+    // records are appended in ID order, so the available rows are sorted by ID as well
+    const auto found = std::lower_bound(this->m_available.cbegin(), this->m_available.cend(), id, [this](const qsizetype index, const quint64 value) { return this->m_records[index].id < value; });
+    if (found == this->m_available.cend() || this->m_records[*found].id != id)
+        return -1;
+    return found - this->m_available.cbegin();
+}
+
+QByteArray SnapshotArchive::readSections(const qsizetype row, const int first, const int last) const
+{
+    // sections are contiguous, so any run of them is a single read; -1 starts at the header lines
+    const ArchiveRecord& record = this->record(row);
+    const quint32 begin = first < 0 ? 0 : record.sections[qBound(0, first, ARCHIVE_SECTIONS)];
+    const quint32 end = record.sections[qBound(0, last + 1, ARCHIVE_SECTIONS)];
+    QFile segment(this->segmentPath(record.segment));
+    if (end <= begin || !segment.open(QIODevice::ReadOnly) || !segment.seek(static_cast<qint64>(record.offset + begin)))
+        return {};
+    return segment.read(end - begin);
+}
+
+QByteArray SnapshotArchive::readSnapshot(const qsizetype row) const
+{
+    return this->readSections(row, -1, ARCHIVE_SECTIONS - 1);
+}
+
+QString SnapshotArchive::text(const char* field, const qsizetype size)
+{
+    return QString::fromUtf8(field, static_cast<qsizetype>(qstrnlen(field, static_cast<uint>(size))));
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef SNAPSHOTARCHIVE_H
+#define SNAPSHOTARCHIVE_H
+
+#include <QtCore>
+
+// record layout of the agent's index.bin, section 0 holds the runtime metrics that follow the header lines
+// every section has its own offset, the offset after the last one is the end of the snapshot
+constexpr int ARCHIVE_SECTIONS = 12;
+
+typedef struct
+{
+    quint64 id;
+    qint64 timestampMs;
+    quint64 offset;
+    quint32 segment;
+    qint32 line;
+    quint32 sections[ARCHIVE_SECTIONS + 1];
+    char thread[48];
+    char callSite[160];
+    char trigger[92];
+} ArchiveRecord;
+
+static_assert(sizeof(ArchiveRecord) == 384, "index records must match the agent's layout");
+
+/*
+ * Read-only view of a snapshot archive written by the agent's "archive" option. The index is memory mapped, so opening
+ * an archive of any size only validates its header, and a snapshot's sections are read from its segment when asked for.
+ * Records whose segment has been rotated out are skipped.
+ */
+class SnapshotArchive
+{
+    static constexpr qint64 HEADER_SIZE = 16;
+    static constexpr quint32 VERSION = 2;
+
+    QDir m_directory;
+    QFile m_index;
+    const ArchiveRecord* m_records = nullptr;
+    bool m_valid = false;
+    QString m_error;
+    QVector<qsizetype> m_available;
+
+    QString segmentPath(quint32 segment) const;
+
+public:
+    explicit SnapshotArchive(const QString& directory);
+    ~SnapshotArchive() = default;
+    bool isOpen() const;
+    QString errorString() const;
+    qsizetype count() const;
+    const ArchiveRecord& record(qsizetype row) const;
+    qsizetype rowOf(quint64 id) const;
+    QByteArray readSections(qsizetype row, int first, int last) const;
+    QByteArray readSnapshot(qsizetype row) const;
+    static QString text(const char* field, qsizetype size);
+};
+
+#endif // SNAPSHOTARCHIVE_H
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "snapshotbrowser.h"
+
+ArchiveModel::ArchiveModel(const SnapshotArchive& archive, QObject* parent)
+    : QAbstractTableModel(parent), m_archive(archive)
+{
+}
+
+int ArchiveModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(this->m_archive.count());
+}
+
+int ArchiveModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : COLUMNS;
+}
+
+QVariant ArchiveModel::data(const QModelIndex& index, const int role) const
+{
+    if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::ToolTipRole))
+        return {};
+
+    // numbers are returned as numbers so the proxy model sorts them numerically
+    const ArchiveRecord& record = this->m_archive.record(index.row());
+    switch (index.column())
+    {
+    case ID:
+        return static_cast<qulonglong>(record.id);
+    case TIME:
+        return QDateTime::fromMSecsSinceEpoch(record.timestampMs).toString("yyyy-MM-dd HH:mm:ss.zzz");
+    case THREAD:
+        return SnapshotArchive::text(record.thread, sizeof record.thread);
+    case CALL_SITE:
+        return SnapshotArchive::text(record.callSite, sizeof record.callSite);
+    case LINE:
+        return record.line;
+    case TRIGGER:
+        return SnapshotArchive::text(record.trigger, sizeof record.trigger);
+    case SIZE:
+        if (role == Qt::ToolTipRole)
+            return QLocale().formattedDataSize(record.sections[ARCHIVE_SECTIONS]);
+        return record.sections[ARCHIVE_SECTIONS];
+    default:
+        return {};
+    }
+}
+
+QVariant ArchiveModel::headerData(const int section, const Qt::Orientation orientation, const int role) const
+{
+    static const char* const headers[] = { "ID", "Time", "Thread", "Call Site", "Line", "Trigger", "Size" };
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole || section < 0 || section >= COLUMNS)
+        return {};
+    return QString(headers[section]);
+}
+
+SnapshotBrowser::SnapshotBrowser(const SnapshotArchive& archive, QWidget* parent)
+    : QDialog(parent), m_archive(archive), m_model(archive)
+{
+    this->setWindowTitle("Memory Debug Visualizer - Snapshot Archive");
+    this->resize(1100, 700);
+
+    // every column takes part in filtering, so a thread name, a method or a trigger all narrow the list down
+    this->m_filter.setSourceModel(&this->m_model);
+    this->m_filter.setFilterKeyColumn(-1);
+    this->m_filter.setFilterCaseSensitivity(Qt::CaseInsensitive);
+    this->m_filter.setSortRole(Qt::DisplayRole);
+
+    this->m_filterEdit = new QLineEdit(this);
+    this->m_filterEdit->setPlaceholderText("Filter by thread, call site, trigger or time");
+    this->m_filterEdit->setClearButtonEnabled(true);
+
+    this->m_table = new QTableView(this);
+    this->m_table->setModel(&this->m_filter);
+    this->m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    this->m_table->setSelectionMode(QAbstractItemView::SingleSelection);
+    this->m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    this->m_table->setSortingEnabled(true);
+    this->m_table->sortByColumn(ArchiveModel::ID, Qt::DescendingOrder);
+    this->m_table->verticalHeader()->hide();
+    this->m_table->horizontalHeader()->setSectionResizeMode(ArchiveModel::CALL_SITE, QHeaderView::Stretch);
+
+    this->m_preview = new QPlainTextEdit(this);
+    this->m_preview->setReadOnly(true);
+    this->m_preview->setMaximumHeight(160);
+    this->m_preview->setPlaceholderText("Select a snapshot to preview its call stack.");
+
+    auto* buttons = new QDialogButtonBox(QDialogButtonBox::Open | QDialogButtonBox::Cancel, this);
+    auto* layout = new QVBoxLayout(this);
+    layout->addWidget(new QLabel(QString("%1 snapshots").arg(archive.count()), this));
+    layout->addWidget(this->m_filterEdit);
+    layout->addWidget(this->m_table, 1);
+    layout->addWidget(this->m_preview);
+    layout->addWidget(buttons);
+
+    connect(this->m_filterEdit, &QLineEdit::textChanged, &this->m_filter, &QSortFilterProxyModel::setFilterFixedString);
+    connect(this->m_table->selectionModel(), &QItemSelectionModel::currentRowChanged, this, [this] { this->showPreview(); });
+    connect(this->m_table, &QTableView::doubleClicked, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::accepted, this, [this] { if (this->selectedSnapshot() >= 0) this->accept(); });
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+}
+
+qsizetype SnapshotBrowser::selectedSnapshot() const
+{
+    const QModelIndex current = this->m_table->currentIndex();
+    return current.isValid() ? this->m_filter.mapToSource(current).row() : -1;
+}
+
+QString SnapshotBrowser::describeSnapshot(const qsizetype row) const
+{
+    const ArchiveRecord& record = this->m_archive.record(row);
+    return QString("Snapshot %1, %2").arg(record.id).arg(QDateTime::fromMSecsSinceEpoch(record.timestampMs).toString("yyyy-MM-dd HH:mm:ss"));
+}
+
+void SnapshotBrowser::showPreview()
+{
+    // only the call stack section of the snapshot is read
+    const qsizetype row = this->selectedSnapshot();
+    if (row < 0)
+    {
+        this->m_preview->clear();
+        return;
+    }
+
+    QString call_stack = QString::fromUtf8(this->m_archive.readSections(row, 1, 1));
+    call_stack.remove("SECTION_END_BEGIN_NEW\n");
+    this->m_preview->setPlainText(call_stack);
+}
\ No newline at end of file
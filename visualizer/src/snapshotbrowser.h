@@ -0,0 +1,50 @@
+#pragma once
+
+#ifndef SNAPSHOTBROWSER_H
+#define SNAPSHOTBROWSER_H
+
+#include <QtWidgets>
+#include "snapshotarchive.h"
+
+/*
+ * Table model over the index of a snapshot archive. Cells are formatted from the mapped records when the view asks
+ * for them, so listing thousands of snapshots never reads a segment.
+ */
+class ArchiveModel final : public QAbstractTableModel
+{
+    const SnapshotArchive& m_archive;
+
+public:
+    enum Column { ID, TIME, THREAD, CALL_SITE, LINE, TRIGGER, SIZE, COLUMNS };
+
+    explicit ArchiveModel(const SnapshotArchive& archive, QObject* parent = Q_NULLPTR);
+    ~ArchiveModel() Q_DECL_OVERRIDE Q_DECL_EQ_DEFAULT;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+};
+
+/*
+ * Lists the snapshots of an archive, newest first, filtered by any text of their index records.
+ * Selecting a snapshot previews its call stack, which is the only section read until the snapshot is opened.
+ */
+class SnapshotBrowser final : public QDialog
+{
+    const SnapshotArchive& m_archive;
+    ArchiveModel m_model;
+    QSortFilterProxyModel m_filter;
+    QLineEdit* m_filterEdit;
+    QTableView* m_table;
+    QPlainTextEdit* m_preview;
+
+    void showPreview();
+
+public:
+    explicit SnapshotBrowser(const SnapshotArchive& archive, QWidget* parent = Q_NULLPTR);
+    ~SnapshotBrowser() Q_DECL_OVERRIDE Q_DECL_EQ_DEFAULT;
+    qsizetype selectedSnapshot() const;
+    QString describeSnapshot(qsizetype row) const;
+};
+
+#endif // SNAPSHOTBROWSER_H
\ No newline at end of file
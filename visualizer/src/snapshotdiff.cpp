@@ -0,0 +1,193 @@
+#include "snapshotdiff.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+QByteArrayView SnapshotDiff::arrayElements(QByteArrayView formatted)
+{
+    // "{ a, b, c }" -> "a, b, c", empty for an empty array or anything that is not one
+    if (!formatted.startsWith("{ ") || !formatted.endsWith(" }") || formatted.size() <= 3)
+        return {};
+    return formatted.sliced(2, formatted.size() - 4);
+}
+
+qsizetype SnapshotDiff::skipElements(QByteArrayView elements, qsizetype from, qsizetype count, qsizetype& skipped)
+{
+    // elements never contain ", ", so the element after the next n is the one after the n-th separator
+    // past the end of the array the result is elements.size() + 2, as if one more separator followed the last element
+    skipped = 0;
+    const char* data = elements.data();
+    const qsizetype size = elements.size();
+    if (from >= size || count <= 0)
+        return from;
+
+    qsizetype i = from;
+#ifdef __SSE2__
+    // every byte is tested together with the one after it, so a separator across two loads is still found once
+    const __m128i comma = _mm_set1_epi8(','), space = _mm_set1_epi8(' ');
+    for (; i + 17 <= size; i += 16)
+    {
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+        uint mask = static_cast<uint>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, comma), _mm_cmpeq_epi8(second, space))));
+        const qsizetype found = qPopulationCount(mask);
+        if (skipped + found < count)
+        {
+            skipped += found;
+            continue;
+        }
+        for (; mask != 0; mask &= mask - 1)
+        {
+            if (++skipped == count)
+                return i + qCountTrailingZeroBits(mask) + 2;
+        }
+    }
+#endif
+    for (; i + 1 < size; i++)
+    {
+        if (data[i] == ',' && data[i + 1] == ' ' && ++skipped == count)
+            return i + 2;
+    }
+
+    skipped++;
+    return size + 2;
+}
+
+QVector<qsizetype> SnapshotDiff::locateElements(QByteArrayView elements, qsizetype from, qsizetype count)
+{
+    // start of up to count elements plus the start of the one after them, so element i spans [offsets[i], offsets[i + 1] - 2)
+    QVector<qsizetype> offsets;
+    if (from >= elements.size())
+        return offsets;
+
+    offsets.push_back(from);
+    while (offsets.size() <= count)
+    {
+        const qsizetype separator = elements.indexOf(", ", offsets.last());
+        if (separator < 0)
+        {
+            offsets.push_back(elements.size() + 2);
+            break;
+        }
+        offsets.push_back(separator + 2);
+    }
+    return offsets;
+}
+
+QByteArrayView SnapshotDiff::element(QByteArrayView elements, const QVector<qsizetype>& offsets, qsizetype index)
+{
+    return elements.sliced(offsets[index], offsets[index + 1] - offsets[index] - 2);
+}
+
+QByteArrayView SnapshotDiff::blockSize(QByteArrayView hashes)
+{
+    // "<block size>\a<hash>,<hash>,..."
+    const qsizetype end = hashes.indexOf('\a');
+    return end < 0 ? hashes : hashes.first(end);
+}
+
+QVector<QByteArrayView> SnapshotDiff::blockHashes(QByteArrayView hashes)
+{
+    QVector<QByteArrayView> blocks;
+    const qsizetype start = hashes.indexOf('\a');
+    for (qsizetype begin = start + 1; start >= 0 && begin < hashes.size();)
+    {
+        qsizetype end = hashes.indexOf(',', begin);
+        if (end < 0)
+            end = hashes.size();
+        if (end > begin)
+            blocks.push_back(hashes.sliced(begin, end - begin));
+        begin = end + 1;
+    }
+    return blocks;
+}
+
+void SnapshotDiff::appendRange(QVector<IndexRange>& ranges, qsizetype begin, qsizetype end)
+{
+    // adjacent changes are merged so a rewritten region reads as a single range
+    if (!ranges.isEmpty() && ranges.last().end == begin)
+        ranges.last().end = end;
+    else
+        ranges.push_back({ begin, end });
+}
+
+QVector<IndexRange> SnapshotDiff::diffArrays(QByteArrayView previous, QByteArrayView current, QByteArrayView previousHashes, QByteArrayView currentHashes)
+{
+    QVector<IndexRange> ranges;
+    if (previous == current)
+        return ranges;
+
+    const QByteArrayView before = SnapshotDiff::arrayElements(previous);
+    const QByteArrayView after = SnapshotDiff::arrayElements(current);
+
+    // hashes are only comparable when both hits used the same block size
+    const QVector<QByteArrayView> previousBlocks = SnapshotDiff::blockHashes(previousHashes);
+    const QVector<QByteArrayView> currentBlocks = SnapshotDiff::blockHashes(currentHashes);
+    const qsizetype blockSize = SnapshotDiff::blockSize(currentHashes).toLongLong();
+    const bool hashed = blockSize > 0 && SnapshotDiff::blockSize(previousHashes) == SnapshotDiff::blockSize(currentHashes);
+
+    // without usable hashes the whole array is compared as one block
+    // both sides are walked together, the byte offsets of their next elements differ once an element changed length
+    const qsizetype step = hashed ? blockSize : std::numeric_limits<qsizetype>::max();
+    qsizetype index = 0, previousAt = 0, currentAt = 0;
+    for (qsizetype block = 0; previousAt < before.size() && currentAt < after.size(); block++)
+    {
+        if (hashed && block < previousBlocks.size() && block < currentBlocks.size() && previousBlocks[block] == currentBlocks[block])
+        {
+            qsizetype skipped;
+            const qsizetype next = SnapshotDiff::skipElements(before, previousAt, step, skipped);
+            currentAt += next - previousAt;
+            previousAt = next;
+            index += skipped;
+            continue;
+        }
+
+        const QVector<qsizetype> beforeOffsets = SnapshotDiff::locateElements(before, previousAt, step);
+        const QVector<qsizetype> afterOffsets = SnapshotDiff::locateElements(after, currentAt, step);
+        const qsizetype previousCount = beforeOffsets.size() - 1, currentCount = afterOffsets.size() - 1;
+        const qsizetype common = qMin(previousCount, currentCount);
+        for (qsizetype i = 0; i < common; i++)
+        {
+            if (element(before, beforeOffsets, i) != element(after, afterOffsets, i))
+                appendRange(ranges, index + i, index + i + 1);
+        }
+
+        // a block that is shorter on one side is the end of that array
+        if (previousCount != currentCount)
+            appendRange(ranges, index + common, index + qMax(previousCount, currentCount));
+        index += qMax(previousCount, currentCount);
+        previousAt = beforeOffsets.last();
+        currentAt = afterOffsets.last();
+    }
+
+    // elements that only exist on one side count as changed
+    qsizetype remaining;
+    SnapshotDiff::skipElements(previousAt < before.size() ? before : after, previousAt < before.size() ? previousAt : currentAt, std::numeric_limits<qsizetype>::max(), remaining);
+    if (remaining > 0)
+        appendRange(ranges, index, index + remaining);
+
+    return ranges;
+}
+
+qsizetype SnapshotDiff::countElements(const QVector<IndexRange>& ranges)
+{
+    qsizetype count = 0;
+    for (const IndexRange& range : ranges)
+        count += range.end - range.begin;
+    return count;
+}
+
+QString SnapshotDiff::describeRanges(const QVector<IndexRange>& ranges, qsizetype limit)
+{
+    QStringList parts;
+    for (qsizetype i = 0; i < qMin(ranges.size(), limit); i++)
+    {
+        const IndexRange& range = ranges[i];
+        parts.push_back(range.end - range.begin == 1 ? QString("[%1]").arg(range.begin) : QString("[%1..%2]").arg(range.begin).arg(range.end - 1));
+    }
+
+    if (ranges.size() > limit)
+        parts.push_back(QString("and %1 more").arg(ranges.size() - limit));
+    return parts.join(", ");
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#ifndef SNAPSHOTDIFF_H
+#define SNAPSHOTDIFF_H
+
+#include <QtCore>
+
+// half-open range of array indices [begin, end)
+typedef struct
+{
+    qsizetype begin;
+    qsizetype end;
+} IndexRange;
+
+/*
+ * Structural diff of two snapshots taken at the same visualize() site.
+ * Primitive arrays are compared block by block: the agent hashes fixed-size blocks of every array at capture time,
+ * and only the elements of blocks whose hashes differ are located and compared. A block whose hashes match has the
+ * same text on both sides, so it is stepped over by counting its separators, sixteen bytes at a time with SSE2.
+ * Both sides are compared as views into the snapshots they were read from, so nothing is copied.
+ */
+class SnapshotDiff
+{
+    static QByteArrayView arrayElements(QByteArrayView formatted);
+    static qsizetype skipElements(QByteArrayView elements, qsizetype from, qsizetype count, qsizetype& skipped);
+    static QVector<qsizetype> locateElements(QByteArrayView elements, qsizetype from, qsizetype count);
+    static QByteArrayView element(QByteArrayView elements, const QVector<qsizetype>& offsets, qsizetype index);
+    static QByteArrayView blockSize(QByteArrayView hashes);
+    static QVector<QByteArrayView> blockHashes(QByteArrayView hashes);
+    static void appendRange(QVector<IndexRange>& ranges, qsizetype begin, qsizetype end);
+
+public:
+    static QVector<IndexRange> diffArrays(QByteArrayView previous, QByteArrayView current, QByteArrayView previousHashes, QByteArrayView currentHashes);
+    static qsizetype countElements(const QVector<IndexRange>& ranges);
+    static QString describeRanges(const QVector<IndexRange>& ranges, qsizetype limit);
+};
+
+#endif // SNAPSHOTDIFF_H
\ No newline at end of file
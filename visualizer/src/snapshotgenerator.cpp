@@ -0,0 +1,184 @@
+#include "snapshotgenerator.h"
+
+namespace
+{
+    const QByteArray SECTION_DELIMITER = "SECTION_END_BEGIN_NEW\n";
+    const char* const PHASE_NAMES[] = { "stack_walk", "runtime_metrics", "allocation_sites", "monitors", "profile", "call_stack", "local_variables", "static_fields", "to_string", "heap_copy", "heap_dump", "heap_format", "serialize", "launch" };
+    constexpr int SAMPLES = 600;
+    constexpr int ALLOCATION_SITES = 32;
+    constexpr int PROFILE_BRANCHING_LEVELS = 10;
+}
+
+SnapshotShape SnapshotGenerator::parseShape(const QStringList& arguments)
+{
+    // every dimension can be given as "--name value", the rest keep the size of a typical capture
+    const auto value = [&arguments](const QString& name, const int fallback)
+    {
+        const qsizetype idx = arguments.indexOf(name);
+        return idx >= 0 && idx + 1 < arguments.size() ? qMax(arguments[idx + 1].toInt(), 0) : fallback;
+    };
+
+    return { qMax(value("--frames", 32), 1), value("--locals", 64), value("--statics", 64), value("--array", 10000), value("--object-bytes", 256), value("--threads", 16) };
+}
+
+QByteArray SnapshotGenerator::arrayContents(const int length, const qulonglong tag, QByteArray& hashes)
+{
+    // "{ a, b, c }" as the agent formats int arrays, the elements differ from one array to the next
+    QByteArray contents = "{ ";
+    QByteArray block;
+    QByteArray block_hashes;
+    for (int i = 0; i < length; i++)
+    {
+        const QByteArray element = QByteArray::number((static_cast<qlonglong>(i) * 2654435761LL + static_cast<qlonglong>(tag)) % 100000);
+        contents += element;
+        if (i + 1 < length)
+            contents += ", ";
+
+        // the visualizer only compares hashes, any hash of the block's elements will do
+        block += element + ',';
+        if ((i + 1) % HASH_BLOCK == 0 || i + 1 == length)
+        {
+            if (!block_hashes.isEmpty())
+                block_hashes += ',';
+            block_hashes += QByteArray::number(static_cast<qulonglong>(qHashBits(block.constData(), static_cast<size_t>(block.size()), 0)), 16);
+            block.clear();
+        }
+    }
+    contents += length == 0 ? "}" : " }";
+
+    hashes += '#' + QByteArray::number(tag) + '\a' + QByteArray::number(HASH_BLOCK) + '\a' + block_hashes + '\n';
+    return contents;
+}
+
+QByteArray SnapshotGenerator::objectContents(const int size, const qulonglong tag)
+{
+    // hex dump of the object bytes, each followed by a space, with the sign extension the agent leaves on negative bytes
+    QByteArray contents;
+    contents.reserve(size * 3);
+    for (int i = 0; i < size; i++)
+    {
+        const auto byte = static_cast<qint8>((i * 31 + static_cast<int>(tag)) & 0xFF);
+        contents += QByteArray::number(static_cast<uint>(static_cast<int>(byte)), 16) + ' ';
+    }
+    return contents;
+}
+
+void SnapshotGenerator::appendVariable(QByteArray& section, QByteArray& heap, QByteArray& hashes, const SnapshotShape& shape, const QByteArray& modifier, const int index, qulonglong& tag)
+{
+    // primitives, int arrays and objects take turns, references carry their handle and tag
+    const QByteArray name = QByteArray::number(index);
+    switch (index % 4)
+    {
+    case 0:
+        section += modifier + "int\acount" + name + '\a' + QByteArray::number(index * 7) + '\n';
+        return;
+    case 1:
+        section += modifier + "double\aratio" + name + '\a' + QByteArray::number(index / 3.0) + '\n';
+        return;
+    case 2:
+    {
+        const qulonglong id = ++tag;
+        section += modifier + "int[]\avalues" + name + "\a[I@" + QByteArray::number(id * 40503 + 0x1b6d3586, 16) + '\a' + QByteArray::number(id) + '\a' + QByteArray::number(id) + '\n';
+        heap += '#' + QByteArray::number(id) + '\a' + SnapshotGenerator::arrayContents(shape.arrayLength, id, hashes) + '\n';
+        return;
+    }
+    default:
+    {
+        const qulonglong id = ++tag;
+        section += modifier + "com.example.Node\anode" + name + "\acom.example.Node@" + QByteArray::number(id * 40503 + 0x4e25154f, 16) + '\a' + QByteArray::number(id) + '\a' + QByteArray::number(id) + '\n';
+        heap += '#' + QByteArray::number(id) + '\a' + SnapshotGenerator::objectContents(shape.objectBytes, id) + '\n';
+        return;
+    }
+    }
+}
+
+QByteArray SnapshotGenerator::generate(const SnapshotShape& shape)
+{
+    QByteArray snapshot = "42\nNAME: main\nPRIORITY: NORMAL\n";
+    QByteArray heap, hashes;
+    qulonglong tag = 0;
+
+    // runtime metrics
+    snapshot += "Heap Usage\a268435456\abytes\nNon-Heap Usage\a67108864\abytes\nFree Memory\a134217728\abytes\nTotal Memory\a402653184\abytes\n"
+        "Memory Usage\a66.67\apercent\nExecution Time\a1500000000\ans\nLive Thread Count\a12\acount\n";
+    snapshot += SECTION_DELIMITER;
+
+    // call stack, the method at the breakpoint first
+    for (int i = 0; i < shape.frames; i++)
+        snapshot += "void frame" + QByteArray::number(i) + "(int, long[], java.lang.String)\n";
+    snapshot += SECTION_DELIMITER;
+
+    // local variables and static fields, their referenced objects go to the heap section
+    for (int i = 0; i < shape.locals; i++)
+        SnapshotGenerator::appendVariable(snapshot, heap, hashes, shape, QByteArray(), i, tag);
+    snapshot += SECTION_DELIMITER;
+    for (int i = 0; i < shape.statics; i++)
+        SnapshotGenerator::appendVariable(snapshot, heap, hashes, shape, "static ", i, tag);
+    snapshot += SECTION_DELIMITER + heap + SECTION_DELIMITER;
+
+    // capture metrics, one line per phase with every counter
+    for (int i = 0; i < static_cast<int>(std::size(PHASE_NAMES)); i++)
+        snapshot += QByteArray(PHASE_NAMES[i]) + '\a' + QByteArray::number((i + 1) * 125000) + '\a' + QByteArray::number(heap.size() / 12) + "\a64\a8\a4096\a20000\a32\a8192\n";
+    snapshot += SECTION_DELIMITER + hashes + SECTION_DELIMITER;
+
+    // sampled allocation sites, the totals first
+    snapshot += "TOTAL\a" + QByteArray::number(ALLOCATION_SITES * 524288) + '\a' + QByteArray::number(ALLOCATION_SITES * 16) + "\a524288\n";
+    for (int i = 0; i < ALLOCATION_SITES; i++)
+    {
+        snapshot += QByteArray::number((ALLOCATION_SITES - i) * 32768) + "\a16\aint[]";
+        for (int j = 0; j < qMin(shape.frames, 8); j++)
+            snapshot += "\avoid frame" + QByteArray::number((i + j) % shape.frames) + "(int, long[], java.lang.String)";
+        snapshot += '\n';
+    }
+    snapshot += SECTION_DELIMITER;
+
+    // a full sampler window at ten samples a second, oldest first
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        const qlonglong age = static_cast<qlonglong>(SAMPLES - i) * 100000000;
+        snapshot += QByteArray::number(age) + '\a' + QByteArray::number(134217728 + (i % 100) * 1048576) + "\a67108864\a12\a" + QByteArray::number(static_cast<qlonglong>(i) * 25000000) + '\n';
+    }
+    snapshot += SECTION_DELIMITER + "memdbgvis.visualize()\n" + SECTION_DELIMITER;
+
+    // a convoy of threads, each owning a monitor and blocked on the next one's, with their contention since the previous hit
+    for (int i = 0; i < shape.threads; i++)
+        snapshot += "THREAD\a" + QByteArray::number(i) + "\aworker-" + QByteArray::number(i) + (i + 1 < shape.threads ? "\aBLOCKED\n" : "\aRUNNABLE\n");
+    for (int i = 0; i < shape.threads; i++)
+    {
+        const QByteArray id = QByteArray::number(++tag);
+        snapshot += "MONITOR\a" + id + "\acom.example.Node@" + QByteArray::number(tag * 40503 + 0x2a139a55, 16) + '\a' + QByteArray::number(i) + "\avoid frame" + QByteArray::number(i % shape.frames) + "(int, long[], java.lang.String)\a"
+            + (i > 0 ? QByteArray::number(i - 1) : QByteArray()) + "\a\n";
+        snapshot += "CONTENTION\a" + id + "\acom.example.Node@" + QByteArray::number(tag * 40503 + 0x2a139a55, 16) + '\a' + QByteArray::number((i + 1) * 100) + '\a' + QByteArray::number((i + 1) * 5000000LL)
+            + "\a32768\a1048576\a" + QByteArray::number((i + 1) * 2000000LL) + '\n';
+    }
+
+    // ten seconds of profile, a binary calling-context tree that turns into single call chains past ten levels, ten samples at every leaf
+    const int profile_depth = qMin(shape.frames, 24);
+    const auto append_node = [&shape, profile_depth](const auto& self, QByteArray& lines, const int level, const int id) -> qlonglong
+    {
+        QByteArray callees;
+        qlonglong total = 0;
+        for (int i = 0; level + 1 < profile_depth && i < (level < PROFILE_BRANCHING_LEVELS ? 2 : 1); i++)
+            total += self(self, callees, level + 1, id * 2 + i);
+
+        const qlonglong self_samples = total == 0 ? 10 : 0;
+        total += self_samples;
+        lines += QByteArray::number(level) + "\acom.example.Worker.frame" + QByteArray::number(id % shape.frames) + '\a' + QByteArray::number(total) + '\a' + QByteArray::number(self_samples) + '\n' + callees;
+        return total;
+    };
+    QByteArray profile;
+    const qlonglong samples = append_node(append_node, profile, 0, 1);
+    snapshot += SECTION_DELIMITER + "PROFILE\a" + QByteArray::number(samples) + "\a10000000000\a10\a1000\a25000000\a0\n" + profile;
+
+    return snapshot;
+}
+
+bool SnapshotGenerator::write(const QString& filepath, const SnapshotShape& shape)
+{
+    QFile output_file(filepath);
+    if (!output_file.open(QIODevice::WriteOnly))
+        return false;
+
+    const QByteArray snapshot = SnapshotGenerator::generate(shape);
+    return output_file.write(snapshot) == snapshot.size();
+}
\ No newline at end of file
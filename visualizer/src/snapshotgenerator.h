@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef SNAPSHOTGENERATOR_H
+#define SNAPSHOTGENERATOR_H
+
+#include <QtCore>
+
+// number of entries in every section of a generated snapshot
+typedef struct
+{
+    int frames;
+    int locals;
+    int statics;
+    int arrayLength;
+    int objectBytes;
+    int threads;
+} SnapshotShape;
+
+/*
+ * Writes synthetic snapshots in the format of the agent, so the visualizer can be measured on payloads of any shape
+ * without running a program under the agent. Locals and static fields take turns being primitives, int arrays of
+ * arrayLength elements and objects with a hex dump of objectBytes bytes, and every reference comes with a tag, a heap
+ * entry and, for arrays, block hashes, like a capture of the same shape. Threads hold one monitor each and block on the
+ * next thread's, and the sampled profile is as deep as the call stack. The same shape always gives the same bytes.
+ */
+class SnapshotGenerator
+{
+    // elements per block hash, the same as the agent's
+    static constexpr int HASH_BLOCK = 4096;
+
+    static void appendVariable(QByteArray& section, QByteArray& heap, QByteArray& hashes, const SnapshotShape& shape, const QByteArray& modifier, int index, qulonglong& tag);
+    static QByteArray arrayContents(int length, qulonglong tag, QByteArray& hashes);
+    static QByteArray objectContents(int size, qulonglong tag);
+
+public:
+    static SnapshotShape parseShape(const QStringList& arguments);
+    static QByteArray generate(const SnapshotShape& shape);
+    static bool write(const QString& filepath, const SnapshotShape& shape);
+};
+
+#endif // SNAPSHOTGENERATOR_H
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "visualizerbenchmark.h"
+
+#ifdef Q_OS_WIN
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+VisualizerBenchmark::VisualizerBenchmark(QByteArray data, const int iterations)
+    : m_data(std::move(data)), m_iterations(qMax(iterations, 1))
+{
+}
+
+qint64 VisualizerBenchmark::median(QVector<qint64> samples)
+{
+    if (samples.isEmpty())
+        return 0;
+
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+}
+
+qint64 VisualizerBenchmark::peakResidentBytes()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof counters))
+        return -1;
+    return static_cast<qint64>(counters.PeakWorkingSetSize);
+#else
+    // Linux reports the peak in KiB, macOS in bytes
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#ifdef Q_OS_MACOS
+    return static_cast<qint64>(usage.ru_maxrss);
+#else
+    return static_cast<qint64>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+QJsonObject VisualizerBenchmark::run() const
+{
+    QVector<qint64> parse, window, first_paint, inspect;
+    QMap<QString, QVector<qint64>> views;
+    qsizetype inspected = 0;
+
+    for (int i = 0; i < this->m_iterations; i++)
+    {
+        QElapsedTimer total, timer;
+        total.start();
+        timer.start();
+
+        VisualizerPayload payload;
+        DebugVisualizer::deserializePayload(this->m_data, payload);
+        parse.push_back(timer.nsecsElapsed());
+
+        // the window is built and populated the way an archived snapshot is opened
+        timer.restart();
+        DebugVisualizer visualizer(payload, "Benchmark");
+        window.push_back(timer.nsecsElapsed());
+        for (const auto& [view, nanos] : visualizer.m_viewNanos)
+            views[view].push_back(nanos);
+
+        // the first frame is painted while the events posted by show() are handled
+        visualizer.resize(1600, 900);
+        visualizer.show();
+        QCoreApplication::processEvents();
+        first_paint.push_back(total.nsecsElapsed());
+
+        // every object the tables refer to is formatted as if it had been entered in the Heap Inspector
+        timer.restart();
+        inspected = 0;
+        for (auto reference = visualizer.m_heapKeys.cbegin(); reference != visualizer.m_heapKeys.cend(); ++reference)
+        {
+            if (!visualizer.m_agentData.heapByteMap.contains(reference.value().toUtf8()))
+                continue;
+
+            visualizer.ui.plainTextEdit->setPlainText(reference.key());
+            visualizer.onInspectButtonClicked();
+            inspected++;
+        }
+        inspect.push_back(timer.nsecsElapsed());
+    }
+
+    QJsonObject view_results;
+    for (auto view = views.cbegin(); view != views.cend(); ++view)
+        view_results[view.key()] = VisualizerBenchmark::median(view.value());
+
+    return {
+        { "iterations", this->m_iterations },
+        { "snapshot_bytes", this->m_data.size() },
+        { "parse_ns", VisualizerBenchmark::median(parse) },
+        { "window_ns", VisualizerBenchmark::median(window) },
+        { "first_paint_ns", VisualizerBenchmark::median(first_paint) },
+        { "inspect_ns", VisualizerBenchmark::median(inspect) },
+        { "inspected_objects", inspected },
+        { "views", view_results },
+        { "peak_rss_bytes", VisualizerBenchmark::peakResidentBytes() }
+    };
+}
+
+QStringList VisualizerBenchmark::compare(const QJsonObject& results, const QJsonObject& baseline, const double tolerance)
+{
+    // timings are only comparable on the same snapshot
+    if (results["snapshot_bytes"] != baseline["snapshot_bytes"])
+        return { "The baseline was measured on a different snapshot." };
+
+    QStringList regressions;
+    const auto check = [&regressions, tolerance](const QString& name, const double current, const double previous)
+    {
+        if (previous > 0 && current > previous * (1 + tolerance / 100))
+            regressions.push_back(QString("%1: %2 -> %3 (+%4%)").arg(name).arg(previous, 0, 'f', 0).arg(current, 0, 'f', 0).arg((current / previous - 1) * 100, 0, 'f', 1));
+    };
+
+    for (const char* const key : { "parse_ns", "window_ns", "first_paint_ns", "inspect_ns", "peak_rss_bytes" })
+        check(key, results[key].toDouble(), baseline[key].toDouble());
+
+    const QJsonObject views = results["views"].toObject(), baseline_views = baseline["views"].toObject();
+    for (auto view = views.constBegin(); view != views.constEnd(); ++view)
+        check("views." + view.key(), view.value().toDouble(), baseline_views[view.key()].toDouble());
+
+    return regressions;
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#ifndef VISUALIZERBENCHMARK_H
+#define VISUALIZERBENCHMARK_H
+
+#include <QtWidgets>
+#include "debugvisualizer.h"
+
+/*
+ * Opens one snapshot in the visualizer a number of times and reports the median time of every step as JSON: parsing,
+ * building the window, populating each tab, the first paint and formatting every object in the Heap Inspector, along
+ * with the peak resident memory of the process. It runs on Qt's offscreen platform, so it needs no display and gives
+ * the same numbers on a build machine as on a desktop. Results can be compared against a baseline to fail a build.
+ */
+class VisualizerBenchmark
+{
+    QByteArray m_data;
+    int m_iterations;
+
+    static qint64 median(QVector<qint64> samples);
+    static qint64 peakResidentBytes();
+
+public:
+    VisualizerBenchmark(QByteArray data, int iterations);
+    QJsonObject run() const;
+    static QStringList compare(const QJsonObject& results, const QJsonObject& baseline, double tolerance);
+};
+
+#endif // VISUALIZERBENCHMARK_H
\ No newline at end of file